@@ -49,6 +49,14 @@ int main(int argc, char *argv[]) {
 				config.type = BM_LIST;
 			} else if (strcmp(argv[i + 1], "set") == 0) {
 				config.type = BM_SET;
+			} else if (strcmp(argv[i + 1], "setops") == 0) {
+				config.type = BM_SETOPS;
+			} else if (strcmp(argv[i + 1], "hll") == 0) {
+				config.type = BM_HLL;
+			} else if (strcmp(argv[i + 1], "vector") == 0) {
+				config.type = BM_VECTOR;
+			} else if (strcmp(argv[i + 1], "aof") == 0) {
+				config.type = BM_AOF;
 			} else if (strcmp(argv[i + 1], "mixed") == 0) {
 				config.type = BM_MIXED;
 			} else {
@@ -69,7 +77,7 @@ int main(int argc, char *argv[]) {
 			printf("  --key-size SIZE       Size of keys in bytes (default: 10)\n");
 			printf("  --value-size SIZE     Size of values in bytes (default: 100)\n");
 			printf("  --type TYPE           Type of benchmark to run (string, hash, list, set, "
-				   "mixed)\n");
+				   "setops, hll, vector, aof, mixed)\n");
 			printf("  --redis-host HOST     Redis server hostname/IP (default: localhost)\n");
 			printf("  --redis-port PORT     Redis server port (default: 6379)\n");
 			printf("  --help                Display this help message\n");
@@ -99,6 +107,18 @@ int main(int argc, char *argv[]) {
 	case BM_SET:
 		printf("Set\n");
 		break;
+	case BM_SETOPS:
+		printf("Set Algebra\n");
+		break;
+	case BM_HLL:
+		printf("Distinct Counting\n");
+		break;
+	case BM_VECTOR:
+		printf("Vector Search\n");
+		break;
+	case BM_AOF:
+		printf("Append Only Log\n");
+		break;
 	case BM_MIXED:
 		printf("Mixed\n");
 		break;
@@ -12,7 +12,17 @@
 #include <unistd.h>
 
 // Benchmark types
-typedef enum { BM_STRING, BM_HASH, BM_LIST, BM_SET, BM_MIXED } BenchmarkType;
+typedef enum {
+	BM_STRING,
+	BM_HASH,
+	BM_LIST,
+	BM_SET,
+	BM_SETOPS,
+	BM_HLL,
+	BM_VECTOR,
+	BM_AOF,
+	BM_MIXED
+} BenchmarkType;
 
 // Benchmark config
 typedef struct {
@@ -282,6 +282,326 @@ static BenchmarkResult benchmark_set_ops(int num_ops, int key_size, int value_si
 	return result;
 }
 
+// Benchmark set algebra: server-side SINTER against shipping every set with
+// SMEMBERS and intersecting on the client
+static BenchmarkResult benchmark_setops(int num_ops, int key_size, int value_size) {
+	HashTable *ht = htable_init(HT_BASE_SIZE);
+	double start_time, end_time, client_time, server_time, card_time;
+	long client_bytes = 0, server_bytes = 0;
+	int rounds = 10;
+
+	// three overlapping sets of decreasing size
+	int sizes[3] = {num_ops, num_ops / 2, num_ops / 10};
+	char *keys[3];
+	char **values = malloc(num_ops * sizeof(char *));
+	for (int i = 0; i < num_ops; i++) {
+		values[i] = random_string(value_size);
+	}
+	for (int k = 0; k < 3; k++) {
+		keys[k] = random_string(key_size);
+		for (int i = 0; i < sizes[k]; i++) {
+			htable_sadd(ht, keys[k], values[(i * (k + 1)) % num_ops]);
+		}
+	}
+
+	char cmd[256];
+	// Client side: SMEMBERS every key, then intersect the decoded members locally
+	start_time = get_time_ms();
+	for (int r = 0; r < rounds; r++) {
+		Set *local[3];
+		for (int k = 0; k < 3; k++) {
+			snprintf(cmd, sizeof(cmd), "smembers %s", keys[k]);
+			char *reply = interpret(ht, parse(cmd));
+			client_bytes += strlen(reply);
+			free(reply);
+
+			char **members = htable_smembers(ht, keys[k]);
+			local[k] = set_init(sizes[k] * 2);
+			for (int i = 0; members[i] != NULL; i++) {
+				set_add(local[k], members[i]);
+				free(members[i]);
+			}
+			free(members);
+		}
+		Set *res = set_op(local, 3, SET_INTER);
+		set_free(res);
+		for (int k = 0; k < 3; k++) {
+			set_free(local[k]);
+		}
+	}
+	end_time = get_time_ms();
+	client_time = end_time - start_time;
+	printf("SMEMBERS + client intersect: %.2f ms (%.2f KB shipped)\n", client_time,
+		   client_bytes / 1024.0);
+
+	// Server side: one SINTER reply carrying only the intersection
+	snprintf(cmd, sizeof(cmd), "sinter %s %s %s", keys[0], keys[1], keys[2]);
+	start_time = get_time_ms();
+	for (int r = 0; r < rounds; r++) {
+		char *reply = interpret(ht, parse(cmd));
+		server_bytes += strlen(reply);
+		free(reply);
+	}
+	end_time = get_time_ms();
+	server_time = end_time - start_time;
+	printf("SINTER: %.2f ms (%.2f KB shipped)\n", server_time, server_bytes / 1024.0);
+
+	// Cardinality only, stopping early at the limit
+	snprintf(cmd, sizeof(cmd), "sintercard 3 %s %s %s limit 10", keys[0], keys[1], keys[2]);
+	start_time = get_time_ms();
+	for (int r = 0; r < rounds; r++) {
+		free(interpret(ht, parse(cmd)));
+	}
+	end_time = get_time_ms();
+	card_time = end_time - start_time;
+	printf("SINTERCARD LIMIT 10: %.2f ms\n", card_time);
+	printf("Server-side speedup: %.2fx, %.2fx fewer bytes\n", client_time / server_time,
+		   (double)client_bytes / server_bytes);
+
+	// Clean up
+	for (int k = 0; k < 3; k++) {
+		free(keys[k]);
+	}
+	for (int i = 0; i < num_ops; i++) {
+		free(values[i]);
+	}
+	free(values);
+	htable_free(ht);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = server_time,
+							  .ops_per_second = rounds / (server_time / 1000.0), // SINTER
+							  .avg_latency_ms = server_time / rounds,
+							  .type = BM_SETOPS,
+							  .num_operations = rounds,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark distinct counting: SADD on an exact set against PFADD + PFCOUNT on
+// a fixed size HyperLogLog, reporting memory and estimate error
+static BenchmarkResult benchmark_hll_ops(int num_ops, int key_size, int value_size) {
+	HashTable *ht = htable_init(HT_BASE_SIZE);
+	double start_time, end_time, set_time, hll_time;
+	char *set_key = random_string(key_size);
+	char *hll_key = random_string(key_size);
+
+	// every value is added twice, like repeat visitors
+	int distinct = num_ops / 2 > 0 ? num_ops / 2 : 1;
+	char **values = malloc(distinct * sizeof(char *));
+	for (int i = 0; i < distinct; i++) {
+		values[i] = random_string(value_size);
+	}
+
+	start_time = get_time_ms();
+	for (int i = 0; i < num_ops; i++) {
+		htable_sadd(ht, set_key, values[i % distinct]);
+	}
+	end_time = get_time_ms();
+	set_time = end_time - start_time;
+
+	start_time = get_time_ms();
+	for (int i = 0; i < num_ops; i++) {
+		htable_pfadd(ht, hll_key, &values[i % distinct], 1);
+	}
+	long long estimate = htable_pfcount(ht, &hll_key, 1);
+	end_time = get_time_ms();
+	hll_time = end_time - start_time;
+
+	// payload bytes only, allocator overhead would add to the set side
+	char **members = htable_smembers(ht, set_key);
+	long set_bytes = 0;
+	int exact = 0;
+	for (; members[exact] != NULL; exact++) {
+		set_bytes += strlen(members[exact]) + 1 + sizeof(char *);
+		free(members[exact]);
+	}
+	free(members);
+	printf("SADD: %.2f ms, %.2f KB, count %d\n", set_time, set_bytes / 1024.0, exact);
+	printf("PFADD + PFCOUNT: %.2f ms, %.2f KB, count %lld (%.2f%% error)\n", hll_time,
+		   HLL_DENSE_BYTES / 1024.0, estimate, 100.0 * (estimate - exact) / exact);
+	printf("Memory saved: %.1fx\n", (double)set_bytes / HLL_DENSE_BYTES);
+
+	// Clean up
+	free(set_key);
+	free(hll_key);
+	for (int i = 0; i < distinct; i++) {
+		free(values[i]);
+	}
+	free(values);
+	htable_free(ht);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = hll_time,
+							  .ops_per_second = num_ops / (hll_time / 1000.0), // PFADD
+							  .avg_latency_ms = hll_time / num_ops,
+							  .type = BM_HLL,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark vector search: VADD of num_ops random vectors of value_size
+// components, then VSIM top 10 over the HNSW graph at growing ef, reporting
+// latency against recall of the exact (TRUTH) results
+static BenchmarkResult benchmark_vector_ops(int num_ops, int key_size, int value_size) {
+	HashTable *ht = htable_init(HT_BASE_SIZE);
+	double start_time, end_time, build_time;
+	char *key = random_string(key_size);
+	int dim = value_size, nqueries = num_ops / 10 > 0 ? num_ops / 10 : 1, k = 10;
+	if (nqueries > 1000)
+		nqueries = 1000;
+	int efs[] = {10, 20, 40, 80, 160, 320};
+
+	char **names = malloc(num_ops * sizeof(char *));
+	float *vectors = malloc((size_t)(num_ops + nqueries) * dim * sizeof(float));
+	for (int i = 0; i < num_ops; i++) {
+		names[i] = random_string(key_size);
+	}
+	for (long i = 0; i < (long)(num_ops + nqueries) * dim; i++) {
+		vectors[i] = rand() / (float)RAND_MAX * 2 - 1;
+	}
+
+	start_time = get_time_ms();
+	for (int i = 0; i < num_ops; i++) {
+		htable_vadd(ht, key, names[i], vectors + (size_t)i * dim, dim, VEC_COSINE, VEC_F32,
+					HNSW_DEFAULT_M, HNSW_DEFAULT_EF_CONSTRUCTION);
+	}
+	end_time = get_time_ms();
+	build_time = end_time - start_time;
+	printf("VADD: %.2f ms (%.2f ops/sec), dim %d\n", build_time,
+		   num_ops / (build_time / 1000.0), dim);
+
+	// exact neighbours by a linear scan, names are borrowed from the set
+	char **truth = malloc((size_t)nqueries * k * sizeof(char *));
+	start_time = get_time_ms();
+	for (int q = 0; q < nqueries; q++) {
+		int n;
+		float *query = vectors + (size_t)(num_ops + q) * dim;
+		VecMatch *res = htable_vsim(ht, key, query, NULL, k, k, true, &n);
+		for (int i = 0; i < k; i++) {
+			truth[q * k + i] = i < n ? res[i].name : NULL;
+		}
+		free(res);
+	}
+	end_time = get_time_ms();
+	printf("VSIM TRUTH: %.3f ms per query\n", (end_time - start_time) / nqueries);
+
+	printf("    ef   latency ms   recall@%d\n", k);
+	double search_time = 0;
+	for (int e = 0; e < (int)(sizeof(efs) / sizeof(efs[0])); e++) {
+		long found = 0;
+		start_time = get_time_ms();
+		for (int q = 0; q < nqueries; q++) {
+			int n;
+			float *query = vectors + (size_t)(num_ops + q) * dim;
+			VecMatch *res = htable_vsim(ht, key, query, NULL, k, efs[e], false, &n);
+			for (int i = 0; i < n; i++) {
+				for (int j = 0; j < k; j++) {
+					found += truth[q * k + j] == res[i].name;
+				}
+			}
+			free(res);
+		}
+		end_time = get_time_ms();
+		search_time = end_time - start_time;
+		printf("%6d   %10.3f   %9.3f\n", efs[e], search_time / nqueries,
+			   (double)found / ((long)nqueries * k));
+	}
+
+	// Clean up
+	free(key);
+	for (int i = 0; i < num_ops; i++) {
+		free(names[i]);
+	}
+	free(names);
+	free(vectors);
+	free(truth);
+	htable_free(ht);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = build_time,
+							  .ops_per_second = num_ops / (build_time / 1000.0), // VADD
+							  .avg_latency_ms = build_time / num_ops,
+							  .type = BM_VECTOR,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark the append only log, SETs through the interpreter with the log off
+// and then under each fsync policy. Commands are flushed in batches the way the
+// event loop flushes those of all the clients it served in an iteration, and
+// under always each batch waits for its fsync as its replies would.
+static BenchmarkResult benchmark_aof_ops(int num_ops, int key_size, int value_size) {
+	const char *path = "hyperkv_benchmark.aof";
+	const char *names[] = {"off", "no", "everysec", "always"};
+	int policies[] = {-1, AOF_FSYNC_NO, AOF_FSYNC_EVERYSEC, AOF_FSYNC_ALWAYS};
+	int batches[] = {1, 32};
+	double start_time, end_time, operation_time = 0;
+	char **cmds = malloc(num_ops * sizeof(char *));
+
+	// Generate random SET commands
+	for (int i = 0; i < num_ops; i++) {
+		char *key = random_string(key_size), *value = random_string(value_size);
+		cmds[i] = malloc(key_size + value_size + 8);
+		sprintf(cmds[i], "set %s %s", key, value);
+		free(key);
+		free(value);
+	}
+
+	printf("  policy   batch     ops/sec   vs off\n");
+	for (int b = 0; b < 2; b++) {
+		double base = 0;
+		for (int p = 0; p < 4; p++) {
+			HashTable *ht = htable_init(num_ops);
+			unlink(path);
+			if (policies[p] >= 0)
+				aof_open(ht, (char *)path, policies[p]);
+			start_time = get_time_ms();
+			for (int i = 0; i < num_ops; i++) {
+				free(interpret(ht, parse(cmds[i])));
+				if ((i + 1) % batches[b] == 0 || i == num_ops - 1) {
+					aof_flush();
+					aof_wait();
+				}
+			}
+			end_time = get_time_ms();
+			operation_time = end_time - start_time;
+			aof_close();
+			htable_free(ht);
+			double ops = num_ops / (operation_time / 1000.0);
+			if (p == 0)
+				base = ops;
+			printf("%8s   %5d   %9.0f   %5.2fx\n", names[p], batches[b], ops, ops / base);
+		}
+	}
+	unlink(path);
+
+	// Clean up
+	for (int i = 0; i < num_ops; i++) {
+		free(cmds[i]);
+	}
+	free(cmds);
+
+	// Calculate results, from always with the largest batch
+	BenchmarkResult result = {.total_time_ms = operation_time,
+							  .ops_per_second = num_ops / (operation_time / 1000.0), // SET
+							  .avg_latency_ms = operation_time / num_ops,
+							  .type = BM_AOF,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
 // Run a benchmark based on configuration
 BenchmarkResult run_local_benchmark(BenchmarkConfig config) {
 	printf("Running local HyperKV benchmark with %d operations...\n", config.num_operations);
@@ -296,6 +616,14 @@ BenchmarkResult run_local_benchmark(BenchmarkConfig config) {
 		return benchmark_list_ops(config.num_operations, config.key_size, config.value_size);
 	case BM_SET:
 		return benchmark_set_ops(config.num_operations, config.key_size, config.value_size);
+	case BM_SETOPS:
+		return benchmark_setops(config.num_operations, config.key_size, config.value_size);
+	case BM_HLL:
+		return benchmark_hll_ops(config.num_operations, config.key_size, config.value_size);
+	case BM_VECTOR:
+		return benchmark_vector_ops(config.num_operations, config.key_size, config.value_size);
+	case BM_AOF:
+		return benchmark_aof_ops(config.num_operations, config.key_size, config.value_size);
 	case BM_MIXED:
 		// For mixed benchmarks, we'll split operations between different types
 		printf("Running mixed benchmark (25%% each type)...\n");
@@ -305,6 +305,234 @@ static BenchmarkResult benchmark_set_ops_redis(redisContext *ctx, int num_ops, i
 	return result;
 }
 
+// Benchmark set algebra (SINTER) with Redis
+static BenchmarkResult benchmark_setops_redis(redisContext *ctx, int num_ops, int key_size,
+											  int value_size) {
+	double start_time, end_time, operation_time;
+	int rounds = 10;
+
+	// three overlapping sets of decreasing size, same shape as the local benchmark
+	int sizes[3] = {num_ops, num_ops / 2, num_ops / 10};
+	char *keys[3];
+	char **values = malloc(num_ops * sizeof(char *));
+	for (int i = 0; i < num_ops; i++) {
+		values[i] = random_string(value_size);
+	}
+	for (int k = 0; k < 3; k++) {
+		keys[k] = random_string(key_size);
+		for (int i = 0; i < sizes[k]; i++) {
+			redisReply *reply =
+				redisCommand(ctx, "SADD %s %s", keys[k], values[(i * (k + 1)) % num_ops]);
+			freeReplyObject(reply);
+		}
+	}
+
+	// Benchmark SINTER operations
+	start_time = get_time_ms();
+	for (int r = 0; r < rounds; r++) {
+		redisReply *reply = redisCommand(ctx, "SINTER %s %s %s", keys[0], keys[1], keys[2]);
+		freeReplyObject(reply);
+	}
+	end_time = get_time_ms();
+	operation_time = end_time - start_time;
+	printf("Redis SINTER: %.2f ms (%.2f ops/sec)\n", operation_time,
+		   rounds / (operation_time / 1000.0));
+
+	// Clean up
+	for (int k = 0; k < 3; k++) {
+		free(keys[k]);
+	}
+	for (int i = 0; i < num_ops; i++) {
+		free(values[i]);
+	}
+	free(values);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = operation_time,
+							  .ops_per_second = rounds / (operation_time / 1000.0), // SINTER
+							  .avg_latency_ms = operation_time / rounds,
+							  .type = BM_SETOPS,
+							  .num_operations = rounds,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark distinct counting (PFADD + PFCOUNT) with Redis
+static BenchmarkResult benchmark_hll_ops_redis(redisContext *ctx, int num_ops, int key_size,
+											   int value_size) {
+	double start_time, end_time, operation_time;
+	char *key = random_string(key_size);
+
+	// every value is added twice, same shape as the local benchmark
+	int distinct = num_ops / 2 > 0 ? num_ops / 2 : 1;
+	char **values = malloc(distinct * sizeof(char *));
+	for (int i = 0; i < distinct; i++) {
+		values[i] = random_string(value_size);
+	}
+
+	start_time = get_time_ms();
+	for (int i = 0; i < num_ops; i++) {
+		redisReply *reply = redisCommand(ctx, "PFADD %s %s", key, values[i % distinct]);
+		freeReplyObject(reply);
+	}
+	redisReply *reply = redisCommand(ctx, "PFCOUNT %s", key);
+	long long estimate = reply->integer;
+	freeReplyObject(reply);
+	end_time = get_time_ms();
+	operation_time = end_time - start_time;
+	printf("Redis PFADD + PFCOUNT: %.2f ms, count %lld\n", operation_time, estimate);
+
+	// Clean up
+	free(key);
+	for (int i = 0; i < distinct; i++) {
+		free(values[i]);
+	}
+	free(values);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = operation_time,
+							  .ops_per_second = num_ops / (operation_time / 1000.0), // PFADD
+							  .avg_latency_ms = operation_time / num_ops,
+							  .type = BM_HLL,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark vector search (VADD + VSIM) with Redis 8 vector sets, same shape
+// as the local benchmark at the default ef
+static BenchmarkResult benchmark_vector_ops_redis(redisContext *ctx, int num_ops, int key_size,
+												  int value_size) {
+	double start_time, end_time, operation_time;
+	char *key = random_string(key_size);
+	int dim = value_size, nqueries = num_ops / 10 > 0 ? num_ops / 10 : 1;
+	if (nqueries > 1000)
+		nqueries = 1000;
+
+	// VADD key VALUES dim x1 .. xdim element NOQUANT
+	int argc = dim + 6;
+	const char **argv = malloc(argc * sizeof(char *));
+	char **components = malloc(dim * sizeof(char *));
+	char dimstr[16];
+	sprintf(dimstr, "%d", dim);
+	for (int i = 0; i < dim; i++) {
+		components[i] = malloc(16);
+	}
+
+	start_time = get_time_ms();
+	for (int i = 0; i < num_ops; i++) {
+		char *name = random_string(key_size);
+		argv[0] = "VADD";
+		argv[1] = key;
+		argv[2] = "VALUES";
+		argv[3] = dimstr;
+		for (int j = 0; j < dim; j++) {
+			sprintf(components[j], "%.6f", rand() / (float)RAND_MAX * 2 - 1);
+			argv[4 + j] = components[j];
+		}
+		argv[4 + dim] = name;
+		argv[5 + dim] = "NOQUANT";
+		redisReply *reply = redisCommandArgv(ctx, argc, argv, NULL);
+		freeReplyObject(reply);
+		free(name);
+	}
+	end_time = get_time_ms();
+	operation_time = end_time - start_time;
+	printf("Redis VADD: %.2f ms (%.2f ops/sec), dim %d\n", operation_time,
+		   num_ops / (operation_time / 1000.0), dim);
+
+	// VSIM key VALUES dim x1 .. xdim COUNT 10
+	double search_time;
+	start_time = get_time_ms();
+	for (int q = 0; q < nqueries; q++) {
+		argv[0] = "VSIM";
+		for (int j = 0; j < dim; j++) {
+			sprintf(components[j], "%.6f", rand() / (float)RAND_MAX * 2 - 1);
+			argv[4 + j] = components[j];
+		}
+		argv[4 + dim] = "COUNT";
+		argv[5 + dim] = "10";
+		redisReply *reply = redisCommandArgv(ctx, argc, argv, NULL);
+		freeReplyObject(reply);
+	}
+	end_time = get_time_ms();
+	search_time = end_time - start_time;
+	printf("Redis VSIM: %.3f ms per query\n", search_time / nqueries);
+
+	// Clean up
+	free(key);
+	for (int i = 0; i < dim; i++) {
+		free(components[i]);
+	}
+	free(components);
+	free(argv);
+
+	// Calculate results
+	BenchmarkResult result = {.total_time_ms = operation_time,
+							  .ops_per_second = num_ops / (operation_time / 1000.0), // VADD
+							  .avg_latency_ms = operation_time / num_ops,
+							  .type = BM_VECTOR,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
+// Benchmark SETs with Redis under each appendfsync policy, one client so every
+// command is its own event loop iteration
+static BenchmarkResult benchmark_aof_ops_redis(redisContext *ctx, int num_ops, int key_size,
+											   int value_size) {
+	const char *names[] = {"no", "everysec", "always"};
+	double start_time, end_time, operation_time = 0;
+	char **keys = malloc(num_ops * sizeof(char *));
+	char **values = malloc(num_ops * sizeof(char *));
+
+	// Generate random keys and values
+	for (int i = 0; i < num_ops; i++) {
+		keys[i] = random_string(key_size);
+		values[i] = random_string(value_size);
+	}
+
+	freeReplyObject(redisCommand(ctx, "CONFIG SET appendonly yes"));
+	for (int p = 0; p < 3; p++) {
+		freeReplyObject(redisCommand(ctx, "CONFIG SET appendfsync %s", names[p]));
+		start_time = get_time_ms();
+		for (int i = 0; i < num_ops; i++) {
+			redisReply *reply = redisCommand(ctx, "SET %s %s", keys[i], values[i]);
+			freeReplyObject(reply);
+		}
+		end_time = get_time_ms();
+		operation_time = end_time - start_time;
+		printf("Redis SET appendfsync %s: %.2f ms (%.2f ops/sec)\n", names[p], operation_time,
+			   num_ops / (operation_time / 1000.0));
+	}
+	freeReplyObject(redisCommand(ctx, "CONFIG SET appendonly no"));
+
+	// Clean up
+	for (int i = 0; i < num_ops; i++) {
+		free(keys[i]);
+		free(values[i]);
+	}
+	free(keys);
+	free(values);
+
+	// Calculate results, from always
+	BenchmarkResult result = {.total_time_ms = operation_time,
+							  .ops_per_second = num_ops / (operation_time / 1000.0), // SET
+							  .avg_latency_ms = operation_time / num_ops,
+							  .type = BM_AOF,
+							  .num_operations = num_ops,
+							  .key_size = key_size,
+							  .value_size = value_size};
+
+	return result;
+}
+
 // Run a benchmark based on configuration
 BenchmarkResult run_redis_benchmark(BenchmarkConfig config) {
 	if (!config.is_local) {
@@ -336,6 +564,22 @@ BenchmarkResult run_redis_benchmark(BenchmarkConfig config) {
 			result = benchmark_set_ops_redis(ctx, config.num_operations, config.key_size,
 											 config.value_size);
 			break;
+		case BM_SETOPS:
+			result = benchmark_setops_redis(ctx, config.num_operations, config.key_size,
+											config.value_size);
+			break;
+		case BM_HLL:
+			result = benchmark_hll_ops_redis(ctx, config.num_operations, config.key_size,
+											 config.value_size);
+			break;
+		case BM_VECTOR:
+			result = benchmark_vector_ops_redis(ctx, config.num_operations, config.key_size,
+												config.value_size);
+			break;
+		case BM_AOF:
+			result = benchmark_aof_ops_redis(ctx, config.num_operations, config.key_size,
+											 config.value_size);
+			break;
 		case BM_MIXED:
 			// For mixed benchmarks, we'll split operations between different types
 			printf("Running mixed Redis benchmark (25%% each type)...\n");
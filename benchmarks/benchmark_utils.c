@@ -37,6 +37,18 @@ void print_benchmark_result(BenchmarkResult result) {
 	case BM_SET:
 		type_str = "Set";
 		break;
+	case BM_SETOPS:
+		type_str = "Set Algebra";
+		break;
+	case BM_HLL:
+		type_str = "Distinct Counting";
+		break;
+	case BM_VECTOR:
+		type_str = "Vector Search";
+		break;
+	case BM_AOF:
+		type_str = "Append Only Log";
+		break;
 	case BM_MIXED:
 		type_str = "Mixed";
 		break;
@@ -67,6 +79,18 @@ void print_benchmark_comparison(BenchmarkResult hyperkv, BenchmarkResult redis)
 	case BM_SET:
 		type_str = "Set";
 		break;
+	case BM_SETOPS:
+		type_str = "Set Algebra";
+		break;
+	case BM_HLL:
+		type_str = "Distinct Counting";
+		break;
+	case BM_VECTOR:
+		type_str = "Vector Search";
+		break;
+	case BM_AOF:
+		type_str = "Append Only Log";
+		break;
 	case BM_MIXED:
 		type_str = "Mixed";
 		break;
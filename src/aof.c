@@ -0,0 +1,731 @@
+#include "common.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Append only log of the commands that changed the keyspace, one per line and
+// quoted the way a client would type them, after an optional snapshot of the
+// dataset the log started from. Commands are captured once they succeed and
+// rewritten where replaying them verbatim would not redo the same change, so
+// XADD and TS.ADD log the id or timestamp they picked and blocking pops log
+// the plain pop they ended up doing.
+//
+// The commands of one event loop iteration are buffered and go out in a
+// single write() at its end, closed by a line holding the CRC32C and length of
+// the batch. Replay only runs a batch once its line vouches for it, so a batch
+// a crash cut short is dropped and a damaged one stops the load. A background
+// thread then fsyncs after every write (always) or once a second (everysec),
+// or syncing is left to the kernel (no). The server holds replies back until
+// the log is as durable as the policy promises up to the commands they
+// acknowledge, so with always the writes of all clients in an iteration share
+// one fsync.
+//
+// BGREWRITEAOF, or the log doubling in size past AOF_REWRITE_MIN_BYTES, forks
+// a child, or in SNAPSHOT_INCREMENTAL mode starts a checkpoint, that writes a
+// snapshot of the dataset to a new log, the smallest form of the state as
+// sketches and indexes could not be rebuilt exactly from commands. Meanwhile
+// the commands fed are also kept aside, and once the snapshot is done they are
+// appended to the new log, which is synced and renamed over the old one. The
+// new file is moved under the log's fd with dup2(), so an fsync running on the
+// old file finishes there.
+
+static struct {
+	int fd;
+	int policy;
+	char *path;
+	// commands of the current iteration
+	char *buf;
+	long long len;
+	long long cap;
+	// bytes of buf already closed by a checksum line
+	long long sealed;
+	// bytes fed since the open, and of those the ones written and synced
+	long long fed;
+	long long written;
+	long long synced;
+	long long size;
+	bool write_ok;
+	long long fsyncs;
+	// the sync thread writes a byte to notify[1] after each fsync under always
+	int notify[2];
+	pthread_t thread;
+	bool stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	// pid of the child rewriting the log, 0 when none is running
+	pid_t child;
+	// whether a checkpoint is writing the rewritten log instead
+	bool checkpoint;
+	char *rewrite_path;
+	// commands fed since the child was forked
+	char *rewrite_buf;
+	long long rewrite_len;
+	long long rewrite_cap;
+	long long rewrite_started;
+	bool rewrite_ok;
+	// size of the log right after it was opened or last rewritten
+	long long base_size;
+} aof = {.fd = -1,
+		 .notify = {-1, -1},
+		 .write_ok = true,
+		 .rewrite_ok = true,
+		 .lock = PTHREAD_MUTEX_INITIALIZER,
+		 .cond = PTHREAD_COND_INITIALIZER};
+
+// names the logged commands are written under, NULL for those that change
+// nothing. Blocking pops are logged as the pops they did.
+static const char *logged[UNKNOWN] = {
+	[DEL] = "del",
+	[SET] = "set",
+	[MSET] = "mset",
+	[INCR] = "incr",
+	[DECR] = "decr",
+	[INCRBY] = "incrby",
+	[DECRBY] = "decrby",
+	[HSET] = "hset",
+	[HDEL] = "hdel",
+	[LPUSH] = "lpush",
+	[LPOP] = "lpop",
+	[RPUSH] = "rpush",
+	[RPOP] = "rpop",
+	[LSET] = "lset",
+	[LREM] = "lrem",
+	[SADD] = "sadd",
+	[SREM] = "srem",
+	[SINTERSTORE] = "sinterstore",
+	[SUNIONSTORE] = "sunionstore",
+	[SDIFFSTORE] = "sdiffstore",
+	[LMOVE] = "lmove",
+	[BLPOP] = "lpop",
+	[BRPOP] = "rpop",
+	[BLMOVE] = "lmove",
+	[ZADD] = "zadd",
+	[ZREM] = "zrem",
+	[ZINCRBY] = "zincrby",
+	[PFADD] = "pfadd",
+	[PFMERGE] = "pfmerge",
+	[SETBIT] = "setbit",
+	[BITOP] = "bitop",
+	[RBADD] = "rbadd",
+	[RBREM] = "rbrem",
+	[RBOP] = "rbop",
+	[XADD] = "xadd",
+	[XTRIM] = "xtrim",
+	[XGROUP] = "xgroup",
+	[XREADGROUP] = "xreadgroup",
+	[XACK] = "xack",
+	[BFRESERVE] = "bf.reserve",
+	[BFADD] = "bf.add",
+	[BFMADD] = "bf.madd",
+	[TSCREATE] = "ts.create",
+	[TSADD] = "ts.add",
+	[JSONSET] = "json.set",
+	[JSONDEL] = "json.del",
+	[JSONNUMINCRBY] = "json.numincrby",
+	[JSONSTRAPPEND] = "json.strappend",
+	[JSONARRAPPEND] = "json.arrappend",
+	[VADD] = "vadd",
+	[VREM] = "vrem",
+	[CMSINITBYDIM] = "cms.initbydim",
+	[CMSINITBYPROB] = "cms.initbyprob",
+	[CMSINCRBY] = "cms.incrby",
+	[CMSMERGE] = "cms.merge",
+	[TOPKRESERVE] = "topk.reserve",
+	[TOPKADD] = "topk.add",
+	[TOPKINCRBY] = "topk.incrby",
+	[GEOADD] = "geoadd",
+	[THROTTLE] = "cl.throttle",
+};
+
+static const char *policy_names[] = {"no", "everysec", "always"};
+
+static long long now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void append(const char *s, long long n) {
+	if (aof.len + n > aof.cap) {
+		aof.cap = aof.len + n > 2 * aof.cap ? aof.len + n : 2 * aof.cap;
+		aof.buf = drealloc(aof.buf, aof.cap);
+	}
+	memcpy(aof.buf + aof.len, s, n);
+	aof.len += n;
+	aof.fed += n;
+}
+
+// double quoted as the parser reads it back, where only " and \ are escaped
+static void append_quoted(const char *s) {
+	append(" \"", 2);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\')
+			append("\\", 1);
+		append(s, 1);
+	}
+	append("\"", 1);
+}
+
+// the first bulk string of a reply, past the array header if there is one
+static char *reply_bulk(char *reply) {
+	if (*reply == '*')
+		reply = strchr(reply, '\n') + 1;
+	int n = atoi(reply + 1);
+	return strndup(strchr(reply, '\n') + 1, n);
+}
+
+// index of the id in xadd key [nomkstream] [maxlen [=|~] threshold] id ...
+static int xadd_id(Command *cmd) {
+	int i = 1;
+	if (strcmp(cmd->argv[i], "nomkstream") == 0)
+		i++;
+	if (strcmp(cmd->argv[i], "maxlen") == 0) {
+		i++;
+		if (strcmp(cmd->argv[i], "~") == 0 || strcmp(cmd->argv[i], "=") == 0)
+			i++;
+		i++;
+	}
+	return i;
+}
+
+// appends cmd to the log if it changed the keyspace, given its reply
+void aof_feed(Command *cmd, char *reply) {
+	if (aof.fd < 0 || cmd->type >= UNKNOWN || logged[cmd->type] == NULL)
+		return;
+	// errors and null replies changed nothing, nor did a limited request
+	if (*reply == '-' || *reply == 'b' || strncmp(reply + 1, "-1\r\n", 4) == 0)
+		return;
+	if (cmd->type == THROTTLE && strncmp(reply, "*5\r\n:1\r\n", 8) == 0)
+		return;
+	int argc = cmd->argc;
+	char **argv = dmalloc((argc + 1) * sizeof(char *));
+	memcpy(argv, cmd->argv, argc * sizeof(char *));
+	char *picked = NULL;
+	switch (cmd->type) {
+	case BLPOP:
+	case BRPOP:
+		picked = reply_bulk(reply);
+		argv[0] = picked;
+		argc = 1;
+		break;
+	case BLMOVE:
+		argc = 4;
+		break;
+	case XADD:
+		picked = reply_bulk(reply);
+		argv[xadd_id(cmd)] = picked;
+		break;
+	case TSADD:
+		picked = strndup(reply + 1, strcspn(reply + 1, "\r"));
+		argv[1] = picked;
+		break;
+	case XREADGROUP:
+		// a replay must not block, as the entries it read are there by then
+		for (int i = 3; i < argc && strcmp(argv[i], "streams") != 0;) {
+			if (strcmp(argv[i], "block") == 0) {
+				memmove(argv + i, argv + i + 2, (argc - i - 2) * sizeof(char *));
+				argc -= 2;
+			} else {
+				i += strcmp(argv[i], "noack") == 0 ? 1 : 2;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	long long from = aof.len;
+	append(logged[cmd->type], strlen(logged[cmd->type]));
+	for (int i = 0; i < argc; i++)
+		append_quoted(argv[i]);
+	append("\n", 1);
+	if (aof_rewriting()) {
+		long long n = aof.len - from;
+		if (aof.rewrite_len + n > aof.rewrite_cap) {
+			aof.rewrite_cap = 2 * (aof.rewrite_len + n);
+			aof.rewrite_buf = drealloc(aof.rewrite_buf, aof.rewrite_cap);
+		}
+		memcpy(aof.rewrite_buf + aof.rewrite_len, aof.buf + from, n);
+		aof.rewrite_len += n;
+	}
+	free(picked);
+	free(argv);
+}
+
+// the line closing the n bytes at p, written to line
+static int seal_line(char *line, const char *p, long long n) {
+	return sprintf(line, "#%08x %lld\n", crc32c(0, p, n), n);
+}
+
+// closes the commands appended since the last checksum line
+static void seal() {
+	if (aof.sealed == aof.len)
+		return;
+	char line[48];
+	append(line, seal_line(line, aof.buf + aof.sealed, aof.len - aof.sealed));
+	aof.sealed = aof.len;
+}
+
+// writes all n bytes of buf to fd, false if it could not
+static bool write_all(int fd, char *buf, long long n) {
+	while (n > 0) {
+		ssize_t done = write(fd, buf, n);
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done <= 0)
+			return false;
+		buf += done;
+		n -= done;
+	}
+	return true;
+}
+
+// writes the commands of the iteration in one go. A failed or short write is
+// cut off the file and retried as a whole later, as the log must not end in
+// half a command that later appends would run into.
+void aof_flush() {
+	if (aof.fd < 0 || aof.len == 0)
+		return;
+	seal();
+	long long done = 0;
+	while (done < aof.len) {
+		ssize_t n = write(aof.fd, aof.buf + done, aof.len - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	if (done < aof.len) {
+		if (aof.write_ok)
+			log_error("Failed to write to %s: %s", aof.path, strerror(errno));
+		if (done > 0 && ftruncate(aof.fd, aof.size) != 0)
+			log_error("Failed to undo a short write to %s: %s", aof.path, strerror(errno));
+		aof.write_ok = false;
+		return;
+	}
+	if (!aof.write_ok)
+		log_info("Writing to %s works again", aof.path);
+	aof.write_ok = true;
+	aof.size += done;
+	aof.len = aof.sealed = 0;
+	pthread_mutex_lock(&aof.lock);
+	aof.written += done;
+	if (aof.policy == AOF_FSYNC_ALWAYS)
+		pthread_cond_signal(&aof.cond);
+	pthread_mutex_unlock(&aof.lock);
+}
+
+// fsyncs what was written, after every write under always and at most once a
+// second under everysec
+static void *sync_loop(void *arg) {
+	pthread_mutex_lock(&aof.lock);
+	while (!aof.stop) {
+		if (aof.policy == AOF_FSYNC_EVERYSEC) {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec++;
+			pthread_cond_timedwait(&aof.cond, &aof.lock, &ts);
+		} else if (aof.synced == aof.written) {
+			pthread_cond_wait(&aof.cond, &aof.lock);
+		}
+		if (aof.stop || aof.synced == aof.written)
+			continue;
+		long long target = aof.written;
+		pthread_mutex_unlock(&aof.lock);
+		// a failed fsync may have dropped the pages it failed on, so what was
+		// acknowledged can no longer be vouched for
+		if (fdatasync(aof.fd) != 0) {
+			log_fatal("Failed to fsync %s: %s", aof.path, strerror(errno));
+			exit(1);
+		}
+		pthread_mutex_lock(&aof.lock);
+		aof.synced = target;
+		aof.fsyncs++;
+		if (aof.policy == AOF_FSYNC_ALWAYS)
+			write(aof.notify[1], "", 1);
+	}
+	pthread_mutex_unlock(&aof.lock);
+	return NULL;
+}
+
+// starts appending to the log at path, a log that does not exist yet starts
+// with a snapshot of the data already in ht
+bool aof_open(HashTable *ht, char *path, int policy) {
+	if (access(path, F_OK) != 0 && ht->used > 0 && !snapshot_save(ht, path))
+		return false;
+	int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0) {
+		log_error("Failed to open %s: %s", path, strerror(errno));
+		return false;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	aof.fd = fd;
+	aof.path = strdup(path);
+	aof.rewrite_path = dmalloc(strlen(path) + 16);
+	sprintf(aof.rewrite_path, "%s.rewrite", path);
+	aof.policy = policy;
+	aof.size = aof.base_size = st.st_size;
+	aof.fed = aof.written = aof.synced = aof.fsyncs = 0;
+	aof.write_ok = true;
+	aof.stop = false;
+	if (policy != AOF_FSYNC_NO) {
+		if (pipe(aof.notify) != 0) {
+			log_error("Failed to create the fsync pipe: %s", strerror(errno));
+			aof.notify[0] = aof.notify[1] = -1;
+		}
+		fcntl(aof.notify[0], F_SETFL, O_NONBLOCK);
+		fcntl(aof.notify[1], F_SETFL, O_NONBLOCK);
+		pthread_create(&aof.thread, NULL, sync_loop, NULL);
+	}
+	log_info("Appending to %s, fsync %s", path, policy_names[policy]);
+	return true;
+}
+
+// runs one logged command, a failure means the log does not match the
+// snapshot it started from
+static bool replay(HashTable *ht, char *line) {
+	char *res = interpret(ht, parse(line));
+	bool ok = *res != '-';
+	if (!ok)
+		log_warn("Replaying '%s' failed: %.*s", line, (int)strcspn(res, "\r"), res);
+	free(res);
+	return ok;
+}
+
+// reads the commands from the current offset of fd, *end, on, replaying them
+// into ht unless it is NULL. A batch is replayed once its checksum line
+// matches, and *end is moved past it. Commands before the first checksum line
+// that it does not cover come from a log written without checksums and are
+// taken as they are. Returns the number of commands, or -1 at a checksum line
+// that does not match, and counts the batches in *batches.
+long long aof_scan(HashTable *ht, int fd, char *path, long long *end, long long *batches) {
+	char *buf = dmalloc(SNAPSHOT_BUF_BYTES);
+	// the batch read since the last checksum line, as it is in the file, and
+	// where each of its commands ends
+	char *batch = dmalloc(64);
+	long long *ends = dmalloc(8 * sizeof(long long));
+	long long n = 0, len = 0, cap = 64, count = 0, ends_cap = 8, failed = 0;
+	bool quoted = false, escaped = false, sealed = false, corrupt = false;
+	ssize_t got;
+	while (!corrupt && (got = read(fd, buf, SNAPSHOT_BUF_BYTES)) > 0) {
+		for (ssize_t i = 0; i < got && !corrupt; i++) {
+			char c = buf[i];
+			if (len + 1 > cap) {
+				cap *= 2;
+				batch = drealloc(batch, cap);
+			}
+			batch[len++] = c;
+			// a command ends at the first newline outside of quotes
+			if (c != '\n' || quoted) {
+				if (escaped)
+					escaped = false;
+				else if (quoted && c == '\\')
+					escaped = true;
+				else if (c == '"')
+					quoted = !quoted;
+				continue;
+			}
+			long long start = count > 0 ? ends[count - 1] + 1 : 0;
+			if (batch[start] != '#') {
+				if (count == ends_cap) {
+					ends_cap *= 2;
+					ends = drealloc(ends, ends_cap * sizeof(long long));
+				}
+				ends[count++] = len - 1;
+				continue;
+			}
+			batch[len - 1] = '\0';
+			unsigned int crc;
+			long long bytes;
+			corrupt = sscanf(batch + start, "#%8x %lld", &crc, &bytes) != 2 || bytes < 0 ||
+					  bytes > start || (sealed && bytes != start) ||
+					  crc32c(0, batch + start - bytes, bytes) != crc;
+			if (corrupt) {
+				log_error("Checksum mismatch in %s in the batch after offset %lld", path, *end);
+				break;
+			}
+			for (long long k = 0; k < count; k++) {
+				batch[ends[k]] = '\0';
+				if (ht != NULL)
+					failed += !replay(ht, batch + (k > 0 ? ends[k - 1] + 1 : 0));
+			}
+			n += count;
+			*end += len;
+			(*batches)++;
+			len = count = 0;
+			sealed = true;
+		}
+	}
+	if (!corrupt && !sealed && count > 0) {
+		// a log written before checksums, taken up to its last whole command
+		for (long long k = 0; k < count; k++) {
+			batch[ends[k]] = '\0';
+			if (ht != NULL)
+				failed += !replay(ht, batch + (k > 0 ? ends[k - 1] + 1 : 0));
+		}
+		n += count;
+		*end += ends[count - 1] + 1;
+	}
+	if (failed > 0)
+		log_warn("%lld commands of %s failed to replay", failed, path);
+	free(buf);
+	free(batch);
+	free(ends);
+	return corrupt ? -1 : n;
+}
+
+// replays the log at path into ht, returns the number of commands replayed, 0
+// if there is no log and -1 if it is damaged. A batch a crash cut short is
+// dropped from the file.
+long long aof_load(HashTable *ht, char *path) {
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return 0;
+		log_error("Failed to open %s: %s", path, strerror(errno));
+		return -1;
+	}
+	long long start = now_us(), end = 0, batches = 0;
+	char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+	if (read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+		memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+		lseek(fd, 0, SEEK_SET);
+		if (snapshot_read(ht, fd, path, &end) < 0) {
+			close(fd);
+			return -1;
+		}
+	}
+	lseek(fd, end, SEEK_SET);
+	long long n = aof_scan(ht, fd, path, &end, &batches);
+	struct stat st;
+	if (n >= 0 && fstat(fd, &st) == 0 && st.st_size > end) {
+		log_warn("Dropping %lld bytes of a batch cut short at the end of %s",
+				 (long long)st.st_size - end, path);
+		if (ftruncate(fd, end) != 0)
+			log_error("Failed to truncate %s: %s", path, strerror(errno));
+	}
+	if (n >= 0)
+		log_info("Replayed %lld commands in %lld batches from %s in %lld us", n, batches, path,
+				 now_us() - start);
+	close(fd);
+	return n;
+}
+
+// whether commands of the type are logged, the ones that may change keys
+bool aof_logs(int type) { return type < UNKNOWN && logged[type] != NULL; }
+
+bool aof_enabled() { return aof.fd >= 0; }
+
+long long aof_offset() { return aof.fed; }
+
+// how far the log is as durable as the policy promises
+long long aof_durable() {
+	pthread_mutex_lock(&aof.lock);
+	long long res = aof.policy == AOF_FSYNC_ALWAYS ? aof.synced : aof.written;
+	pthread_mutex_unlock(&aof.lock);
+	return res;
+}
+
+int aof_notify_fd() { return aof.notify[0]; }
+
+// drains the fsync notifications
+void aof_poll() {
+	char tmp[64];
+	while (aof.notify[0] >= 0 && read(aof.notify[0], tmp, sizeof(tmp)) > 0)
+		;
+}
+
+// waits until everything written is durable, false if a write is pending
+bool aof_wait() {
+	if (aof.len > 0)
+		return false;
+	struct pollfd pfd = {.fd = aof.notify[0], .events = POLLIN};
+	while (aof_durable() < aof.written) {
+		poll(&pfd, 1, -1);
+		aof_poll();
+	}
+	return true;
+}
+
+// BGREWRITEAOF, returns 1 once the child is started, 0 if a rewrite or a
+// background save is already running and -1 if fork failed
+int aof_rewrite(HashTable *ht) {
+	if (aof_rewriting() || snapshot_running())
+		return 0;
+	long long start = now_us();
+	if (snapshot_mode() == SNAPSHOT_INCREMENTAL) {
+		if (!snapshot_checkpoint(ht, aof.rewrite_path)) {
+			aof.rewrite_ok = false;
+			return -1;
+		}
+		aof.checkpoint = true;
+		aof.rewrite_started = start;
+		aof.rewrite_len = 0;
+		log_info("Rewriting %s from a checkpoint", aof.path);
+		return 1;
+	}
+	pid_t pid = fork();
+	if (pid == 0)
+		_exit(snapshot_save(ht, aof.rewrite_path) ? 0 : 1);
+	if (pid < 0) {
+		log_error("Failed to fork to rewrite %s: %s", aof.path, strerror(errno));
+		aof.rewrite_ok = false;
+		return -1;
+	}
+	aof.child = pid;
+	aof.rewrite_started = start;
+	aof.rewrite_len = 0;
+	log_info("Rewriting %s in pid %d, fork took %lld us", aof.path, (int)pid, now_us() - start);
+	return 1;
+}
+
+bool aof_rewriting() { return aof.child > 0 || aof.checkpoint; }
+
+// appends the commands fed during the rewrite to the new log and swaps it in
+static bool rewrite_done() {
+	// what is still buffered goes to the old log, the new one gets it below
+	aof_flush();
+	int fd = open(aof.rewrite_path, O_WRONLY | O_APPEND);
+	if (aof.len > 0 || fd < 0)
+		return false;
+	struct stat st;
+	char line[48];
+	int sealed = aof.rewrite_len > 0 ? seal_line(line, aof.rewrite_buf, aof.rewrite_len) : 0;
+	bool ok = write_all(fd, aof.rewrite_buf, aof.rewrite_len) && write_all(fd, line, sealed) &&
+			  fdatasync(fd) == 0 &&
+			  fstat(fd, &st) == 0 && rename(aof.rewrite_path, aof.path) == 0;
+	if (ok && dup2(fd, aof.fd) < 0) {
+		// the old log is gone, so the only safe place for writes is the new one
+		log_fatal("Failed to switch to the rewritten %s: %s", aof.path, strerror(errno));
+		exit(1);
+	}
+	close(fd);
+	if (!ok)
+		return false;
+	log_info("Rewrote %s from %lld to %lld bytes in %lld us", aof.path, aof.size,
+			 (long long)st.st_size, now_us() - aof.rewrite_started);
+	aof.size = aof.base_size = st.st_size;
+	return true;
+}
+
+static void rewrite_finish(bool ok) {
+	aof.rewrite_ok = ok;
+	if (!ok) {
+		log_error("Failed to rewrite %s", aof.path);
+		unlink(aof.rewrite_path);
+		// not retried before the log doubles again
+		aof.base_size = aof.size;
+	}
+	aof.rewrite_len = 0;
+}
+
+// reaps the rewrite child once it has exited, or waits for it with wait set,
+// and starts a rewrite once the log has grown enough. A rewrite from a
+// checkpoint is finished once the checkpoint is, or at once with wait set.
+void aof_rewrite_poll(HashTable *ht, bool wait) {
+	if (aof.checkpoint) {
+		if (wait)
+			snapshot_poll(true);
+		int status = snapshot_checkpoint_status();
+		if (status == 0)
+			return;
+		aof.checkpoint = false;
+		rewrite_finish(status > 0 && rewrite_done());
+		return;
+	}
+	if (aof.child <= 0) {
+		if (aof.fd >= 0 && aof.size >= AOF_REWRITE_MIN_BYTES && aof.size >= 2 * aof.base_size) {
+			log_info("%s grew to %lld bytes, rewriting it", aof.path, aof.size);
+			aof_rewrite(ht);
+		}
+		return;
+	}
+	int status;
+	pid_t pid = waitpid(aof.child, &status, wait ? 0 : WNOHANG);
+	if (pid == 0 || (pid < 0 && errno == EINTR))
+		return;
+	aof.child = 0;
+	rewrite_finish(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && rewrite_done());
+}
+
+// caps an event loop timeout so that a failed write is retried and a finished
+// rewrite noticed promptly
+int aof_timeout(int timeout) {
+	if ((aof.len == 0 && !aof_rewriting()) || (timeout >= 0 && timeout < AOF_POLL_MS))
+		return timeout;
+	return AOF_POLL_MS;
+}
+
+// flushes and syncs the log, then stops appending to it
+void aof_close() {
+	if (aof.fd < 0)
+		return;
+	if (aof.child > 0) {
+		kill(aof.child, SIGKILL);
+		waitpid(aof.child, NULL, 0);
+		unlink(aof.rewrite_path);
+		aof.child = 0;
+		aof.rewrite_len = 0;
+	}
+	if (aof.checkpoint) {
+		snapshot_checkpoint_cancel();
+		aof.checkpoint = false;
+		aof.rewrite_len = 0;
+	}
+	aof_flush();
+	if (aof.len > 0)
+		log_error("Closing %s with %lld bytes that could not be written", aof.path, aof.len);
+	if (aof.policy != AOF_FSYNC_NO) {
+		pthread_mutex_lock(&aof.lock);
+		aof.stop = true;
+		pthread_cond_signal(&aof.cond);
+		pthread_mutex_unlock(&aof.lock);
+		pthread_join(aof.thread, NULL);
+		close(aof.notify[0]);
+		close(aof.notify[1]);
+		aof.notify[0] = aof.notify[1] = -1;
+	}
+	if (fdatasync(aof.fd) != 0)
+		log_error("Failed to fsync %s: %s", aof.path, strerror(errno));
+	close(aof.fd);
+	aof.fd = -1;
+	aof.len = 0;
+	free(aof.path);
+	free(aof.rewrite_path);
+	aof.path = aof.rewrite_path = NULL;
+}
+
+// field and value pairs describing the log and its last rewrite
+char **aof_info() {
+	pthread_mutex_lock(&aof.lock);
+	long long values[] = {aof.fd >= 0, aof.size, aof.base_size, aof.fsyncs, aof_rewriting()};
+	pthread_mutex_unlock(&aof.lock);
+	char *names[] = {"aof_enabled", "aof_current_size", "aof_base_size", "aof_fsyncs",
+					 "aof_rewrite_in_progress"};
+	int n = sizeof(values) / sizeof(values[0]);
+	char **res = dmalloc((2 * n + 7) * sizeof(char *));
+	for (int i = 0; i < n; i++) {
+		res[2 * i] = strdup(names[i]);
+		res[2 * i + 1] = dmalloc(24);
+		sprintf(res[2 * i + 1], "%lld", values[i]);
+	}
+	res[2 * n] = strdup("aof_fsync");
+	res[2 * n + 1] = strdup(policy_names[aof.policy]);
+	res[2 * n + 2] = strdup("aof_last_write_status");
+	res[2 * n + 3] = strdup(aof.write_ok ? "ok" : "err");
+	res[2 * n + 4] = strdup("aof_last_bgrewrite_status");
+	res[2 * n + 5] = strdup(aof.rewrite_ok ? "ok" : "err");
+	res[2 * n + 6] = NULL;
+	return res;
+}
@@ -0,0 +1,190 @@
+#include "common.h"
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define BITOPS_X86
+#include <immintrin.h>
+#endif
+
+// Bit kernels over string values. Bits are numbered from the most significant
+// bit of the first byte, as in Redis. On x86 the AVX2 and POPCNT variants are
+// compiled with target attributes and picked at runtime, so the build itself
+// needs no extra flags.
+
+static long popcount_generic(const uint8_t *p, long n) {
+	long count = 0, i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(uint64_t));
+		count += __builtin_popcountll(w);
+	}
+	for (; i < n; i++)
+		count += __builtin_popcount(p[i]);
+	return count;
+}
+
+static uint64_t combine_word(int op, uint64_t a, uint64_t b) {
+	switch (op) {
+	case BITOP_AND:
+		return a & b;
+	case BITOP_OR:
+		return a | b;
+	case BITOP_XOR:
+		return a ^ b;
+	default:
+		return a & ~b;
+	}
+}
+
+static void combine_generic(int op, uint8_t *dst, const uint8_t *src, long n) {
+	long i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t a, b;
+		memcpy(&a, dst + i, sizeof(uint64_t));
+		memcpy(&b, src + i, sizeof(uint64_t));
+		a = combine_word(op, a, b);
+		memcpy(dst + i, &a, sizeof(uint64_t));
+	}
+	for (; i < n; i++)
+		dst[i] = combine_word(op, dst[i], src[i]);
+}
+
+#ifdef BITOPS_X86
+__attribute__((target("popcnt"))) static long popcount_hw(const uint8_t *p, long n) {
+	long count = 0, i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(uint64_t));
+		count += __builtin_popcountll(w);
+	}
+	for (; i < n; i++)
+		count += __builtin_popcount(p[i]);
+	return count;
+}
+
+// nibble lookup with vpshufb, byte counts are summed into 64 bit lanes by
+// vpsadbw so the accumulator never overflows
+__attribute__((target("avx2,popcnt"))) static long popcount_avx2(const uint8_t *p, long n) {
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2,
+										 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i acc = _mm256_setzero_si256();
+	long i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i lo = _mm256_and_si256(v, low);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+		__m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+	}
+	long count = _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+				 _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+	return count + popcount_hw(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void combine_avx2(int op, uint8_t *dst, const uint8_t *src,
+														 long n) {
+	long i = 0;
+	switch (op) {
+	case BITOP_AND:
+		for (; i + 32 <= n; i += 32) {
+			__m256i a = _mm256_loadu_si256((__m256i *)(dst + i));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_and_si256(a, b));
+		}
+		break;
+	case BITOP_OR:
+		for (; i + 32 <= n; i += 32) {
+			__m256i a = _mm256_loadu_si256((__m256i *)(dst + i));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(a, b));
+		}
+		break;
+	case BITOP_XOR:
+		for (; i + 32 <= n; i += 32) {
+			__m256i a = _mm256_loadu_si256((__m256i *)(dst + i));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a, b));
+		}
+		break;
+	case BITOP_ANDNOT:
+		for (; i + 32 <= n; i += 32) {
+			__m256i a = _mm256_loadu_si256((__m256i *)(dst + i));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+			_mm256_storeu_si256((__m256i *)(dst + i), _mm256_andnot_si256(b, a));
+		}
+		break;
+	}
+	combine_generic(op, dst + i, src + i, n - i);
+}
+#endif
+
+static long (*popcount_impl)(const uint8_t *, long);
+static void (*combine_impl)(int, uint8_t *, const uint8_t *, long);
+
+static void bitops_init() {
+	popcount_impl = popcount_generic;
+	combine_impl = combine_generic;
+#ifdef BITOPS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt"))
+		popcount_impl = popcount_hw;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+		popcount_impl = popcount_avx2;
+	if (__builtin_cpu_supports("avx2"))
+		combine_impl = combine_avx2;
+#endif
+}
+
+// number of set bits in p[0..n)
+long bit_count(const uint8_t *p, long n) {
+	if (popcount_impl == NULL)
+		bitops_init();
+	return popcount_impl(p, n);
+}
+
+// dst[0..n) = dst op src[0..n), for AND, OR, XOR and ANDNOT
+void bit_combine(int op, uint8_t *dst, const uint8_t *src, long n) {
+	if (combine_impl == NULL)
+		bitops_init();
+	combine_impl(op, dst, src, n);
+}
+
+// dst[0..n) = op applied over srcs, shorter sources count as zero padded.
+// NOT takes a single source.
+void bit_op(int op, uint8_t *dst, uint8_t **srcs, int *lens, int nsrcs, int n) {
+	if (combine_impl == NULL)
+		bitops_init();
+	memcpy(dst, srcs[0], lens[0]);
+	memset(dst + lens[0], 0, n - lens[0]);
+	if (op == BITOP_NOT) {
+		for (int i = 0; i < n; i++)
+			dst[i] = ~dst[i];
+		return;
+	}
+	for (int k = 1; k < nsrcs; k++) {
+		combine_impl(op, dst, srcs[k], lens[k]);
+		if (op == BITOP_AND)
+			memset(dst + lens[k], 0, n - lens[k]);
+	}
+}
+
+// position of the first bit equal to bit in p[0..n), -1 if there is none
+long bit_pos(const uint8_t *p, long n, int bit) {
+	uint64_t skipw = bit ? 0 : UINT64_MAX;
+	uint8_t skip = bit ? 0 : 0xff;
+	long i = 0;
+	for (; i + 8 <= n; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(uint64_t));
+		if (w != skipw)
+			break;
+	}
+	for (; i < n; i++) {
+		if (p[i] != skip) {
+			unsigned b = bit ? p[i] : (uint8_t)~p[i];
+			return i * 8 + __builtin_clz(b) - 24;
+		}
+	}
+	return -1;
+}
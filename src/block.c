@@ -0,0 +1,255 @@
+#include "common.h"
+#include "log.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Clients blocked on list or stream keys park on a per-key wait queue. Pushes
+// and stream appends mark the key as ready, and once the current command is
+// done the oldest waiters of each ready key re-run their command. A waiter
+// whose command blocks again keeps its deadline.
+
+WaitQueue QUEUE_DELETED;
+
+static struct {
+	int size;
+	int used;
+	WaitQueue **queues;
+} wait_table;
+
+static Waiter *waiters;
+static char **ready;
+static int nready, ready_cap;
+static int current_client = -1;
+
+static bool is_deleted(WaitQueue *q) { return q == &QUEUE_DELETED; }
+
+static double now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void queue_insert(WaitQueue **queues, int size, WaitQueue *q) {
+	for (int i = 0; i < size; i++) {
+		int hash = hash_func(q->key, size, i);
+		if (queues[hash] == NULL || is_deleted(queues[hash])) {
+			queues[hash] = q;
+			return;
+		}
+	}
+}
+
+static void wait_table_resize(int new_size) {
+	int size = next_prime(new_size);
+	WaitQueue **queues = calloc(size, sizeof(WaitQueue *));
+	for (int i = 0; i < wait_table.size; i++) {
+		WaitQueue *q = wait_table.queues[i];
+		if (q != NULL && !is_deleted(q))
+			queue_insert(queues, size, q);
+	}
+	free(wait_table.queues);
+	wait_table.queues = queues;
+	wait_table.size = size;
+}
+
+static WaitQueue *queue_find(char *key) {
+	for (int i = 0; i < wait_table.size; i++) {
+		int hash = hash_func(key, wait_table.size, i);
+		WaitQueue *q = wait_table.queues[hash];
+		if (q == NULL)
+			return NULL;
+		if (!is_deleted(q) && strcmp(q->key, key) == 0)
+			return q;
+	}
+	return NULL;
+}
+
+static WaitQueue *queue_get(char *key) {
+	WaitQueue *q = queue_find(key);
+	if (q != NULL)
+		return q;
+	if (wait_table.size == 0 || (wait_table.used + 1) * 100 / wait_table.size > 70)
+		wait_table_resize(wait_table.size * 2 + HT_BASE_SIZE);
+	q = dmalloc(sizeof(WaitQueue));
+	q->key = strdup(key);
+	q->head = q->tail = NULL;
+	queue_insert(wait_table.queues, wait_table.size, q);
+	wait_table.used++;
+	return q;
+}
+
+static void queue_del(WaitQueue *q) {
+	for (int i = 0; i < wait_table.size; i++) {
+		int hash = hash_func(q->key, wait_table.size, i);
+		if (wait_table.queues[hash] == q) {
+			wait_table.queues[hash] = &QUEUE_DELETED;
+			wait_table.used--;
+			break;
+		}
+	}
+	free(q->key);
+	free(q);
+}
+
+// removes w from the wait queues of all its keys and from the waiter list
+static void waiter_unlink(Waiter *w) {
+	for (int i = 0; i < w->nkeys; i++) {
+		WaitNode *nd = w->nodes[i];
+		WaitQueue *q = nd->queue;
+		if (nd->prev != NULL)
+			nd->prev->next = nd->next;
+		else
+			q->head = nd->next;
+		if (nd->next != NULL)
+			nd->next->prev = nd->prev;
+		else
+			q->tail = nd->prev;
+		free(nd);
+		if (q->head == NULL)
+			queue_del(q);
+	}
+	if (w->prev != NULL)
+		w->prev->next = w->next;
+	else
+		waiters = w->next;
+	if (w->next != NULL)
+		w->next->prev = w->prev;
+	free(w->nodes);
+}
+
+static void waiter_free(Waiter *w) {
+	if (w->cmd != NULL)
+		command_free(w->cmd);
+	free(w);
+}
+
+void block_set_client(int cfd) { current_client = cfd; }
+
+// parks the current client on cmd->argv[first .. first + nkeys), timeout is
+// in seconds and 0 blocks forever
+void block_client(Command *cmd, int first, int nkeys, double timeout) {
+	Waiter *w = dmalloc(sizeof(Waiter));
+	w->cfd = current_client;
+	w->cmd = command_dup(cmd);
+	w->deadline = timeout > 0 ? now_ms() + timeout * 1000 : 0;
+	w->nkeys = nkeys;
+	w->nodes = dmalloc(nkeys * sizeof(WaitNode *));
+	for (int i = 0; i < nkeys; i++) {
+		WaitQueue *q = queue_get(w->cmd->argv[first + i]);
+		WaitNode *nd = dmalloc(sizeof(WaitNode));
+		nd->waiter = w;
+		nd->queue = q;
+		nd->next = NULL;
+		nd->prev = q->tail;
+		if (q->tail != NULL)
+			q->tail->next = nd;
+		else
+			q->head = nd;
+		q->tail = nd;
+		w->nodes[i] = nd;
+	}
+	w->prev = NULL;
+	w->next = waiters;
+	if (waiters != NULL)
+		waiters->prev = w;
+	waiters = w;
+	log_debug("Client fd %d blocked on %d keys", w->cfd, nkeys);
+}
+
+// marks key as ready if any client waits on it, pushes call this so only the
+// queue of the pushed key is ever looked at
+void block_signal(char *key) {
+	if (wait_table.used == 0 || queue_find(key) == NULL)
+		return;
+	if (nready == ready_cap) {
+		ready_cap = ready_cap == 0 ? 4 : ready_cap * 2;
+		ready = drealloc(ready, ready_cap * sizeof(char *));
+	}
+	ready[nready++] = strdup(key);
+}
+
+static bool is_ready(HashTable *ht, char *key) {
+	char *type = htable_type(ht, key);
+	bool res = strcmp(type, "list") == 0 || strcmp(type, "stream") == 0;
+	free(type);
+	return res;
+}
+
+static int queue_len(WaitQueue *q) {
+	int n = 0;
+	for (WaitNode *nd = q != NULL ? q->head : NULL; nd != NULL; nd = nd->next)
+		n++;
+	return n;
+}
+
+// serves the oldest waiters of every ready key for as long as the key holds
+// values, serving may push to other keys (BLMOVE) which are then served too.
+// Each waiter is served once per signal, as those that block again rejoin
+// the tail of the queue.
+void block_serve(HashTable *ht) {
+	int prev_client = current_client;
+	for (int i = 0; i < nready; i++) {
+		char *key = ready[i];
+		WaitQueue *q;
+		int pending = queue_len(queue_find(key));
+		while (pending-- > 0 && (q = queue_find(key)) != NULL && is_ready(ht, key)) {
+			Waiter *w = q->head->waiter;
+			Command *cmd = w->cmd;
+			w->cmd = NULL;
+			waiter_unlink(w);
+			log_debug("Serving client fd %d blocked on key '%s'", w->cfd, key);
+			block_set_client(w->cfd);
+			char *resp = interpret(ht, cmd);
+			if (*resp != 'b')
+				send_reply(w->cfd, resp);
+			else
+				waiters->deadline = w->deadline;
+			free(resp);
+			waiter_free(w);
+		}
+		free(key);
+	}
+	nready = 0;
+	block_set_client(prev_client);
+}
+
+// milliseconds until the nearest deadline, -1 if nobody waits with a timeout
+int block_timeout() {
+	double nearest = -1, now = now_ms();
+	for (Waiter *w = waiters; w != NULL; w = w->next) {
+		if (w->deadline > 0 && (nearest < 0 || w->deadline - now < nearest))
+			nearest = w->deadline > now ? w->deadline - now : 0;
+	}
+	return nearest < 0 ? -1 : (int)nearest + 1;
+}
+
+// replies a null to every waiter whose timeout has passed
+void block_expire() {
+	double now = now_ms();
+	Waiter *w = waiters;
+	while (w != NULL) {
+		Waiter *next = w->next;
+		if (w->deadline > 0 && w->deadline <= now) {
+			log_debug("Client fd %d timed out while blocked", w->cfd);
+			send_reply(w->cfd, w->cmd->type == BLMOVE ? "$-1\r\n" : "*-1\r\n");
+			waiter_unlink(w);
+			waiter_free(w);
+		}
+		w = next;
+	}
+}
+
+// drops the waiters of a disconnected client
+void block_remove(int cfd) {
+	Waiter *w = waiters;
+	while (w != NULL) {
+		Waiter *next = w->next;
+		if (w->cfd == cfd) {
+			waiter_unlink(w);
+			waiter_free(w);
+		}
+		w = next;
+	}
+}
@@ -0,0 +1,188 @@
+#include "common.h"
+#include "log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Scalable blocked Bloom filter. Every item hashes to one 64 byte block and
+// sets its k bits inside it, so a lookup touches a single cache line per sub
+// filter. Once the newest sub filter reaches its capacity a larger one with a
+// tighter error rate is appended, which keeps the compound false positive rate
+// under the target. Batches hash every item and prefetch its blocks before
+// testing any bits, so the cache misses of a batch overlap.
+
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_WORDS * 64)
+#define BLOOM_MAX_K 32
+#define BLOOM_BATCH 16
+#define BLOOM_SEED 0x5bd1e995ULL
+#define BLOOM_LN2 0.693147180559945309417
+
+// false positive rate of a blocked filter with c bits per item: the load of a
+// block is Poisson distributed and each block behaves as a plain Bloom filter
+static double blocked_fpr(double c, int k) {
+	double lambda = BLOOM_BLOCK_BITS / c, p = exp(-lambda), fpr = 0;
+	int last = lambda + 10 * sqrt(lambda) + 10;
+	for (int i = 0; i <= last; i++) {
+		fpr += p * pow(1 - pow(1 - 1.0 / BLOOM_BLOCK_BITS, (double)i * k), k);
+		p *= lambda / (i + 1);
+	}
+	return fpr;
+}
+
+// starts from the size of a standard filter and adds bits per item until the
+// blocked layout meets the error rate
+static void filter_init(BloomFilter *f, double error, long long capacity) {
+	double c = -log(error) / (BLOOM_LN2 * BLOOM_LN2);
+	int k = (int)ceil(-log2(error));
+	if (k > BLOOM_MAX_K)
+		k = BLOOM_MAX_K;
+	while (blocked_fpr(c, k) > error)
+		c *= 1.02;
+	double bits = capacity * c;
+	f->capacity = capacity;
+	f->count = 0;
+	f->k = k;
+	f->nblocks = (long long)ceil(bits / BLOOM_BLOCK_BITS);
+	if (f->nblocks == 0)
+		f->nblocks = 1;
+	size_t size = f->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+	f->blocks = aligned_alloc(64, size);
+	if (f->blocks == NULL) {
+		log_fatal("Memory allocation failed for %zu bytes", size);
+		fprintf(stderr, "couldn't allocate memory");
+		exit(1);
+	}
+	memset(f->blocks, 0, size);
+}
+
+// the high bits of the hash pick the block, a remix of it the bits in there
+static uint64_t *filter_block(BloomFilter *f, uint64_t h) {
+	long long i = (unsigned __int128)h * (uint64_t)f->nblocks >> 64;
+	return f->blocks + i * BLOOM_BLOCK_WORDS;
+}
+
+// each bit takes 9 fresh bits of a remixed hash, as double hashing modulo the
+// block size leaves too few distinct patterns for low error rates
+// the k bit positions are 9 bit slices of remixes of the hash, double hashing
+// modulo the block size leaves too few distinct patterns for low error rates
+static void filter_mask(BloomFilter *f, uint64_t h, uint64_t *mask) {
+	memset(mask, 0, BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+	uint64_t bits = 0;
+	int left = 0;
+	for (int i = 0; i < f->k; i++) {
+		if (left < 9) {
+			h += 0x9e3779b97f4a7c15ULL;
+			bits = h ^ h >> 33;
+			bits *= 0xff51afd7ed558ccdULL;
+			bits ^= bits >> 33;
+			left = 64;
+		}
+		uint32_t bit = bits & (BLOOM_BLOCK_BITS - 1);
+		bits >>= 9;
+		left -= 9;
+		mask[bit >> 6] |= 1ULL << (bit & 63);
+	}
+}
+
+static bool filter_test(BloomFilter *f, uint64_t h) {
+	uint64_t mask[BLOOM_BLOCK_WORDS], *block = filter_block(f, h);
+	filter_mask(f, h, mask);
+	uint64_t miss = 0;
+	for (int i = 0; i < BLOOM_BLOCK_WORDS; i++)
+		miss |= mask[i] & ~block[i];
+	return miss == 0;
+}
+
+static void filter_set(BloomFilter *f, uint64_t h) {
+	uint64_t mask[BLOOM_BLOCK_WORDS], *block = filter_block(f, h);
+	filter_mask(f, h, mask);
+	for (int i = 0; i < BLOOM_BLOCK_WORDS; i++)
+		block[i] |= mask[i];
+	f->count++;
+}
+
+// sub filter i targets error / 2^(i + 1), so the rates sum to at most error
+static void bloom_grow(Bloom *bf) {
+	BloomFilter *last = &bf->filters[bf->n - 1];
+	long long capacity = last->capacity * bf->expansion;
+	bf->filters = drealloc(bf->filters, (bf->n + 1) * sizeof(BloomFilter));
+	filter_init(&bf->filters[bf->n], bf->error * pow(0.5, bf->n + 1), capacity);
+	bf->n++;
+}
+
+static bool bloom_test(Bloom *bf, uint64_t h) {
+	for (int i = bf->n - 1; i >= 0; i--)
+		if (filter_test(&bf->filters[i], h))
+			return true;
+	return false;
+}
+
+// hashes items[0..n) and prefetches their blocks in every sub filter
+static void bloom_prepare(Bloom *bf, char **items, int n, uint64_t *hashes) {
+	for (int i = 0; i < n; i++)
+		hashes[i] = murmur64a(items[i], strlen(items[i]), BLOOM_SEED);
+	for (int j = 0; j < bf->n; j++)
+		for (int i = 0; i < n; i++)
+			__builtin_prefetch(filter_block(&bf->filters[j], hashes[i]));
+}
+
+Bloom *bloom_init(double error, long long capacity, int expansion) {
+	Bloom *bf = dmalloc(sizeof(Bloom));
+	bf->error = error;
+	bf->expansion = expansion;
+	bf->count = 0;
+	bf->n = 1;
+	bf->filters = dmalloc(sizeof(BloomFilter));
+	filter_init(bf->filters, expansion > 0 ? error / 2 : error, capacity);
+	return bf;
+}
+
+void bloom_free(Bloom *bf) {
+	if (bf == NULL)
+		return;
+	for (int i = 0; i < bf->n; i++)
+		free(bf->filters[i].blocks);
+	free(bf->filters);
+	free(bf);
+}
+
+// res[i] is 1 if items[i] was added, 0 if it may already have been there and
+// -1 if a non scaling filter was full
+void bloom_add(Bloom *bf, char **items, int n, int *res) {
+	uint64_t hashes[BLOOM_BATCH];
+	for (int first = 0; first < n; first += BLOOM_BATCH) {
+		int m = n - first < BLOOM_BATCH ? n - first : BLOOM_BATCH;
+		bloom_prepare(bf, items + first, m, hashes);
+		for (int i = 0; i < m; i++) {
+			int *r = &res[first + i];
+			if (bloom_test(bf, hashes[i])) {
+				*r = 0;
+				continue;
+			}
+			BloomFilter *last = &bf->filters[bf->n - 1];
+			if (last->count >= last->capacity) {
+				if (bf->expansion == 0) {
+					*r = -1;
+					continue;
+				}
+				bloom_grow(bf);
+				last = &bf->filters[bf->n - 1];
+			}
+			filter_set(last, hashes[i]);
+			bf->count++;
+			*r = 1;
+		}
+	}
+}
+
+// res[i] is 1 if items[i] may be in the filter, 0 if it is definitely not
+void bloom_exists(Bloom *bf, char **items, int n, int *res) {
+	uint64_t hashes[BLOOM_BATCH];
+	for (int first = 0; first < n; first += BLOOM_BATCH) {
+		int m = n - first < BLOOM_BATCH ? n - first : BLOOM_BATCH;
+		bloom_prepare(bf, items + first, m, hashes);
+		for (int i = 0; i < m; i++)
+			res[first + i] = bloom_test(bf, hashes[i]);
+	}
+}
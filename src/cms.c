@@ -0,0 +1,128 @@
+#include "common.h"
+#include "log.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Count-min sketch. Every item maps to one counter in each of depth rows and
+// its estimate is the smallest of them, which overcounts by at most
+// e / width * count with probability 1 - e^-depth. The rows are contiguous and
+// 64 byte aligned, so merging sketches is a flat loop over all the counters
+// that the compiler can vectorize. As in bloom.c, batches hash every item and
+// prefetch its counters before touching any of them.
+
+#define CMS_BATCH 16
+#define CMS_SEED 0x2545f4914f6cdd1dULL
+
+// counters saturate instead of wrapping around
+static uint32_t counter_add(uint32_t c, uint64_t by) {
+	uint64_t sum = c + by;
+	return sum < UINT32_MAX ? sum : UINT32_MAX;
+}
+
+static long long count_add(long long count, unsigned long long by) {
+	return by < (unsigned long long)(LLONG_MAX - count) ? count + by : LLONG_MAX;
+}
+
+// row i takes h1 + i * h2 of the two hash halves (Kirsch and Mitzenmacher),
+// reduced to the width with a multiply instead of a modulo
+static uint32_t *cms_counter(CountMin *cms, uint64_t h, int i) {
+	uint32_t x = (uint32_t)h + i * ((uint32_t)(h >> 32) | 1);
+	return cms->counters + (long long)i * cms->stride + ((uint64_t)x * cms->width >> 32);
+}
+
+// hashes items[0..n) and prefetches their counters in every row
+static void cms_prepare(CountMin *cms, char **items, int n, uint64_t *hashes) {
+	for (int i = 0; i < n; i++)
+		hashes[i] = murmur64a(items[i], strlen(items[i]), CMS_SEED);
+	for (int j = 0; j < cms->depth; j++)
+		for (int i = 0; i < n; i++)
+			__builtin_prefetch(cms_counter(cms, hashes[i], j));
+}
+
+static long long cms_estimate(CountMin *cms, uint64_t h) {
+	uint32_t min = UINT32_MAX;
+	for (int i = 0; i < cms->depth; i++) {
+		uint32_t c = *cms_counter(cms, h, i);
+		if (c < min)
+			min = c;
+	}
+	return min;
+}
+
+CountMin *cms_init(int width, int depth) {
+	CountMin *cms = dmalloc(sizeof(CountMin));
+	cms->width = width;
+	cms->depth = depth;
+	cms->stride = (width + CMS_LINE_COUNTERS - 1) / CMS_LINE_COUNTERS * CMS_LINE_COUNTERS;
+	cms->count = 0;
+	size_t size = (size_t)cms->stride * depth * sizeof(uint32_t);
+	cms->counters = aligned_alloc(64, size);
+	if (cms->counters == NULL) {
+		log_fatal("Memory allocation failed for %zu bytes", size);
+		fprintf(stderr, "couldn't allocate memory");
+		exit(1);
+	}
+	memset(cms->counters, 0, size);
+	return cms;
+}
+
+void cms_free(CountMin *cms) {
+	if (cms == NULL)
+		return;
+	free(cms->counters);
+	free(cms);
+}
+
+// adds incrs[i] to items[i], res[i] is its estimate afterwards
+void cms_incrby(CountMin *cms, char **items, long long *incrs, int n, long long *res) {
+	uint64_t hashes[CMS_BATCH];
+	for (int first = 0; first < n; first += CMS_BATCH) {
+		int m = n - first < CMS_BATCH ? n - first : CMS_BATCH;
+		cms_prepare(cms, items + first, m, hashes);
+		for (int i = 0; i < m; i++) {
+			long long incr = incrs[first + i];
+			for (int j = 0; j < cms->depth; j++) {
+				uint32_t *c = cms_counter(cms, hashes[i], j);
+				*c = counter_add(*c, incr);
+			}
+			cms->count = count_add(cms->count, incr);
+			res[first + i] = cms_estimate(cms, hashes[i]);
+		}
+	}
+}
+
+void cms_query(CountMin *cms, char **items, int n, long long *res) {
+	uint64_t hashes[CMS_BATCH];
+	for (int first = 0; first < n; first += CMS_BATCH) {
+		int m = n - first < CMS_BATCH ? n - first : CMS_BATCH;
+		cms_prepare(cms, items + first, m, hashes);
+		for (int i = 0; i < m; i++)
+			res[first + i] = cms_estimate(cms, hashes[i]);
+	}
+}
+
+// sets dst to the weighted sum of srcs, which all have its dimensions and may
+// include dst itself
+void cms_merge(CountMin *dst, CountMin **srcs, long long *weights, int n) {
+	long long size = (long long)dst->stride * dst->depth;
+	uint64_t *acc = dmalloc(size * sizeof(uint64_t));
+	memset(acc, 0, size * sizeof(uint64_t));
+	long long count = 0;
+	for (int i = 0; i < n; i++) {
+		uint64_t w = weights != NULL ? weights[i] : 1;
+		const uint32_t *c = srcs[i]->counters;
+		// acc stays under 2^32 and w * c under 2^64 - 2^33, so the sum cannot wrap
+		for (long long j = 0; j < size; j++) {
+			uint64_t sum = acc[j] + w * c[j];
+			acc[j] = sum < UINT32_MAX ? sum : UINT32_MAX;
+		}
+		unsigned long long by = srcs[i]->count;
+		count = count_add(count, w != 0 && by > LLONG_MAX / w ? LLONG_MAX : by * w);
+	}
+	for (long long j = 0; j < size; j++)
+		dst->counters[j] = acc[j];
+	dst->count = count;
+	free(acc);
+}
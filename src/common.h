@@ -3,44 +3,565 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define LOCALHOST "127.0.0.1"
 #define PORT_NUM 6379
 #define SA struct sockaddr
 #define HT_BASE_SIZE 2
+#define MAX_CLIENTS 1024
 
 typedef struct HashTableItem {
-	enum { STR_T, HASH_T, LIST_T, SET_T } type;
+	enum {
+		STR_T,
+		HASH_T,
+		LIST_T,
+		SET_T,
+		ZSET_T,
+		HLL_T,
+		ROARING_T,
+		STREAM_T,
+		BLOOM_T,
+		TS_T,
+		JSON_T,
+		VSET_T,
+		CMS_T,
+		TOPK_T,
+		RATELIMIT_T
+	} type : 8;
+	// the checkpoint that saved the item, or that was running when it was set
+	unsigned int epoch : 24;
+	// when the item was last looked up, in seconds since the epoch
+	unsigned int access;
 	char *key;
 	void *value;
 } HashTableItem;
 
+typedef struct StrHeader {
+	int len;
+	int cap;
+	char buf[];
+} StrHeader;
+
+#define STR_HDR(s) ((StrHeader *)((s) - offsetof(StrHeader, buf)))
+
 typedef struct HashTable {
 	int size;
 	int used;
+	// the running or last checkpoint, stamped on new items
+	unsigned int epoch : 24;
+	// the time lookups stamp items with, kept current by the event loop
+	unsigned int clock;
 	HashTableItem **items;
 } HashTable;
 
-typedef struct ListNode {
-	char *value;
-	struct ListNode *next;
-	struct ListNode *prev;
-} ListNode;
+#define LIST_CHUNK_INIT 64
+#define LIST_CHUNK_BYTES 8192
+#define LIST_CHUNK_ENTRIES 128
+
+typedef struct ListChunk {
+	int count;
+	int start;
+	int used;
+	int cap;
+	struct ListChunk *next;
+	struct ListChunk *prev;
+	char data[];
+} ListChunk;
 
 typedef struct List {
 	int len;
-	ListNode *head;
-	ListNode *tail;
+	ListChunk *head;
+	ListChunk *tail;
 } List;
 
 enum ListDirection { LEFT, RIGHT };
 
+enum SetOp { SET_INTER, SET_UNION, SET_DIFF };
+
+enum BitOp { BITOP_AND, BITOP_OR, BITOP_XOR, BITOP_NOT, BITOP_ANDNOT };
+
+enum JsonStatus {
+	JSON_OK,
+	JSON_ERR_SYNTAX,
+	JSON_ERR_PATH,
+	JSON_ERR_MISSING,
+	JSON_ERR_TYPE,
+	JSON_ERR_ROOT,
+	JSON_ERR_RANGE,
+	// nx or xx was not met
+	JSON_NOOP
+};
+
+#define JSON_SET_NX 1
+#define JSON_SET_XX 2
+
+enum TSAgg { TS_AGG_NONE, TS_AGG_AVG, TS_AGG_SUM, TS_AGG_MIN, TS_AGG_MAX, TS_AGG_COUNT };
+
+enum VecMetric { VEC_L2, VEC_COSINE, VEC_IP };
+
+enum VecQuant { VEC_F32, VEC_Q8 };
+
+#define GEO_ADD_NX 1
+#define GEO_ADD_XX 2
+
+enum GeoSort { GEO_SORT_NONE, GEO_SORT_ASC, GEO_SORT_DESC };
+
 typedef struct Set {
 	int size;
 	int used;
 	char **members;
 } Set;
 
+#define ZSET_PACKED_INIT 64
+#define ZSET_PACKED_ENTRIES 128
+#define ZSET_PACKED_VALUE 64
+#define ZSKIPLIST_MAXLEVEL 32
+
+typedef struct ZNode {
+	double score;
+	char *member;
+	struct ZNode *backward;
+	int height;
+	struct ZLevel {
+		struct ZNode *forward;
+		int span;
+	} level[];
+} ZNode;
+
+typedef struct ZSet {
+	int len;
+	// packed encoding, NULL once converted to a skiplist
+	char *packed;
+	int used;
+	int cap;
+	// skiplist encoding
+	int level;
+	ZNode *header;
+	ZNode *tail;
+	// member -> node index of the skiplist
+	int size;
+	int nindex;
+	ZNode **index;
+} ZSet;
+
+#define HLL_P 14
+#define HLL_REGISTERS (1 << HLL_P)
+#define HLL_BITS 6
+#define HLL_REGISTER_MAX ((1 << HLL_BITS) - 1)
+#define HLL_DENSE_BYTES (HLL_REGISTERS * HLL_BITS / 8)
+#define HLL_SPARSE_MAX 1024
+
+typedef struct HyperLogLog {
+	bool dense;
+	// card holds the estimate until a register changes
+	bool cached;
+	long long card;
+	// sparse encoding, sorted (index << 8 | count) entries
+	int nsparse;
+	int cap;
+	uint32_t *sparse;
+	// dense encoding, HLL_DENSE_BYTES of packed registers
+	uint8_t *registers;
+} HyperLogLog;
+
+#define RB_ARRAY_MAX 4096
+#define RB_BITMAP_WORDS 1024
+
+typedef struct RContainer {
+	enum { RB_ARRAY, RB_BITMAP, RB_RUN } type;
+	// high 16 bits shared by the ids in the container
+	uint16_t key;
+	// written since the encoding was last chosen
+	bool dirty;
+	int card;
+	// sorted values of an array, or n (start, length - 1) pairs of a run
+	// container, cap counts uint16_t
+	int n;
+	int cap;
+	uint16_t *values;
+	// bitmap encoding, RB_BITMAP_WORDS words
+	uint64_t *words;
+} RContainer;
+
+typedef struct Roaring {
+	long long card;
+	// containers sorted by key
+	int n;
+	int cap;
+	RContainer *containers;
+} Roaring;
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_DEFAULT_ERROR 0.01
+#define BLOOM_DEFAULT_CAPACITY 100
+#define BLOOM_DEFAULT_EXPANSION 2
+
+typedef struct BloomFilter {
+	long long capacity;
+	long long count;
+	// bits set per item, all inside one 64 byte block
+	int k;
+	long long nblocks;
+	uint64_t *blocks;
+} BloomFilter;
+
+typedef struct Bloom {
+	// target false positive rate over all sub filters
+	double error;
+	// capacity multiplier for each new sub filter, 0 when non scaling
+	int expansion;
+	long long count;
+	int n;
+	BloomFilter *filters;
+} Bloom;
+
+#define RADIX_KEY_LEN 16
+
+typedef struct RadixNode {
+	// path compressed into the node, below the byte that leads to it
+	int plen;
+	uint8_t prefix[RADIX_KEY_LEN];
+	// children sorted by their leading byte
+	int nchildren;
+	uint8_t *bytes;
+	struct RadixNode **children;
+	// set on leaves only
+	void *value;
+} RadixNode;
+
+typedef struct RadixTree {
+	long long size;
+	RadixNode *root;
+} RadixTree;
+
+#define STREAM_BLOCK_ENTRIES 128
+#define STREAM_BLOCK_BYTES 4096
+
+typedef struct StreamID {
+	uint64_t ms;
+	uint64_t seq;
+} StreamID;
+
+enum StreamIDGen { XID_EXPLICIT, XID_AUTO_SEQ, XID_AUTO };
+
+typedef struct StreamBlock {
+	// id the block is indexed under, that of its first entry when created
+	StreamID key;
+	StreamID last;
+	// live entries, which start at data + start once the head is trimmed
+	int count;
+	int start;
+	int used;
+	int cap;
+	uint8_t *data;
+	struct StreamBlock *next;
+} StreamBlock;
+
+typedef struct StreamEntry {
+	StreamID id;
+	// fields and values alternate, -1 for a pending entry trimmed away
+	int nfields;
+	char **fields;
+} StreamEntry;
+
+typedef struct StreamPending {
+	StreamID id;
+	char *consumer;
+	long long delivered;
+	int deliveries;
+} StreamPending;
+
+typedef struct StreamGroup {
+	char *name;
+	StreamID last;
+	// id -> StreamPending of entries delivered but not acknowledged
+	RadixTree *pel;
+} StreamGroup;
+
+typedef struct Stream {
+	long long len;
+	StreamID last;
+	// first id of every block -> block
+	RadixTree *index;
+	StreamBlock *head;
+	StreamBlock *tail;
+	int ngroups;
+	StreamGroup **groups;
+} Stream;
+
+#define TS_CHUNK_BYTES 4096
+
+typedef struct TSChunk {
+	// the first sample is kept here, the rest are bit packed in data
+	long long first_ts;
+	double first_value;
+	int count;
+	long long nbits;
+	// words allocated in data
+	int cap;
+	uint64_t *data;
+	// encoder state after the last sample
+	long long last_ts;
+	long long last_delta;
+	uint64_t last_value;
+	uint8_t leading;
+	uint8_t trailing;
+} TSChunk;
+
+typedef struct TimeSeries {
+	// ms of history kept behind the newest sample, 0 keeps everything
+	long long retention;
+	long long count;
+	// chunks oldest first
+	int n;
+	int cap;
+	TSChunk *chunks;
+} TimeSeries;
+
+typedef struct TSSample {
+	long long ts;
+	double value;
+} TSSample;
+
+typedef struct JsonNode {
+	enum {
+		JSON_NULL,
+		JSON_FALSE,
+		JSON_TRUE,
+		JSON_INT,
+		JSON_DOUBLE,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	} type;
+	// bytes of a string, elements of an array or object
+	int n;
+	int cap;
+	union {
+		long long i;
+		double d;
+		char *str;
+		struct JsonNode **items;
+	};
+	// object keys, parallel to items
+	char **keys;
+	// open addressing index of item positions + 1 for large objects, 0 is free
+	int nindex;
+	int *index;
+} JsonNode;
+
+#define VEC_MAX_DIM 32768
+#define HNSW_MAX_LEVEL 16
+#define HNSW_DEFAULT_M 16
+#define HNSW_MAX_M 128
+#define HNSW_DEFAULT_EF_CONSTRUCTION 200
+#define HNSW_DEFAULT_EF 100
+
+typedef struct HNSWNode {
+	// element name, NULL while the slot is free
+	char *name;
+	int level;
+	// for each level a count followed by the neighbour slots, room for 2M on
+	// level 0 and for M above it
+	int *links;
+} HNSWNode;
+
+typedef struct VectorSet {
+	int dim;
+	int metric;
+	int quant;
+	int m;
+	int ef_construction;
+	int count;
+	// slots ever used, freed ones are reused first
+	int n;
+	int cap;
+	int nfree;
+	int *free;
+	HNSWNode *nodes;
+	// dim components per slot, float32 or int8 with a scale per vector
+	float *f32;
+	int8_t *q8;
+	float *scale;
+	// squared norm per slot, for L2 over int8 vectors
+	float *norm;
+	// top of the graph, -1 when empty
+	int entry;
+	int max_level;
+	// name -> slot + 1, linear probing, 0 is free
+	int nindex;
+	int *index;
+	// slots visited by the running search are marked with the epoch
+	uint32_t epoch;
+	uint32_t *visited;
+	uint64_t rng;
+} VectorSet;
+
+typedef struct VecMatch {
+	// borrowed from the set, valid until it is next written
+	char *name;
+	float dist;
+} VecMatch;
+
+#define CMS_DEFAULT_WIDTH 2000
+#define CMS_DEFAULT_DEPTH 5
+// counters in a 64 byte cache line, rows are padded to a multiple of it
+#define CMS_LINE_COUNTERS 16
+
+typedef struct CountMin {
+	int width;
+	int depth;
+	// counters from the start of one row to the next
+	int stride;
+	long long count;
+	// depth rows of saturating counters, 64 byte aligned
+	uint32_t *counters;
+} CountMin;
+
+#define TOPK_DEFAULT_K 50
+#define TOPK_DEFAULT_DEPTH 4
+#define TOPK_DEFAULT_DECAY 0.9
+// buckets per tracked item when the width is not given
+#define TOPK_WIDTH_PER_K 8
+// counts at or above this no longer decay
+#define TOPK_DECAY_LOOKUP 256
+
+typedef struct TopKBucket {
+	uint32_t fp;
+	uint32_t count;
+} TopKBucket;
+
+typedef struct TopKItem {
+	char *item;
+	uint32_t fp;
+	uint32_t count;
+} TopKItem;
+
+typedef struct TopK {
+	int k;
+	int width;
+	int depth;
+	double decay;
+	// depth rows of width buckets, an empty bucket has a zero count
+	TopKBucket *buckets;
+	// min heap on count of the tracked heavy hitters
+	int n;
+	TopKItem *heap;
+	uint64_t rng;
+	// decay^count, the chance that a colliding item takes a bucket down by one
+	double lookup[TOPK_DECAY_LOOKUP];
+} TopK;
+
+#define GEO_STEP_MAX 26
+#define GEO_LAT_MIN -85.05112878
+#define GEO_LAT_MAX 85.05112878
+#define GEO_LON_MIN -180.0
+#define GEO_LON_MAX 180.0
+
+typedef struct GeoShape {
+	double lon;
+	double lat;
+	// a box of width by height meters centred on lon lat, or a circle
+	bool box;
+	double radius;
+	double width;
+	double height;
+} GeoShape;
+
+typedef struct GeoMatch {
+	// borrowed from the sorted set, valid until it is next written
+	char *member;
+	// meters from the centre of the search
+	double dist;
+	uint64_t hash;
+	double lon;
+	double lat;
+} GeoMatch;
+
+// cap on the microseconds a limit can span, far enough from LLONG_MAX that
+// adding it to a timestamp cannot overflow
+#define RATE_MAX_US (1LL << 60)
+
+typedef struct RateLimit {
+	// theoretical arrival time in microseconds, the limit is full once past it
+	long long tat;
+} RateLimit;
+
+typedef struct RateLimitResult {
+	bool limited;
+	long long limit;
+	long long remaining;
+	// microseconds until the request would be allowed, -1 if it was or never is
+	long long retry_after;
+	// microseconds until the limit is full again
+	long long reset_after;
+} RateLimitResult;
+
+#define SNAPSHOT_FILE "dump.hkv"
+#define SNAPSHOT_MAGIC "HYPERKV"
+#define SNAPSHOT_VERSION 5
+// snapshots are written and read through a buffer of this many bytes
+#define SNAPSHOT_BUF_BYTES (1 << 20)
+// keys are grouped into sections of about this many bytes, each compressed on
+// its own and loaded on its own thread
+#define SNAPSHOT_SECTION_BYTES (4 << 20)
+#define SNAPSHOT_LOAD_THREADS 8
+// sections each loader thread decodes ahead of the ones linked into the table
+#define SNAPSHOT_LOAD_AHEAD 2
+// keys linked per event loop iteration while loading in the background
+#define SNAPSHOT_LOAD_KEYS 8192
+// hashes with at most this many fields are written as a single blob
+#define SNAPSHOT_SMALL_HASH 64
+// keys are grouped into sections by how recently they were accessed, so that
+// the hottest load first
+#define SNAPSHOT_HEAT_CLASSES 4
+// false positive rate of the filter of key names each section is indexed with
+#define SNAPSHOT_FILTER_ERROR 0.01
+// how often the event loop checks on a background save, in ms
+#define SNAPSHOT_POLL_MS 100
+// slots of the table a checkpoint walks per event loop iteration
+#define SNAPSHOT_CHECKPOINT_SLOTS 4096
+// a checkpoint compresses smaller sections, as each is compressed at once
+#define SNAPSHOT_CHECKPOINT_SECTION_BYTES (512 << 10)
+// how long a server handing over waits for the new process to take over
+#define HANDOVER_TIMEOUT_MS 30000
+
+// whether background saves and log rewrites fork or write a checkpoint from
+// the event loop
+enum SnapshotMode { SNAPSHOT_FORK, SNAPSHOT_INCREMENTAL };
+
+enum AofFsync { AOF_FSYNC_NO, AOF_FSYNC_EVERYSEC, AOF_FSYNC_ALWAYS };
+// how soon the event loop retries a failed write to the append only log or
+// checks on a rewrite, in ms
+#define AOF_POLL_MS 100
+// the log is rewritten once past this size and twice its size after the last
+// rewrite
+#define AOF_REWRITE_MIN_BYTES (64LL << 20)
+
+typedef struct SnapWriter {
+	// a writer without a file grows its buffer to hold everything written
+	int fd;
+	int len;
+	int cap;
+	uint8_t *buf;
+	long long bytes;
+	// set by the first failed write, the ones after it are dropped
+	bool failed;
+} SnapWriter;
+
+typedef struct SnapReader {
+	// a reader without a file reads buf[0..len) and nothing else
+	int fd;
+	long long pos;
+	long long len;
+	uint8_t *buf;
+	// bytes of the file not read into the buffer yet
+	long long left;
+	// set once the file turns out short or malformed, reads then give zeros
+	bool failed;
+} SnapReader;
+
 typedef struct Parser {
 	char *string;
 	int pos;
@@ -85,6 +606,96 @@ typedef struct Command {
 		SISMEMBER,
 		SMEMBERS,
 		SMISMEMBER,
+		SINTER,
+		SINTERSTORE,
+		SINTERCARD,
+		SUNION,
+		SUNIONSTORE,
+		SDIFF,
+		SDIFFSTORE,
+		LMOVE,
+		BLPOP,
+		BRPOP,
+		BLMOVE,
+		ZADD,
+		ZREM,
+		ZSCORE,
+		ZINCRBY,
+		ZCARD,
+		ZRANK,
+		ZREVRANK,
+		ZRANGE,
+		ZRANGEBYSCORE,
+		PFADD,
+		PFCOUNT,
+		PFMERGE,
+		SETBIT,
+		GETBIT,
+		BITCOUNT,
+		BITOP,
+		BITPOS,
+		RBADD,
+		RBREM,
+		RBISMEMBER,
+		RBCARD,
+		RBMEMBERS,
+		RBOP,
+		XADD,
+		XLEN,
+		XRANGE,
+		XTRIM,
+		XREAD,
+		XGROUP,
+		XREADGROUP,
+		XACK,
+		BFRESERVE,
+		BFADD,
+		BFMADD,
+		BFEXISTS,
+		BFMEXISTS,
+		BFCARD,
+		TSCREATE,
+		TSADD,
+		TSGET,
+		TSRANGE,
+		TSINFO,
+		JSONSET,
+		JSONGET,
+		JSONDEL,
+		JSONTYPE,
+		JSONNUMINCRBY,
+		JSONSTRAPPEND,
+		JSONARRAPPEND,
+		JSONARRLEN,
+		VADD,
+		VREM,
+		VSIM,
+		VCARD,
+		VDIM,
+		VEMB,
+		VINFO,
+		CMSINITBYDIM,
+		CMSINITBYPROB,
+		CMSINCRBY,
+		CMSQUERY,
+		CMSMERGE,
+		CMSINFO,
+		TOPKRESERVE,
+		TOPKADD,
+		TOPKINCRBY,
+		TOPKQUERY,
+		TOPKLIST,
+		TOPKINFO,
+		GEOADD,
+		GEOPOS,
+		GEODIST,
+		GEOSEARCH,
+		THROTTLE,
+		SAVE,
+		BGSAVE,
+		LASTSAVE,
+		INFO,
+		BGREWRITEAOF,
 		QUIT,
 		SHUTDOWN,
 		UNKNOWN,
@@ -94,15 +705,48 @@ typedef struct Command {
 	char **argv;
 } Command;
 
+typedef struct Waiter {
+	int cfd;
+	Command *cmd;
+	double deadline;
+	int nkeys;
+	struct WaitNode **nodes;
+	struct Waiter *next;
+	struct Waiter *prev;
+} Waiter;
+
+typedef struct WaitNode {
+	Waiter *waiter;
+	struct WaitQueue *queue;
+	struct WaitNode *next;
+	struct WaitNode *prev;
+} WaitNode;
+
+typedef struct WaitQueue {
+	char *key;
+	WaitNode *head;
+	WaitNode *tail;
+} WaitQueue;
+
+// a reply held back until the append only log is durable up to offset
+typedef struct HeldReply {
+	int cfd;
+	long long offset;
+	char *msg;
+} HeldReply;
+
 // helper.c
 void *dmalloc(size_t size);
 void *drealloc(void *p, size_t size);
 int next_prime(int n);
 int hash_func(char *key, int size, int i);
+uint64_t murmur64a(const void *key, int len, uint64_t seed);
 int ndigits(int x);
 bool is_number(char *str);
 int strtoi(char *str);
 char *intostr(int x);
+bool parse_double(char *str, double *res);
+char *dtostr(double x);
 
 // htable.c
 HashTable *htable_init(int size);
@@ -110,6 +754,10 @@ void htable_free(HashTable *ht);
 bool htable_del(HashTable *ht, char *key);
 bool htable_exists(HashTable *ht, char *key);
 char *htable_type(HashTable *ht, char *key);
+HashTableItem *htable_search(HashTable *ht, char *key);
+HashTableItem *htable_next(HashTable *ht, int *pos);
+HashTableItem *htable_restore(HashTable *ht, char *key, int type, void *value);
+void htable_reserve(HashTable *ht, int n);
 bool htable_set(HashTable *ht, char *key, char *value);
 bool htable_hset(HashTable *ht, char *key, char *field, char *value);
 int htable_push(HashTable *ht, char *key, char *value, int dir);
@@ -132,20 +780,132 @@ char **htable_hgetall(HashTable *ht, char *key);
 char **htable_hkeyvals(HashTable *ht, char *key, int ky);
 char **htable_lrange(HashTable *ht, char *key, int begin, int end);
 char **htable_smembers(HashTable *ht, char *key);
+char **htable_setop(HashTable *ht, char **keys, int n, int op);
+int htable_setopstore(HashTable *ht, char *dst, char **keys, int n, int op);
+int htable_sintercard(HashTable *ht, char **keys, int n, int limit);
 char **set_members(Set *set);
+bool htable_zadd(HashTable *ht, char *key, char *member, double score);
+bool htable_zrem(HashTable *ht, char *key, char *member);
+bool htable_zscore(HashTable *ht, char *key, char *member, double *score);
+int htable_zcard(HashTable *ht, char *key);
+int htable_zrank(HashTable *ht, char *key, char *member, bool rev);
+char **htable_zrange(HashTable *ht, char *key, int start, int end, bool rev, bool withscores);
+char **htable_zrangebyscore(HashTable *ht, char *key, double min, bool minex, double max,
+							bool maxex, bool rev, bool withscores);
+bool htable_pfadd(HashTable *ht, char *key, char **values, int n);
+long long htable_pfcount(HashTable *ht, char **keys, int n);
+void htable_pfmerge(HashTable *ht, char *dst, char **keys, int n);
+int htable_setbit(HashTable *ht, char *key, int offset, int bit);
+int htable_getbit(HashTable *ht, char *key, int offset);
+long htable_bitcount(HashTable *ht, char *key, int start, int end, bool bits);
+int htable_bitop(HashTable *ht, int op, char *dst, char **keys, int n);
+long htable_bitpos(HashTable *ht, char *key, int bit, int start, int end, bool has_end);
+int htable_rbadd(HashTable *ht, char *key, uint32_t *ids, int n);
+int htable_rbrem(HashTable *ht, char *key, uint32_t *ids, int n);
+bool htable_rbismember(HashTable *ht, char *key, uint32_t id);
+long long htable_rbcard(HashTable *ht, char *key);
+char **htable_rbmembers(HashTable *ht, char *key);
+long long htable_rbop(HashTable *ht, int op, char *dst, char **keys, int n);
+bool htable_xadd(HashTable *ht, char *key, StreamID *id, int gen, char **fields, int n,
+				 long long maxlen, bool approx);
+long long htable_xlen(HashTable *ht, char *key);
+long long htable_xtrim(HashTable *ht, char *key, long long maxlen, bool approx);
+StreamEntry *htable_xrange(HashTable *ht, char *key, StreamID start, StreamID end,
+						   long long count, int *n);
+StreamID htable_xlast(HashTable *ht, char *key);
+int htable_xgroup_create(HashTable *ht, char *key, char *group, StreamID *id, bool mkstream);
+bool htable_xgroup_destroy(HashTable *ht, char *key, char *group);
+bool htable_xgroup_exists(HashTable *ht, char *key, char *group);
+StreamEntry *htable_xreadgroup(HashTable *ht, char *key, char *group, char *consumer,
+							   StreamID *after, long long count, bool noack, int *n);
+int htable_xack(HashTable *ht, char *key, char *group, StreamID *ids, int n);
+bool htable_bfreserve(HashTable *ht, char *key, double error, long long capacity, int expansion);
+void htable_bfadd(HashTable *ht, char *key, char **items, int n, int *res);
+void htable_bfexists(HashTable *ht, char *key, char **items, int n, int *res);
+long long htable_bfcard(HashTable *ht, char *key);
+bool htable_tscreate(HashTable *ht, char *key, long long retention);
+bool htable_tsadd(HashTable *ht, char *key, long long *t, double value);
+TSSample *htable_tsrange(HashTable *ht, char *key, long long from, long long to, long long count,
+						 int agg, long long bucket, int *n);
+bool htable_tsget(HashTable *ht, char *key, TSSample *last);
+char **htable_tsinfo(HashTable *ht, char *key);
+int htable_jsonset(HashTable *ht, char *key, char *path, char *value, int cond);
+int htable_jsonget(HashTable *ht, char *key, char **paths, int n, char **res);
+int htable_jsondel(HashTable *ht, char *key, char *path, long long *removed);
+int htable_jsontype(HashTable *ht, char *key, char *path, char **res);
+int htable_jsonnumincrby(HashTable *ht, char *key, char *path, double by, char **res);
+int htable_jsonappend(HashTable *ht, char *key, char *path, int type, char **values, int n,
+					  long long *len);
+int htable_jsonarrlen(HashTable *ht, char *key, char *path, long long *len);
+int htable_vadd(HashTable *ht, char *key, char *name, float *values, int dim, int metric, int quant,
+				int m, int ef);
+bool htable_vrem(HashTable *ht, char *key, char *name);
+VecMatch *htable_vsim(HashTable *ht, char *key, float *query, char *ele, int k, int ef, bool exact,
+					  int *n);
+long long htable_vcard(HashTable *ht, char *key);
+int htable_vdim(HashTable *ht, char *key);
+float *htable_vemb(HashTable *ht, char *key, char *name);
+char **htable_vinfo(HashTable *ht, char *key);
+bool htable_cmsinit(HashTable *ht, char *key, int width, int depth);
+void htable_cmsincrby(HashTable *ht, char *key, char **items, long long *incrs, int n,
+					  long long *res);
+void htable_cmsquery(HashTable *ht, char *key, char **items, int n, long long *res);
+int htable_cmsmerge(HashTable *ht, char *dst, char **keys, long long *weights, int n);
+char **htable_cmsinfo(HashTable *ht, char *key);
+bool htable_topkreserve(HashTable *ht, char *key, int k, int width, int depth, double decay);
+char **htable_topkadd(HashTable *ht, char *key, char **items, long long *incrs, int n);
+void htable_topkquery(HashTable *ht, char *key, char **items, int n, int *res);
+TopKItem *htable_topklist(HashTable *ht, char *key, int *n);
+char **htable_topkinfo(HashTable *ht, char *key);
+int htable_geoadd(HashTable *ht, char *key, double *coords, char **members, int n, int cond,
+				  bool ch);
+bool htable_geopos(HashTable *ht, char *key, char *member, double *lon, double *lat);
+GeoMatch *htable_geosearch(HashTable *ht, char *key, GeoShape *shape, int sort, int count, bool any,
+						   int *n);
+void htable_throttle(HashTable *ht, char *key, long long burst, long long count, long long period,
+					 long long quantity, RateLimitResult *res);
+
+// str.c
+char *str_new(const char *data, int len);
+void str_free(char *s);
+int str_len(char *s);
+char *str_grow(char *s, int len);
+
+// bitops.c
+long bit_count(const uint8_t *p, long n);
+void bit_op(int op, uint8_t *dst, uint8_t **srcs, int *lens, int nsrcs, int n);
+long bit_pos(const uint8_t *p, long n, int bit);
+void bit_combine(int op, uint8_t *dst, const uint8_t *src, long n);
+
+// roaring.c
+Roaring *roaring_init(void);
+void roaring_free(Roaring *rb);
+bool roaring_add(Roaring *rb, uint32_t x);
+bool roaring_rem(Roaring *rb, uint32_t x);
+bool roaring_contains(Roaring *rb, uint32_t x);
+void roaring_optimize(Roaring *rb);
+uint32_t *roaring_members(Roaring *rb);
+Roaring *roaring_op(Roaring **rbs, int n, int op);
+
+// bloom.c
+Bloom *bloom_init(double error, long long capacity, int expansion);
+void bloom_free(Bloom *bf);
+void bloom_add(Bloom *bf, char **items, int n, int *res);
+void bloom_exists(Bloom *bf, char **items, int n, int *res);
 
 // list.c
 List *list_init(void);
 void list_free(List *ls);
 void list_lpush(List *ls, char *value);
 void list_rpush(List *ls, char *value);
-ListNode *list_lpop(List *ls);
-ListNode *list_rpop(List *ls);
-ListNode *list_index(List *ls, int id);
+char *list_lpop(List *ls);
+char *list_rpop(List *ls);
+char *list_index(List *ls, int id);
 bool list_set(List *ls, int id, char *value);
 int list_pos(List *ls, char *value);
 int list_rem(List *ls, int count, char *value);
 char **list_range(List *ls, int begin, int end);
+bool list_append_chunk(List *ls, const char *data, int bytes, int count);
 
 // set.c
 Set *set_init(int size);
@@ -153,24 +913,227 @@ void set_free(Set *set);
 bool set_add(Set *set, char *value);
 bool set_rem(Set *set, char *key);
 bool set_ismember(Set *set, char *key);
+Set *set_op(Set **sets, int n, int op);
+int set_intercard(Set **sets, int n, int limit);
+
+// zset.c
+ZSet *zset_init(void);
+void zset_free(ZSet *zs);
+bool zset_add(ZSet *zs, char *member, double score);
+bool zset_rem(ZSet *zs, char *member);
+bool zset_score(ZSet *zs, char *member, double *score);
+int zset_rank(ZSet *zs, char *member);
+int zset_count_below(ZSet *zs, double score, bool inclusive);
+char **zset_range(ZSet *zs, int start, int end, bool rev, bool withscores);
+void zset_scan(ZSet *zs, double min, double max, bool (*fn)(char *, double, void *), void *arg);
+
+// hll.c
+HyperLogLog *hll_init(void);
+void hll_free(HyperLogLog *hll);
+bool hll_add(HyperLogLog *hll, char *value);
+void hll_raw_max(uint8_t *dst, uint8_t *src);
+void hll_merge(uint8_t *raw, HyperLogLog *hll);
+void hll_set_raw(HyperLogLog *hll, uint8_t *raw);
+long long hll_estimate(uint8_t *raw);
+long long hll_count(HyperLogLog *hll);
+
+// radix.c
+RadixTree *radix_init(void);
+void radix_free(RadixTree *t, void (*free_value)(void *));
+void radix_insert(RadixTree *t, const uint8_t *key, void *value);
+void *radix_find(RadixTree *t, const uint8_t *key);
+void *radix_seek(RadixTree *t, const uint8_t *key, int dir);
+void *radix_remove(RadixTree *t, const uint8_t *key);
+
+// stream.c
+int stream_id_cmp(StreamID a, StreamID b);
+bool stream_id_incr(StreamID *id);
+bool stream_id_decr(StreamID *id);
+bool stream_parse_id(char *str, StreamID *id, uint64_t seq);
+char *stream_id_str(StreamID id);
+Stream *stream_init(void);
+void stream_free(Stream *s);
+bool stream_add(Stream *s, StreamID *id, int gen, char **fields, int n);
+long long stream_trim(Stream *s, long long maxlen, bool approx);
+StreamEntry *stream_range(Stream *s, StreamID start, StreamID end, long long count, int *n);
+void stream_entries_free(StreamEntry *entries, int n);
+StreamGroup *stream_group(Stream *s, char *name);
+bool stream_group_create(Stream *s, char *name, StreamID last);
+bool stream_group_destroy(Stream *s, char *name);
+StreamEntry *stream_read_group(Stream *s, StreamGroup *g, char *consumer, StreamID *after,
+							   long long count, bool noack, int *n);
+bool stream_ack(StreamGroup *g, StreamID id);
+void stream_save(SnapWriter *w, Stream *s);
+Stream *stream_load(SnapReader *r);
+
+// ts.c
+TimeSeries *ts_init(long long retention);
+void ts_free(TimeSeries *s);
+bool ts_add(TimeSeries *s, long long *t, double value);
+TSSample *ts_range(TimeSeries *s, long long from, long long to, long long count, int agg,
+				   long long bucket, int *n);
+long long ts_bytes(TimeSeries *s);
+
+// json.c
+JsonNode *json_parse(const char *s);
+void json_free(JsonNode *node);
+char *json_dump(JsonNode *node);
+int json_get(JsonNode *root, char *path, JsonNode **res);
+int json_project(JsonNode *root, char **paths, int n, char **res);
+int json_set(JsonNode **root, char *path, JsonNode *value, int cond);
+int json_del(JsonNode **root, char *path, long long *removed);
+int json_numincrby(JsonNode *root, char *path, double by, JsonNode **res);
+int json_append(JsonNode *root, char *path, int type, JsonNode **values, int n, long long *len);
+char *json_type(JsonNode *node);
+
+// distance.c
+float vec_dot_f32(const float *a, const float *b, int n);
+float vec_l2_f32(const float *a, const float *b, int n);
+int32_t vec_dot_i8(const int8_t *a, const int8_t *b, int n);
+
+// vset.c
+VectorSet *vset_init(int dim, int metric, int quant, int m, int ef_construction);
+void vset_free(VectorSet *vs);
+bool vset_add(VectorSet *vs, char *name, float *values);
+bool vset_rem(VectorSet *vs, char *name);
+bool vset_emb(VectorSet *vs, char *name, float *out);
+VecMatch *vset_search(VectorSet *vs, float *query, char *ele, int k, int ef, bool exact, int *n);
+long long vset_bytes(VectorSet *vs);
+void vset_save(SnapWriter *w, VectorSet *vs);
+VectorSet *vset_load(SnapReader *r);
+
+// cms.c
+CountMin *cms_init(int width, int depth);
+void cms_free(CountMin *cms);
+void cms_incrby(CountMin *cms, char **items, long long *incrs, int n, long long *res);
+void cms_query(CountMin *cms, char **items, int n, long long *res);
+void cms_merge(CountMin *dst, CountMin **srcs, long long *weights, int n);
+
+// topk.c
+TopK *topk_init(int k, int width, int depth, double decay);
+void topk_free(TopK *tk);
+char *topk_add(TopK *tk, char *item, long long incr);
+bool topk_query(TopK *tk, char *item);
+TopKItem *topk_list(TopK *tk, int *n);
+
+// geo.c
+bool geo_valid(double lon, double lat);
+uint64_t geo_encode(double lon, double lat);
+void geo_decode(uint64_t hash, double *lon, double *lat);
+double geo_dist(double lon1, double lat1, double lon2, double lat2);
+GeoMatch *geo_search(ZSet *zs, GeoShape *shape, int sort, int count, bool any, int *n);
+
+// crc32c.c
+uint32_t crc32c(uint32_t crc, const void *p, size_t n);
+bool crc32c_selftest(void);
+
+// lz.c
+long lz_bound(long n);
+long lz_compress(const uint8_t *src, long n, uint8_t *dst);
+bool lz_decompress(const uint8_t *src, long n, uint8_t *dst, long cap);
+
+// ratelimit.c
+long long gcra_now(void);
+void gcra_throttle(RateLimit *rl, long long now, long long burst, long long count,
+				   long long period, long long quantity, RateLimitResult *res);
+
+// snapshot.c
+void snap_put_bytes(SnapWriter *w, const void *p, size_t n);
+void snap_put_u8(SnapWriter *w, uint8_t x);
+void snap_put_len(SnapWriter *w, uint64_t x);
+void snap_put_u64(SnapWriter *w, uint64_t x);
+void snap_put_double(SnapWriter *w, double x);
+void snap_put_str(SnapWriter *w, const char *s, int len);
+bool snap_fits(SnapReader *r, uint64_t n);
+void snap_get_bytes(SnapReader *r, void *p, size_t n);
+uint8_t snap_get_u8(SnapReader *r);
+uint64_t snap_get_len(SnapReader *r);
+uint64_t snap_get_u64(SnapReader *r);
+double snap_get_double(SnapReader *r);
+char *snap_get_str(SnapReader *r, int *len);
+const uint8_t *snap_get_ref(SnapReader *r, uint64_t n);
+bool snapshot_save(HashTable *ht, char *path);
+bool snapshot_save_tables(HashTable **tables, int n, char *path);
+bool snapshot_save_fd(HashTable *ht, int fd);
+long long snapshot_read(HashTable *ht, int fd, char *path, long long *end);
+long long snapshot_load(HashTable *ht, char *path);
+long long snapshot_load_start(HashTable *ht, char *path);
+bool snapshot_loading(void);
+void snapshot_load_wait(void);
+void snapshot_init(char *path);
+void snapshot_set_mode(int mode);
+int snapshot_mode(void);
+char *snapshot_path(void);
+bool snapshot_running(void);
+bool snapshot_save_now(HashTable *ht);
+int snapshot_bgsave(HashTable *ht);
+void snapshot_poll(bool wait);
+int snapshot_timeout(int timeout);
+long long snapshot_lastsave(void);
+char **snapshot_info(void);
+bool snapshot_checkpoint(HashTable *ht, char *path);
+int snapshot_checkpoint_status(void);
+void snapshot_checkpoint_cancel(void);
+void snapshot_touch(HashTable *ht, Command *cmd);
+
+// aof.c
+bool aof_open(HashTable *ht, char *path, int policy);
+long long aof_load(HashTable *ht, char *path);
+long long aof_scan(HashTable *ht, int fd, char *path, long long *end, long long *batches);
+void aof_feed(Command *cmd, char *reply);
+bool aof_logs(int type);
+void aof_flush(void);
+bool aof_enabled(void);
+long long aof_offset(void);
+long long aof_durable(void);
+int aof_notify_fd(void);
+void aof_poll(void);
+int aof_rewrite(HashTable *ht);
+bool aof_rewriting(void);
+void aof_rewrite_poll(HashTable *ht, bool wait);
+bool aof_wait(void);
+int aof_timeout(int timeout);
+void aof_close(void);
+char **aof_info(void);
 
 // parser.c
 Parser *parser_init(char *msg);
 void parser_free(Parser *parser);
 Command *parse(char *msg);
+int command_type(char *name);
+Command *command_init(int type, int argc, char **argv);
 void command_free(Command *cmd);
+Command *command_dup(Command *cmd);
 
 // interpreter.c
 char *interpret(HashTable *ht, Command *cmd);
 
+// block.c
+void block_set_client(int cfd);
+void block_client(Command *cmd, int first, int nkeys, double timeout);
+void block_signal(char *key);
+void block_serve(HashTable *ht);
+int block_timeout(void);
+void block_expire(void);
+void block_remove(int cfd);
+
+// handover.c
+bool handover_listen(char *path);
+int handover_fd(void);
+void handover_close(void);
+bool handover_send(int sfd, HashTable *ht);
+int handover_receive(char *path, HashTable *ht, int *sfd, bool wait);
+
 // server.c
 int init_server(void);
 int accept_connection(int sfd);
 void close_socket(int sockfd);
 void close_client(int cfd);
 int rediskw(int cfd, HashTable *ht);
+int serve(int sfd, HashTable *ht);
 char *readline(int cfd);
 void writeline(int cfd, char *msg);
+void send_reply(int cfd, char *msg);
 
 // client.c
 int connect_server(char *addr, int port);
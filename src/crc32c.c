@@ -0,0 +1,83 @@
+#include "common.h"
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__)
+#define CRC32C_X86
+#include <immintrin.h>
+#endif
+
+// CRC32C (Castagnoli) checksums of persisted data. On x86 with SSE4.2 the
+// crc32 instruction takes 8 bytes at a time, elsewhere tables for slicing by 8
+// do. As in bitops.c, the SSE4.2 variant is compiled with a target attribute
+// and picked at runtime. Both give the standard CRC32C, so checksums written
+// on one machine verify on another.
+
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t table[8][256];
+
+static uint32_t crc_generic(uint32_t crc, const uint8_t *p, size_t n) {
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		w ^= crc;
+		crc = table[7][w & 0xff] ^ table[6][(w >> 8) & 0xff] ^ table[5][(w >> 16) & 0xff] ^
+			  table[4][(w >> 24) & 0xff] ^ table[3][(w >> 32) & 0xff] ^
+			  table[2][(w >> 40) & 0xff] ^ table[1][(w >> 48) & 0xff] ^ table[0][w >> 56];
+	}
+	for (; n > 0; n--)
+		crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2"))) static uint32_t crc_hw(uint32_t crc, const uint8_t *p,
+														 size_t n) {
+	uint64_t c = crc;
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		c = _mm_crc32_u64(c, w);
+	}
+	crc = c;
+	for (; n > 0; n--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+static uint32_t (*crc_impl)(uint32_t, const uint8_t *, size_t);
+
+static void crc_init() {
+	for (int i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		table[0][i] = crc;
+	}
+	for (int i = 0; i < 256; i++)
+		for (int k = 1; k < 8; k++)
+			table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+	crc_impl = crc_generic;
+#ifdef CRC32C_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+		crc_impl = crc_hw;
+#endif
+}
+
+// extends crc, the checksum of what came before or 0, over p[0..n)
+uint32_t crc32c(uint32_t crc, const void *p, size_t n) {
+	if (crc_impl == NULL)
+		crc_init();
+	return ~crc_impl(~crc, p, n);
+}
+
+// whether the table fallback gives the same checksum as the one in use
+bool crc32c_selftest() {
+	if (crc_impl == NULL)
+		crc_init();
+	const char *s = "123456789";
+	return crc32c(0, s, 9) == 0xe3069283 &&
+		   ~crc_generic(~0u, (const uint8_t *)s, 9) == 0xe3069283;
+}
@@ -0,0 +1,195 @@
+#include "common.h"
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define DISTANCE_X86
+#include <immintrin.h>
+#endif
+
+// Distance kernels for vector sets: dot product and squared L2 distance over
+// float32 vectors, and dot product over int8 ones. As in bitops.c the AVX2 and
+// AVX-512 variants are compiled with target attributes and picked at runtime.
+
+static float dot_f32_generic(const float *a, const float *b, int n) {
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += a[i] * b[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+static float l2_f32_generic(const float *a, const float *b, int n) {
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		float d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+		float d2 = a[i + 2] - b[i + 2], d3 = a[i + 3] - b[i + 3];
+		s0 += d0 * d0;
+		s1 += d1 * d1;
+		s2 += d2 * d2;
+		s3 += d3 * d3;
+	}
+	for (; i < n; i++)
+		s0 += (a[i] - b[i]) * (a[i] - b[i]);
+	return (s0 + s1) + (s2 + s3);
+}
+
+static int32_t dot_i8_generic(const int8_t *a, const int8_t *b, int n) {
+	int32_t s = 0;
+	for (int i = 0; i < n; i++)
+		s += a[i] * b[i];
+	return s;
+}
+
+#ifdef DISTANCE_X86
+__attribute__((target("avx2,fma"))) static float hsum_avx2(__m256 v) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+// two accumulators hide the latency of the fused multiply adds
+__attribute__((target("avx2,fma"))) static float dot_f32_avx2(const float *a, const float *b,
+															   int n) {
+	__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+	}
+	for (; i + 8 <= n; i += 8)
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+	return hsum_avx2(_mm256_add_ps(acc0, acc1)) + dot_f32_generic(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static float l2_f32_avx2(const float *a, const float *b,
+															  int n) {
+	__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+		acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+		acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+	}
+	for (; i + 8 <= n; i += 8) {
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		acc0 = _mm256_fmadd_ps(d, d, acc0);
+	}
+	return hsum_avx2(_mm256_add_ps(acc0, acc1)) + l2_f32_generic(a + i, b + i, n - i);
+}
+
+// bytes are widened to 16 bits and vpmaddwd sums adjacent products into 32
+// bit lanes, which cannot overflow for vectors under 2^16 components
+__attribute__((target("avx2"))) static int32_t dot_i8_avx2(const int8_t *a, const int8_t *b,
+														   int n) {
+	__m256i acc = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i x = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(a + i)));
+		__m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(b + i)));
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+	}
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+	return _mm_cvtsi128_si32(s) + dot_i8_generic(a + i, b + i, n - i);
+}
+
+// the tail is a masked load, so no scalar loop is left over
+__attribute__((target("avx512f"))) static float dot_f32_avx512(const float *a, const float *b,
+																int n) {
+	__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 32 <= n; i += 32) {
+		acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+		acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+	}
+	for (; i < n; i += 16) {
+		__mmask16 m = n - i >= 16 ? 0xffff : (1u << (n - i)) - 1;
+		acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i),
+							   acc0);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) static float l2_f32_avx512(const float *a, const float *b,
+															   int n) {
+	__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+		__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+		acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+		acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+	}
+	for (; i < n; i += 16) {
+		__mmask16 m = n - i >= 16 ? 0xffff : (1u << (n - i)) - 1;
+		__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i));
+		acc0 = _mm512_fmadd_ps(d, d, acc0);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f,avx512bw"))) static int32_t dot_i8_avx512(const int8_t *a,
+																		  const int8_t *b, int n) {
+	__m512i acc = _mm512_setzero_si512();
+	int i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m512i x = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(a + i)));
+		__m512i y = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(b + i)));
+		acc = _mm512_add_epi32(acc, _mm512_madd_epi16(x, y));
+	}
+	return _mm512_reduce_add_epi32(acc) + dot_i8_generic(a + i, b + i, n - i);
+}
+#endif
+
+static float (*dot_f32_impl)(const float *, const float *, int);
+static float (*l2_f32_impl)(const float *, const float *, int);
+static int32_t (*dot_i8_impl)(const int8_t *, const int8_t *, int);
+
+static void distance_init() {
+	dot_f32_impl = dot_f32_generic;
+	l2_f32_impl = l2_f32_generic;
+	dot_i8_impl = dot_i8_generic;
+#ifdef DISTANCE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		dot_f32_impl = dot_f32_avx2;
+		l2_f32_impl = l2_f32_avx2;
+	}
+	if (__builtin_cpu_supports("avx2"))
+		dot_i8_impl = dot_i8_avx2;
+	if (__builtin_cpu_supports("avx512f")) {
+		dot_f32_impl = dot_f32_avx512;
+		l2_f32_impl = l2_f32_avx512;
+	}
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		dot_i8_impl = dot_i8_avx512;
+#endif
+}
+
+float vec_dot_f32(const float *a, const float *b, int n) {
+	if (dot_f32_impl == NULL)
+		distance_init();
+	return dot_f32_impl(a, b, n);
+}
+
+// squared euclidean distance
+float vec_l2_f32(const float *a, const float *b, int n) {
+	if (l2_f32_impl == NULL)
+		distance_init();
+	return l2_f32_impl(a, b, n);
+}
+
+int32_t vec_dot_i8(const int8_t *a, const int8_t *b, int n) {
+	if (dot_i8_impl == NULL)
+		distance_init();
+	return dot_i8_impl(a, b, n);
+}
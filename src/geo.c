@@ -0,0 +1,211 @@
+#include "common.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Geospatial index over a sorted set. Points are scored by a 52 bit geohash
+// interleaving 26 bits of latitude and longitude, the same scores Redis
+// uses, so members of a cell at any precision form one contiguous score
+// range. A search picks the finest precision whose cells span the search
+// area, scans the 3x3 block of cells around the centre as score ranges and
+// filters the points it finds by their exact distance.
+
+#define GEO_EARTH_RADIUS 6372797.560856
+#define GEO_PI 3.14159265358979323846
+
+static double rad(double deg) { return deg * (GEO_PI / 180); }
+
+static double deg(double rad) { return rad * (180 / GEO_PI); }
+
+// bits of x moved to the even positions of the result
+static uint64_t spread(uint32_t x) {
+	uint64_t v = x;
+	v = (v | v << 16) & 0x0000ffff0000ffffULL;
+	v = (v | v << 8) & 0x00ff00ff00ff00ffULL;
+	v = (v | v << 4) & 0x0f0f0f0f0f0f0f0fULL;
+	v = (v | v << 2) & 0x3333333333333333ULL;
+	v = (v | v << 1) & 0x5555555555555555ULL;
+	return v;
+}
+
+// inverse of spread, the even bits of v
+static uint32_t squash(uint64_t v) {
+	v &= 0x5555555555555555ULL;
+	v = (v | v >> 1) & 0x3333333333333333ULL;
+	v = (v | v >> 2) & 0x0f0f0f0f0f0f0f0fULL;
+	v = (v | v >> 4) & 0x00ff00ff00ff00ffULL;
+	v = (v | v >> 8) & 0x0000ffff0000ffffULL;
+	v = (v | v >> 16) & 0x00000000ffffffffULL;
+	return v;
+}
+
+// latitude bits go to the even positions and longitude bits to the odd ones
+static uint64_t interleave(uint32_t lat, uint32_t lon) { return spread(lat) | spread(lon) << 1; }
+
+// cell of x within [min, max] at step bits of precision
+static uint32_t cell(double x, double min, double max, int step) {
+	uint32_t n = 1u << step, i = (x - min) / (max - min) * n;
+	return i < n ? i : n - 1;
+}
+
+bool geo_valid(double lon, double lat) {
+	return lon >= GEO_LON_MIN && lon <= GEO_LON_MAX && lat >= GEO_LAT_MIN && lat <= GEO_LAT_MAX;
+}
+
+uint64_t geo_encode(double lon, double lat) {
+	return interleave(cell(lat, GEO_LAT_MIN, GEO_LAT_MAX, GEO_STEP_MAX),
+					  cell(lon, GEO_LON_MIN, GEO_LON_MAX, GEO_STEP_MAX));
+}
+
+// the centre of the cell hash stands for
+void geo_decode(uint64_t hash, double *lon, double *lat) {
+	double n = 1 << GEO_STEP_MAX;
+	*lat = GEO_LAT_MIN + (squash(hash) + 0.5) / n * (GEO_LAT_MAX - GEO_LAT_MIN);
+	*lon = GEO_LON_MIN + (squash(hash >> 1) + 0.5) / n * (GEO_LON_MAX - GEO_LON_MIN);
+}
+
+// great circle distance in meters by the haversine formula
+double geo_dist(double lon1, double lat1, double lon2, double lat2) {
+	double u = sin(rad(lat2 - lat1) / 2), v = sin(rad(lon2 - lon1) / 2);
+	double a = u * u + cos(rad(lat1)) * cos(rad(lat2)) * v * v;
+	return 2 * GEO_EARTH_RADIUS * asin(sqrt(a < 1 ? a : 1));
+}
+
+// whether lon lat falls in the shape, setting its distance from the centre.
+// A box is measured like Redis does, its height along the meridian and its
+// width along the parallel of the point
+static bool geo_within(GeoShape *s, double lon, double lat, double *dist) {
+	if (!s->box) {
+		*dist = geo_dist(s->lon, s->lat, lon, lat);
+		return *dist <= s->radius;
+	}
+	if (GEO_EARTH_RADIUS * fabs(rad(lat - s->lat)) > s->height / 2)
+		return false;
+	if (geo_dist(s->lon, lat, lon, lat) > s->width / 2)
+		return false;
+	*dist = geo_dist(s->lon, s->lat, lon, lat);
+	return true;
+}
+
+// half extents in degrees of the latitudes and longitudes the shape can reach,
+// a longitude extent of 180 covers every meridian
+static void geo_extent(GeoShape *s, double *dlat, double *dlon) {
+	double lat = rad(fabs(s->lat));
+	*dlon = 180;
+	if (!s->box) {
+		// a cap of angular radius r reaches asin(sin r / cos lat) meridians away
+		double r = s->radius / GEO_EARTH_RADIUS;
+		*dlat = deg(r);
+		if (r < GEO_PI / 2 - lat)
+			*dlon = deg(asin(sin(r) / cos(lat)));
+		return;
+	}
+	double h = s->height / 2 / GEO_EARTH_RADIUS, w = s->width / 2 / GEO_EARTH_RADIUS;
+	*dlat = deg(h);
+	// the widest parallel span is at the latitude closest to the pole
+	if (lat + h < GEO_PI / 2) {
+		double x = sin(w / 2) / cos(lat + h);
+		if (x < 1)
+			*dlon = deg(2 * asin(x));
+	}
+}
+
+// the finest step whose cells are at least as large as the extents, so that
+// the cells next to the centre one cover the shape
+static int geo_step(GeoShape *s) {
+	double dlat, dlon;
+	geo_extent(s, &dlat, &dlon);
+	int step = GEO_STEP_MAX;
+	while (step > 1 && ((GEO_LAT_MAX - GEO_LAT_MIN) / (1 << step) < dlat ||
+						(GEO_LON_MAX - GEO_LON_MIN) / (1 << step) < dlon))
+		step--;
+	return step;
+}
+
+typedef struct GeoRange {
+	uint64_t min;
+	uint64_t max;
+} GeoRange;
+
+static int cmp_range(const void *a, const void *b) {
+	const GeoRange *x = a, *y = b;
+	return x->min < y->min ? -1 : x->min > y->min;
+}
+
+// score ranges of the 3x3 cells around the centre, sorted with adjacent and
+// repeated ones merged, returns their number
+static int geo_ranges(GeoShape *s, GeoRange *ranges) {
+	int step = geo_step(s), shift = 2 * (GEO_STEP_MAX - step), n = 0;
+	int64_t cells = 1 << step;
+	int64_t lat = cell(s->lat, GEO_LAT_MIN, GEO_LAT_MAX, step);
+	int64_t lon = cell(s->lon, GEO_LON_MIN, GEO_LON_MAX, step);
+	for (int64_t i = lat - 1; i <= lat + 1; i++) {
+		if (i < 0 || i >= cells)
+			continue;
+		// longitudes wrap around the antimeridian
+		for (int64_t j = lon - 1; j <= lon + 1; j++) {
+			uint64_t hash = interleave(i, (j + cells) % cells);
+			ranges[n++] = (GeoRange){hash << shift, ((hash + 1) << shift) - 1};
+		}
+	}
+	qsort(ranges, n, sizeof(GeoRange), cmp_range);
+	int m = 0;
+	for (int i = 0; i < n; i++) {
+		if (m > 0 && ranges[i].min <= ranges[m - 1].max + 1) {
+			if (ranges[i].max > ranges[m - 1].max)
+				ranges[m - 1].max = ranges[i].max;
+		} else {
+			ranges[m++] = ranges[i];
+		}
+	}
+	return m;
+}
+
+typedef struct GeoScan {
+	GeoShape *shape;
+	// stop once limit matches are found, 0 for no limit
+	int limit;
+	int n;
+	int cap;
+	GeoMatch *res;
+} GeoScan;
+
+static bool geo_visit(char *member, double score, void *arg) {
+	GeoScan *sc = arg;
+	GeoMatch m = {.member = member, .hash = score};
+	geo_decode(m.hash, &m.lon, &m.lat);
+	if (!geo_within(sc->shape, m.lon, m.lat, &m.dist))
+		return true;
+	if (sc->n == sc->cap) {
+		sc->cap *= 2;
+		sc->res = drealloc(sc->res, sc->cap * sizeof(GeoMatch));
+	}
+	sc->res[sc->n++] = m;
+	return sc->limit == 0 || sc->n < sc->limit;
+}
+
+static int cmp_match_asc(const void *a, const void *b) {
+	const GeoMatch *x = a, *y = b;
+	return x->dist < y->dist ? -1 : x->dist > y->dist;
+}
+
+static int cmp_match_desc(const void *a, const void *b) { return cmp_match_asc(b, a); }
+
+// members of zs inside the shape. count > 0 keeps that many, the nearest
+// ones unless any is set, in which case the scan stops at the first count
+// found. Members are borrowed from the set
+GeoMatch *geo_search(ZSet *zs, GeoShape *shape, int sort, int count, bool any, int *n) {
+	GeoRange ranges[9];
+	int nranges = geo_ranges(shape, ranges);
+	GeoScan sc = {.shape = shape, .limit = any ? count : 0, .n = 0, .cap = 16};
+	sc.res = dmalloc(sc.cap * sizeof(GeoMatch));
+	for (int i = 0; i < nranges && (sc.limit == 0 || sc.n < sc.limit); i++)
+		zset_scan(zs, ranges[i].min, ranges[i].max, geo_visit, &sc);
+	if (count > 0 && !any && sort == GEO_SORT_NONE)
+		sort = GEO_SORT_ASC;
+	if (sort != GEO_SORT_NONE)
+		qsort(sc.res, sc.n, sizeof(GeoMatch),
+			  sort == GEO_SORT_ASC ? cmp_match_asc : cmp_match_desc);
+	*n = count > 0 && sc.n > count ? count : sc.n;
+	return sc.res;
+}
@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Hot restart. A server started with HYPERKV_HANDOVER set listens on a Unix
+// socket at that path, and a new process started with the same setting
+// connects to it before binding the port. The running server then writes its
+// keyspace to a memory file as an uncompressed snapshot and passes that and
+// its listening socket over the connection with SCM_RIGHTS. The new process
+// maps the memory file, so the data never goes through a disk, loads it like
+// any snapshot and accepts on the socket clients were already connecting to,
+// with the connections queued meanwhile. The old server exits once the new one
+// has acknowledged, and keeps serving if it goes away before that. The new one
+// waits for it to exit, so that only one of them appends to the log at a time.
+
+#define HANDOVER_MAGIC "HKVH"
+
+static struct {
+	// listening for a process taking over, -1 when off
+	int fd;
+	char *path;
+	// the connection of the process that took over, which waits for it to
+	// close, -1 until one has
+	int peer;
+} handover = {.fd = -1, .peer = -1};
+
+static long long now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static bool unix_addr(struct sockaddr_un *addr, char *path) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		log_error("Handover socket path %s is too long", path);
+		return false;
+	}
+	strcpy(addr->sun_path, path);
+	return true;
+}
+
+// listens at path for a process taking over, replacing the socket file a
+// previous server left there
+bool handover_listen(char *path) {
+	struct sockaddr_un addr;
+	if (!unix_addr(&addr, path))
+		return false;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	unlink(path);
+	if (fd < 0 || bind(fd, (SA *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+		log_error("Failed to listen for a handover on %s: %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+	handover.fd = fd;
+	free(handover.path);
+	handover.path = strdup(path);
+	log_info("Listening for a handover on %s", path);
+	return true;
+}
+
+int handover_fd() { return handover.fd; }
+
+// stops listening, and lets the process that took over go on. Call it last,
+// as that process starts appending to the log.
+void handover_close() {
+	if (handover.fd >= 0) {
+		close(handover.fd);
+		// the socket file is the new process's to replace
+		if (handover.peer < 0)
+			unlink(handover.path);
+	}
+	if (handover.peer >= 0)
+		close(handover.peer);
+	handover.fd = handover.peer = -1;
+}
+
+static bool send_fds(int cfd, int sfd, int mfd) {
+	int fds[] = {sfd, mfd};
+	char buf[CMSG_SPACE(sizeof(fds))];
+	memset(buf, 0, sizeof(buf));
+	struct iovec iov = {.iov_base = HANDOVER_MAGIC, .iov_len = strlen(HANDOVER_MAGIC)};
+	struct msghdr msg = {.msg_iov = &iov,
+						 .msg_iovlen = 1,
+						 .msg_control = buf,
+						 .msg_controllen = sizeof(buf)};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	return sendmsg(cfd, &msg, MSG_NOSIGNAL) == (ssize_t)iov.iov_len;
+}
+
+static bool recv_fds(int fd, int *sfd, int *mfd) {
+	int fds[2];
+	char magic[sizeof(HANDOVER_MAGIC)] = {0};
+	char buf[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = {.iov_base = magic, .iov_len = strlen(HANDOVER_MAGIC)};
+	struct msghdr msg = {.msg_iov = &iov,
+						 .msg_iovlen = 1,
+						 .msg_control = buf,
+						 .msg_controllen = sizeof(buf)};
+	if (recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)iov.iov_len ||
+		strcmp(magic, HANDOVER_MAGIC) != 0)
+		return false;
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+		return false;
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	*sfd = fds[0];
+	*mfd = fds[1];
+	return true;
+}
+
+// hands the keyspace and the listening socket sfd to the process connecting
+// to the handover socket. Returns true once it has taken them over, when this
+// process is left to exit through handover_close, or false if it could not.
+bool handover_send(int sfd, HashTable *ht) {
+	int cfd = accept4(handover.fd, NULL, NULL, SOCK_CLOEXEC);
+	if (cfd < 0)
+		return false;
+	long long start = now_us();
+	// nothing runs here once the data is handed over, so what is in flight
+	// settles first
+	snapshot_load_wait();
+	snapshot_poll(true);
+	aof_rewrite_poll(ht, true);
+	aof_flush();
+	aof_wait();
+	struct timeval timeout = {.tv_sec = HANDOVER_TIMEOUT_MS / 1000,
+							  .tv_usec = HANDOVER_TIMEOUT_MS % 1000 * 1000};
+	setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	int mfd = memfd_create("hyperkv-handover", MFD_CLOEXEC);
+	bool ok = mfd >= 0 && snapshot_save_fd(ht, mfd) && send_fds(cfd, sfd, mfd);
+	char ack;
+	ok = ok && read(cfd, &ack, 1) == 1;
+	if (mfd >= 0)
+		close(mfd);
+	if (!ok) {
+		log_warn("The new process did not take over, serving on");
+		close(cfd);
+		return false;
+	}
+	handover.peer = cfd;
+	log_info("Handed %d keys over in %lld us", ht->used, now_us() - start);
+	return true;
+}
+
+// takes over from the server listening for a handover at path, receiving its
+// listening socket into *sfd and loading its keyspace into ht, in the
+// background unless wait is set. Returns 1 once the old server has let go, 0
+// if none listens at path and -1 if the handover failed.
+int handover_receive(char *path, HashTable *ht, int *sfd, bool wait) {
+	struct sockaddr_un addr;
+	if (!unix_addr(&addr, path))
+		return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, (SA *)&addr, sizeof(addr)) != 0) {
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+	long long start = now_us();
+	int mfd;
+	if (!recv_fds(fd, sfd, &mfd)) {
+		log_error("No handover received from %s", path);
+		close(fd);
+		return -1;
+	}
+	char name[32];
+	sprintf(name, "/proc/self/fd/%d", mfd);
+	long long n = wait ? snapshot_load(ht, name) : snapshot_load_start(ht, name);
+	close(mfd);
+	char ack = 0;
+	if (n < 0 || write(fd, &ack, 1) != 1) {
+		close(*sfd);
+		close(fd);
+		return -1;
+	}
+	// the old server closes its end once it has stopped appending to the log
+	while (read(fd, &ack, 1) < 0 && errno == EINTR)
+		;
+	close(fd);
+	log_info("Took over %lld keys from %s in %lld us", n, path, now_us() - start);
+	return 1;
+}
@@ -76,8 +76,51 @@ static int sdbm(char *str, int size) {
 int hash_func(char *key, int size, int i) {
 	log_trace("Computing hash for key '%s', size %d, attempt %d", key, size, i);
 	int hash = djb2(key, size);
-	int res = i == 0 ? hash : hash + (i * (sdbm(key, size)));
-	return res % size;
+	if (i == 0)
+		return hash;
+	// a zero step would keep probing the home slot only
+	long step = sdbm(key, size);
+	if (step == 0)
+		step = 1;
+	return (hash + i * step) % size;
+}
+
+// MurmurHash64A
+uint64_t murmur64a(const void *key, int len, uint64_t seed) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = seed ^ (len * m);
+	const uint8_t *data = key, *end = data + (len - (len & 7));
+	for (; data != end; data += 8) {
+		uint64_t k;
+		memcpy(&k, data, sizeof(uint64_t));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+	switch (len & 7) {
+	case 7:
+		h ^= (uint64_t)data[6] << 48; // fall through
+	case 6:
+		h ^= (uint64_t)data[5] << 40; // fall through
+	case 5:
+		h ^= (uint64_t)data[4] << 32; // fall through
+	case 4:
+		h ^= (uint64_t)data[3] << 24; // fall through
+	case 3:
+		h ^= (uint64_t)data[2] << 16; // fall through
+	case 2:
+		h ^= (uint64_t)data[1] << 8; // fall through
+	case 1:
+		h ^= (uint64_t)data[0];
+		h *= m;
+	}
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
 }
 
 int ndigits(int x) {
@@ -118,3 +161,27 @@ char *intostr(int x) {
 	sprintf(res, "%d", x);
 	return res;
 }
+
+// parses a finite or infinite double, rejecting NaN and trailing garbage
+bool parse_double(char *str, double *res) {
+	char *end;
+	*res = strtod(str, &end);
+	return end != str && *end == '\0' && !isnan(*res);
+}
+
+// shortest representation of x that reads back to the same double
+char *dtostr(double x) {
+	char buf[32];
+	if (isinf(x))
+		return strdup(x > 0 ? "inf" : "-inf");
+	if (x == floor(x) && fabs(x) < 1e17) {
+		snprintf(buf, sizeof(buf), "%.0f", x);
+		return strdup(buf);
+	}
+	for (int prec = 1; prec <= 17; prec++) {
+		snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if (strtod(buf, NULL) == x)
+			break;
+	}
+	return strdup(buf);
+}
@@ -0,0 +1,241 @@
+#include "common.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// HyperLogLog with 2^14 registers of 6 bits. Sketches start sparse, as a
+// sorted array of (index, count) pairs for the non-zero registers, and turn
+// into the 12 KB dense encoding once that array outgrows HLL_SPARSE_MAX.
+// Merges unpack registers to one byte each so they can be maxed 16 at a time.
+
+#define HLL_Q (64 - HLL_P)
+#define HLL_ALPHA_INF 0.721347520444481703680
+
+static int dense_get(uint8_t *regs, int i) {
+	int byte = i * HLL_BITS / 8, fb = i * HLL_BITS & 7;
+	unsigned b0 = regs[byte], b1 = fb > 8 - HLL_BITS ? regs[byte + 1] : 0;
+	return ((b0 >> fb) | (b1 << (8 - fb))) & HLL_REGISTER_MAX;
+}
+
+static void dense_set(uint8_t *regs, int i, int val) {
+	int byte = i * HLL_BITS / 8, fb = i * HLL_BITS & 7;
+	regs[byte] &= ~(HLL_REGISTER_MAX << fb);
+	regs[byte] |= val << fb;
+	if (fb > 8 - HLL_BITS) {
+		regs[byte + 1] &= ~(HLL_REGISTER_MAX >> (8 - fb));
+		regs[byte + 1] |= val >> (8 - fb);
+	}
+}
+
+// every 3 packed bytes hold 4 registers
+static void dense_unpack(uint8_t *regs, uint8_t *raw) {
+	for (int i = 0, j = 0; i < HLL_REGISTERS; i += 4, j += 3) {
+		unsigned b0 = regs[j], b1 = regs[j + 1], b2 = regs[j + 2];
+		raw[i] = b0 & 63;
+		raw[i + 1] = (b0 >> 6 | b1 << 2) & 63;
+		raw[i + 2] = (b1 >> 4 | b2 << 4) & 63;
+		raw[i + 3] = b2 >> 2;
+	}
+}
+
+static void dense_pack(uint8_t *raw, uint8_t *regs) {
+	for (int i = 0, j = 0; i < HLL_REGISTERS; i += 4, j += 3) {
+		regs[j] = raw[i] | raw[i + 1] << 6;
+		regs[j + 1] = raw[i + 1] >> 2 | raw[i + 2] << 4;
+		regs[j + 2] = raw[i + 2] >> 4 | raw[i + 3] << 2;
+	}
+}
+
+// index of the sparse entry for register i, or where it would be inserted
+static int sparse_find(HyperLogLog *hll, int i) {
+	int lo = 0, hi = hll->nsparse;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if ((int)(hll->sparse[mid] >> 8) < i)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void hll_to_dense(HyperLogLog *hll) {
+	hll->registers = calloc(HLL_DENSE_BYTES, sizeof(uint8_t));
+	for (int k = 0; k < hll->nsparse; k++)
+		dense_set(hll->registers, hll->sparse[k] >> 8, hll->sparse[k] & 0xff);
+	free(hll->sparse);
+	hll->sparse = NULL;
+	hll->nsparse = hll->cap = 0;
+	hll->dense = true;
+}
+
+static bool sparse_set(HyperLogLog *hll, int i, int count) {
+	int k = sparse_find(hll, i);
+	if (k < hll->nsparse && (int)(hll->sparse[k] >> 8) == i) {
+		if ((int)(hll->sparse[k] & 0xff) >= count)
+			return false;
+		hll->sparse[k] = (uint32_t)i << 8 | count;
+		return true;
+	}
+	if (hll->nsparse == HLL_SPARSE_MAX) {
+		hll_to_dense(hll);
+		dense_set(hll->registers, i, count);
+		return true;
+	}
+	if (hll->nsparse == hll->cap) {
+		hll->cap = hll->cap == 0 ? 16 : hll->cap * 2;
+		hll->sparse = drealloc(hll->sparse, hll->cap * sizeof(uint32_t));
+	}
+	memmove(hll->sparse + k + 1, hll->sparse + k, (hll->nsparse - k) * sizeof(uint32_t));
+	hll->sparse[k] = (uint32_t)i << 8 | count;
+	hll->nsparse++;
+	return true;
+}
+
+HyperLogLog *hll_init() {
+	HyperLogLog *hll = dmalloc(sizeof(HyperLogLog));
+	hll->dense = false;
+	hll->cached = true;
+	hll->card = 0;
+	hll->nsparse = hll->cap = 0;
+	hll->sparse = NULL;
+	hll->registers = NULL;
+	return hll;
+}
+
+void hll_free(HyperLogLog *hll) {
+	if (hll == NULL)
+		return;
+	free(hll->sparse);
+	free(hll->registers);
+	free(hll);
+}
+
+// returns true if the sketch changed, i.e. the estimate may have changed
+bool hll_add(HyperLogLog *hll, char *value) {
+	uint64_t hash = murmur64a(value, strlen(value), 0xadc83b19ULL);
+	int i = hash & (HLL_REGISTERS - 1);
+	// the run of zeros is counted on the bits left after the index, the set
+	// sentinel bit caps it at HLL_Q + 1
+	hash >>= HLL_P;
+	hash |= 1ULL << HLL_Q;
+	int count = __builtin_ctzll(hash) + 1;
+
+	bool changed;
+	if (hll->dense) {
+		changed = dense_get(hll->registers, i) < count;
+		if (changed)
+			dense_set(hll->registers, i, count);
+	} else {
+		changed = sparse_set(hll, i, count);
+	}
+	if (changed)
+		hll->cached = false;
+	return changed;
+}
+
+// registers are merged unpacked, one byte each
+void hll_raw_max(uint8_t *dst, uint8_t *src) {
+#ifdef __SSE2__
+	for (int i = 0; i < HLL_REGISTERS; i += 16) {
+		__m128i a = _mm_loadu_si128((__m128i *)(dst + i));
+		__m128i b = _mm_loadu_si128((__m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(a, b));
+	}
+#else
+	for (int i = 0; i < HLL_REGISTERS; i++)
+		dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+#endif
+}
+
+// folds the registers of hll into raw, which holds HLL_REGISTERS bytes
+void hll_merge(uint8_t *raw, HyperLogLog *hll) {
+	if (hll->dense) {
+		uint8_t tmp[HLL_REGISTERS];
+		dense_unpack(hll->registers, tmp);
+		hll_raw_max(raw, tmp);
+		return;
+	}
+	for (int k = 0; k < hll->nsparse; k++) {
+		int i = hll->sparse[k] >> 8, count = hll->sparse[k] & 0xff;
+		if (raw[i] < count)
+			raw[i] = count;
+	}
+}
+
+// replaces the registers of hll with the unpacked ones in raw
+void hll_set_raw(HyperLogLog *hll, uint8_t *raw) {
+	if (!hll->dense)
+		hll_to_dense(hll);
+	dense_pack(raw, hll->registers);
+	hll->cached = false;
+}
+
+static double hll_tau(double x) {
+	if (x == 0 || x == 1)
+		return 0;
+	double zp, y = 1, z = 1 - x;
+	do {
+		x = sqrt(x);
+		zp = z;
+		y *= 0.5;
+		z -= pow(1 - x, 2) * y;
+	} while (zp != z);
+	return z / 3;
+}
+
+static double hll_sigma(double x) {
+	if (x == 1)
+		return INFINITY;
+	double zp, y = 1, z = x;
+	do {
+		x *= x;
+		zp = z;
+		z += x * y;
+		y += y;
+	} while (zp != z);
+	return z;
+}
+
+// cardinality estimate from a register histogram, using Ertl's improved
+// estimator which needs no bias correction tables
+static long long hll_estimate_hist(int *hist) {
+	double m = HLL_REGISTERS;
+	double z = m * hll_tau((m - hist[HLL_Q + 1]) / m);
+	for (int j = HLL_Q; j >= 1; j--) {
+		z += hist[j];
+		z *= 0.5;
+	}
+	z += m * hll_sigma(hist[0] / m);
+	return llroundl(HLL_ALPHA_INF * m * m / z);
+}
+
+long long hll_estimate(uint8_t *raw) {
+	int hist[64] = {0};
+	for (int i = 0; i < HLL_REGISTERS; i++)
+		hist[raw[i]]++;
+	return hll_estimate_hist(hist);
+}
+
+long long hll_count(HyperLogLog *hll) {
+	if (hll->cached)
+		return hll->card;
+	if (hll->dense) {
+		uint8_t raw[HLL_REGISTERS];
+		dense_unpack(hll->registers, raw);
+		hll->card = hll_estimate(raw);
+	} else {
+		int hist[64] = {0};
+		hist[0] = HLL_REGISTERS - hll->nsparse;
+		for (int k = 0; k < hll->nsparse; k++)
+			hist[hll->sparse[k] & 0xff]++;
+		hll->card = hll_estimate_hist(hist);
+	}
+	hll->cached = true;
+	return hll->card;
+}
@@ -7,22 +7,26 @@
 
 HashTableItem HT_DELETED;
 
-static void htable_insert(HashTable *ht, int type, char *key, void *value);
+static HashTableItem *htable_insert(HashTable *ht, int type, char *key, void *value);
 
 HashTable *htable_init(int size) {
 	log_debug("Initializing hash table with size %d", size);
 	HashTable *ht = dmalloc(sizeof(HashTable));
 	ht->size = next_prime(size);
 	ht->used = 0;
+	ht->epoch = 0;
+	ht->clock = 0;
 	ht->items = calloc(ht->size, sizeof(HashTableItem *));
 	log_debug("Hash table initialized with adjusted size %d", ht->size);
 	return ht;
 }
 
-static HashTableItem *item_init(int type, char *key, void *value) {
+static HashTableItem *item_init(HashTable *ht, int type, char *key, void *value) {
 	log_trace("Creating hash table item with key '%s'", key);
 	HashTableItem *item = dmalloc(sizeof(HashTableItem));
 	item->type = type;
+	item->epoch = ht->epoch;
+	item->access = ht->clock;
 	item->key = strdup(key);
 	item->value = value;
 	return item;
@@ -32,7 +36,7 @@ static void item_free(HashTableItem *item) {
 	log_trace("Freeing hash table item with key '%s'", item->key);
 	switch (item->type) {
 	case STR_T:
-		free(item->value);
+		str_free(item->value);
 		break;
 	case HASH_T:
 		htable_free((HashTable *)item->value);
@@ -43,6 +47,39 @@ static void item_free(HashTableItem *item) {
 	case SET_T:
 		set_free((Set *)item->value);
 		break;
+	case ZSET_T:
+		zset_free((ZSet *)item->value);
+		break;
+	case HLL_T:
+		hll_free((HyperLogLog *)item->value);
+		break;
+	case ROARING_T:
+		roaring_free((Roaring *)item->value);
+		break;
+	case STREAM_T:
+		stream_free((Stream *)item->value);
+		break;
+	case BLOOM_T:
+		bloom_free((Bloom *)item->value);
+		break;
+	case TS_T:
+		ts_free((TimeSeries *)item->value);
+		break;
+	case JSON_T:
+		json_free((JsonNode *)item->value);
+		break;
+	case VSET_T:
+		vset_free((VectorSet *)item->value);
+		break;
+	case CMS_T:
+		cms_free((CountMin *)item->value);
+		break;
+	case TOPK_T:
+		topk_free((TopK *)item->value);
+		break;
+	case RATELIMIT_T:
+		free(item->value);
+		break;
 	}
 	free(item->key);
 	free(item);
@@ -64,9 +101,16 @@ void htable_free(HashTable *ht) {
 	log_debug("Hash table freed successfully");
 }
 
-static void item_swap(HashTable *new_ht, HashTableItem *item) {
-	htable_insert(new_ht, item->type, item->key, item->value);
-	item->value = NULL;
+// moves item into new_ht, which has room for it
+static void item_move(HashTable *new_ht, HashTableItem *item) {
+	for (int i = 0; i < new_ht->size; i++) {
+		int hash = hash_func(item->key, new_ht->size, i);
+		if (new_ht->items[hash] == NULL) {
+			new_ht->items[hash] = item;
+			new_ht->used++;
+			return;
+		}
+	}
 }
 
 static void htable_resize(HashTable *ht, int new_size) {
@@ -77,9 +121,9 @@ static void htable_resize(HashTable *ht, int new_size) {
 	HashTable *new_ht = htable_init(new_size);
 	for (int i = 0; i < ht->size; i++) {
 		HashTableItem *cur_item = ht->items[i];
-		if (cur_item != NULL && !is_deleted(cur_item)) {
-			item_swap(new_ht, cur_item);
-		}
+		if (cur_item != NULL && !is_deleted(cur_item))
+			item_move(new_ht, cur_item);
+		ht->items[i] = NULL;
 	}
 
 	int tmp_size = ht->size;
@@ -106,20 +150,22 @@ static void htable_resize_down(HashTable *ht) {
 		htable_resize(ht, ht->size / 2);
 }
 
-static void htable_insert(HashTable *ht, int type, char *key, void *value) {
+static HashTableItem *htable_insert(HashTable *ht, int type, char *key, void *value) {
 	log_debug("Inserting key '%s' into hash table", key);
 	for (int i = 0; i < ht->size; i++) {
 		int hash = hash_func(key, ht->size, i);
 		HashTableItem *cur_item = ht->items[hash];
 
 		if (cur_item == NULL || is_deleted(cur_item)) {
-			ht->items[hash] = item_init(type, key, value);
+			HashTableItem *item = item_init(ht, type, key, value);
+			ht->items[hash] = item;
 			ht->used++;
 			htable_resize_up(ht);
 			log_debug("Key '%s' inserted successfully at hash %d", key, hash);
-			break;
+			return item;
 		}
 	}
+	return NULL;
 }
 
 HashTableItem *htable_search(HashTable *ht, char *key) {
@@ -131,6 +177,10 @@ HashTableItem *htable_search(HashTable *ht, char *key) {
 			return NULL;
 		if (!is_deleted(cur_item) && strcmp(cur_item->key, key) == 0) {
 			log_trace("Key '%s' found at hash %d", key, hash);
+			// written only when it changes, to keep pages read by a forked
+			// snapshot shared
+			if (cur_item->access != ht->clock)
+				cur_item->access = ht->clock;
 			return cur_item;
 		}
 	}
@@ -138,6 +188,30 @@ HashTableItem *htable_search(HashTable *ht, char *key) {
 	return NULL;
 }
 
+// the next live item from slot *pos on, moving *pos past it, NULL at the end
+HashTableItem *htable_next(HashTable *ht, int *pos) {
+	for (; *pos < ht->size; (*pos)++) {
+		HashTableItem *item = ht->items[*pos];
+		if (item != NULL && !is_deleted(item)) {
+			(*pos)++;
+			return item;
+		}
+	}
+	return NULL;
+}
+
+// sets key to a value of type built elsewhere, replacing whatever it held
+HashTableItem *htable_restore(HashTable *ht, char *key, int type, void *value) {
+	htable_del(ht, key);
+	return htable_insert(ht, type, key, value);
+}
+
+// grows the table ahead of n inserts so that none of them resizes it
+void htable_reserve(HashTable *ht, int n) {
+	if ((long long)(ht->used + n) * 100 / ht->size > 70)
+		htable_resize(ht, (ht->used + n) * 2);
+}
+
 bool htable_exists(HashTable *ht, char *key) {
 	log_trace("Checking if key '%s' exists in hash table", key);
 	HashTableItem *item = htable_search(ht, key);
@@ -157,6 +231,28 @@ char *htable_type(HashTable *ht, char *key) {
 		return strdup("list");
 	case SET_T:
 		return strdup("set");
+	case ZSET_T:
+		return strdup("zset");
+	case HLL_T:
+		return strdup("hyperloglog");
+	case ROARING_T:
+		return strdup("roaring");
+	case STREAM_T:
+		return strdup("stream");
+	case BLOOM_T:
+		return strdup("bloom");
+	case TS_T:
+		return strdup("timeseries");
+	case JSON_T:
+		return strdup("json");
+	case VSET_T:
+		return strdup("vectorset");
+	case CMS_T:
+		return strdup("cms");
+	case TOPK_T:
+		return strdup("topk");
+	case RATELIMIT_T:
+		return strdup("ratelimit");
 	}
 	return NULL;
 }
@@ -193,7 +289,7 @@ static void htable_update_str(HashTable *ht, char *key, void *value) {
 			break;
 		if (!is_deleted(cur_item) && strcmp(cur_item->key, key) == 0) {
 			item_free(cur_item);
-			ht->items[hash] = item_init(STR_T, key, value);
+			ht->items[hash] = item_init(ht, STR_T, key, value);
 			break;
 		}
 	}
@@ -246,14 +342,14 @@ bool htable_set(HashTable *ht, char *key, char *value) {
 	log_debug("Setting string key '%s' with value", key);
 	HashTableItem *item = htable_search(ht, key);
 	if (item == NULL) {
-		htable_insert(ht, STR_T, key, strdup(value));
+		htable_insert(ht, STR_T, key, str_new(value, strlen(value)));
 		return true;
 	}
 	if (item->type != STR_T) {
 		log_warn("Cannot set string value for non-string key '%s' (type: %d)", key, item->type);
 		return false;
 	}
-	htable_update_str(ht, key, strdup(value));
+	htable_update_str(ht, key, str_new(value, strlen(value)));
 	return true;
 }
 
@@ -268,6 +364,7 @@ bool htable_hset(HashTable *ht, char *key, char *field, char *value) {
 }
 
 int htable_push(HashTable *ht, char *key, char *value, int dir) {
+	block_signal(key);
 	if (htable_exists(ht, key)) {
 		return htable_update_list(ht, key, value, dir);
 	}
@@ -309,8 +406,7 @@ char *htable_pop(HashTable *ht, char *key, int dir) {
 	if (tmp == NULL)
 		return NULL;
 	List *tmp_ls = (List *)tmp->value;
-	ListNode *tmp_nd = dir == LEFT ? list_lpop(tmp_ls) : list_rpop(tmp_ls);
-	char *res = tmp_nd->value;
+	char *res = dir == LEFT ? list_lpop(tmp_ls) : list_rpop(tmp_ls);
 	if (tmp_ls->len == 0)
 		htable_del(ht, key);
 	return res;
@@ -372,8 +468,7 @@ char *htable_lindex(HashTable *ht, char *key, int id) {
 	if (tmp == NULL)
 		return NULL;
 	List *tmp_ls = (List *)tmp->value;
-	ListNode *tmp_nd = list_index(tmp_ls, id);
-	return tmp_nd != NULL ? tmp_nd->value : NULL;
+	return list_index(tmp_ls, id);
 }
 
 bool htable_lset(HashTable *ht, char *key, int id, char *value) {
@@ -486,3 +581,927 @@ char **htable_smembers(HashTable *ht, char *key) {
 	Set *tmp_st = (Set *)tmp->value;
 	return set_members(tmp_st);
 }
+
+// collects the sets stored at keys, missing keys are left as NULL
+static Set **htable_sets(HashTable *ht, char **keys, int n) {
+	Set **sets = dmalloc(n * sizeof(Set *));
+	for (int i = 0; i < n; i++) {
+		HashTableItem *tmp = htable_search(ht, keys[i]);
+		sets[i] = tmp != NULL ? (Set *)tmp->value : NULL;
+	}
+	return sets;
+}
+
+char **htable_setop(HashTable *ht, char **keys, int n, int op) {
+	Set **sets = htable_sets(ht, keys, n);
+	Set *res = set_op(sets, n, op);
+	char **members = set_members(res);
+	set_free(res);
+	free(sets);
+	return members;
+}
+
+int htable_setopstore(HashTable *ht, char *dst, char **keys, int n, int op) {
+	Set **sets = htable_sets(ht, keys, n);
+	Set *res = set_op(sets, n, op);
+	int used = res->used;
+	free(sets);
+	htable_del(ht, dst);
+	if (used > 0)
+		htable_insert(ht, SET_T, dst, res);
+	else
+		set_free(res);
+	return used;
+}
+
+int htable_sintercard(HashTable *ht, char **keys, int n, int limit) {
+	Set **sets = htable_sets(ht, keys, n);
+	int res = set_intercard(sets, n, limit);
+	free(sets);
+	return res;
+}
+
+static ZSet *htable_zset(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (ZSet *)tmp->value : NULL;
+}
+
+bool htable_zadd(HashTable *ht, char *key, char *member, double score) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL) {
+		zs = zset_init();
+		htable_insert(ht, ZSET_T, key, zs);
+	}
+	return zset_add(zs, member, score);
+}
+
+bool htable_zrem(HashTable *ht, char *key, char *member) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL)
+		return false;
+	bool res = zset_rem(zs, member);
+	if (zs->len == 0)
+		htable_del(ht, key);
+	return res;
+}
+
+bool htable_zscore(HashTable *ht, char *key, char *member, double *score) {
+	ZSet *zs = htable_zset(ht, key);
+	return zs != NULL && zset_score(zs, member, score);
+}
+
+int htable_zcard(HashTable *ht, char *key) {
+	ZSet *zs = htable_zset(ht, key);
+	return zs != NULL ? zs->len : 0;
+}
+
+int htable_zrank(HashTable *ht, char *key, char *member, bool rev) {
+	ZSet *zs = htable_zset(ht, key);
+	int rank = zs != NULL ? zset_rank(zs, member) : -1;
+	return rank >= 0 && rev ? zs->len - 1 - rank : rank;
+}
+
+// ranks may be negative to count from the end and are clamped to the set,
+// returns NULL when the range is empty
+char **htable_zrange(HashTable *ht, char *key, int start, int end, bool rev, bool withscores) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL)
+		return NULL;
+	start = start < 0 ? zs->len + start : start;
+	end = end < 0 ? zs->len + end : end;
+	if (start < 0)
+		start = 0;
+	if (end >= zs->len)
+		end = zs->len - 1;
+	if (start > end)
+		return NULL;
+	return zset_range(zs, start, end, rev, withscores);
+}
+
+char **htable_zrangebyscore(HashTable *ht, char *key, double min, bool minex, double max,
+							bool maxex, bool rev, bool withscores) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL)
+		return NULL;
+	// ascending ranks of the first and last member within the bounds
+	int first = zset_count_below(zs, min, minex);
+	int last = zset_count_below(zs, max, !maxex) - 1;
+	if (first > last)
+		return NULL;
+	if (rev)
+		return zset_range(zs, zs->len - 1 - last, zs->len - 1 - first, true, withscores);
+	return zset_range(zs, first, last, false, withscores);
+}
+
+static HyperLogLog *htable_hll(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (HyperLogLog *)tmp->value : NULL;
+}
+
+// returns true if the sketch was created or any register changed
+bool htable_pfadd(HashTable *ht, char *key, char **values, int n) {
+	HyperLogLog *hll = htable_hll(ht, key);
+	bool changed = false;
+	if (hll == NULL) {
+		hll = hll_init();
+		htable_insert(ht, HLL_T, key, hll);
+		changed = true;
+	}
+	for (int i = 0; i < n; i++)
+		changed |= hll_add(hll, values[i]);
+	return changed;
+}
+
+// estimate of the union of the sketches at keys
+long long htable_pfcount(HashTable *ht, char **keys, int n) {
+	if (n == 1) {
+		HyperLogLog *hll = htable_hll(ht, keys[0]);
+		return hll != NULL ? hll_count(hll) : 0;
+	}
+	uint8_t *raw = calloc(HLL_REGISTERS, sizeof(uint8_t));
+	for (int i = 0; i < n; i++) {
+		HyperLogLog *hll = htable_hll(ht, keys[i]);
+		if (hll != NULL)
+			hll_merge(raw, hll);
+	}
+	long long res = hll_estimate(raw);
+	free(raw);
+	return res;
+}
+
+// stores the union of dst and the sketches at keys into dst
+void htable_pfmerge(HashTable *ht, char *dst, char **keys, int n) {
+	uint8_t *raw = calloc(HLL_REGISTERS, sizeof(uint8_t));
+	HyperLogLog *res = htable_hll(ht, dst);
+	if (res == NULL) {
+		res = hll_init();
+		htable_insert(ht, HLL_T, dst, res);
+	}
+	hll_merge(raw, res);
+	for (int i = 0; i < n; i++) {
+		HyperLogLog *hll = htable_hll(ht, keys[i]);
+		if (hll != NULL && hll != res)
+			hll_merge(raw, hll);
+	}
+	hll_set_raw(res, raw);
+	free(raw);
+}
+
+// returns the previous value of the bit, growing the string as needed
+int htable_setbit(HashTable *ht, char *key, int offset, int bit) {
+	HashTableItem *tmp = htable_search(ht, key);
+	if (tmp == NULL) {
+		htable_insert(ht, STR_T, key, str_new("", 0));
+		tmp = htable_search(ht, key);
+	}
+	int byte = offset >> 3, shift = 7 - (offset & 7);
+	tmp->value = str_grow(tmp->value, byte + 1);
+	uint8_t *p = (uint8_t *)tmp->value + byte;
+	int old = *p >> shift & 1;
+	*p = (*p & ~(1 << shift)) | bit << shift;
+	return old;
+}
+
+int htable_getbit(HashTable *ht, char *key, int offset) {
+	char *value = htable_get(ht, key);
+	if (value == NULL || offset >> 3 >= str_len(value))
+		return 0;
+	return (uint8_t)value[offset >> 3] >> (7 - (offset & 7)) & 1;
+}
+
+// clamps the range start..end (negative counts from the end) to 0..len - 1,
+// returns false when it is empty
+static bool range_clamp(int *start, int *end, int len) {
+	*start = *start < 0 ? len + *start : *start;
+	*end = *end < 0 ? len + *end : *end;
+	if (*start < 0)
+		*start = 0;
+	if (*end >= len)
+		*end = len - 1;
+	return *start <= *end;
+}
+
+// set bits within the byte range, or the bit range when bits is set
+long htable_bitcount(HashTable *ht, char *key, int start, int end, bool bits) {
+	char *value = htable_get(ht, key);
+	if (value == NULL)
+		return 0;
+	uint8_t *p = (uint8_t *)value;
+	int len = str_len(value);
+	if (!range_clamp(&start, &end, bits ? len * 8 : len))
+		return 0;
+	if (!bits)
+		return bit_count(p + start, end - start + 1);
+	// count the covering bytes, then drop the bits outside the range
+	int first = start >> 3, last = end >> 3;
+	long count = bit_count(p + first, last - first + 1);
+	count -= __builtin_popcount(p[first] >> (8 - (start & 7)));
+	count -= __builtin_popcount(p[last] & ((1 << (7 - (end & 7))) - 1));
+	return count;
+}
+
+// stores op over the strings at keys into dst, returns the length of dst
+int htable_bitop(HashTable *ht, int op, char *dst, char **keys, int n) {
+	uint8_t **srcs = dmalloc(n * sizeof(uint8_t *));
+	int *lens = dmalloc(n * sizeof(int)), len = 0;
+	for (int i = 0; i < n; i++) {
+		char *value = htable_get(ht, keys[i]);
+		srcs[i] = (uint8_t *)(value != NULL ? value : "");
+		lens[i] = value != NULL ? str_len(value) : 0;
+		len = lens[i] > len ? lens[i] : len;
+	}
+	char *res = len > 0 ? str_grow(str_new("", 0), len) : NULL;
+	if (res != NULL)
+		bit_op(op, (uint8_t *)res, srcs, lens, n, len);
+	htable_del(ht, dst);
+	if (res != NULL)
+		htable_insert(ht, STR_T, dst, res);
+	free(srcs);
+	free(lens);
+	return len;
+}
+
+// first bit equal to bit within the byte range start..end, -1 if none. When
+// looking for a clear bit without an explicit end, the string counts as
+// padded with zeros.
+long htable_bitpos(HashTable *ht, char *key, int bit, int start, int end, bool has_end) {
+	char *value = htable_get(ht, key);
+	if (value == NULL)
+		return bit ? -1 : 0;
+	int len = str_len(value);
+	if (!range_clamp(&start, &end, len))
+		return -1;
+	long pos = bit_pos((uint8_t *)value + start, end - start + 1, bit);
+	if (pos >= 0)
+		return start * 8L + pos;
+	return bit == 0 && !has_end ? (end + 1) * 8L : -1;
+}
+
+static Roaring *htable_roaring(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (Roaring *)tmp->value : NULL;
+}
+
+// returns the number of ids that were not in the bitmap
+int htable_rbadd(HashTable *ht, char *key, uint32_t *ids, int n) {
+	Roaring *rb = htable_roaring(ht, key);
+	if (rb == NULL) {
+		rb = roaring_init();
+		htable_insert(ht, ROARING_T, key, rb);
+	}
+	int added = 0;
+	for (int i = 0; i < n; i++)
+		added += roaring_add(rb, ids[i]);
+	roaring_optimize(rb);
+	return added;
+}
+
+// returns the number of ids removed, the key goes once the bitmap is empty
+int htable_rbrem(HashTable *ht, char *key, uint32_t *ids, int n) {
+	Roaring *rb = htable_roaring(ht, key);
+	if (rb == NULL)
+		return 0;
+	int removed = 0;
+	for (int i = 0; i < n; i++)
+		removed += roaring_rem(rb, ids[i]);
+	if (rb->card == 0)
+		htable_del(ht, key);
+	else
+		roaring_optimize(rb);
+	return removed;
+}
+
+bool htable_rbismember(HashTable *ht, char *key, uint32_t id) {
+	Roaring *rb = htable_roaring(ht, key);
+	return rb != NULL && roaring_contains(rb, id);
+}
+
+long long htable_rbcard(HashTable *ht, char *key) {
+	Roaring *rb = htable_roaring(ht, key);
+	return rb != NULL ? rb->card : 0;
+}
+
+char **htable_rbmembers(HashTable *ht, char *key) {
+	Roaring *rb = htable_roaring(ht, key);
+	if (rb == NULL)
+		return NULL;
+	uint32_t *ids = roaring_members(rb);
+	char **res = dmalloc((rb->card + 1) * sizeof(char *));
+	char buf[16];
+	for (long long i = 0; i < rb->card; i++) {
+		sprintf(buf, "%u", ids[i]);
+		res[i] = strdup(buf);
+	}
+	res[rb->card] = NULL;
+	free(ids);
+	return res;
+}
+
+// stores op over the bitmaps at keys into dst, returns its cardinality
+long long htable_rbop(HashTable *ht, int op, char *dst, char **keys, int n) {
+	Roaring **rbs = dmalloc(n * sizeof(Roaring *));
+	for (int i = 0; i < n; i++)
+		rbs[i] = htable_roaring(ht, keys[i]);
+	Roaring *res = roaring_op(rbs, n, op);
+	free(rbs);
+	long long card = res->card;
+	htable_del(ht, dst);
+	if (card > 0)
+		htable_insert(ht, ROARING_T, dst, res);
+	else
+		roaring_free(res);
+	return card;
+}
+
+static Stream *htable_stream(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (Stream *)tmp->value : NULL;
+}
+
+// appends an entry, creating the stream, then trims it to maxlen unless that
+// is negative. Returns false if the id does not go past the last one.
+bool htable_xadd(HashTable *ht, char *key, StreamID *id, int gen, char **fields, int n,
+				 long long maxlen, bool approx) {
+	Stream *s = htable_stream(ht, key);
+	bool created = s == NULL;
+	if (created)
+		s = stream_init();
+	if (!stream_add(s, id, gen, fields, n)) {
+		if (created)
+			stream_free(s);
+		return false;
+	}
+	if (created)
+		htable_insert(ht, STREAM_T, key, s);
+	if (maxlen >= 0)
+		stream_trim(s, maxlen, approx);
+	block_signal(key);
+	return true;
+}
+
+long long htable_xlen(HashTable *ht, char *key) {
+	Stream *s = htable_stream(ht, key);
+	return s != NULL ? s->len : 0;
+}
+
+long long htable_xtrim(HashTable *ht, char *key, long long maxlen, bool approx) {
+	Stream *s = htable_stream(ht, key);
+	return s != NULL ? stream_trim(s, maxlen, approx) : 0;
+}
+
+StreamEntry *htable_xrange(HashTable *ht, char *key, StreamID start, StreamID end,
+						   long long count, int *n) {
+	Stream *s = htable_stream(ht, key);
+	*n = 0;
+	return s != NULL ? stream_range(s, start, end, count, n) : NULL;
+}
+
+// last id added to the stream, 0-0 if there is none
+StreamID htable_xlast(HashTable *ht, char *key) {
+	Stream *s = htable_stream(ht, key);
+	return s != NULL ? s->last : (StreamID){0, 0};
+}
+
+// creates group starting after *id, or after the last entry when id is NULL.
+// Returns -1 if the stream is missing and mkstream is not set, -2 if the
+// group already exists.
+int htable_xgroup_create(HashTable *ht, char *key, char *group, StreamID *id, bool mkstream) {
+	Stream *s = htable_stream(ht, key);
+	if (s == NULL) {
+		if (!mkstream)
+			return -1;
+		s = stream_init();
+		htable_insert(ht, STREAM_T, key, s);
+	}
+	return stream_group_create(s, group, id != NULL ? *id : s->last) ? 0 : -2;
+}
+
+bool htable_xgroup_destroy(HashTable *ht, char *key, char *group) {
+	Stream *s = htable_stream(ht, key);
+	return s != NULL && stream_group_destroy(s, group);
+}
+
+bool htable_xgroup_exists(HashTable *ht, char *key, char *group) {
+	Stream *s = htable_stream(ht, key);
+	return s != NULL && stream_group(s, group) != NULL;
+}
+
+// see stream_read_group, *n is -1 if the stream or the group is missing
+StreamEntry *htable_xreadgroup(HashTable *ht, char *key, char *group, char *consumer,
+							   StreamID *after, long long count, bool noack, int *n) {
+	Stream *s = htable_stream(ht, key);
+	StreamGroup *g = s != NULL ? stream_group(s, group) : NULL;
+	*n = -1;
+	if (g == NULL)
+		return NULL;
+	return stream_read_group(s, g, consumer, after, count, noack, n);
+}
+
+// returns the number of ids that were pending in the group
+int htable_xack(HashTable *ht, char *key, char *group, StreamID *ids, int n) {
+	Stream *s = htable_stream(ht, key);
+	StreamGroup *g = s != NULL ? stream_group(s, group) : NULL;
+	int acked = 0;
+	for (int i = 0; g != NULL && i < n; i++)
+		acked += stream_ack(g, ids[i]);
+	return acked;
+}
+
+static Bloom *htable_bloom(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (Bloom *)tmp->value : NULL;
+}
+
+// returns false if the key already exists
+bool htable_bfreserve(HashTable *ht, char *key, double error, long long capacity, int expansion) {
+	if (htable_exists(ht, key))
+		return false;
+	htable_insert(ht, BLOOM_T, key, bloom_init(error, capacity, expansion));
+	return true;
+}
+
+// adds items to the filter at key, creating it with the default error rate
+// and capacity
+void htable_bfadd(HashTable *ht, char *key, char **items, int n, int *res) {
+	Bloom *bf = htable_bloom(ht, key);
+	if (bf == NULL) {
+		bf = bloom_init(BLOOM_DEFAULT_ERROR, BLOOM_DEFAULT_CAPACITY, BLOOM_DEFAULT_EXPANSION);
+		htable_insert(ht, BLOOM_T, key, bf);
+	}
+	bloom_add(bf, items, n, res);
+}
+
+void htable_bfexists(HashTable *ht, char *key, char **items, int n, int *res) {
+	Bloom *bf = htable_bloom(ht, key);
+	if (bf == NULL)
+		memset(res, 0, n * sizeof(int));
+	else
+		bloom_exists(bf, items, n, res);
+}
+
+long long htable_bfcard(HashTable *ht, char *key) {
+	Bloom *bf = htable_bloom(ht, key);
+	return bf != NULL ? bf->count : 0;
+}
+
+static TimeSeries *htable_timeseries(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (TimeSeries *)tmp->value : NULL;
+}
+
+// returns false if the key already exists
+bool htable_tscreate(HashTable *ht, char *key, long long retention) {
+	if (htable_exists(ht, key))
+		return false;
+	htable_insert(ht, TS_T, key, ts_init(retention));
+	return true;
+}
+
+// appends a sample, creating the series without retention. Returns false if
+// the timestamp is not newer than the last sample.
+bool htable_tsadd(HashTable *ht, char *key, long long *t, double value) {
+	TimeSeries *s = htable_timeseries(ht, key);
+	if (s == NULL) {
+		s = ts_init(0);
+		htable_insert(ht, TS_T, key, s);
+	}
+	return ts_add(s, t, value);
+}
+
+TSSample *htable_tsrange(HashTable *ht, char *key, long long from, long long to, long long count,
+						 int agg, long long bucket, int *n) {
+	TimeSeries *s = htable_timeseries(ht, key);
+	if (s == NULL) {
+		*n = 0;
+		return NULL;
+	}
+	return ts_range(s, from, to, count, agg, bucket, n);
+}
+
+bool htable_tsget(HashTable *ht, char *key, TSSample *last) {
+	TimeSeries *s = htable_timeseries(ht, key);
+	if (s == NULL || s->n == 0)
+		return false;
+	TSChunk *c = &s->chunks[s->n - 1];
+	last->ts = c->last_ts;
+	memcpy(&last->value, &c->last_value, sizeof(double));
+	return true;
+}
+
+static char *lltostr(long long x) {
+	char buf[32];
+	sprintf(buf, "%lld", x);
+	return strdup(buf);
+}
+
+char **htable_tsinfo(HashTable *ht, char *key) {
+	TimeSeries *s = htable_timeseries(ht, key);
+	if (s == NULL)
+		return NULL;
+	char **res = dmalloc(13 * sizeof(char *));
+	res[0] = strdup("totalSamples");
+	res[1] = lltostr(s->count);
+	res[2] = strdup("memoryUsage");
+	res[3] = lltostr(ts_bytes(s));
+	res[4] = strdup("firstTimestamp");
+	res[5] = lltostr(s->n > 0 ? s->chunks[0].first_ts : 0);
+	res[6] = strdup("lastTimestamp");
+	res[7] = lltostr(s->n > 0 ? s->chunks[s->n - 1].last_ts : 0);
+	res[8] = strdup("retentionTime");
+	res[9] = lltostr(s->retention);
+	res[10] = strdup("chunkCount");
+	res[11] = lltostr(s->n);
+	res[12] = NULL;
+	return res;
+}
+
+// the slot holding the document, so that writes at the root can replace it
+static JsonNode **htable_json(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (JsonNode **)&tmp->value : NULL;
+}
+
+int htable_jsonset(HashTable *ht, char *key, char *path, char *value, int cond) {
+	JsonNode *node = json_parse(value);
+	if (node == NULL)
+		return JSON_ERR_SYNTAX;
+	JsonNode **root = htable_json(ht, key);
+	JsonNode *doc = root != NULL ? *root : NULL;
+	int status = json_set(&doc, path, node, cond);
+	if (status != JSON_OK)
+		json_free(node);
+	else if (root != NULL)
+		*root = doc;
+	else
+		htable_insert(ht, JSON_T, key, doc);
+	return status;
+}
+
+// *res is NULL if the key does not exist
+int htable_jsonget(HashTable *ht, char *key, char **paths, int n, char **res) {
+	JsonNode **root = htable_json(ht, key);
+	*res = NULL;
+	return root != NULL ? json_project(*root, paths, n, res) : JSON_OK;
+}
+
+// deleting the root deletes the key
+int htable_jsondel(HashTable *ht, char *key, char *path, long long *removed) {
+	JsonNode **root = htable_json(ht, key);
+	*removed = 0;
+	if (root == NULL)
+		return JSON_OK;
+	int status = json_del(root, path, removed);
+	if (*root == NULL)
+		htable_del(ht, key);
+	return status;
+}
+
+// *res is NULL if the key or the path does not exist
+int htable_jsontype(HashTable *ht, char *key, char *path, char **res) {
+	JsonNode **root = htable_json(ht, key), *node;
+	*res = NULL;
+	if (root == NULL)
+		return JSON_OK;
+	int status = json_get(*root, path, &node);
+	if (status == JSON_OK)
+		*res = json_type(node);
+	return status == JSON_ERR_MISSING ? JSON_OK : status;
+}
+
+int htable_jsonnumincrby(HashTable *ht, char *key, char *path, double by, char **res) {
+	JsonNode **root = htable_json(ht, key), *node;
+	if (root == NULL)
+		return JSON_ERR_MISSING;
+	int status = json_numincrby(*root, path, by, &node);
+	if (status == JSON_OK)
+		*res = json_dump(node);
+	return status;
+}
+
+// appends the JSON values to the string or array at path, *len is its new length
+int htable_jsonappend(HashTable *ht, char *key, char *path, int type, char **values, int n,
+					  long long *len) {
+	JsonNode **root = htable_json(ht, key);
+	if (root == NULL)
+		return JSON_ERR_MISSING;
+	JsonNode **nodes = dmalloc(n * sizeof(JsonNode *));
+	int status = JSON_OK;
+	for (int i = 0; i < n; i++) {
+		nodes[i] = json_parse(values[i]);
+		if (nodes[i] == NULL) {
+			n = i;
+			status = JSON_ERR_SYNTAX;
+			break;
+		}
+	}
+	if (status == JSON_OK)
+		status = json_append(*root, path, type, nodes, n, len);
+	if (status != JSON_OK)
+		for (int i = 0; i < n; i++)
+			json_free(nodes[i]);
+	free(nodes);
+	return status;
+}
+
+// *len is -1 if the key does not exist
+int htable_jsonarrlen(HashTable *ht, char *key, char *path, long long *len) {
+	JsonNode **root = htable_json(ht, key), *node;
+	*len = -1;
+	if (root == NULL)
+		return JSON_OK;
+	int status = json_get(*root, path, &node);
+	if (status == JSON_OK && node->type != JSON_ARRAY)
+		return JSON_ERR_TYPE;
+	if (status == JSON_OK)
+		*len = node->n;
+	return status;
+}
+
+static VectorSet *htable_vset(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (VectorSet *)tmp->value : NULL;
+}
+
+// adds or replaces the vector of name, creating the set with the given layout
+// and graph parameters. Returns 1 if name is new, 0 if it was replaced and -1
+// if dim does not match the set.
+int htable_vadd(HashTable *ht, char *key, char *name, float *values, int dim, int metric, int quant,
+				int m, int ef) {
+	VectorSet *vs = htable_vset(ht, key);
+	if (vs == NULL) {
+		vs = vset_init(dim, metric, quant, m, ef);
+		htable_insert(ht, VSET_T, key, vs);
+	}
+	if (vs->dim != dim)
+		return -1;
+	return vset_add(vs, name, values);
+}
+
+// removing the last element deletes the key
+bool htable_vrem(HashTable *ht, char *key, char *name) {
+	VectorSet *vs = htable_vset(ht, key);
+	if (vs == NULL || !vset_rem(vs, name))
+		return false;
+	if (vs->count == 0)
+		htable_del(ht, key);
+	return true;
+}
+
+// *n is 0 if the key does not exist and -1 if ele is not in the set
+VecMatch *htable_vsim(HashTable *ht, char *key, float *query, char *ele, int k, int ef, bool exact,
+					  int *n) {
+	VectorSet *vs = htable_vset(ht, key);
+	if (vs == NULL) {
+		*n = 0;
+		return NULL;
+	}
+	return vset_search(vs, query, ele, k, ef, exact, n);
+}
+
+long long htable_vcard(HashTable *ht, char *key) {
+	VectorSet *vs = htable_vset(ht, key);
+	return vs != NULL ? vs->count : 0;
+}
+
+// 0 if the key does not exist
+int htable_vdim(HashTable *ht, char *key) {
+	VectorSet *vs = htable_vset(ht, key);
+	return vs != NULL ? vs->dim : 0;
+}
+
+// the vector of name, NULL if the key or the element does not exist
+float *htable_vemb(HashTable *ht, char *key, char *name) {
+	VectorSet *vs = htable_vset(ht, key);
+	if (vs == NULL)
+		return NULL;
+	float *res = dmalloc(vs->dim * sizeof(float));
+	if (!vset_emb(vs, name, res)) {
+		free(res);
+		return NULL;
+	}
+	return res;
+}
+
+char **htable_vinfo(HashTable *ht, char *key) {
+	VectorSet *vs = htable_vset(ht, key);
+	if (vs == NULL)
+		return NULL;
+	char *metrics[] = {"l2", "cosine", "ip"};
+	char **res = dmalloc(17 * sizeof(char *));
+	res[0] = strdup("quant-type");
+	res[1] = strdup(vs->quant == VEC_Q8 ? "int8" : "f32");
+	res[2] = strdup("metric");
+	res[3] = strdup(metrics[vs->metric]);
+	res[4] = strdup("vector-dim");
+	res[5] = lltostr(vs->dim);
+	res[6] = strdup("size");
+	res[7] = lltostr(vs->count);
+	res[8] = strdup("max-level");
+	res[9] = lltostr(vs->max_level);
+	res[10] = strdup("hnsw-m");
+	res[11] = lltostr(vs->m);
+	res[12] = strdup("ef-construction");
+	res[13] = lltostr(vs->ef_construction);
+	res[14] = strdup("memory-usage");
+	res[15] = lltostr(vset_bytes(vs));
+	res[16] = NULL;
+	return res;
+}
+
+static CountMin *htable_cms(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (CountMin *)tmp->value : NULL;
+}
+
+// returns false if the key already exists
+bool htable_cmsinit(HashTable *ht, char *key, int width, int depth) {
+	if (htable_exists(ht, key))
+		return false;
+	htable_insert(ht, CMS_T, key, cms_init(width, depth));
+	return true;
+}
+
+// counts items up in the sketch at key, creating it with the default
+// dimensions
+void htable_cmsincrby(HashTable *ht, char *key, char **items, long long *incrs, int n,
+					  long long *res) {
+	CountMin *cms = htable_cms(ht, key);
+	if (cms == NULL) {
+		cms = cms_init(CMS_DEFAULT_WIDTH, CMS_DEFAULT_DEPTH);
+		htable_insert(ht, CMS_T, key, cms);
+	}
+	cms_incrby(cms, items, incrs, n, res);
+}
+
+void htable_cmsquery(HashTable *ht, char *key, char **items, int n, long long *res) {
+	CountMin *cms = htable_cms(ht, key);
+	if (cms == NULL)
+		memset(res, 0, n * sizeof(long long));
+	else
+		cms_query(cms, items, n, res);
+}
+
+// returns 1 once dst holds the weighted sum of the sketches at keys, 0 if one
+// of them is missing and -1 if their dimensions differ
+int htable_cmsmerge(HashTable *ht, char *dst, char **keys, long long *weights, int n) {
+	CountMin **srcs = dmalloc(n * sizeof(CountMin *));
+	int res = 1;
+	for (int i = 0; i < n && res == 1; i++) {
+		srcs[i] = htable_cms(ht, keys[i]);
+		if (srcs[i] == NULL)
+			res = 0;
+		else if (srcs[i]->width != srcs[0]->width || srcs[i]->depth != srcs[0]->depth)
+			res = -1;
+	}
+	CountMin *cms = htable_cms(ht, dst);
+	if (res == 1 && cms != NULL && (cms->width != srcs[0]->width || cms->depth != srcs[0]->depth))
+		res = -1;
+	if (res == 1) {
+		if (cms == NULL) {
+			cms = cms_init(srcs[0]->width, srcs[0]->depth);
+			htable_insert(ht, CMS_T, dst, cms);
+		}
+		cms_merge(cms, srcs, weights, n);
+	}
+	free(srcs);
+	return res;
+}
+
+char **htable_cmsinfo(HashTable *ht, char *key) {
+	CountMin *cms = htable_cms(ht, key);
+	if (cms == NULL)
+		return NULL;
+	char **res = dmalloc(7 * sizeof(char *));
+	res[0] = strdup("width");
+	res[1] = lltostr(cms->width);
+	res[2] = strdup("depth");
+	res[3] = lltostr(cms->depth);
+	res[4] = strdup("count");
+	res[5] = lltostr(cms->count);
+	res[6] = NULL;
+	return res;
+}
+
+static TopK *htable_topk(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (TopK *)tmp->value : NULL;
+}
+
+// returns false if the key already exists
+bool htable_topkreserve(HashTable *ht, char *key, int k, int width, int depth, double decay) {
+	if (htable_exists(ht, key))
+		return false;
+	htable_insert(ht, TOPK_T, key, topk_init(k, width, depth, decay));
+	return true;
+}
+
+// counts items up by incrs, or by one each when incrs is NULL, creating the
+// sketch with the default k. res[i] is the item items[i] pushed out of the
+// top k, NULL if none
+char **htable_topkadd(HashTable *ht, char *key, char **items, long long *incrs, int n) {
+	TopK *tk = htable_topk(ht, key);
+	if (tk == NULL) {
+		tk = topk_init(TOPK_DEFAULT_K, TOPK_DEFAULT_K * TOPK_WIDTH_PER_K, TOPK_DEFAULT_DEPTH,
+					   TOPK_DEFAULT_DECAY);
+		htable_insert(ht, TOPK_T, key, tk);
+	}
+	char **res = dmalloc(n * sizeof(char *));
+	for (int i = 0; i < n; i++)
+		res[i] = topk_add(tk, items[i], incrs != NULL ? incrs[i] : 1);
+	return res;
+}
+
+void htable_topkquery(HashTable *ht, char *key, char **items, int n, int *res) {
+	TopK *tk = htable_topk(ht, key);
+	for (int i = 0; i < n; i++)
+		res[i] = tk != NULL && topk_query(tk, items[i]);
+}
+
+TopKItem *htable_topklist(HashTable *ht, char *key, int *n) {
+	TopK *tk = htable_topk(ht, key);
+	if (tk == NULL) {
+		*n = 0;
+		return NULL;
+	}
+	return topk_list(tk, n);
+}
+
+char **htable_topkinfo(HashTable *ht, char *key) {
+	TopK *tk = htable_topk(ht, key);
+	if (tk == NULL)
+		return NULL;
+	char decay[32];
+	snprintf(decay, sizeof(decay), "%g", tk->decay);
+	char **res = dmalloc(9 * sizeof(char *));
+	res[0] = strdup("k");
+	res[1] = lltostr(tk->k);
+	res[2] = strdup("width");
+	res[3] = lltostr(tk->width);
+	res[4] = strdup("depth");
+	res[5] = lltostr(tk->depth);
+	res[6] = strdup("decay");
+	res[7] = strdup(decay);
+	res[8] = NULL;
+	return res;
+}
+
+// adds the points at coords, longitude then latitude, under members. Returns
+// the number of members added, or also of those moved when ch is set
+int htable_geoadd(HashTable *ht, char *key, double *coords, char **members, int n, int cond,
+				  bool ch) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL) {
+		if (cond == GEO_ADD_XX)
+			return 0;
+		zs = zset_init();
+		htable_insert(ht, ZSET_T, key, zs);
+	}
+	int res = 0;
+	for (int i = 0; i < n; i++) {
+		double score, old;
+		bool exists = zset_score(zs, members[i], &old);
+		if ((exists && cond == GEO_ADD_NX) || (!exists && cond == GEO_ADD_XX))
+			continue;
+		score = geo_encode(coords[2 * i], coords[2 * i + 1]);
+		zset_add(zs, members[i], score);
+		res += !exists || (ch && old != score);
+	}
+	return res;
+}
+
+bool htable_geopos(HashTable *ht, char *key, char *member, double *lon, double *lat) {
+	ZSet *zs = htable_zset(ht, key);
+	double score;
+	if (zs == NULL || !zset_score(zs, member, &score))
+		return false;
+	geo_decode(score, lon, lat);
+	return true;
+}
+
+GeoMatch *htable_geosearch(HashTable *ht, char *key, GeoShape *shape, int sort, int count, bool any,
+						   int *n) {
+	ZSet *zs = htable_zset(ht, key);
+	if (zs == NULL) {
+		*n = 0;
+		return NULL;
+	}
+	return geo_search(zs, shape, sort, count, any, n);
+}
+
+static RateLimit *htable_ratelimit(HashTable *ht, char *key) {
+	HashTableItem *tmp = htable_search(ht, key);
+	return tmp != NULL ? (RateLimit *)tmp->value : NULL;
+}
+
+// runs a request against the limit at key, which is only created once a
+// request is allowed
+void htable_throttle(HashTable *ht, char *key, long long burst, long long count, long long period,
+					 long long quantity, RateLimitResult *res) {
+	RateLimit *rl = htable_ratelimit(ht, key), fresh = {0};
+	gcra_throttle(rl != NULL ? rl : &fresh, gcra_now(), burst, count, period, quantity, res);
+	if (rl == NULL && !res->limited) {
+		rl = dmalloc(sizeof(RateLimit));
+		*rl = fresh;
+		htable_insert(ht, RATELIMIT_T, key, rl);
+	}
+}
@@ -0,0 +1,70 @@
+#include "common.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Verifies a snapshot or append only log offline, checking every checksum the
+// server would check when loading it. Snapshots are loaded into a scratch
+// table, logs are scanned without replaying them.
+
+static void print_usage() {
+	printf("Usage: hyperkv-check <file>\n");
+	printf("Verifies the checksums of a snapshot or an append only log.\n");
+}
+
+int main(int argc, char **argv) {
+	if (argc != 2 || strcmp(argv[1], "--help") == 0) {
+		print_usage();
+		return argc == 2 ? 0 : 1;
+	}
+	log_set_level(LOG_WARN);
+	char *path = argv[1];
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		printf("%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	printf("crc32c: %s\n", crc32c_selftest() ? "ok" : "implementations disagree");
+	long long end = 0, keys = 0, batches = 0;
+	char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+	if (read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+		memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+		HashTable *ht = htable_init(HT_BASE_SIZE);
+		lseek(fd, 0, SEEK_SET);
+		keys = snapshot_read(ht, fd, path, &end);
+		htable_free(ht);
+		if (keys < 0) {
+			printf("%s: damaged snapshot\n", path);
+			close(fd);
+			return 1;
+		}
+		printf("snapshot: %lld keys in %lld bytes\n", keys, end);
+	}
+	if (end == st.st_size) {
+		close(fd);
+		printf("%s: ok\n", path);
+		return 0;
+	}
+	lseek(fd, end, SEEK_SET);
+	long long start = end, n = aof_scan(NULL, fd, path, &end, &batches);
+	close(fd);
+	if (n < 0) {
+		printf("%s: checksum mismatch after offset %lld\n", path, end);
+		return 1;
+	}
+	printf("log: %lld commands in %lld batches, %lld bytes\n", n, batches, end - start);
+	if (batches == 0 && n > 0)
+		printf("%s: written without checksums, nothing to verify\n", path);
+	if (end < st.st_size) {
+		printf("%s: %lld bytes at the end are not covered by a checksum\n", path,
+			   (long long)st.st_size - end);
+		return 1;
+	}
+	printf("%s: ok\n", path);
+	return 0;
+}
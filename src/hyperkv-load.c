@@ -0,0 +1,664 @@
+#include "common.h"
+#include "log.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Builds a snapshot offline from CSV files of key,value lines or from files of
+// RESP commands, as redis-cli --pipe takes them, and exports one back to
+// either. Threads first split the mapped inputs into records, then route each
+// record to the shard its key hashes to, so that the commands of a key keep
+// their order, and finally run the commands of each shard on a table presized
+// for them. The shards go into the snapshot as one keyspace, ready to load.
+
+// the arguments a command of an export carries before it is split
+#define LOAD_BATCH 128
+
+enum { FORMAT_CSV, FORMAT_RESP };
+
+typedef struct Input {
+	char *path;
+	char *data;
+	long long size;
+	// where each record starts, and one past the last
+	long long *records;
+	long long n, cap;
+	// the offset of a record that could not be split off, -1 if none
+	long long bad;
+} Input;
+
+// a record of an input, as routed to a shard
+typedef struct Record {
+	int input;
+	long long start, end;
+} Record;
+
+typedef struct Load {
+	int format, nthreads;
+	Input *inputs;
+	int ninputs;
+	Record *records;
+	long long nrecords;
+	struct Worker *workers;
+	HashTable **tables;
+} Load;
+
+typedef struct Worker {
+	Load *load;
+	int id;
+	// the records routed to each shard, in input order
+	long long **routed;
+	long long *nrouted, *caprouted;
+	// the first record that failed and why
+	long long failed;
+	char *error;
+	long long routed_records;
+} Worker;
+
+static long long now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void print_usage() {
+	printf("Usage: hyperkv-load [-j threads] import <csv|resp> <snapshot> <input>...\n");
+	printf("       hyperkv-load export <csv|resp> <snapshot> <output>\n");
+	printf("Builds a snapshot from CSV key,value lines or RESP commands, or writes one out\n");
+	printf("as either. CSV holds string keys only.\n");
+}
+
+// reads the number following the type byte at *p up to its CRLF, -1 if there
+// is none
+static long long resp_number(const char **p, const char *end) {
+	const char *s = *p + 1;
+	long long x = 0;
+	int digits = 0;
+	for (; s < end && isdigit((unsigned char)*s) && digits < 18; s++, digits++)
+		x = x * 10 + (*s - '0');
+	if (digits == 0 || end - s < 2 || s[0] != '\r' || s[1] != '\n')
+		return -1;
+	*p = s + 2;
+	return x;
+}
+
+// the length of the RESP array at p, 0 if it is malformed or cut off
+static long long resp_frame(const char *p, const char *end) {
+	const char *s = p;
+	long long n = s < end && *s == '*' ? resp_number(&s, end) : -1;
+	if (n <= 0)
+		return 0;
+	for (long long i = 0; i < n; i++) {
+		long long len = s < end && *s == '$' ? resp_number(&s, end) : -1;
+		if (len < 0 || end - s < len + 2 || s[len] != '\r' || s[len + 1] != '\n')
+			return 0;
+		s += len + 2;
+	}
+	return s - p;
+}
+
+// the length of the CSV line at p with its newline, which quoted fields may
+// hold, 0 if a quote is left open
+static long long csv_frame(const char *p, const char *end) {
+	bool quoted = false;
+	for (const char *s = p; s < end; s++) {
+		if (*s == '"')
+			quoted = !quoted;
+		else if (*s == '\n' && !quoted)
+			return s + 1 - p;
+	}
+	return quoted ? 0 : end - p;
+}
+
+// splits the input into records, skipping empty CSV lines
+static void frame(Input *in, int format) {
+	const char *p = in->data, *end = in->data + in->size;
+	while (p < end && in->bad < 0) {
+		long long len = format == FORMAT_CSV ? csv_frame(p, end) : resp_frame(p, end);
+		if (len == 0) {
+			in->bad = p - in->data;
+			break;
+		}
+		long long blank = 0;
+		while (format == FORMAT_CSV && blank < len && (p[blank] == '\r' || p[blank] == '\n'))
+			blank++;
+		if (blank < len) {
+			if (in->n + 1 >= in->cap) {
+				in->cap = in->cap > 0 ? in->cap * 2 : 1024;
+				in->records = drealloc(in->records, in->cap * sizeof(long long));
+			}
+			in->records[in->n++] = p - in->data;
+		}
+		p += len;
+		// the end of the last record
+		in->records[in->n] = p - in->data;
+	}
+}
+
+// the unquoted fields of the CSV line from p to end
+static int csv_fields(const char *p, const char *end, char ***fields) {
+	while (end > p && (end[-1] == '\n' || end[-1] == '\r'))
+		end--;
+	int n = 0, cap = 2;
+	*fields = dmalloc(cap * sizeof(char *));
+	const char *s = p;
+	do {
+		char *field = dmalloc(end - s + 1);
+		int len = 0;
+		if (s < end && *s == '"') {
+			for (s++; s < end; s++) {
+				if (*s == '"' && (s + 1 == end || s[1] != '"')) {
+					s++;
+					break;
+				}
+				field[len++] = *s;
+				s += *s == '"';
+			}
+		}
+		for (; s < end && *s != ','; s++)
+			field[len++] = *s;
+		field[len] = '\0';
+		if (n == cap) {
+			cap *= 2;
+			*fields = drealloc(*fields, cap * sizeof(char *));
+		}
+		(*fields)[n++] = field;
+	} while (s++ < end);
+	return n;
+}
+
+// the elements of the RESP array from p, framed already
+static int resp_fields(const char *p, const char *end, char ***fields) {
+	int n = resp_number(&p, end);
+	*fields = dmalloc(n * sizeof(char *));
+	for (int i = 0; i < n; i++) {
+		long long len = resp_number(&p, end);
+		(*fields)[i] = strndup(p, len);
+		p += len + 2;
+	}
+	return n;
+}
+
+static int record_fields(Load *l, Record *r, char ***fields) {
+	char *data = l->inputs[r->input].data;
+	if (l->format == FORMAT_CSV)
+		return csv_fields(data + r->start, data + r->end, fields);
+	return resp_fields(data + r->start, data + r->end, fields);
+}
+
+static void free_fields(char **fields, int n) {
+	for (int i = 0; i < n; i++)
+		free(fields[i]);
+	free(fields);
+}
+
+// the type of the command of a RESP record, UNKNOWN for one that names no
+// key or several keys that may hash to different shards
+static int record_type(char *name) {
+	char lower[32];
+	int i = 0;
+	for (; name[i] != '\0' && i < (int)sizeof(lower) - 1; i++)
+		lower[i] = tolower((unsigned char)name[i]);
+	lower[i] = '\0';
+	int type = name[i] == '\0' ? command_type(lower) : UNKNOWN;
+	switch (type) {
+	case EXISTS:
+	case MGET:
+	case SINTER:
+	case SINTERSTORE:
+	case SINTERCARD:
+	case SUNION:
+	case SUNIONSTORE:
+	case SDIFF:
+	case SDIFFSTORE:
+	case LMOVE:
+	case BLPOP:
+	case BRPOP:
+	case BLMOVE:
+	case PFCOUNT:
+	case PFMERGE:
+	case BITOP:
+	case RBOP:
+	case XREAD:
+	case XREADGROUP:
+	case CMSMERGE:
+	case SAVE:
+	case BGSAVE:
+	case LASTSAVE:
+	case INFO:
+	case BGREWRITEAOF:
+	case QUIT:
+	case SHUTDOWN:
+	case NOOP:
+		return UNKNOWN;
+	default:
+		return type;
+	}
+}
+
+// whether the argument at i of a command of type is a key, DEL and MSET being
+// the commands taken with several keys
+static bool is_key(int type, int i) {
+	if (type == DEL)
+		return i >= 1;
+	if (type == MSET)
+		return i % 2 == 1;
+	return i == 1;
+}
+
+static int shard(char *key, int n) { return murmur64a(key, strlen(key), 0) % n; }
+
+static void fail(Worker *w, long long record, char *error) {
+	if (w->error == NULL) {
+		w->failed = record;
+		w->error = strdup(error);
+	}
+}
+
+static void route_to(Worker *w, int s, long long record) {
+	if (w->nrouted[s] > 0 && w->routed[s][w->nrouted[s] - 1] == record)
+		return;
+	if (w->nrouted[s] == w->caprouted[s]) {
+		w->caprouted[s] = w->caprouted[s] > 0 ? w->caprouted[s] * 2 : 1024;
+		w->routed[s] = drealloc(w->routed[s], w->caprouted[s] * sizeof(long long));
+	}
+	w->routed[s][w->nrouted[s]++] = record;
+}
+
+// routes a slice of the records to the shards of their keys
+static void *route(void *arg) {
+	Worker *w = arg;
+	Load *l = w->load;
+	int n = l->nthreads;
+	long long first = l->nrecords * w->id / n, last = l->nrecords * (w->id + 1) / n;
+	for (long long i = first; i < last && w->error == NULL; i++) {
+		char **fields;
+		int nfields = record_fields(l, &l->records[i], &fields);
+		if (l->format == FORMAT_CSV) {
+			if (nfields == 2)
+				route_to(w, shard(fields[0], n), i);
+			else
+				fail(w, i, "expected a key and a value");
+		} else {
+			int type = record_type(fields[0]);
+			if (type == UNKNOWN)
+				fail(w, i, "not a command on one key");
+			for (int j = 1; j < nfields && type != UNKNOWN; j++)
+				if (is_key(type, j))
+					route_to(w, shard(fields[j], n), i);
+			// left to fail with the arity error
+			if (nfields == 1 && type != UNKNOWN)
+				route_to(w, 0, i);
+		}
+		free_fields(fields, nfields);
+		w->routed_records++;
+	}
+	return NULL;
+}
+
+// runs the RESP command of fields on the shard s, keeping only its keys and
+// their values if it names several
+static void run(Worker *w, long long record, char **fields, int n, int s) {
+	Load *l = w->load;
+	int type = record_type(fields[0]);
+	char **argv = dmalloc(n * sizeof(char *));
+	int argc = 0;
+	for (int i = 1; i < n; i++) {
+		if (type == MSET && i % 2 == 0)
+			continue;
+		bool multi = type == DEL || (type == MSET && i + 1 < n);
+		if (multi && shard(fields[i], l->nthreads) != s)
+			continue;
+		argv[argc++] = strdup(fields[i]);
+		if (type == MSET && i + 1 < n)
+			argv[argc++] = strdup(fields[i + 1]);
+	}
+	char *res = interpret(l->tables[s], command_init(type, argc, argv));
+	if (res[0] == '-') {
+		res[strcspn(res, "\r\n")] = '\0';
+		fail(w, record, res + 1);
+	}
+	free(res);
+}
+
+// builds the shard of the worker from the records every worker routed to it
+static void *build(void *arg) {
+	Worker *w = arg;
+	Load *l = w->load;
+	int s = w->id;
+	long long n = 0;
+	for (int t = 0; t < l->nthreads; t++)
+		n += l->workers[t].nrouted[s];
+	HashTable *ht = htable_init(n * 2 > HT_BASE_SIZE ? n * 2 : HT_BASE_SIZE);
+	ht->clock = time(NULL);
+	l->tables[s] = ht;
+	for (int t = 0; t < l->nthreads && w->error == NULL; t++) {
+		Worker *from = &l->workers[t];
+		for (long long i = 0; i < from->nrouted[s] && w->error == NULL; i++) {
+			long long record = from->routed[s][i];
+			char **fields;
+			int nfields = record_fields(l, &l->records[record], &fields);
+			if (l->format == FORMAT_RESP)
+				run(w, record, fields, nfields, s);
+			else if (!htable_set(ht, fields[0], fields[1]))
+				fail(w, record, "key holds a value that is not a string");
+			free_fields(fields, nfields);
+		}
+	}
+	return NULL;
+}
+
+static void *frame_inputs(void *arg) {
+	Worker *w = arg;
+	Load *l = w->load;
+	for (int i = w->id; i < l->ninputs; i += l->nthreads)
+		frame(&l->inputs[i], l->format);
+	return NULL;
+}
+
+static void run_workers(Load *l, void *(*fn)(void *)) {
+	pthread_t *threads = dmalloc(l->nthreads * sizeof(pthread_t));
+	for (int t = 0; t < l->nthreads; t++)
+		pthread_create(&threads[t], NULL, fn, &l->workers[t]);
+	for (int t = 0; t < l->nthreads; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+}
+
+static bool open_input(Input *in, char *path) {
+	*in = (Input){.path = path, .bad = -1};
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		printf("%s: %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+	in->size = st.st_size;
+	in->data = in->size > 0 ? mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+	if (in->data == MAP_FAILED) {
+		printf("%s: %s\n", path, strerror(errno));
+		return false;
+	}
+	madvise(in->data, in->size, MADV_SEQUENTIAL);
+	in->records = dmalloc(sizeof(long long));
+	in->records[0] = 0;
+	return true;
+}
+
+// the first failure of any worker, by the order of the records
+static Worker *first_failure(Load *l) {
+	Worker *first = NULL;
+	for (int t = 0; t < l->nthreads; t++)
+		if (l->workers[t].error != NULL && (first == NULL || l->workers[t].failed < first->failed))
+			first = &l->workers[t];
+	return first;
+}
+
+static int import(int format, int nthreads, char *path, char **inputs, int ninputs) {
+	long long start = now_us();
+	Load l = {.format = format, .nthreads = nthreads, .ninputs = ninputs};
+	l.inputs = dmalloc(ninputs * sizeof(Input));
+	l.workers = calloc(nthreads, sizeof(Worker));
+	l.tables = calloc(nthreads, sizeof(HashTable *));
+	int res = 0, opened = 0;
+	for (; opened < ninputs && res == 0; opened++)
+		res = open_input(&l.inputs[opened], inputs[opened]) ? 0 : 1;
+	for (int t = 0; t < nthreads; t++) {
+		l.workers[t] = (Worker){.load = &l, .id = t, .failed = -1};
+		l.workers[t].routed = calloc(nthreads, sizeof(long long *));
+		l.workers[t].nrouted = calloc(nthreads, sizeof(long long));
+		l.workers[t].caprouted = calloc(nthreads, sizeof(long long));
+	}
+	if (res == 0)
+		run_workers(&l, frame_inputs);
+	for (int i = 0; i < ninputs && res == 0; i++) {
+		Input *in = &l.inputs[i];
+		if (in->bad >= 0) {
+			printf("%s: malformed record at offset %lld\n", in->path, in->bad);
+			res = 1;
+		}
+		l.records = drealloc(l.records, (l.nrecords + in->n + 1) * sizeof(Record));
+		for (long long j = 0; j < in->n; j++)
+			l.records[l.nrecords++] =
+				(Record){.input = i, .start = in->records[j], .end = in->records[j + 1]};
+	}
+	if (res == 0)
+		run_workers(&l, route);
+	if (res == 0 && first_failure(&l) == NULL)
+		run_workers(&l, build);
+	Worker *failed = res == 0 ? first_failure(&l) : NULL;
+	if (failed != NULL) {
+		Record *r = &l.records[failed->failed];
+		printf("%s: record at offset %lld: %s\n", l.inputs[r->input].path, r->start,
+			   failed->error);
+		res = 1;
+	}
+	long long records = 0, keys = 0;
+	for (int t = 0; t < nthreads && res == 0; t++) {
+		records += l.workers[t].routed_records;
+		keys += l.tables[t]->used;
+	}
+	if (res == 0 && !snapshot_save_tables(l.tables, nthreads, path)) {
+		printf("%s: %s\n", path, strerror(errno));
+		res = 1;
+	}
+	if (res == 0)
+		printf("%s: %lld records, %lld keys in %lld ms\n", path, records, keys,
+			   (now_us() - start) / 1000);
+	for (int t = 0; t < nthreads; t++) {
+		Worker *w = &l.workers[t];
+		for (int s = 0; s < nthreads; s++)
+			free(w->routed[s]);
+		free(w->routed);
+		free(w->nrouted);
+		free(w->caprouted);
+		free(w->error);
+		if (l.tables[t] != NULL)
+			htable_free(l.tables[t]);
+	}
+	for (int i = 0; i < opened; i++) {
+		if (l.inputs[i].data != NULL && l.inputs[i].data != MAP_FAILED)
+			munmap(l.inputs[i].data, l.inputs[i].size);
+		free(l.inputs[i].records);
+	}
+	free(l.inputs);
+	free(l.records);
+	free(l.workers);
+	free(l.tables);
+	return res;
+}
+
+// a RESP command of an export, split into several of at most LOAD_BATCH
+// arguments after the key
+typedef struct Emit {
+	FILE *f;
+	char *name, *key;
+	int n, step;
+	char *body;
+	size_t len, cap;
+} Emit;
+
+static void emit_flush(Emit *e) {
+	if (e->n == 0)
+		return;
+	fprintf(e->f, "*%d\r\n$%zu\r\n%s\r\n$%zu\r\n%s\r\n", e->n + 2, strlen(e->name), e->name,
+			strlen(e->key), e->key);
+	fwrite(e->body, 1, e->len, e->f);
+	e->n = 0;
+	e->len = 0;
+}
+
+static void emit_arg(Emit *e, const char *s, size_t len) {
+	if (e->len + len + 32 > e->cap) {
+		e->cap = (e->len + len + 32) * 2;
+		e->body = drealloc(e->body, e->cap);
+	}
+	e->len += sprintf(e->body + e->len, "$%zu\r\n", len);
+	memcpy(e->body + e->len, s, len);
+	memcpy(e->body + e->len + len, "\r\n", 2);
+	e->len += len + 2;
+	// the arguments that go together, as a field and its value, are not split
+	if (++e->n >= LOAD_BATCH && e->n % e->step == 0)
+		emit_flush(e);
+}
+
+static void emit_start(Emit *e, char *name, char *key, int step) {
+	e->name = name;
+	e->key = key;
+	e->step = step;
+}
+
+static bool emit_zset_member(char *member, double score, void *arg) {
+	char *s = dtostr(score);
+	emit_arg(arg, s, strlen(s));
+	emit_arg(arg, member, strlen(member));
+	free(s);
+	return true;
+}
+
+static void emit_members(Emit *e, char **members) {
+	for (int i = 0; members[i] != NULL; i++) {
+		emit_arg(e, members[i], strlen(members[i]));
+		free(members[i]);
+	}
+	free(members);
+}
+
+// writes the commands that rebuild item, false for a type left out
+static bool emit_item(Emit *e, HashTableItem *item) {
+	switch (item->type) {
+	case STR_T:
+		emit_start(e, "SET", item->key, 1);
+		emit_arg(e, item->value, str_len(item->value));
+		break;
+	case HASH_T: {
+		emit_start(e, "HSET", item->key, 2);
+		int pos = 0;
+		HashTableItem *field;
+		while ((field = htable_next(item->value, &pos)) != NULL) {
+			emit_arg(e, field->key, strlen(field->key));
+			emit_arg(e, field->value, str_len(field->value));
+		}
+		break;
+	}
+	case LIST_T: {
+		List *ls = item->value;
+		emit_start(e, "RPUSH", item->key, 1);
+		emit_members(e, list_range(ls, 0, ls->len - 1));
+		break;
+	}
+	case SET_T:
+		emit_start(e, "SADD", item->key, 1);
+		emit_members(e, set_members(item->value));
+		break;
+	case ZSET_T:
+		emit_start(e, "ZADD", item->key, 2);
+		zset_scan(item->value, -INFINITY, INFINITY, emit_zset_member, e);
+		break;
+	default:
+		return false;
+	}
+	emit_flush(e);
+	return true;
+}
+
+// writes s as a CSV field, quoted if it holds a separator, a quote or a newline
+static void csv_field(FILE *f, char *s, size_t len) {
+	if (strcspn(s, ",\"\r\n") == len) {
+		fwrite(s, 1, len, f);
+		return;
+	}
+	fputc('"', f);
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == '"')
+			fputc('"', f);
+		fputc(s[i], f);
+	}
+	fputc('"', f);
+}
+
+static int export(int format, char *path, char *output) {
+	long long start = now_us();
+	HashTable *ht = htable_init(HT_BASE_SIZE);
+	// a missing snapshot would load as an empty one
+	bool found = access(path, R_OK) == 0;
+	if (!found || snapshot_load(ht, path) < 0) {
+		printf("%s: %s\n", path, found ? "damaged snapshot" : strerror(errno));
+		htable_free(ht);
+		return 1;
+	}
+	FILE *f = fopen(output, "w");
+	if (f == NULL) {
+		printf("%s: %s\n", output, strerror(errno));
+		htable_free(ht);
+		return 1;
+	}
+	setvbuf(f, NULL, _IOFBF, SNAPSHOT_BUF_BYTES);
+	Emit e = {.f = f};
+	long long written = 0, skipped = 0;
+	int pos = 0;
+	HashTableItem *item;
+	while ((item = htable_next(ht, &pos)) != NULL) {
+		// values with a NUL would not read back through either format
+		bool plain = item->type != STR_T || str_len(item->value) == (int)strlen(item->value);
+		if (plain && format == FORMAT_CSV && item->type == STR_T) {
+			csv_field(f, item->key, strlen(item->key));
+			fputc(',', f);
+			csv_field(f, item->value, str_len(item->value));
+			fputc('\n', f);
+			written++;
+		} else if (plain && format == FORMAT_RESP && emit_item(&e, item)) {
+			written++;
+		} else {
+			skipped++;
+		}
+	}
+	free(e.body);
+	bool ok = fclose(f) == 0;
+	htable_free(ht);
+	if (!ok) {
+		printf("%s: %s\n", output, strerror(errno));
+		return 1;
+	}
+	printf("%s: %lld keys in %lld ms\n", output, written, (now_us() - start) / 1000);
+	if (skipped > 0)
+		printf("%s: %lld keys left out, of types a %s export does not cover\n", output, skipped,
+			   format == FORMAT_CSV ? "CSV" : "RESP");
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int nthreads = sysconf(_SC_NPROCESSORS_ONLN), i = 1;
+	if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+		nthreads = atoi(argv[2]);
+		i = 3;
+	}
+	if (argc - i == 1 && strcmp(argv[i], "--help") == 0) {
+		print_usage();
+		return 0;
+	}
+	bool import_mode = argc - i >= 4 && strcmp(argv[i], "import") == 0;
+	bool export_mode = argc - i == 4 && strcmp(argv[i], "export") == 0;
+	int format = argc - i >= 2 && strcmp(argv[i + 1], "csv") == 0 ? FORMAT_CSV : FORMAT_RESP;
+	if ((!import_mode && !export_mode) || nthreads < 1 ||
+		(strcmp(argv[i + 1], "csv") != 0 && strcmp(argv[i + 1], "resp") != 0)) {
+		print_usage();
+		return 1;
+	}
+	log_set_level(LOG_WARN);
+	if (import_mode)
+		return import(format, nthreads, argv[i + 2], argv + i + 3, argc - i - 3);
+	return export(format, argv[i + 2], argv[i + 3]);
+}
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 static void print_intro() {
 	const char *green_color = "\033[32m"; // ANSI code for green text
@@ -36,11 +38,24 @@ static void print_usage() {
 	printf("  --prod        Run in production mode with minimal logs\n");
 	printf("  --test        Run in test mode with no logs\n");
 	printf("  --help        Display this help message\n");
+	printf("Environment:\n");
+	printf("  HYPERKV_SNAPSHOT  Snapshot file loaded at startup and written by SAVE (default %s)\n",
+		   SNAPSHOT_FILE);
+	printf("  HYPERKV_AOF       Append only log replayed at startup instead of the snapshot\n");
+	printf("  HYPERKV_AOF_FSYNC always, everysec or no (default everysec)\n");
+	printf("  HYPERKV_BGSAVE    fork, or incremental to checkpoint without forking\n");
+	printf("  HYPERKV_HANDOVER  Unix socket a new process takes over the data and port through\n");
 }
 
 static void close_server(int sfd, HashTable *ht) {
 	log_info("Shutting down server");
 	close_socket(sfd);
+	handover_close();
+	aof_close();
+	// a running background save is left to finish, then superseded
+	snapshot_poll(true);
+	if (!snapshot_save_now(ht))
+		log_error("Failed to save the dataset on shutdown");
 	htable_free(ht);
 	log_info("Server shutdown complete");
 	exit(0);
@@ -83,24 +98,68 @@ int main(int argc, char **argv) {
 	}
 	log_info("Hash table initialized with base size %d", HT_BASE_SIZE);
 
+	char *env_snapshot = getenv("HYPERKV_SNAPSHOT");
+	snapshot_init(env_snapshot != NULL ? env_snapshot : SNAPSHOT_FILE);
+	char *env_bgsave = getenv("HYPERKV_BGSAVE");
+	if (env_bgsave != NULL && strcmp(env_bgsave, "incremental") == 0)
+		snapshot_set_mode(SNAPSHOT_INCREMENTAL);
+	// the log holds every write since it was started, so it wins over the
+	// snapshot whenever there is one. Without a log the snapshot loads while
+	// clients are served, a log being started from the whole keyspace.
+	// A running server listening for a handover passes both the data and its
+	// listening socket instead, once it has stopped appending to the log.
+	char *env_aof = getenv("HYPERKV_AOF");
+	char *env_handover = getenv("HYPERKV_HANDOVER");
+	ht->clock = time(NULL);
+	int sfd = -1, taken = 0;
+	if (env_handover != NULL)
+		taken = handover_receive(env_handover, ht, &sfd, env_aof != NULL);
+	if (taken < 0) {
+		log_fatal("Failed to take over from %s", env_handover);
+		exit(1);
+	} else if (taken > 0) {
+		log_info("Took over the port and data from %s", env_handover);
+	} else if (env_aof != NULL && access(env_aof, F_OK) == 0) {
+		if (aof_load(ht, env_aof) < 0) {
+			log_fatal("Failed to load append only log %s", env_aof);
+			exit(1);
+		}
+	} else if ((env_aof != NULL ? snapshot_load(ht, snapshot_path())
+								: snapshot_load_start(ht, snapshot_path())) < 0) {
+		log_fatal("Failed to load snapshot %s", snapshot_path());
+		exit(1);
+	}
+	if (env_aof != NULL) {
+		char *env_fsync = getenv("HYPERKV_AOF_FSYNC");
+		int policy = AOF_FSYNC_EVERYSEC;
+		if (env_fsync != NULL && strcmp(env_fsync, "always") == 0)
+			policy = AOF_FSYNC_ALWAYS;
+		else if (env_fsync != NULL && strcmp(env_fsync, "no") == 0)
+			policy = AOF_FSYNC_NO;
+		if (!aof_open(ht, env_aof, policy)) {
+			log_fatal("Failed to open append only log %s", env_aof);
+			exit(1);
+		}
+	}
+
 	print_intro();
 
-	int sfd = init_server();
+	if (sfd < 0)
+		sfd = init_server();
 	log_info("Server initialized and listening on port %d", PORT_NUM);
+	if (env_handover != NULL)
+		handover_listen(env_handover);
 
-	while (1) {
-		log_debug("Waiting for incoming connections");
-		int cfd = accept_connection(sfd);
-		log_info("Accepted new client connection");
-
-		int code = rediskw(cfd, ht);
-		if (code == 1) {
-			log_info("Received shutdown command");
-			close_server(sfd, ht);
-		} else {
-			log_debug("Closing client connection");
-			close_socket(cfd);
-		}
+	int code = serve(sfd, ht);
+	if (code == 1) {
+		log_info("Received shutdown command");
+		close_server(sfd, ht);
+	} else if (code == 2) {
+		// the new process has the data and writes it out on its shutdown
+		aof_close();
+		handover_close();
+		log_info("Exiting after the handover");
+		exit(0);
 	}
 	return 0;
 }
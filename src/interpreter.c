@@ -1,5 +1,8 @@
 #include "common.h"
 #include "log.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,24 +16,55 @@ static char *reply_string(char *str) {
 	return res;
 }
 
-static char *reply_integer(int x) {
-	char *res = dmalloc((ndigits(x) + 5) * sizeof(char));
-	sprintf(res, ":%d\r\n", x);
+// bulk reply of n bytes which may include NULs
+static char *reply_bulk(char *str, int n) {
+	char *res = dmalloc((n + ndigits(n) + 7) * sizeof(char));
+	int hdr = sprintf(res, "$%d\r\n", n);
+	memcpy(res + hdr, str, n);
+	memcpy(res + hdr + n, "\r\n", 3);
+	return res;
+}
+
+static char *reply_integer(long long x) {
+	char buf[32];
+	sprintf(buf, ":%lld\r\n", x);
+	return strdup(buf);
+}
+
+// appends tmp to the reply, growing the buffer geometrically so that replies
+// with many elements are built in linear time
+static char *reply_append(char *res, int *len, int *cap, char *tmp) {
+	int n = strlen(tmp);
+	if (*len + n + 1 > *cap) {
+		while (*len + n + 1 > *cap)
+			*cap *= 2;
+		res = drealloc(res, *cap * sizeof(char));
+	}
+	memcpy(res + *len, tmp, n + 1);
+	*len += n;
+	free(tmp);
 	return res;
 }
 
+static char *reply_header(int n) {
+	char *hdr = dmalloc((ndigits(n) + 5) * sizeof(char));
+	sprintf(hdr, "*%d\r\n", n);
+	return hdr;
+}
+
 static char *reply_array_n(char **arr, int n) {
-	char *res = dmalloc((ndigits(n) + 5) * sizeof(char));
-	sprintf(res, "*%d\r\n", n);
+	int len = 0, cap = 64;
+	char *res = dmalloc(cap * sizeof(char));
+	res = reply_append(res, &len, &cap, reply_header(n));
 	for (int i = 0; i < n; i++) {
 		char *tmp;
 		if (arr[i] == NULL) {
 			tmp = reply_string(NULL);
 		} else {
-			tmp = is_number(arr[i]) ? reply_integer(strtoi(arr[i])) : reply_string(arr[i]);
+			tmp = is_number(arr[i]) ? reply_integer(strtoll(arr[i], NULL, 10))
+									: reply_string(arr[i]);
 		}
-		res = drealloc(res, (strlen(res) + strlen(tmp) + 1) * sizeof(char));
-		strncat(res, tmp, strlen(tmp) + 1);
+		res = reply_append(res, &len, &cap, tmp);
 	}
 	return res;
 }
@@ -38,19 +72,10 @@ static char *reply_array_n(char **arr, int n) {
 static char *reply_array(char **arr) {
 	if (arr == NULL)
 		return strdup("*0\r\n");
-	char *res = dmalloc(sizeof(char));
-	*res = '\0';
 	int n = 0;
-	while (*arr != NULL) {
-		char *tmp = is_number(*arr) ? reply_integer(strtoi(*arr)) : reply_string(*arr);
-		res = drealloc(res, (strlen(res) + strlen(tmp) + 1) * sizeof(char));
-		strncat(res, tmp, strlen(tmp) + 1);
-		arr++;
+	while (arr[n] != NULL)
 		n++;
-	}
-	char *new_res = dmalloc((strlen(res) + ndigits(n) + 5) * sizeof(char));
-	sprintf(new_res, "*%d\r\n%s", n, res);
-	return new_res;
+	return reply_array_n(arr, n);
 }
 
 static char *reply_err_argc(int given, char *expected) {
@@ -65,10 +90,37 @@ static char *reply_err_intid() {
 	return strdup("-ERR value is not an integer or out of range\r\n");
 }
 
+static char *reply_err_timeout() {
+	return strdup("-ERR timeout is not a float or out of range\r\n");
+}
+
+static char *reply_err_syntax() { return strdup("-ERR syntax error\r\n"); }
+
+static char *reply_err_float() { return strdup("-ERR value is not a valid float\r\n"); }
+
+static char *reply_double(double x) {
+	char *tmp = dtostr(x);
+	char *res = reply_string(tmp);
+	free(tmp);
+	return res;
+}
+
 static bool is_type(char *given, char *expected) {
 	return strcmp(given, expected) == 0 || strcmp(given, "none") == 0;
 }
 
+// checks that every key in keys is either missing or of the expected type
+static bool is_type_all(HashTable *ht, char **keys, int n, char *expected) {
+	for (int i = 0; i < n; i++) {
+		char *type = htable_type(ht, keys[i]);
+		bool ok = is_type(type, expected);
+		free(type);
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
 char *exec_del(HashTable *ht, Command *cmd) {
 	log_debug("Executing DEL command with %d arguments", cmd->argc);
 	if (cmd->argc >= 1) {
@@ -137,7 +189,7 @@ char *exec_get(HashTable *ht, Command *cmd) {
 			free(type);
 			char *res = htable_get(ht, cmd->argv[0]);
 			log_debug("GET: Retrieved value for key '%s'", cmd->argv[0]);
-			return reply_string(res);
+			return res != NULL ? reply_bulk(res, str_len(res)) : reply_string(NULL);
 		}
 		log_warn("GET: Wrong type for key '%s', expected string, got %s", cmd->argv[0], type);
 		return reply_err_type();
@@ -269,7 +321,7 @@ char *exec_strlen(HashTable *ht, Command *cmd) {
 		if (is_type(type, "string")) {
 			free(type);
 			char *res = htable_get(ht, cmd->argv[0]);
-			return reply_integer(res == NULL ? 0 : strlen(res));
+			return reply_integer(res == NULL ? 0 : str_len(res));
 		}
 		return reply_err_type();
 	}
@@ -614,6 +666,2377 @@ char *exec_smismember(HashTable *ht, Command *cmd) {
 	return reply_err_argc(cmd->argc, "2+");
 }
 
+static char *exec_setop(HashTable *ht, Command *cmd, int op) {
+	if (cmd->argc >= 1) {
+		if (is_type_all(ht, cmd->argv, cmd->argc, "set")) {
+			char **res = htable_setop(ht, cmd->argv, cmd->argc, op);
+			return reply_array(res);
+		}
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1+");
+}
+
+static char *exec_setopstore(HashTable *ht, Command *cmd, int op) {
+	if (cmd->argc >= 2) {
+		if (is_type_all(ht, cmd->argv + 1, cmd->argc - 1, "set")) {
+			int res = htable_setopstore(ht, cmd->argv[0], cmd->argv + 1, cmd->argc - 1, op);
+			return reply_integer(res);
+		}
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+char *exec_sinter(HashTable *ht, Command *cmd) { return exec_setop(ht, cmd, SET_INTER); }
+
+char *exec_sinterstore(HashTable *ht, Command *cmd) {
+	return exec_setopstore(ht, cmd, SET_INTER);
+}
+
+char *exec_sunion(HashTable *ht, Command *cmd) { return exec_setop(ht, cmd, SET_UNION); }
+
+char *exec_sunionstore(HashTable *ht, Command *cmd) {
+	return exec_setopstore(ht, cmd, SET_UNION);
+}
+
+char *exec_sdiff(HashTable *ht, Command *cmd) { return exec_setop(ht, cmd, SET_DIFF); }
+
+char *exec_sdiffstore(HashTable *ht, Command *cmd) { return exec_setopstore(ht, cmd, SET_DIFF); }
+
+// sintercard numkeys key [key ...] [limit limit]
+char *exec_sintercard(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		if (!is_number(cmd->argv[0]) || strtoi(cmd->argv[0]) <= 0)
+			return reply_err_intid();
+		int nkeys = strtoi(cmd->argv[0]), limit = 0;
+		if (cmd->argc == nkeys + 3 && strcmp(cmd->argv[nkeys + 1], "limit") == 0) {
+			if (!is_number(cmd->argv[nkeys + 2]) || strtoi(cmd->argv[nkeys + 2]) < 0)
+				return reply_err_intid();
+			limit = strtoi(cmd->argv[nkeys + 2]);
+		} else if (cmd->argc != nkeys + 1) {
+			return reply_err_argc(cmd->argc, "numkeys+1");
+		}
+		if (is_type_all(ht, cmd->argv + 1, nkeys, "set"))
+			return reply_integer(htable_sintercard(ht, cmd->argv + 1, nkeys, limit));
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// parses a blocking timeout given in seconds, 0 blocks forever
+static bool parse_timeout(char *str, double *timeout) {
+	char *end;
+	*timeout = strtod(str, &end);
+	return end != str && *end == '\0' && *timeout >= 0;
+}
+
+static int parse_dir(char *str) {
+	if (strcmp(str, "left") == 0)
+		return LEFT;
+	if (strcmp(str, "right") == 0)
+		return RIGHT;
+	return -1;
+}
+
+// lmove source destination left|right left|right
+char *exec_lmove(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 4) {
+		int from = parse_dir(cmd->argv[2]), to = parse_dir(cmd->argv[3]);
+		if (from < 0 || to < 0)
+			return reply_err_syntax();
+		if (is_type_all(ht, cmd->argv, 2, "list")) {
+			char *value = htable_pop(ht, cmd->argv[0], from);
+			if (value != NULL)
+				htable_push(ht, cmd->argv[1], value, to);
+			char *res = reply_string(value);
+			free(value);
+			return res;
+		}
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "4");
+}
+
+// pops from the first non-empty key, otherwise the client blocks until one of
+// the keys is pushed to and the command is run again
+static char *exec_bpop(HashTable *ht, Command *cmd, int dir) {
+	if (cmd->argc >= 2) {
+		double timeout;
+		int nkeys = cmd->argc - 1;
+		if (!parse_timeout(cmd->argv[nkeys], &timeout))
+			return reply_err_timeout();
+		if (!is_type_all(ht, cmd->argv, nkeys, "list"))
+			return reply_err_type();
+		for (int i = 0; i < nkeys; i++) {
+			char *value = htable_pop(ht, cmd->argv[i], dir);
+			if (value != NULL) {
+				char *res = reply_array_n((char *[]){cmd->argv[i], value}, 2);
+				free(value);
+				return res;
+			}
+		}
+		block_client(cmd, 0, nkeys, timeout);
+		return strdup("b");
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+char *exec_blpop(HashTable *ht, Command *cmd) { return exec_bpop(ht, cmd, LEFT); }
+
+char *exec_brpop(HashTable *ht, Command *cmd) { return exec_bpop(ht, cmd, RIGHT); }
+
+// blmove source destination left|right left|right timeout
+char *exec_blmove(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 5) {
+		double timeout;
+		if (!parse_timeout(cmd->argv[4], &timeout))
+			return reply_err_timeout();
+		if (parse_dir(cmd->argv[2]) < 0 || parse_dir(cmd->argv[3]) < 0)
+			return reply_err_syntax();
+		if (!is_type_all(ht, cmd->argv, 2, "list"))
+			return reply_err_type();
+		if (!htable_exists(ht, cmd->argv[0])) {
+			block_client(cmd, 0, 1, timeout);
+			return strdup("b");
+		}
+		cmd->argc = 4;
+		char *res = exec_lmove(ht, cmd);
+		cmd->argc = 5;
+		return res;
+	}
+	return reply_err_argc(cmd->argc, "5");
+}
+
+// zadd key score member [score member ...]
+char *exec_zadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc % 2 == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			int n = (cmd->argc - 1) / 2, added = 0;
+			double *scores = dmalloc(n * sizeof(double));
+			for (int i = 0; i < n; i++) {
+				if (!parse_double(cmd->argv[1 + 2 * i], &scores[i])) {
+					free(scores);
+					return reply_err_float();
+				}
+			}
+			for (int i = 0; i < n; i++)
+				added += htable_zadd(ht, cmd->argv[0], cmd->argv[2 + 2 * i], scores[i]);
+			free(scores);
+			return reply_integer(added);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+char *exec_zrem(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			int removed = 0;
+			for (int i = 1; i < cmd->argc; i++)
+				removed += htable_zrem(ht, cmd->argv[0], cmd->argv[i]);
+			return reply_integer(removed);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+char *exec_zscore(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			double score;
+			if (!htable_zscore(ht, cmd->argv[0], cmd->argv[1], &score))
+				return reply_string(NULL);
+			return reply_double(score);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+// zincrby key increment member
+char *exec_zincrby(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			double incr, score = 0;
+			if (!parse_double(cmd->argv[1], &incr))
+				return reply_err_float();
+			htable_zscore(ht, cmd->argv[0], cmd->argv[2], &score);
+			if (isnan(score + incr))
+				return strdup("-ERR resulting score is not a number (NaN)\r\n");
+			htable_zadd(ht, cmd->argv[0], cmd->argv[2], score + incr);
+			return reply_double(score + incr);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+char *exec_zcard(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			return reply_integer(htable_zcard(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+static char *exec_zrank_dir(HashTable *ht, Command *cmd, bool rev) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			int rank = htable_zrank(ht, cmd->argv[0], cmd->argv[1], rev);
+			return rank >= 0 ? reply_integer(rank) : reply_string(NULL);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+char *exec_zrank(HashTable *ht, Command *cmd) { return exec_zrank_dir(ht, cmd, false); }
+
+char *exec_zrevrank(HashTable *ht, Command *cmd) { return exec_zrank_dir(ht, cmd, true); }
+
+// parses a score range bound, a leading '(' makes it exclusive
+static bool parse_score_bound(char *str, double *score, bool *ex) {
+	*ex = *str == '(';
+	return parse_double(*ex ? str + 1 : str, score);
+}
+
+// zrange key start stop [byscore] [rev] [withscores]
+char *exec_zrange(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc <= 6) {
+		bool byscore = false, rev = false, withscores = false;
+		for (int i = 3; i < cmd->argc; i++) {
+			if (strcmp(cmd->argv[i], "byscore") == 0)
+				byscore = true;
+			else if (strcmp(cmd->argv[i], "rev") == 0)
+				rev = true;
+			else if (strcmp(cmd->argv[i], "withscores") == 0)
+				withscores = true;
+			else
+				return reply_err_syntax();
+		}
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "zset")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		char **res;
+		if (byscore) {
+			// with rev the range is given from max to min
+			double min, max;
+			bool minex, maxex;
+			char *lo = cmd->argv[rev ? 2 : 1], *hi = cmd->argv[rev ? 1 : 2];
+			if (!parse_score_bound(lo, &min, &minex) || !parse_score_bound(hi, &max, &maxex))
+				return strdup("-ERR min or max is not a float\r\n");
+			res = htable_zrangebyscore(ht, cmd->argv[0], min, minex, max, maxex, rev, withscores);
+		} else {
+			if (!is_number(cmd->argv[1]) || !is_number(cmd->argv[2]))
+				return reply_err_intid();
+			int start = strtoi(cmd->argv[1]), end = strtoi(cmd->argv[2]);
+			res = htable_zrange(ht, cmd->argv[0], start, end, rev, withscores);
+		}
+		char *reply = reply_array(res);
+		for (int i = 0; res != NULL && res[i] != NULL; i++)
+			free(res[i]);
+		free(res);
+		return reply;
+	}
+	return reply_err_argc(cmd->argc, "3..6");
+}
+
+// zrangebyscore key min max [withscores]
+char *exec_zrangebyscore(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3 || cmd->argc == 4) {
+		if (cmd->argc == 4 && strcmp(cmd->argv[3], "withscores") != 0)
+			return reply_err_syntax();
+		// run as zrange key min max byscore [withscores]
+		Command tmp = {ZRANGE, cmd->argc + 1, dmalloc((cmd->argc + 1) * sizeof(char *))};
+		memcpy(tmp.argv, cmd->argv, 3 * sizeof(char *));
+		tmp.argv[3] = "byscore";
+		if (cmd->argc == 4)
+			tmp.argv[4] = cmd->argv[3];
+		char *res = exec_zrange(ht, &tmp);
+		free(tmp.argv);
+		return res;
+	}
+	return reply_err_argc(cmd->argc, "3..4");
+}
+
+// pfadd key [element ...]
+char *exec_pfadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "hyperloglog")) {
+			free(type);
+			return reply_integer(htable_pfadd(ht, cmd->argv[0], cmd->argv + 1, cmd->argc - 1));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1+");
+}
+
+char *exec_pfcount(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 1) {
+		if (!is_type_all(ht, cmd->argv, cmd->argc, "hyperloglog"))
+			return reply_err_type();
+		return reply_integer(htable_pfcount(ht, cmd->argv, cmd->argc));
+	}
+	return reply_err_argc(cmd->argc, "1+");
+}
+
+// pfmerge destkey [sourcekey ...]
+char *exec_pfmerge(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 1) {
+		if (!is_type_all(ht, cmd->argv, cmd->argc, "hyperloglog"))
+			return reply_err_type();
+		htable_pfmerge(ht, cmd->argv[0], cmd->argv + 1, cmd->argc - 1);
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "1+");
+}
+
+// parses a bit offset, which must fit the 256 MB a string may grow to
+static bool parse_offset(char *str, int *offset) {
+	if (!is_number(str) || *str == '-' || *str == '\0' || strlen(str) > 10)
+		return false;
+	long long x = strtoll(str, NULL, 10);
+	*offset = x;
+	return x <= INT_MAX;
+}
+
+static char *reply_err_offset() {
+	return strdup("-ERR bit offset is not an integer or out of range\r\n");
+}
+
+static char *reply_err_bit() { return strdup("-ERR bit is not an integer or out of range\r\n"); }
+
+// setbit key offset value
+char *exec_setbit(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "string")) {
+			free(type);
+			int offset;
+			if (!parse_offset(cmd->argv[1], &offset))
+				return reply_err_offset();
+			if (strcmp(cmd->argv[2], "0") != 0 && strcmp(cmd->argv[2], "1") != 0)
+				return reply_err_bit();
+			return reply_integer(htable_setbit(ht, cmd->argv[0], offset, *cmd->argv[2] - '0'));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+char *exec_getbit(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "string")) {
+			free(type);
+			int offset;
+			if (!parse_offset(cmd->argv[1], &offset))
+				return reply_err_offset();
+			return reply_integer(htable_getbit(ht, cmd->argv[0], offset));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+// bitcount key [start end [byte|bit]]
+char *exec_bitcount(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 3 || cmd->argc == 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "string")) {
+			free(type);
+			int start = 0, end = -1;
+			bool bits = false;
+			if (cmd->argc >= 3) {
+				if (!is_number(cmd->argv[1]) || !is_number(cmd->argv[2]))
+					return reply_err_intid();
+				start = strtoi(cmd->argv[1]);
+				end = strtoi(cmd->argv[2]);
+			}
+			if (cmd->argc == 4) {
+				if (strcmp(cmd->argv[3], "bit") != 0 && strcmp(cmd->argv[3], "byte") != 0)
+					return reply_err_syntax();
+				bits = strcmp(cmd->argv[3], "bit") == 0;
+			}
+			return reply_integer(htable_bitcount(ht, cmd->argv[0], start, end, bits));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1 or 3..4");
+}
+
+// bitop and|or|xor|not destkey key [key ...]
+char *exec_bitop(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		int op;
+		if (strcmp(cmd->argv[0], "and") == 0)
+			op = BITOP_AND;
+		else if (strcmp(cmd->argv[0], "or") == 0)
+			op = BITOP_OR;
+		else if (strcmp(cmd->argv[0], "xor") == 0)
+			op = BITOP_XOR;
+		else if (strcmp(cmd->argv[0], "not") == 0)
+			op = BITOP_NOT;
+		else
+			return reply_err_syntax();
+		if (op == BITOP_NOT && cmd->argc != 3)
+			return strdup("-ERR BITOP NOT must be called with a single source key\r\n");
+		if (!is_type_all(ht, cmd->argv + 2, cmd->argc - 2, "string"))
+			return reply_err_type();
+		return reply_integer(htable_bitop(ht, op, cmd->argv[1], cmd->argv + 2, cmd->argc - 2));
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// bitpos key bit [start [end]]
+char *exec_bitpos(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2 && cmd->argc <= 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "string")) {
+			free(type);
+			if (strcmp(cmd->argv[1], "0") != 0 && strcmp(cmd->argv[1], "1") != 0)
+				return reply_err_bit();
+			int start = 0, end = -1;
+			for (int i = 2; i < cmd->argc; i++) {
+				if (!is_number(cmd->argv[i]))
+					return reply_err_intid();
+			}
+			if (cmd->argc >= 3)
+				start = strtoi(cmd->argv[2]);
+			if (cmd->argc == 4)
+				end = strtoi(cmd->argv[3]);
+			int bit = *cmd->argv[1] - '0';
+			return reply_integer(
+				htable_bitpos(ht, cmd->argv[0], bit, start, end, cmd->argc == 4));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2..4");
+}
+
+// parses an unsigned 32 bit id
+static bool parse_id(char *str, uint32_t *id) {
+	if (!is_number(str) || *str == '-' || *str == '\0' || strlen(str) > 10)
+		return false;
+	unsigned long long x = strtoull(str, NULL, 10);
+	*id = x;
+	return x <= UINT32_MAX;
+}
+
+// parses argv[first..argc) as ids, NULL if any of them is not one
+static uint32_t *parse_ids(Command *cmd, int first) {
+	uint32_t *ids = dmalloc((cmd->argc - first) * sizeof(uint32_t));
+	for (int i = first; i < cmd->argc; i++) {
+		if (!parse_id(cmd->argv[i], &ids[i - first])) {
+			free(ids);
+			return NULL;
+		}
+	}
+	return ids;
+}
+
+// rbadd key id [id ...]
+char *exec_rbadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "roaring")) {
+			free(type);
+			uint32_t *ids = parse_ids(cmd, 1);
+			if (ids == NULL)
+				return reply_err_intid();
+			int res = htable_rbadd(ht, cmd->argv[0], ids, cmd->argc - 1);
+			free(ids);
+			return reply_integer(res);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// rbrem key id [id ...]
+char *exec_rbrem(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "roaring")) {
+			free(type);
+			uint32_t *ids = parse_ids(cmd, 1);
+			if (ids == NULL)
+				return reply_err_intid();
+			int res = htable_rbrem(ht, cmd->argv[0], ids, cmd->argc - 1);
+			free(ids);
+			return reply_integer(res);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+char *exec_rbismember(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "roaring")) {
+			free(type);
+			uint32_t id;
+			if (!parse_id(cmd->argv[1], &id))
+				return reply_err_intid();
+			return reply_integer(htable_rbismember(ht, cmd->argv[0], id));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+char *exec_rbcard(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "roaring")) {
+			free(type);
+			return reply_integer(htable_rbcard(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+char *exec_rbmembers(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "roaring")) {
+			free(type);
+			char **res = htable_rbmembers(ht, cmd->argv[0]);
+			char *reply = reply_array(res);
+			for (int i = 0; res != NULL && res[i] != NULL; i++)
+				free(res[i]);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// rbop and|or|andnot destkey key [key ...]
+char *exec_rbop(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		int op;
+		if (strcmp(cmd->argv[0], "and") == 0)
+			op = SET_INTER;
+		else if (strcmp(cmd->argv[0], "or") == 0)
+			op = SET_UNION;
+		else if (strcmp(cmd->argv[0], "andnot") == 0)
+			op = SET_DIFF;
+		else
+			return reply_err_syntax();
+		if (!is_type_all(ht, cmd->argv + 2, cmd->argc - 2, "roaring"))
+			return reply_err_type();
+		return reply_integer(htable_rbop(ht, op, cmd->argv[1], cmd->argv + 2, cmd->argc - 2));
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+static char *reply_err_streamid() {
+	return strdup("-ERR Invalid stream ID specified as stream command argument\r\n");
+}
+
+// appends the [id, [field, value ...]] pairs of entries to the reply
+static char *reply_append_entries(char *res, int *len, int *cap, StreamEntry *entries, int n) {
+	res = reply_append(res, len, cap, reply_header(n));
+	for (int i = 0; i < n; i++) {
+		char *id = stream_id_str(entries[i].id);
+		res = reply_append(res, len, cap, reply_header(2));
+		res = reply_append(res, len, cap, reply_string(id));
+		if (entries[i].nfields < 0)
+			res = reply_append(res, len, cap, strdup("*-1\r\n"));
+		else
+			res = reply_append(res, len, cap,
+							   reply_array_n(entries[i].fields, entries[i].nfields));
+		free(id);
+	}
+	return res;
+}
+
+static bool parse_count(char *str, long long *count) {
+	if (!is_number(str) || *str == '-' || *str == '\0' || strlen(str) > 18)
+		return false;
+	*count = strtoll(str, NULL, 10);
+	return true;
+}
+
+// parses maxlen [=|~] threshold at argv[*i], moving *i past it
+static char *parse_maxlen(Command *cmd, int *i, long long *maxlen, bool *approx) {
+	(*i)++;
+	*approx = false;
+	if (*i < cmd->argc && (strcmp(cmd->argv[*i], "~") == 0 || strcmp(cmd->argv[*i], "=") == 0)) {
+		*approx = *cmd->argv[*i] == '~';
+		(*i)++;
+	}
+	if (*i == cmd->argc)
+		return reply_err_syntax();
+	if (!parse_count(cmd->argv[*i], maxlen))
+		return reply_err_intid();
+	(*i)++;
+	return NULL;
+}
+
+// xadd key [nomkstream] [maxlen [=|~] threshold] *|id field value [field value ...]
+char *exec_xadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "stream")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		int i = 1;
+		bool nomkstream = false, approx = false;
+		long long maxlen = -1;
+		if (strcmp(cmd->argv[i], "nomkstream") == 0) {
+			nomkstream = true;
+			i++;
+		}
+		if (i < cmd->argc && strcmp(cmd->argv[i], "maxlen") == 0) {
+			char *err = parse_maxlen(cmd, &i, &maxlen, &approx);
+			if (err != NULL)
+				return err;
+		}
+		int nfields = cmd->argc - i - 1;
+		if (nfields < 2 || nfields % 2 != 0)
+			return reply_err_argc(cmd->argc, "4+");
+
+		StreamID id = {0, 0};
+		int gen = XID_EXPLICIT;
+		char *str = cmd->argv[i], *dash = strchr(str, '-');
+		if (strcmp(str, "*") == 0) {
+			gen = XID_AUTO;
+		} else if (dash != NULL && strcmp(dash, "-*") == 0) {
+			gen = XID_AUTO_SEQ;
+			*dash = '\0';
+			bool ok = stream_parse_id(str, &id, 0);
+			*dash = '-';
+			if (!ok)
+				return reply_err_streamid();
+		} else if (!stream_parse_id(str, &id, 0)) {
+			return reply_err_streamid();
+		}
+		if (gen == XID_EXPLICIT && id.ms == 0 && id.seq == 0)
+			return strdup("-ERR The ID specified in XADD must be greater than 0-0\r\n");
+		if (nomkstream && !htable_exists(ht, cmd->argv[0]))
+			return reply_string(NULL);
+		if (!htable_xadd(ht, cmd->argv[0], &id, gen, cmd->argv + i + 1, nfields, maxlen, approx))
+			return strdup("-ERR The ID specified in XADD is equal or smaller than the target "
+						  "stream top item\r\n");
+		char *tmp = stream_id_str(id);
+		char *res = reply_string(tmp);
+		free(tmp);
+		return res;
+	}
+	return reply_err_argc(cmd->argc, "4+");
+}
+
+char *exec_xlen(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "stream")) {
+			free(type);
+			return reply_integer(htable_xlen(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// parses a range bound, - and + being the smallest and largest ids. A leading
+// ( makes the bound exclusive.
+static bool parse_bound(char *str, StreamID *id, bool start) {
+	if (strcmp(str, "-") == 0) {
+		*id = (StreamID){0, 0};
+		return true;
+	}
+	if (strcmp(str, "+") == 0) {
+		*id = (StreamID){UINT64_MAX, UINT64_MAX};
+		return true;
+	}
+	bool ex = *str == '(';
+	if (!stream_parse_id(str + ex, id, start ? 0 : UINT64_MAX))
+		return false;
+	return !ex || (start ? stream_id_incr(id) : stream_id_decr(id));
+}
+
+// xrange key start end [count n]
+char *exec_xrange(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3 || cmd->argc == 5) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "stream")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		StreamID start, end;
+		long long count = 0;
+		if (!parse_bound(cmd->argv[1], &start, true) || !parse_bound(cmd->argv[2], &end, false))
+			return reply_err_streamid();
+		if (cmd->argc == 5) {
+			if (strcmp(cmd->argv[3], "count") != 0)
+				return reply_err_syntax();
+			if (!parse_count(cmd->argv[4], &count))
+				return reply_err_intid();
+			if (count == 0)
+				return reply_array(NULL);
+		}
+		int n, len = 0, cap = 64;
+		StreamEntry *entries = htable_xrange(ht, cmd->argv[0], start, end, count, &n);
+		char *res = reply_append_entries(dmalloc(cap), &len, &cap, entries, n);
+		stream_entries_free(entries, n);
+		return res;
+	}
+	return reply_err_argc(cmd->argc, "3 or 5");
+}
+
+// xtrim key maxlen [=|~] threshold
+char *exec_xtrim(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc <= 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "stream")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		int i = 1;
+		long long maxlen;
+		bool approx;
+		if (strcmp(cmd->argv[i], "maxlen") != 0)
+			return reply_err_syntax();
+		char *err = parse_maxlen(cmd, &i, &maxlen, &approx);
+		if (err != NULL)
+			return err;
+		if (i != cmd->argc)
+			return reply_err_syntax();
+		return reply_integer(htable_xtrim(ht, cmd->argv[0], maxlen, approx));
+	}
+	return reply_err_argc(cmd->argc, "3..4");
+}
+
+// parses [count n] [block ms] [noack] from argv[*i] up to streams, and checks
+// that the keys and ids after it pair up. noack is NULL unless allowed.
+static char *parse_xread(Command *cmd, int *i, long long *count, double *timeout, bool *noack) {
+	*count = 0;
+	*timeout = -1;
+	while (*i < cmd->argc && strcmp(cmd->argv[*i], "streams") != 0) {
+		char *opt = cmd->argv[*i];
+		if (noack != NULL && strcmp(opt, "noack") == 0) {
+			*noack = true;
+			(*i)++;
+			continue;
+		}
+		if (*i + 1 == cmd->argc)
+			return reply_err_syntax();
+		if (strcmp(opt, "count") == 0) {
+			if (!parse_count(cmd->argv[*i + 1], count))
+				return reply_err_intid();
+		} else if (strcmp(opt, "block") == 0) {
+			long long ms;
+			if (!parse_count(cmd->argv[*i + 1], &ms))
+				return reply_err_timeout();
+			*timeout = ms / 1000.0;
+		} else {
+			return reply_err_syntax();
+		}
+		*i += 2;
+	}
+	if (*i == cmd->argc)
+		return reply_err_syntax();
+	(*i)++;
+	if (*i == cmd->argc || (cmd->argc - *i) % 2 != 0)
+		return strdup("-ERR Unbalanced list of streams: for each stream key an ID must be "
+					  "specified\r\n");
+	return NULL;
+}
+
+// xread [count n] [block ms] streams key [key ...] id [id ...]
+char *exec_xread(HashTable *ht, Command *cmd) {
+	int first = 0;
+	long long count;
+	double timeout;
+	char *err = parse_xread(cmd, &first, &count, &timeout, NULL);
+	if (err != NULL)
+		return err;
+	int nkeys = (cmd->argc - first) / 2;
+	char **keys = cmd->argv + first, **ids = keys + nkeys;
+	if (!is_type_all(ht, keys, nkeys, "stream"))
+		return reply_err_type();
+	StreamID *after = dmalloc(nkeys * sizeof(StreamID));
+	for (int k = 0; k < nkeys; k++) {
+		if (strcmp(ids[k], "$") == 0) {
+			after[k] = htable_xlast(ht, keys[k]);
+		} else if (!stream_parse_id(ids[k], &after[k], 0)) {
+			free(after);
+			return reply_err_streamid();
+		}
+	}
+
+	int len = 0, cap = 64, found = 0;
+	char *res = dmalloc(cap);
+	for (int k = 0; k < nkeys; k++) {
+		StreamID start = after[k];
+		int n = 0;
+		StreamEntry *entries = NULL;
+		if (stream_id_incr(&start))
+			entries = htable_xrange(ht, keys[k], start, (StreamID){UINT64_MAX, UINT64_MAX},
+									count, &n);
+		if (n > 0) {
+			res = reply_append(res, &len, &cap, reply_header(2));
+			res = reply_append(res, &len, &cap, reply_string(keys[k]));
+			res = reply_append_entries(res, &len, &cap, entries, n);
+			found++;
+		}
+		stream_entries_free(entries, n);
+	}
+	if (found > 0) {
+		// the header goes in front of the per key replies
+		char *hdr = reply_header(found);
+		char *tmp = dmalloc(strlen(hdr) + len + 1);
+		sprintf(tmp, "%s%s", hdr, res);
+		free(hdr);
+		free(res);
+		free(after);
+		return tmp;
+	}
+	free(res);
+	if (timeout < 0) {
+		free(after);
+		return strdup("*-1\r\n");
+	}
+	// $ is pinned to the current last id, so the retry waits for newer entries
+	for (int k = 0; k < nkeys; k++) {
+		if (strcmp(ids[k], "$") == 0) {
+			free(ids[k]);
+			ids[k] = stream_id_str(after[k]);
+		}
+	}
+	free(after);
+	block_client(cmd, first, nkeys, timeout);
+	return strdup("b");
+}
+
+// xgroup create key group id|$ [mkstream], xgroup destroy key group
+char *exec_xgroup(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc <= 5) {
+		char *type = htable_type(ht, cmd->argv[1]);
+		if (!is_type(type, "stream")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		if (strcmp(cmd->argv[0], "destroy") == 0 && cmd->argc == 3)
+			return reply_integer(htable_xgroup_destroy(ht, cmd->argv[1], cmd->argv[2]));
+		if (strcmp(cmd->argv[0], "create") != 0 || cmd->argc == 3)
+			return reply_err_syntax();
+		bool mkstream = cmd->argc == 5;
+		if (mkstream && strcmp(cmd->argv[4], "mkstream") != 0)
+			return reply_err_syntax();
+		StreamID id;
+		bool last = strcmp(cmd->argv[3], "$") == 0;
+		if (!last && !stream_parse_id(cmd->argv[3], &id, 0))
+			return reply_err_streamid();
+		int res = htable_xgroup_create(ht, cmd->argv[1], cmd->argv[2], last ? NULL : &id,
+									   mkstream);
+		if (res == -1)
+			return strdup("-ERR The XGROUP subcommand requires the key to exist\r\n");
+		if (res == -2)
+			return strdup("-BUSYGROUP Consumer Group name already exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "3..5");
+}
+
+// xreadgroup group group consumer [count n] [block ms] [noack]
+//     streams key [key ...] id|> [id|> ...]
+char *exec_xreadgroup(HashTable *ht, Command *cmd) {
+	if (cmd->argc < 6)
+		return reply_err_argc(cmd->argc, "6+");
+	if (strcmp(cmd->argv[0], "group") != 0)
+		return reply_err_syntax();
+	char *group = cmd->argv[1], *consumer = cmd->argv[2];
+	int first = 3;
+	long long count;
+	double timeout;
+	bool noack = false;
+	char *err = parse_xread(cmd, &first, &count, &timeout, &noack);
+	if (err != NULL)
+		return err;
+	int nkeys = (cmd->argc - first) / 2;
+	char **keys = cmd->argv + first, **ids = keys + nkeys;
+	if (!is_type_all(ht, keys, nkeys, "stream"))
+		return reply_err_type();
+	StreamID *after = dmalloc(nkeys * sizeof(StreamID));
+	bool only_new = true;
+	for (int k = 0; k < nkeys; k++) {
+		if (strcmp(ids[k], ">") == 0)
+			continue;
+		only_new = false;
+		if (!stream_parse_id(ids[k], &after[k], 0)) {
+			free(after);
+			return reply_err_streamid();
+		}
+	}
+	for (int k = 0; k < nkeys; k++) {
+		if (!htable_xgroup_exists(ht, keys[k], group)) {
+			free(after);
+			char *res = dmalloc(strlen(keys[k]) + strlen(group) + 80);
+			sprintf(res, "-NOGROUP No such key '%s' or consumer group '%s'\r\n", keys[k], group);
+			return res;
+		}
+	}
+
+	int len = 0, cap = 64, found = 0;
+	char *res = dmalloc(cap);
+	for (int k = 0; k < nkeys; k++) {
+		bool new = strcmp(ids[k], ">") == 0;
+		int n;
+		StreamEntry *entries = htable_xreadgroup(ht, keys[k], group, consumer,
+												 new ? NULL : &after[k], count, noack, &n);
+		// reading pending entries replies for the key even when there are none
+		if (n > 0 || !new) {
+			res = reply_append(res, &len, &cap, reply_header(2));
+			res = reply_append(res, &len, &cap, reply_string(keys[k]));
+			res = reply_append_entries(res, &len, &cap, entries, n);
+			found++;
+		}
+		stream_entries_free(entries, n);
+	}
+	free(after);
+	if (found > 0) {
+		char *hdr = reply_header(found);
+		char *tmp = dmalloc(strlen(hdr) + len + 1);
+		sprintf(tmp, "%s%s", hdr, res);
+		free(hdr);
+		free(res);
+		return tmp;
+	}
+	free(res);
+	if (timeout < 0 || !only_new)
+		return strdup("*-1\r\n");
+	block_client(cmd, first, nkeys, timeout);
+	return strdup("b");
+}
+
+// xack key group id [id ...]
+char *exec_xack(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "stream")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		int n = cmd->argc - 2;
+		StreamID *ids = dmalloc(n * sizeof(StreamID));
+		for (int i = 0; i < n; i++) {
+			if (!stream_parse_id(cmd->argv[i + 2], &ids[i], 0)) {
+				free(ids);
+				return reply_err_streamid();
+			}
+		}
+		int res = htable_xack(ht, cmd->argv[0], cmd->argv[1], ids, n);
+		free(ids);
+		return reply_integer(res);
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+#define BLOOM_MAX_CAPACITY (1LL << 30)
+#define BLOOM_MAX_EXPANSION 32
+
+static char *reply_err_bffull() { return strdup("-ERR non scaling filter is full\r\n"); }
+
+// bf.reserve key error_rate capacity [expansion n] [nonscaling]
+char *exec_bfreserve(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		double error;
+		long long capacity, expansion = BLOOM_DEFAULT_EXPANSION;
+		bool has_expansion = false, nonscaling = false;
+		if (!parse_double(cmd->argv[1], &error) || error <= 0 || error >= 1)
+			return strdup("-ERR error rate should be between 0 and 1\r\n");
+		if (!parse_count(cmd->argv[2], &capacity) || capacity == 0 ||
+			capacity > BLOOM_MAX_CAPACITY)
+			return strdup("-ERR capacity is out of range\r\n");
+		for (int i = 3; i < cmd->argc; i++) {
+			if (strcmp(cmd->argv[i], "expansion") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &expansion) || expansion == 0 ||
+					expansion > BLOOM_MAX_EXPANSION)
+					return strdup("-ERR expansion is out of range\r\n");
+				has_expansion = true;
+			} else if (strcmp(cmd->argv[i], "nonscaling") == 0) {
+				nonscaling = true;
+			} else {
+				return reply_err_syntax();
+			}
+		}
+		if (has_expansion && nonscaling)
+			return reply_err_syntax();
+		if (!htable_bfreserve(ht, cmd->argv[0], error, capacity, nonscaling ? 0 : expansion))
+			return strdup("-ERR item exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// bf.add key item
+char *exec_bfadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "bloom")) {
+			free(type);
+			int res;
+			htable_bfadd(ht, cmd->argv[0], cmd->argv + 1, 1, &res);
+			return res < 0 ? reply_err_bffull() : reply_integer(res);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+// bf.madd key item [item ...], a full non scaling filter fails the items that
+// did not fit with an error element
+char *exec_bfmadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "bloom")) {
+			free(type);
+			int n = cmd->argc - 1, len = 0, cap = 64;
+			int *res = dmalloc(n * sizeof(int));
+			htable_bfadd(ht, cmd->argv[0], cmd->argv + 1, n, res);
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(n));
+			for (int i = 0; i < n; i++) {
+				char *tmp = res[i] < 0 ? reply_err_bffull() : reply_integer(res[i]);
+				reply = reply_append(reply, &len, &cap, tmp);
+			}
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// bf.exists key item
+char *exec_bfexists(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "bloom")) {
+			free(type);
+			int res;
+			htable_bfexists(ht, cmd->argv[0], cmd->argv + 1, 1, &res);
+			return reply_integer(res);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+// bf.mexists key item [item ...]
+char *exec_bfmexists(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "bloom")) {
+			free(type);
+			int n = cmd->argc - 1, len = 0, cap = 64;
+			int *res = dmalloc(n * sizeof(int));
+			htable_bfexists(ht, cmd->argv[0], cmd->argv + 1, n, res);
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(n));
+			for (int i = 0; i < n; i++)
+				reply = reply_append(reply, &len, &cap, reply_integer(res[i]));
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// bf.card key, the number of items added
+char *exec_bfcard(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "bloom")) {
+			free(type);
+			return reply_integer(htable_bfcard(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// a sample as [timestamp, value]
+static char *reply_sample(TSSample *s) {
+	int len = 0, cap = 64;
+	char *res = dmalloc(cap * sizeof(char));
+	res = reply_append(res, &len, &cap, reply_header(2));
+	res = reply_append(res, &len, &cap, reply_integer(s->ts));
+	return reply_append(res, &len, &cap, reply_double(s->value));
+}
+
+// a timestamp in ms, * for the current time is parsed as -1 when auto is set
+static bool parse_timestamp(char *str, long long *t, bool auto_ts) {
+	if (auto_ts && strcmp(str, "*") == 0) {
+		*t = -1;
+		return true;
+	}
+	return parse_count(str, t);
+}
+
+static char *reply_err_timestamp() { return strdup("-ERR invalid timestamp\r\n"); }
+
+// ts.create key [retention ms]
+char *exec_tscreate(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 3) {
+		long long retention = 0;
+		if (cmd->argc == 3) {
+			if (strcmp(cmd->argv[1], "retention") != 0)
+				return reply_err_syntax();
+			if (!parse_count(cmd->argv[2], &retention))
+				return strdup("-ERR invalid retention\r\n");
+		}
+		if (!htable_tscreate(ht, cmd->argv[0], retention))
+			return strdup("-ERR item exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "1 or 3");
+}
+
+// ts.add key timestamp|* value
+char *exec_tsadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "timeseries")) {
+			free(type);
+			long long t;
+			double value;
+			if (!parse_timestamp(cmd->argv[1], &t, true))
+				return reply_err_timestamp();
+			if (!parse_double(cmd->argv[2], &value))
+				return reply_err_float();
+			if (!htable_tsadd(ht, cmd->argv[0], &t, value))
+				return strdup("-ERR timestamp must be newer than the last sample\r\n");
+			return reply_integer(t);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+char *exec_tsget(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "timeseries")) {
+			free(type);
+			TSSample last;
+			if (!htable_tsget(ht, cmd->argv[0], &last))
+				return strdup("*0\r\n");
+			return reply_sample(&last);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+static bool parse_agg(char *str, int *agg) {
+	char *names[] = {"avg", "sum", "min", "max", "count"};
+	for (int i = 0; i < 5; i++) {
+		if (strcmp(str, names[i]) == 0) {
+			*agg = TS_AGG_AVG + i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// ts.range key from|- to|+ [count n] [aggregation avg|sum|min|max|count bucket]
+char *exec_tsrange(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "timeseries")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		long long from = 0, to = LLONG_MAX, count = 0, bucket = 0;
+		int agg = TS_AGG_NONE;
+		if (strcmp(cmd->argv[1], "-") != 0 && !parse_timestamp(cmd->argv[1], &from, false))
+			return reply_err_timestamp();
+		if (strcmp(cmd->argv[2], "+") != 0 && !parse_timestamp(cmd->argv[2], &to, false))
+			return reply_err_timestamp();
+		for (int i = 3; i < cmd->argc; i++) {
+			if (strcmp(cmd->argv[i], "count") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &count))
+					return reply_err_intid();
+			} else if (strcmp(cmd->argv[i], "aggregation") == 0 && i + 2 < cmd->argc) {
+				if (!parse_agg(cmd->argv[i + 1], &agg))
+					return reply_err_syntax();
+				if (!parse_count(cmd->argv[i + 2], &bucket) || bucket == 0)
+					return strdup("-ERR bucket duration is out of range\r\n");
+				i += 2;
+			} else {
+				return reply_err_syntax();
+			}
+		}
+		int n;
+		TSSample *samples = htable_tsrange(ht, cmd->argv[0], from, to, count, agg, bucket, &n);
+		int len = 0, cap = 64;
+		char *res = dmalloc(cap * sizeof(char));
+		res = reply_append(res, &len, &cap, reply_header(n));
+		for (int i = 0; i < n; i++)
+			res = reply_append(res, &len, &cap, reply_sample(&samples[i]));
+		free(samples);
+		return res;
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+char *exec_tsinfo(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "timeseries")) {
+			free(type);
+			char **res = htable_tsinfo(ht, cmd->argv[0]);
+			char *reply = reply_array(res);
+			for (int i = 0; res != NULL && res[i] != NULL; i++)
+				free(res[i]);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+static char *reply_json_status(int status) {
+	switch (status) {
+	case JSON_ERR_SYNTAX:
+		return strdup("-ERR invalid json\r\n");
+	case JSON_ERR_PATH:
+		return strdup("-ERR invalid path\r\n");
+	case JSON_ERR_MISSING:
+		return strdup("-ERR path does not exist\r\n");
+	case JSON_ERR_TYPE:
+		return strdup("-ERR wrong json type at path\r\n");
+	case JSON_ERR_ROOT:
+		return strdup("-ERR new documents must be created at the root path\r\n");
+	case JSON_ERR_RANGE:
+		return strdup("-ERR index or result out of range\r\n");
+	case JSON_NOOP:
+		return reply_string(NULL);
+	default:
+		return reply_string("OK");
+	}
+}
+
+// json.set key path value [nx|xx]
+char *exec_jsonset(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3 || cmd->argc == 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			int cond = 0;
+			if (cmd->argc == 4 && strcmp(cmd->argv[3], "nx") == 0)
+				cond = JSON_SET_NX;
+			else if (cmd->argc == 4 && strcmp(cmd->argv[3], "xx") == 0)
+				cond = JSON_SET_XX;
+			else if (cmd->argc == 4)
+				return reply_err_syntax();
+			return reply_json_status(
+				htable_jsonset(ht, cmd->argv[0], cmd->argv[1], cmd->argv[2], cond));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3 or 4");
+}
+
+// json.get key [path ...], the root when no path is given
+char *exec_jsonget(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			char *root = "$", *json;
+			char **paths = cmd->argc > 1 ? cmd->argv + 1 : &root;
+			int n = cmd->argc > 1 ? cmd->argc - 1 : 1;
+			int status = htable_jsonget(ht, cmd->argv[0], paths, n, &json);
+			if (status != JSON_OK)
+				return reply_json_status(status);
+			char *res = reply_string(json);
+			free(json);
+			return res;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1+");
+}
+
+// json.del key [path]
+char *exec_jsondel(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			long long removed;
+			int status = htable_jsondel(ht, cmd->argv[0], cmd->argc == 2 ? cmd->argv[1] : "$",
+										&removed);
+			return status == JSON_OK ? reply_integer(removed) : reply_json_status(status);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1 or 2");
+}
+
+// json.type key [path]
+char *exec_jsontype(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			char *res;
+			int status = htable_jsontype(ht, cmd->argv[0], cmd->argc == 2 ? cmd->argv[1] : "$",
+										 &res);
+			if (status != JSON_OK)
+				return reply_json_status(status);
+			char *reply = reply_string(res);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1 or 2");
+}
+
+// json.numincrby key path number
+char *exec_jsonnumincrby(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			double by;
+			char *res;
+			if (!parse_double(cmd->argv[2], &by) || isinf(by))
+				return reply_err_float();
+			int status = htable_jsonnumincrby(ht, cmd->argv[0], cmd->argv[1], by, &res);
+			if (status != JSON_OK)
+				return reply_json_status(status);
+			char *reply = reply_string(res);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+// json.strappend key [path] string
+char *exec_jsonstrappend(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2 || cmd->argc == 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			long long len;
+			char *path = cmd->argc == 3 ? cmd->argv[1] : "$";
+			int status = htable_jsonappend(ht, cmd->argv[0], path, JSON_STRING,
+										   cmd->argv + cmd->argc - 1, 1, &len);
+			return status == JSON_OK ? reply_integer(len) : reply_json_status(status);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2 or 3");
+}
+
+// json.arrappend key path value [value ...]
+char *exec_jsonarrappend(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			long long len;
+			int status = htable_jsonappend(ht, cmd->argv[0], cmd->argv[1], JSON_ARRAY,
+										   cmd->argv + 2, cmd->argc - 2, &len);
+			return status == JSON_OK ? reply_integer(len) : reply_json_status(status);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// json.arrlen key [path]
+char *exec_jsonarrlen(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "json")) {
+			free(type);
+			long long len;
+			int status = htable_jsonarrlen(ht, cmd->argv[0], cmd->argc == 2 ? cmd->argv[1] : "$",
+										   &len);
+			if (status != JSON_OK)
+				return reply_json_status(status);
+			return len < 0 ? reply_string(NULL) : reply_integer(len);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1 or 2");
+}
+
+#define HNSW_MAX_EF 100000
+
+static char *reply_err_vdim() { return strdup("-ERR vector dimension mismatch\r\n"); }
+
+// shortest representation of x that reads back to the same float
+static char *reply_float(float x) {
+	char buf[32];
+	for (int prec = 1; prec <= 9; prec++) {
+		snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if (strtof(buf, NULL) == x)
+			break;
+	}
+	return reply_string(buf);
+}
+
+// parses values dim x1 .. xdim at argv[*i] and moves *i past it. Returns an
+// error reply, or NULL with the components in *values.
+static char *parse_vector(Command *cmd, int *i, float **values, int *dim) {
+	long long n;
+	if (strcmp(cmd->argv[*i], "values") != 0 || *i + 1 >= cmd->argc)
+		return reply_err_syntax();
+	if (!parse_count(cmd->argv[*i + 1], &n) || n == 0 || n > VEC_MAX_DIM)
+		return strdup("-ERR vector dimension is out of range\r\n");
+	if (*i + 2 + n > cmd->argc)
+		return reply_err_syntax();
+	*values = dmalloc(n * sizeof(float));
+	for (int k = 0; k < n; k++) {
+		double x;
+		if (!parse_double(cmd->argv[*i + 2 + k], &x) || fabs(x) > FLT_MAX) {
+			free(*values);
+			return reply_err_float();
+		}
+		(*values)[k] = x;
+	}
+	*dim = n;
+	*i += 2 + n;
+	return NULL;
+}
+
+static bool parse_metric(char *str, int *metric) {
+	char *names[] = {"l2", "cosine", "ip"};
+	for (int i = 0; i < 3; i++) {
+		if (strcmp(str, names[i]) == 0) {
+			*metric = VEC_L2 + i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// vadd key values dim x1 .. xdim element [noquant|q8] [metric l2|cosine|ip] [m n] [ef n],
+// the layout and graph options only apply when the set is created
+char *exec_vadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 4) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "vectorset")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		float *values;
+		int i = 1, dim, metric = VEC_COSINE, quant = VEC_F32;
+		long long m = HNSW_DEFAULT_M, ef = HNSW_DEFAULT_EF_CONSTRUCTION;
+		char *err = parse_vector(cmd, &i, &values, &dim);
+		if (err != NULL)
+			return err;
+		if (i == cmd->argc) {
+			free(values);
+			return reply_err_syntax();
+		}
+		char *name = cmd->argv[i++];
+		for (; i < cmd->argc && err == NULL; i++) {
+			if (strcmp(cmd->argv[i], "noquant") == 0) {
+				quant = VEC_F32;
+			} else if (strcmp(cmd->argv[i], "q8") == 0) {
+				quant = VEC_Q8;
+			} else if (strcmp(cmd->argv[i], "metric") == 0 && i + 1 < cmd->argc) {
+				if (!parse_metric(cmd->argv[++i], &metric))
+					err = reply_err_syntax();
+			} else if (strcmp(cmd->argv[i], "m") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &m) || m < 2 || m > HNSW_MAX_M)
+					err = strdup("-ERR m is out of range\r\n");
+			} else if (strcmp(cmd->argv[i], "ef") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &ef) || ef == 0 || ef > HNSW_MAX_EF)
+					err = strdup("-ERR ef is out of range\r\n");
+			} else {
+				err = reply_err_syntax();
+			}
+		}
+		int added = -1;
+		if (err == NULL)
+			added = htable_vadd(ht, cmd->argv[0], name, values, dim, metric, quant, m, ef);
+		free(values);
+		if (err != NULL)
+			return err;
+		return added < 0 ? reply_err_vdim() : reply_integer(added);
+	}
+	return reply_err_argc(cmd->argc, "4+");
+}
+
+// vrem key element
+char *exec_vrem(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "vectorset")) {
+			free(type);
+			return reply_integer(htable_vrem(ht, cmd->argv[0], cmd->argv[1]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+// vsim key ele element|values dim x1 .. xdim [withscores] [count k] [ef n] [truth],
+// scores are distances: squared L2, 1 - cosine similarity or the negated dot
+// product. truth scans the whole set instead of the graph.
+char *exec_vsim(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (!is_type(type, "vectorset")) {
+			free(type);
+			return reply_err_type();
+		}
+		free(type);
+		float *query = NULL;
+		char *ele = NULL, *err = NULL;
+		int i = 1, dim;
+		long long count = 10, ef = HNSW_DEFAULT_EF;
+		bool withscores = false, truth = false;
+		if (strcmp(cmd->argv[1], "ele") == 0) {
+			ele = cmd->argv[2];
+			i = 3;
+		} else {
+			err = parse_vector(cmd, &i, &query, &dim);
+			if (err != NULL)
+				return err;
+		}
+		for (; i < cmd->argc && err == NULL; i++) {
+			if (strcmp(cmd->argv[i], "withscores") == 0) {
+				withscores = true;
+			} else if (strcmp(cmd->argv[i], "truth") == 0) {
+				truth = true;
+			} else if (strcmp(cmd->argv[i], "count") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &count) || count == 0 || count > HNSW_MAX_EF)
+					err = reply_err_intid();
+			} else if (strcmp(cmd->argv[i], "ef") == 0 && i + 1 < cmd->argc) {
+				if (!parse_count(cmd->argv[++i], &ef) || ef == 0 || ef > HNSW_MAX_EF)
+					err = strdup("-ERR ef is out of range\r\n");
+			} else {
+				err = reply_err_syntax();
+			}
+		}
+		int n = 0;
+		VecMatch *res = NULL;
+		if (err == NULL && query != NULL && htable_vdim(ht, cmd->argv[0]) != 0 &&
+			htable_vdim(ht, cmd->argv[0]) != dim)
+			err = reply_err_vdim();
+		if (err == NULL)
+			res = htable_vsim(ht, cmd->argv[0], query, ele, count, ef, truth, &n);
+		free(query);
+		if (err != NULL)
+			return err;
+		if (n < 0)
+			return strdup("-ERR element not found\r\n");
+		int len = 0, cap = 64;
+		char *reply = dmalloc(cap * sizeof(char));
+		reply = reply_append(reply, &len, &cap, reply_header(withscores ? 2 * n : n));
+		for (int k = 0; k < n; k++) {
+			reply = reply_append(reply, &len, &cap, reply_string(res[k].name));
+			if (withscores)
+				reply = reply_append(reply, &len, &cap, reply_float(res[k].dist));
+		}
+		free(res);
+		return reply;
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+char *exec_vcard(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "vectorset")) {
+			free(type);
+			return reply_integer(htable_vcard(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+char *exec_vdim(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "vectorset")) {
+			free(type);
+			return reply_integer(htable_vdim(ht, cmd->argv[0]));
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// vemb key element, the stored components, normalized for cosine sets and
+// dequantized for q8 ones
+char *exec_vemb(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "vectorset")) {
+			free(type);
+			float *values = htable_vemb(ht, cmd->argv[0], cmd->argv[1]);
+			if (values == NULL)
+				return strdup("*0\r\n");
+			int dim = htable_vdim(ht, cmd->argv[0]), len = 0, cap = 64;
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(dim));
+			for (int i = 0; i < dim; i++)
+				reply = reply_append(reply, &len, &cap, reply_float(values[i]));
+			free(values);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2");
+}
+
+char *exec_vinfo(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "vectorset")) {
+			free(type);
+			char **res = htable_vinfo(ht, cmd->argv[0]);
+			char *reply = reply_array(res);
+			for (int i = 0; res != NULL && res[i] != NULL; i++)
+				free(res[i]);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+#define CMS_MAX_WIDTH (1 << 24)
+#define CMS_MAX_DEPTH 16
+#define TOPK_MAX_K 100000
+#define TOPK_MAX_WIDTH (1 << 24)
+#define TOPK_MAX_DEPTH 16
+
+// a reply of integers, as for cms.incrby and cms.query
+static char *reply_integers(long long *arr, int n) {
+	int len = 0, cap = 64;
+	char *res = dmalloc(cap * sizeof(char));
+	res = reply_append(res, &len, &cap, reply_header(n));
+	for (int i = 0; i < n; i++)
+		res = reply_append(res, &len, &cap, reply_integer(arr[i]));
+	return res;
+}
+
+// parses a sketch dimension between 1 and max
+static bool parse_dim(char *str, long long max, int *dim) {
+	long long x;
+	if (!parse_count(str, &x) || x == 0 || x > max)
+		return false;
+	*dim = x;
+	return true;
+}
+
+// parses the increments of item incr pairs starting at argv[1], which must fit
+// a 32 bit counter
+static long long *parse_increments(Command *cmd) {
+	int n = (cmd->argc - 1) / 2;
+	long long *incrs = dmalloc(n * sizeof(long long));
+	for (int i = 0; i < n; i++) {
+		if (!parse_count(cmd->argv[2 + 2 * i], &incrs[i]) || incrs[i] == 0 ||
+			incrs[i] > UINT32_MAX) {
+			free(incrs);
+			return NULL;
+		}
+	}
+	return incrs;
+}
+
+// cms.initbydim key width depth
+char *exec_cmsinitbydim(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		int width, depth;
+		if (!parse_dim(cmd->argv[1], CMS_MAX_WIDTH, &width))
+			return strdup("-ERR width is out of range\r\n");
+		if (!parse_dim(cmd->argv[2], CMS_MAX_DEPTH, &depth))
+			return strdup("-ERR depth is out of range\r\n");
+		if (!htable_cmsinit(ht, cmd->argv[0], width, depth))
+			return strdup("-ERR item exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+// cms.initbyprob key error probability, the estimates overcount by at most
+// error times the total count with the given probability of failure
+char *exec_cmsinitbyprob(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3) {
+		double error, prob;
+		if (!parse_double(cmd->argv[1], &error) || error <= 0 || error >= 1)
+			return strdup("-ERR error rate should be between 0 and 1\r\n");
+		if (!parse_double(cmd->argv[2], &prob) || prob <= 0 || prob >= 1)
+			return strdup("-ERR probability should be between 0 and 1\r\n");
+		double width = ceil(M_E / error), depth = ceil(-log(prob));
+		if (width > CMS_MAX_WIDTH)
+			return strdup("-ERR width is out of range\r\n");
+		if (depth > CMS_MAX_DEPTH)
+			return strdup("-ERR depth is out of range\r\n");
+		if (!htable_cmsinit(ht, cmd->argv[0], width, depth))
+			return strdup("-ERR item exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "3");
+}
+
+// cms.incrby key item incr [item incr ...], replies with the new estimates
+char *exec_cmsincrby(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc % 2 == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "cms")) {
+			free(type);
+			int n = (cmd->argc - 1) / 2;
+			long long *incrs = parse_increments(cmd);
+			if (incrs == NULL)
+				return reply_err_intid();
+			char **items = dmalloc(n * sizeof(char *));
+			for (int i = 0; i < n; i++)
+				items[i] = cmd->argv[1 + 2 * i];
+			long long *res = dmalloc(n * sizeof(long long));
+			htable_cmsincrby(ht, cmd->argv[0], items, incrs, n, res);
+			char *reply = reply_integers(res, n);
+			free(items);
+			free(incrs);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// cms.query key item [item ...]
+char *exec_cmsquery(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "cms")) {
+			free(type);
+			int n = cmd->argc - 1;
+			long long *res = dmalloc(n * sizeof(long long));
+			htable_cmsquery(ht, cmd->argv[0], cmd->argv + 1, n, res);
+			char *reply = reply_integers(res, n);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// cms.merge dst numkeys key [key ...] [weights w [w ...]]
+char *exec_cmsmerge(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3) {
+		long long nkeys;
+		if (!parse_count(cmd->argv[1], &nkeys) || nkeys == 0 || nkeys > cmd->argc - 2)
+			return reply_err_intid();
+		long long *weights = NULL;
+		if (cmd->argc == 2 * nkeys + 3 && strcmp(cmd->argv[nkeys + 2], "weights") == 0) {
+			weights = dmalloc(nkeys * sizeof(long long));
+			for (int i = 0; i < nkeys; i++) {
+				if (!parse_count(cmd->argv[nkeys + 3 + i], &weights[i]) ||
+					weights[i] > UINT32_MAX) {
+					free(weights);
+					return reply_err_intid();
+				}
+			}
+		} else if (cmd->argc != nkeys + 2) {
+			return reply_err_syntax();
+		}
+		if (!is_type_all(ht, cmd->argv, 1, "cms") ||
+			!is_type_all(ht, cmd->argv + 2, nkeys, "cms")) {
+			free(weights);
+			return reply_err_type();
+		}
+		int res = htable_cmsmerge(ht, cmd->argv[0], cmd->argv + 2, weights, nkeys);
+		free(weights);
+		if (res == 0)
+			return strdup("-ERR no such key\r\n");
+		if (res < 0)
+			return strdup("-ERR width or depth of the sketches differ\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// cms.info key
+char *exec_cmsinfo(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "cms")) {
+			free(type);
+			char **res = htable_cmsinfo(ht, cmd->argv[0]);
+			char *reply = reply_array(res);
+			for (int i = 0; res != NULL && res[i] != NULL; i++)
+				free(res[i]);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// topk.reserve key k [width depth decay]
+char *exec_topkreserve(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 2 || cmd->argc == 5) {
+		int k, width, depth = TOPK_DEFAULT_DEPTH;
+		double decay = TOPK_DEFAULT_DECAY;
+		if (!parse_dim(cmd->argv[1], TOPK_MAX_K, &k))
+			return strdup("-ERR k is out of range\r\n");
+		width = k * TOPK_WIDTH_PER_K;
+		if (cmd->argc == 5) {
+			if (!parse_dim(cmd->argv[2], TOPK_MAX_WIDTH, &width))
+				return strdup("-ERR width is out of range\r\n");
+			if (!parse_dim(cmd->argv[3], TOPK_MAX_DEPTH, &depth))
+				return strdup("-ERR depth is out of range\r\n");
+			if (!parse_double(cmd->argv[4], &decay) || decay <= 0 || decay > 1)
+				return strdup("-ERR decay should be in (0, 1]\r\n");
+		}
+		if (!htable_topkreserve(ht, cmd->argv[0], k, width, depth, decay))
+			return strdup("-ERR item exists\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "2 or 5");
+}
+
+// the items pushed out of the top k, nil where none was
+static char *reply_expelled(char **res, int n) {
+	int len = 0, cap = 64;
+	char *reply = dmalloc(cap * sizeof(char));
+	reply = reply_append(reply, &len, &cap, reply_header(n));
+	for (int i = 0; i < n; i++) {
+		reply = reply_append(reply, &len, &cap, reply_string(res[i]));
+		free(res[i]);
+	}
+	free(res);
+	return reply;
+}
+
+// topk.add key item [item ...]
+char *exec_topkadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "topk")) {
+			free(type);
+			int n = cmd->argc - 1;
+			return reply_expelled(htable_topkadd(ht, cmd->argv[0], cmd->argv + 1, NULL, n), n);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// topk.incrby key item incr [item incr ...]
+char *exec_topkincrby(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 3 && cmd->argc % 2 == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "topk")) {
+			free(type);
+			int n = (cmd->argc - 1) / 2;
+			long long *incrs = parse_increments(cmd);
+			if (incrs == NULL)
+				return reply_err_intid();
+			char **items = dmalloc(n * sizeof(char *));
+			for (int i = 0; i < n; i++)
+				items[i] = cmd->argv[1 + 2 * i];
+			char **res = htable_topkadd(ht, cmd->argv[0], items, incrs, n);
+			free(items);
+			free(incrs);
+			return reply_expelled(res, n);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3+");
+}
+
+// topk.query key item [item ...], 1 for the items in the top k
+char *exec_topkquery(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "topk")) {
+			free(type);
+			int n = cmd->argc - 1, len = 0, cap = 64;
+			int *res = dmalloc(n * sizeof(int));
+			htable_topkquery(ht, cmd->argv[0], cmd->argv + 1, n, res);
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(n));
+			for (int i = 0; i < n; i++)
+				reply = reply_append(reply, &len, &cap, reply_integer(res[i]));
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// topk.list key [withcount], by descending count
+char *exec_topklist(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1 || cmd->argc == 2) {
+		bool withcount = cmd->argc == 2;
+		if (withcount && strcmp(cmd->argv[1], "withcount") != 0)
+			return reply_err_syntax();
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "topk")) {
+			free(type);
+			int n, len = 0, cap = 64;
+			TopKItem *items = htable_topklist(ht, cmd->argv[0], &n);
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(withcount ? 2 * n : n));
+			for (int i = 0; i < n; i++) {
+				reply = reply_append(reply, &len, &cap, reply_string(items[i].item));
+				if (withcount)
+					reply = reply_append(reply, &len, &cap, reply_integer(items[i].count));
+			}
+			free(items);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1 or 2");
+}
+
+// topk.info key
+char *exec_topkinfo(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 1) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "topk")) {
+			free(type);
+			char **res = htable_topkinfo(ht, cmd->argv[0]);
+			char *reply = reply_array(res);
+			for (int i = 0; res != NULL && res[i] != NULL; i++)
+				free(res[i]);
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "1");
+}
+
+// meters per unit of a distance
+static bool parse_unit(char *str, double *unit) {
+	if (strcmp(str, "m") == 0)
+		*unit = 1;
+	else if (strcmp(str, "km") == 0)
+		*unit = 1000;
+	else if (strcmp(str, "ft") == 0)
+		*unit = 0.3048;
+	else if (strcmp(str, "mi") == 0)
+		*unit = 1609.34;
+	else
+		return false;
+	return true;
+}
+
+static char *reply_err_unit() {
+	return strdup("-ERR unsupported unit provided. please use m, km, ft, mi\r\n");
+}
+
+static char *reply_err_lonlat(double lon, double lat) {
+	char buf[96];
+	snprintf(buf, sizeof(buf), "-ERR invalid longitude,latitude pair %f,%f\r\n", lon, lat);
+	return strdup(buf);
+}
+
+// distances are rounded to 0.1 mm like redis does
+static char *reply_dist(double dist) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.4f", dist);
+	return reply_string(buf);
+}
+
+static char *reply_lonlat(double lon, double lat) {
+	int len = 0, cap = 64;
+	char *res = dmalloc(cap * sizeof(char));
+	res = reply_append(res, &len, &cap, reply_header(2));
+	res = reply_append(res, &len, &cap, reply_double(lon));
+	return reply_append(res, &len, &cap, reply_double(lat));
+}
+
+// geoadd key [nx|xx] [ch] longitude latitude member [longitude latitude member ...]
+char *exec_geoadd(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 4) {
+		int i = 1, cond = 0;
+		bool ch = false;
+		for (; i < cmd->argc; i++) {
+			if (strcmp(cmd->argv[i], "nx") == 0 && cond != GEO_ADD_XX)
+				cond = GEO_ADD_NX;
+			else if (strcmp(cmd->argv[i], "xx") == 0 && cond != GEO_ADD_NX)
+				cond = GEO_ADD_XX;
+			else if (strcmp(cmd->argv[i], "ch") == 0)
+				ch = true;
+			else if (strcmp(cmd->argv[i], "nx") == 0 || strcmp(cmd->argv[i], "xx") == 0)
+				return strdup("-ERR xx and nx options at the same time are not compatible\r\n");
+			else
+				break;
+		}
+		if (cmd->argc - i == 0 || (cmd->argc - i) % 3 != 0)
+			return reply_err_syntax();
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			int n = (cmd->argc - i) / 3;
+			double *coords = dmalloc(2 * n * sizeof(double));
+			char **members = dmalloc(n * sizeof(char *));
+			char *err = NULL;
+			for (int j = 0; j < n && err == NULL; j++) {
+				double *lon = &coords[2 * j], *lat = &coords[2 * j + 1];
+				if (!parse_double(cmd->argv[i + 3 * j], lon) ||
+					!parse_double(cmd->argv[i + 3 * j + 1], lat))
+					err = reply_err_float();
+				else if (!geo_valid(*lon, *lat))
+					err = reply_err_lonlat(*lon, *lat);
+				members[j] = cmd->argv[i + 3 * j + 2];
+			}
+			if (err == NULL)
+				err = reply_integer(htable_geoadd(ht, cmd->argv[0], coords, members, n, cond, ch));
+			free(coords);
+			free(members);
+			return err;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "4+");
+}
+
+// geopos key member [member ...], nil for missing members
+char *exec_geopos(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 2) {
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			int len = 0, cap = 64;
+			char *res = dmalloc(cap * sizeof(char));
+			res = reply_append(res, &len, &cap, reply_header(cmd->argc - 1));
+			for (int i = 1; i < cmd->argc; i++) {
+				double lon, lat;
+				char *tmp = htable_geopos(ht, cmd->argv[0], cmd->argv[i], &lon, &lat)
+								? reply_lonlat(lon, lat)
+								: strdup("*-1\r\n");
+				res = reply_append(res, &len, &cap, tmp);
+			}
+			return res;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "2+");
+}
+
+// geodist key member1 member2 [m|km|ft|mi]
+char *exec_geodist(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 3 || cmd->argc == 4) {
+		double unit = 1;
+		if (cmd->argc == 4 && !parse_unit(cmd->argv[3], &unit))
+			return reply_err_unit();
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			double lon1, lat1, lon2, lat2;
+			if (!htable_geopos(ht, cmd->argv[0], cmd->argv[1], &lon1, &lat1) ||
+				!htable_geopos(ht, cmd->argv[0], cmd->argv[2], &lon2, &lat2))
+				return reply_string(NULL);
+			return reply_dist(geo_dist(lon1, lat1, lon2, lat2) / unit);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "3 or 4");
+}
+
+// parses a distance followed by its unit at argv[*i], moving *i past them
+static bool parse_distance(Command *cmd, int *i, double *meters, double *unit) {
+	if (*i + 1 >= cmd->argc || !parse_double(cmd->argv[*i], meters) || *meters < 0)
+		return false;
+	if (!parse_unit(cmd->argv[*i + 1], unit))
+		return false;
+	*meters *= *unit;
+	*i += 2;
+	return true;
+}
+
+// geosearch key frommember member|fromlonlat longitude latitude
+// byradius radius unit|bybox width height unit [asc|desc] [count n [any]]
+// [withcoord] [withdist] [withhash]
+char *exec_geosearch(HashTable *ht, Command *cmd) {
+	if (cmd->argc >= 5) {
+		GeoShape shape = {0};
+		char *member = NULL;
+		bool from = false, by = false, any = false, withcoord = false, withdist = false;
+		bool withhash = false;
+		double unit = 1;
+		long long count = 0;
+		int sort = GEO_SORT_NONE;
+		for (int i = 1; i < cmd->argc;) {
+			char *arg = cmd->argv[i++];
+			if (strcmp(arg, "frommember") == 0 && !from && i < cmd->argc) {
+				member = cmd->argv[i++];
+				from = true;
+			} else if (strcmp(arg, "fromlonlat") == 0 && !from && i + 1 < cmd->argc) {
+				if (!parse_double(cmd->argv[i], &shape.lon) ||
+					!parse_double(cmd->argv[i + 1], &shape.lat))
+					return reply_err_float();
+				if (!geo_valid(shape.lon, shape.lat))
+					return reply_err_lonlat(shape.lon, shape.lat);
+				i += 2;
+				from = true;
+			} else if (strcmp(arg, "byradius") == 0 && !by) {
+				if (!parse_distance(cmd, &i, &shape.radius, &unit))
+					return reply_err_syntax();
+				by = true;
+			} else if (strcmp(arg, "bybox") == 0 && !by && i < cmd->argc) {
+				if (!parse_double(cmd->argv[i++], &shape.width) || shape.width < 0 ||
+					!parse_distance(cmd, &i, &shape.height, &unit))
+					return reply_err_syntax();
+				shape.width *= unit;
+				shape.box = by = true;
+			} else if (strcmp(arg, "asc") == 0) {
+				sort = GEO_SORT_ASC;
+			} else if (strcmp(arg, "desc") == 0) {
+				sort = GEO_SORT_DESC;
+			} else if (strcmp(arg, "count") == 0 && i < cmd->argc) {
+				if (!parse_count(cmd->argv[i++], &count) || count == 0 || count > INT_MAX)
+					return reply_err_intid();
+				if (i < cmd->argc && strcmp(cmd->argv[i], "any") == 0) {
+					any = true;
+					i++;
+				}
+			} else if (strcmp(arg, "withcoord") == 0) {
+				withcoord = true;
+			} else if (strcmp(arg, "withdist") == 0) {
+				withdist = true;
+			} else if (strcmp(arg, "withhash") == 0) {
+				withhash = true;
+			} else {
+				return reply_err_syntax();
+			}
+		}
+		if (!from || !by)
+			return reply_err_syntax();
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "zset")) {
+			free(type);
+			if (member != NULL && !htable_geopos(ht, cmd->argv[0], member, &shape.lon, &shape.lat))
+				return htable_exists(ht, cmd->argv[0])
+						   ? strdup("-ERR could not decode requested zset member\r\n")
+						   : strdup("*0\r\n");
+			int n, len = 0, cap = 64, fields = 1 + withdist + withhash + withcoord;
+			GeoMatch *res = htable_geosearch(ht, cmd->argv[0], &shape, sort, count, any, &n);
+			char *reply = dmalloc(cap * sizeof(char));
+			reply = reply_append(reply, &len, &cap, reply_header(n));
+			for (int i = 0; i < n; i++) {
+				if (fields > 1)
+					reply = reply_append(reply, &len, &cap, reply_header(fields));
+				reply = reply_append(reply, &len, &cap, reply_string(res[i].member));
+				if (withdist)
+					reply = reply_append(reply, &len, &cap, reply_dist(res[i].dist / unit));
+				if (withhash)
+					reply = reply_append(reply, &len, &cap, reply_integer(res[i].hash));
+				if (withcoord)
+					reply = reply_append(reply, &len, &cap, reply_lonlat(res[i].lon, res[i].lat));
+			}
+			free(res);
+			return reply;
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "5+");
+}
+
+// microseconds rounded up to whole seconds
+static long long us_to_sec(long long us) { return us < 0 ? us : (us + 999999) / 1000000; }
+
+// cl.throttle key max_burst count period [quantity], allows count requests per
+// period seconds plus bursts of max_burst and replies with whether the
+// request was limited, the limit, the requests remaining, and the seconds
+// until a retry and until the limit is full, as redis-cell does
+char *exec_throttle(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 4 || cmd->argc == 5) {
+		long long burst, count, period, quantity = 1;
+		if (!parse_count(cmd->argv[1], &burst) || !parse_count(cmd->argv[2], &count) ||
+			!parse_count(cmd->argv[3], &period) ||
+			(cmd->argc == 5 && !parse_count(cmd->argv[4], &quantity)))
+			return reply_err_intid();
+		if (count == 0 || period == 0 || period > RATE_MAX_US / 1000000)
+			return reply_err_intid();
+		char *type = htable_type(ht, cmd->argv[0]);
+		if (is_type(type, "ratelimit")) {
+			free(type);
+			RateLimitResult r;
+			htable_throttle(ht, cmd->argv[0], burst, count, period * 1000000, quantity, &r);
+			long long res[] = {r.limited, r.limit, r.remaining, us_to_sec(r.retry_after),
+							   us_to_sec(r.reset_after)};
+			return reply_integers(res, 5);
+		}
+		free(type);
+		return reply_err_type();
+	}
+	return reply_err_argc(cmd->argc, "4 or 5");
+}
+
+char *exec_save(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 0) {
+		if (snapshot_running())
+			return strdup("-ERR background save already in progress\r\n");
+		if (!snapshot_save_now(ht))
+			return strdup("-ERR failed to write the snapshot\r\n");
+		return reply_string("OK");
+	}
+	return reply_err_argc(cmd->argc, "0");
+}
+
+char *exec_bgsave(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 0) {
+		if (aof_rewriting())
+			return strdup("-ERR append only log rewrite in progress\r\n");
+		int res = snapshot_bgsave(ht);
+		if (res == 0)
+			return strdup("-ERR background save already in progress\r\n");
+		if (res < 0)
+			return strdup("-ERR failed to start the background save\r\n");
+		return reply_string("Background saving started");
+	}
+	return reply_err_argc(cmd->argc, "0");
+}
+
+char *exec_lastsave(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 0)
+		return reply_integer(snapshot_lastsave());
+	return reply_err_argc(cmd->argc, "0");
+}
+
+// info [persistence]
+char *exec_info(HashTable *ht, Command *cmd) {
+	if (cmd->argc <= 1) {
+		if (cmd->argc == 1 && strcmp(cmd->argv[0], "persistence") != 0)
+			return strdup("*0\r\n");
+		char **snap = snapshot_info(), **aof = aof_info();
+		int n = 0, m = 0;
+		while (snap[n] != NULL)
+			n++;
+		while (aof[m] != NULL)
+			m++;
+		char **res = dmalloc((n + m + 1) * sizeof(char *));
+		memcpy(res, snap, n * sizeof(char *));
+		memcpy(res + n, aof, (m + 1) * sizeof(char *));
+		char *reply = reply_array(res);
+		for (int i = 0; res[i] != NULL; i++)
+			free(res[i]);
+		free(res);
+		free(snap);
+		free(aof);
+		return reply;
+	}
+	return reply_err_argc(cmd->argc, "0 or 1");
+}
+
+char *exec_bgrewriteaof(HashTable *ht, Command *cmd) {
+	if (cmd->argc == 0) {
+		if (!aof_enabled())
+			return strdup("-ERR append only log is off\r\n");
+		int res = aof_rewrite(ht);
+		if (res == 0)
+			return strdup("-ERR background save or rewrite already in progress\r\n");
+		if (res < 0)
+			return strdup("-ERR failed to start the rewrite\r\n");
+		return reply_string("Background append only file rewriting started");
+	}
+	return reply_err_argc(cmd->argc, "0");
+}
+
 // char *exec_(HashTable *ht, Command *cmd) {
 // if (cmd->argc) {
 // char *type = htable_type(ht, cmd->argv[0]);
@@ -634,17 +3057,45 @@ char *exec_shutdown(HashTable *ht, Command *cmd) { return strdup("x"); }
 char *exec_noop(HashTable *ht, Command *cmd) { return strdup(""); }
 
 static char *(*fns[])(HashTable *, Command *) = {
-	&exec_del,	 &exec_exists,	 &exec_type,	&exec_set,		 &exec_get,		 &exec_mset,
-	&exec_mget,	 &exec_incr,	 &exec_decr,	&exec_incrby,	 &exec_decrby,	 &exec_strlen,
-	&exec_hset,	 &exec_hget,	 &exec_hdel,	&exec_hgetall,	 &exec_hexists,	 &exec_hkeys,
-	&exec_hvals, &exec_hmget,	 &exec_hlen,	&exec_lpush,	 &exec_lpop,	 &exec_rpush,
-	&exec_rpop,	 &exec_llen,	 &exec_lindex,	&exec_lrange,	 &exec_lset,	 &exec_lrem,
-	&exec_lpos,	 &exec_sadd,	 &exec_srem,	&exec_sismember, &exec_smembers, &exec_smismember,
-	&exec_quit,	 &exec_shutdown, &exec_unknown, &exec_noop};
+	&exec_del,			&exec_exists,		 &exec_type,		  &exec_set,
+	&exec_get,			&exec_mset,			 &exec_mget,		  &exec_incr,
+	&exec_decr,			&exec_incrby,		 &exec_decrby,		  &exec_strlen,
+	&exec_hset,			&exec_hget,			 &exec_hdel,		  &exec_hgetall,
+	&exec_hexists,		&exec_hkeys,		 &exec_hvals,		  &exec_hmget,
+	&exec_hlen,			&exec_lpush,		 &exec_lpop,		  &exec_rpush,
+	&exec_rpop,			&exec_llen,			 &exec_lindex,		  &exec_lrange,
+	&exec_lset,			&exec_lrem,			 &exec_lpos,		  &exec_sadd,
+	&exec_srem,			&exec_sismember,	 &exec_smembers,	  &exec_smismember,
+	&exec_sinter,		&exec_sinterstore,	 &exec_sintercard,	  &exec_sunion,
+	&exec_sunionstore,	&exec_sdiff,		 &exec_sdiffstore,	  &exec_lmove,
+	&exec_blpop,		&exec_brpop,		 &exec_blmove,		  &exec_zadd,
+	&exec_zrem,			&exec_zscore,		 &exec_zincrby,		  &exec_zcard,
+	&exec_zrank,		&exec_zrevrank,		 &exec_zrange,		  &exec_zrangebyscore,
+	&exec_pfadd,		&exec_pfcount,		 &exec_pfmerge,		  &exec_setbit,
+	&exec_getbit,		&exec_bitcount,		 &exec_bitop,		  &exec_bitpos,
+	&exec_rbadd,		&exec_rbrem,		 &exec_rbismember,	  &exec_rbcard,
+	&exec_rbmembers,	&exec_rbop,			 &exec_xadd,		  &exec_xlen,
+	&exec_xrange,		&exec_xtrim,		 &exec_xread,		  &exec_xgroup,
+	&exec_xreadgroup,	&exec_xack,			 &exec_bfreserve,	  &exec_bfadd,
+	&exec_bfmadd,		&exec_bfexists,		 &exec_bfmexists,	  &exec_bfcard,
+	&exec_tscreate,		&exec_tsadd,		 &exec_tsget,		  &exec_tsrange,
+	&exec_tsinfo,		&exec_jsonset,		 &exec_jsonget,		  &exec_jsondel,
+	&exec_jsontype,		&exec_jsonnumincrby, &exec_jsonstrappend, &exec_jsonarrappend,
+	&exec_jsonarrlen,	&exec_vadd,			 &exec_vrem,		  &exec_vsim,
+	&exec_vcard,		&exec_vdim,			 &exec_vemb,		  &exec_vinfo,
+	&exec_cmsinitbydim, &exec_cmsinitbyprob, &exec_cmsincrby,	  &exec_cmsquery,
+	&exec_cmsmerge,		&exec_cmsinfo,		 &exec_topkreserve,	  &exec_topkadd,
+	&exec_topkincrby,	&exec_topkquery,	 &exec_topklist,	  &exec_topkinfo,
+	&exec_geoadd,		&exec_geopos,		 &exec_geodist,		  &exec_geosearch,
+	&exec_throttle,		&exec_save,			 &exec_bgsave,		  &exec_lastsave,
+	&exec_info,			&exec_bgrewriteaof,	 &exec_quit,		  &exec_shutdown,
+	&exec_unknown,		&exec_noop};
 
 char *interpret(HashTable *ht, Command *cmd) {
 	char *res;
+	snapshot_touch(ht, cmd);
 	res = fns[cmd->type](ht, cmd);
+	aof_feed(cmd, res);
 	command_free(cmd);
 	return res;
 }
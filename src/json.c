@@ -0,0 +1,680 @@
+#include "common.h"
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// JSON documents are parsed once into a tree of JsonNodes and edited in place,
+// so a write at a path touches only the nodes along it and a read serializes
+// only the fragment it returns. Objects keep their keys in insertion order and
+// add an open addressing index once they hold JSON_INDEX_MIN keys, so each
+// step of a path is a hash probe rather than a scan.
+//
+// Paths use the legacy dot notation with an optional $ root: $, ., .a.b[0],
+// a["b c"][-1]. Wildcards, recursive descent and filters are not supported.
+
+#define JSON_MAX_DEPTH 128
+#define JSON_INDEX_MIN 16
+
+typedef struct JsonBuf {
+	char *buf;
+	int len;
+	int cap;
+} JsonBuf;
+
+// a step is a key, or an index when key is NULL
+typedef struct JsonStep {
+	char *key;
+	long long index;
+} JsonStep;
+
+typedef struct JsonPath {
+	int n;
+	JsonStep *steps;
+} JsonPath;
+
+static JsonNode *node_new(int type) {
+	JsonNode *node = calloc(1, sizeof(JsonNode));
+	node->type = type;
+	return node;
+}
+
+void json_free(JsonNode *node) {
+	if (node == NULL)
+		return;
+	if (node->type == JSON_STRING)
+		free(node->str);
+	if (node->type == JSON_ARRAY || node->type == JSON_OBJECT) {
+		for (int i = 0; i < node->n; i++) {
+			json_free(node->items[i]);
+			if (node->keys != NULL)
+				free(node->keys[i]);
+		}
+		free(node->items);
+		free(node->keys);
+		free(node->index);
+	}
+	free(node);
+}
+
+static void index_put(JsonNode *obj, int pos) {
+	int mask = obj->nindex - 1;
+	int j = murmur64a(obj->keys[pos], strlen(obj->keys[pos]), 0) & mask;
+	while (obj->index[j] != 0)
+		j = (j + 1) & mask;
+	obj->index[j] = pos + 1;
+}
+
+// the index is kept at most half full, small objects go without one
+static void index_build(JsonNode *obj) {
+	free(obj->index);
+	obj->index = NULL;
+	obj->nindex = 0;
+	if (obj->n < JSON_INDEX_MIN)
+		return;
+	obj->nindex = 2 * JSON_INDEX_MIN;
+	while (obj->nindex < obj->n * 2)
+		obj->nindex *= 2;
+	obj->index = calloc(obj->nindex, sizeof(int));
+	for (int i = 0; i < obj->n; i++)
+		index_put(obj, i);
+}
+
+static int obj_find(JsonNode *obj, const char *key) {
+	if (obj->index == NULL) {
+		for (int i = 0; i < obj->n; i++)
+			if (strcmp(obj->keys[i], key) == 0)
+				return i;
+		return -1;
+	}
+	int mask = obj->nindex - 1;
+	int j = murmur64a(key, strlen(key), 0) & mask;
+	for (; obj->index[j] != 0; j = (j + 1) & mask)
+		if (strcmp(obj->keys[obj->index[j] - 1], key) == 0)
+			return obj->index[j] - 1;
+	return -1;
+}
+
+static void node_reserve(JsonNode *node, int n) {
+	if (node->n + n <= node->cap)
+		return;
+	while (node->n + n > node->cap)
+		node->cap = node->cap == 0 ? 4 : node->cap * 2;
+	node->items = drealloc(node->items, node->cap * sizeof(JsonNode *));
+	if (node->type == JSON_OBJECT)
+		node->keys = drealloc(node->keys, node->cap * sizeof(char *));
+}
+
+static void arr_push(JsonNode *arr, JsonNode *value) {
+	node_reserve(arr, 1);
+	arr->items[arr->n++] = value;
+}
+
+// takes ownership of key and value, replacing the value of an existing key
+static void obj_put(JsonNode *obj, char *key, JsonNode *value) {
+	int pos = obj_find(obj, key);
+	if (pos >= 0) {
+		free(key);
+		json_free(obj->items[pos]);
+		obj->items[pos] = value;
+		return;
+	}
+	node_reserve(obj, 1);
+	obj->keys[obj->n] = key;
+	obj->items[obj->n++] = value;
+	if (obj->index != NULL && obj->n * 2 <= obj->nindex)
+		index_put(obj, obj->n - 1);
+	else if (obj->n >= JSON_INDEX_MIN)
+		index_build(obj);
+}
+
+static void node_remove(JsonNode *node, int pos) {
+	json_free(node->items[pos]);
+	memmove(node->items + pos, node->items + pos + 1, (node->n - pos - 1) * sizeof(JsonNode *));
+	if (node->type == JSON_OBJECT) {
+		free(node->keys[pos]);
+		memmove(node->keys + pos, node->keys + pos + 1, (node->n - pos - 1) * sizeof(char *));
+	}
+	node->n--;
+	if (node->type == JSON_OBJECT)
+		index_build(node);
+}
+
+static void skip_ws(const char **p) {
+	while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')
+		(*p)++;
+}
+
+static void buf_put(JsonBuf *b, const char *s, int n) {
+	if (b->len + n + 1 > b->cap) {
+		while (b->len + n + 1 > b->cap)
+			b->cap = b->cap == 0 ? 64 : b->cap * 2;
+		b->buf = drealloc(b->buf, b->cap);
+	}
+	memcpy(b->buf + b->len, s, n);
+	b->len += n;
+	b->buf[b->len] = '\0';
+}
+
+static int hex4(const char *s) {
+	int x = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = s[i];
+		if (!isxdigit((unsigned char)c))
+			return -1;
+		x = x * 16 + (isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10);
+	}
+	return x;
+}
+
+static void put_utf8(JsonBuf *b, uint32_t cp) {
+	char out[4];
+	int n;
+	if (cp < 0x80) {
+		out[0] = cp;
+		n = 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xc0 | cp >> 6;
+		out[1] = 0x80 | (cp & 0x3f);
+		n = 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xe0 | cp >> 12;
+		out[1] = 0x80 | (cp >> 6 & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		n = 3;
+	} else {
+		out[0] = 0xf0 | cp >> 18;
+		out[1] = 0x80 | (cp >> 12 & 0x3f);
+		out[2] = 0x80 | (cp >> 6 & 0x3f);
+		out[3] = 0x80 | (cp & 0x3f);
+		n = 4;
+	}
+	buf_put(b, out, n);
+}
+
+// parses the string at *p, which starts at its opening quote. Returns NULL
+// on a syntax error.
+static char *parse_str(const char **p, int *len) {
+	JsonBuf b = {NULL, 0, 0};
+	buf_put(&b, "", 0);
+	const char *s = *p + 1;
+	bool ok = true;
+	while (*s != '"') {
+		if ((unsigned char)*s < 0x20) {
+			ok = false;
+			break;
+		}
+		if (*s != '\\') {
+			const char *run = s;
+			while (*s != '"' && *s != '\\' && (unsigned char)*s >= 0x20)
+				s++;
+			buf_put(&b, run, s - run);
+			continue;
+		}
+		s++;
+		char c = *s++;
+		const char *esc = strchr("\"\\/bfnrt", c);
+		if (c != '\0' && esc != NULL) {
+			buf_put(&b, &"\"\\/\b\f\n\r\t"[esc - "\"\\/bfnrt"], 1);
+			continue;
+		}
+		int cp = c == 'u' ? hex4(s) : -1, lo = -1;
+		if (cp >= 0xd800 && cp < 0xdc00 && s[4] == '\\' && s[5] == 'u')
+			lo = hex4(s + 6);
+		// a high surrogate needs a low one after it, which may not stand alone
+		if (cp >= 0xd800 && cp < 0xdc00 && lo >= 0xdc00 && lo < 0xe000) {
+			cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+			s += 6;
+		} else if (cp < 0 || (cp >= 0xd800 && cp < 0xe000)) {
+			ok = false;
+			break;
+		}
+		s += 4;
+		put_utf8(&b, cp);
+	}
+	if (!ok) {
+		free(b.buf);
+		return NULL;
+	}
+	*p = s + 1;
+	*len = b.len;
+	return b.buf;
+}
+
+static JsonNode *parse_number(const char **p) {
+	const char *s = *p, *q = s;
+	bool integral = true;
+	if (*q == '-')
+		q++;
+	if (!isdigit((unsigned char)*q))
+		return NULL;
+	if (*q == '0')
+		q++;
+	else
+		while (isdigit((unsigned char)*q))
+			q++;
+	if (*q == '.') {
+		integral = false;
+		if (!isdigit((unsigned char)*++q))
+			return NULL;
+		while (isdigit((unsigned char)*q))
+			q++;
+	}
+	if (*q == 'e' || *q == 'E') {
+		integral = false;
+		q++;
+		if (*q == '+' || *q == '-')
+			q++;
+		if (!isdigit((unsigned char)*q))
+			return NULL;
+		while (isdigit((unsigned char)*q))
+			q++;
+	}
+	JsonNode *node = node_new(JSON_INT);
+	errno = 0;
+	if (integral)
+		node->i = strtoll(s, NULL, 10);
+	if (!integral || errno == ERANGE) {
+		node->type = JSON_DOUBLE;
+		node->d = strtod(s, NULL);
+		if (isinf(node->d)) {
+			free(node);
+			return NULL;
+		}
+	}
+	*p = q;
+	return node;
+}
+
+static JsonNode *parse_value(const char **p, int depth);
+
+// parses the members of an array or object, *p is past the opening bracket
+static JsonNode *parse_container(const char **p, int type, int depth) {
+	JsonNode *node = node_new(type);
+	char close = type == JSON_ARRAY ? ']' : '}';
+	skip_ws(p);
+	if (**p == close) {
+		(*p)++;
+		return node;
+	}
+	while (true) {
+		char *key = NULL;
+		int len;
+		skip_ws(p);
+		if (type == JSON_OBJECT) {
+			if (**p != '"' || (key = parse_str(p, &len)) == NULL)
+				break;
+			skip_ws(p);
+			if (*(*p)++ != ':') {
+				free(key);
+				break;
+			}
+		}
+		JsonNode *value = parse_value(p, depth + 1);
+		if (value == NULL) {
+			free(key);
+			break;
+		}
+		if (type == JSON_OBJECT)
+			obj_put(node, key, value);
+		else
+			arr_push(node, value);
+		skip_ws(p);
+		if (**p == close) {
+			(*p)++;
+			return node;
+		}
+		if (*(*p)++ != ',')
+			break;
+	}
+	json_free(node);
+	return NULL;
+}
+
+static JsonNode *parse_value(const char **p, int depth) {
+	if (depth > JSON_MAX_DEPTH)
+		return NULL;
+	skip_ws(p);
+	char c = **p;
+	if (c == '{' || c == '[') {
+		(*p)++;
+		return parse_container(p, c == '{' ? JSON_OBJECT : JSON_ARRAY, depth);
+	}
+	if (c == '"') {
+		int len;
+		char *str = parse_str(p, &len);
+		if (str == NULL)
+			return NULL;
+		JsonNode *node = node_new(JSON_STRING);
+		node->str = str;
+		node->n = len;
+		return node;
+	}
+	if (c == '-' || isdigit((unsigned char)c))
+		return parse_number(p);
+	const char *words[] = {"null", "false", "true"};
+	int types[] = {JSON_NULL, JSON_FALSE, JSON_TRUE};
+	for (int i = 0; i < 3; i++) {
+		if (strncmp(*p, words[i], strlen(words[i])) == 0) {
+			*p += strlen(words[i]);
+			return node_new(types[i]);
+		}
+	}
+	return NULL;
+}
+
+// NULL if s is not a single JSON value
+JsonNode *json_parse(const char *s) {
+	JsonNode *node = parse_value(&s, 0);
+	if (node == NULL)
+		return NULL;
+	skip_ws(&s);
+	if (*s != '\0') {
+		json_free(node);
+		return NULL;
+	}
+	return node;
+}
+
+static void dump_str(JsonBuf *b, const char *s, int n) {
+	buf_put(b, "\"", 1);
+	int run = 0;
+	for (int i = 0; i < n; i++) {
+		unsigned char c = s[i];
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		buf_put(b, s + run, i - run);
+		run = i + 1;
+		char esc[8];
+		const char *named = strchr("\"\\\b\f\n\r\t", c);
+		if (c != '\0' && named != NULL)
+			sprintf(esc, "\\%c", "\"\\bfnrt"[named - "\"\\\b\f\n\r\t"]);
+		else
+			sprintf(esc, "\\u%04x", c);
+		buf_put(b, esc, strlen(esc));
+	}
+	buf_put(b, s + run, n - run);
+	buf_put(b, "\"", 1);
+}
+
+static void dump_node(JsonBuf *b, JsonNode *node) {
+	char num[32];
+	switch (node->type) {
+	case JSON_NULL:
+		buf_put(b, "null", 4);
+		break;
+	case JSON_FALSE:
+		buf_put(b, "false", 5);
+		break;
+	case JSON_TRUE:
+		buf_put(b, "true", 4);
+		break;
+	case JSON_INT:
+		buf_put(b, num, sprintf(num, "%lld", node->i));
+		break;
+	case JSON_DOUBLE: {
+		char *tmp = dtostr(node->d);
+		buf_put(b, tmp, strlen(tmp));
+		free(tmp);
+		break;
+	}
+	case JSON_STRING:
+		dump_str(b, node->str, node->n);
+		break;
+	case JSON_ARRAY:
+	case JSON_OBJECT:
+		buf_put(b, node->type == JSON_ARRAY ? "[" : "{", 1);
+		for (int i = 0; i < node->n; i++) {
+			if (i > 0)
+				buf_put(b, ",", 1);
+			if (node->type == JSON_OBJECT) {
+				dump_str(b, node->keys[i], strlen(node->keys[i]));
+				buf_put(b, ":", 1);
+			}
+			dump_node(b, node->items[i]);
+		}
+		buf_put(b, node->type == JSON_ARRAY ? "]" : "}", 1);
+		break;
+	}
+}
+
+// compact serialization of node and its children
+char *json_dump(JsonNode *node) {
+	JsonBuf b = {NULL, 0, 0};
+	dump_node(&b, node);
+	return b.buf;
+}
+
+char *json_type(JsonNode *node) {
+	char *names[] = {"null",   "boolean", "boolean", "integer",
+					 "number", "string",  "array",   "object"};
+	return strdup(names[node->type]);
+}
+
+static void path_free(JsonPath *path) {
+	for (int i = 0; i < path->n; i++)
+		free(path->steps[i].key);
+	free(path->steps);
+	free(path);
+}
+
+static void path_push(JsonPath *path, char *key, long long index) {
+	path->steps = drealloc(path->steps, (path->n + 1) * sizeof(JsonStep));
+	path->steps[path->n].key = key;
+	path->steps[path->n++].index = index;
+}
+
+// NULL if the path is malformed
+static JsonPath *path_parse(const char *s) {
+	JsonPath *path = calloc(1, sizeof(JsonPath));
+	if (*s == '$' || (s[0] == '.' && s[1] == '\0'))
+		s++;
+	// a leading key may go without its dot
+	bool bare = *s != '.' && *s != '[' && *s != '\0';
+	while (*s != '\0') {
+		if (*s == '.' || bare) {
+			s += !bare;
+			bare = false;
+			int n = strcspn(s, ".[");
+			if (n == 0)
+				break;
+			path_push(path, strndup(s, n), 0);
+			s += n;
+		} else if (*s == '[' && (s[1] == '"' || s[1] == '\'')) {
+			const char *end = strchr(s + 2, s[1]);
+			if (end == NULL || end[1] != ']')
+				break;
+			path_push(path, strndup(s + 2, end - s - 2), 0);
+			s = end + 2;
+		} else if (*s == '[') {
+			char *end;
+			errno = 0;
+			long long index = strtoll(s + 1, &end, 10);
+			if (end == s + 1 || *end != ']' || errno == ERANGE)
+				break;
+			path_push(path, NULL, index);
+			s = end + 1;
+		} else {
+			break;
+		}
+	}
+	if (*s != '\0') {
+		path_free(path);
+		return NULL;
+	}
+	return path;
+}
+
+// the slot holding the child of node at step, NULL if there is none
+static JsonNode **step_slot(JsonNode *node, JsonStep *step) {
+	if (step->key != NULL) {
+		int pos = node->type == JSON_OBJECT ? obj_find(node, step->key) : -1;
+		return pos >= 0 ? &node->items[pos] : NULL;
+	}
+	if (node->type != JSON_ARRAY)
+		return NULL;
+	long long i = step->index < 0 ? node->n + step->index : step->index;
+	return i >= 0 && i < node->n ? &node->items[i] : NULL;
+}
+
+// follows the first n steps of path from root
+static JsonNode *path_walk(JsonNode *root, JsonPath *path, int n) {
+	for (int i = 0; i < n && root != NULL; i++) {
+		JsonNode **slot = step_slot(root, &path->steps[i]);
+		root = slot != NULL ? *slot : NULL;
+	}
+	return root;
+}
+
+int json_get(JsonNode *root, char *path, JsonNode **res) {
+	JsonPath *p = path_parse(path);
+	if (p == NULL)
+		return JSON_ERR_PATH;
+	*res = path_walk(root, p, p->n);
+	path_free(p);
+	return *res != NULL ? JSON_OK : JSON_ERR_MISSING;
+}
+
+// serializes the value at path, or with several paths an object of each path
+// and its value
+int json_project(JsonNode *root, char **paths, int n, char **res) {
+	JsonNode **nodes = dmalloc(n * sizeof(JsonNode *));
+	for (int i = 0; i < n; i++) {
+		int status = json_get(root, paths[i], &nodes[i]);
+		if (status != JSON_OK) {
+			free(nodes);
+			return status;
+		}
+	}
+	JsonBuf b = {NULL, 0, 0};
+	if (n > 1)
+		buf_put(&b, "{", 1);
+	for (int i = 0; i < n; i++) {
+		if (n > 1) {
+			if (i > 0)
+				buf_put(&b, ",", 1);
+			dump_str(&b, paths[i], strlen(paths[i]));
+			buf_put(&b, ":", 1);
+		}
+		dump_node(&b, nodes[i]);
+	}
+	if (n > 1)
+		buf_put(&b, "}", 1);
+	free(nodes);
+	*res = b.buf;
+	return JSON_OK;
+}
+
+// stores value at path, taking ownership of it only when JSON_OK is returned.
+// cond is 0, JSON_SET_NX or JSON_SET_XX. A new key may only be set at the root.
+int json_set(JsonNode **root, char *path, JsonNode *value, int cond) {
+	JsonPath *p = path_parse(path);
+	if (p == NULL)
+		return JSON_ERR_PATH;
+	int status = JSON_OK;
+	if (p->n == 0) {
+		if ((cond == JSON_SET_NX && *root != NULL) || (cond == JSON_SET_XX && *root == NULL)) {
+			status = JSON_NOOP;
+		} else {
+			json_free(*root);
+			*root = value;
+		}
+		path_free(p);
+		return status;
+	}
+	JsonNode *parent = *root == NULL ? NULL : path_walk(*root, p, p->n - 1);
+	JsonStep *last = &p->steps[p->n - 1];
+	JsonNode **slot = parent != NULL ? step_slot(parent, last) : NULL;
+	if (*root == NULL)
+		status = JSON_ERR_ROOT;
+	else if (parent == NULL)
+		status = JSON_ERR_MISSING;
+	else if ((cond == JSON_SET_NX && slot != NULL) || (cond == JSON_SET_XX && slot == NULL))
+		status = JSON_NOOP;
+	else if (slot != NULL) {
+		json_free(*slot);
+		*slot = value;
+	} else if (last->key != NULL && parent->type == JSON_OBJECT)
+		obj_put(parent, strdup(last->key), value);
+	else
+		status = parent->type == JSON_ARRAY && last->key == NULL ? JSON_ERR_RANGE : JSON_ERR_TYPE;
+	path_free(p);
+	return status;
+}
+
+// removes the value at path, the whole document when path is the root
+int json_del(JsonNode **root, char *path, long long *removed) {
+	JsonPath *p = path_parse(path);
+	if (p == NULL)
+		return JSON_ERR_PATH;
+	*removed = 0;
+	if (p->n == 0) {
+		json_free(*root);
+		*root = NULL;
+		*removed = 1;
+	} else {
+		JsonNode *parent = path_walk(*root, p, p->n - 1);
+		JsonNode **slot = parent != NULL ? step_slot(parent, &p->steps[p->n - 1]) : NULL;
+		if (slot != NULL) {
+			node_remove(parent, slot - parent->items);
+			*removed = 1;
+		}
+	}
+	path_free(p);
+	return JSON_OK;
+}
+
+// adds by to the number at path, which stays an integer while both are
+int json_numincrby(JsonNode *root, char *path, double by, JsonNode **res) {
+	int status = json_get(root, path, res);
+	if (status != JSON_OK)
+		return status;
+	JsonNode *node = *res;
+	if (node->type != JSON_INT && node->type != JSON_DOUBLE)
+		return JSON_ERR_TYPE;
+	long long sum;
+	if (node->type == JSON_INT && by == floor(by) && fabs(by) < 9e18 &&
+		!__builtin_add_overflow(node->i, (long long)by, &sum)) {
+		node->i = sum;
+		return JSON_OK;
+	}
+	double d = (node->type == JSON_INT ? node->i : node->d) + by;
+	if (!isfinite(d))
+		return JSON_ERR_RANGE;
+	node->type = JSON_DOUBLE;
+	node->d = d;
+	return JSON_OK;
+}
+
+// appends values to the string or array at path, type says which is
+// expected. Takes ownership of values only when JSON_OK is returned.
+int json_append(JsonNode *root, char *path, int type, JsonNode **values, int n, long long *len) {
+	JsonNode *node;
+	int status = json_get(root, path, &node);
+	if (status != JSON_OK)
+		return status;
+	if (node->type != type)
+		return JSON_ERR_TYPE;
+	if (type == JSON_ARRAY) {
+		for (int i = 0; i < n; i++)
+			arr_push(node, values[i]);
+		*len = node->n;
+		return JSON_OK;
+	}
+	for (int i = 0; i < n; i++)
+		if (values[i]->type != JSON_STRING)
+			return JSON_ERR_TYPE;
+	JsonBuf b = {node->str, node->n, node->n + 1};
+	for (int i = 0; i < n; i++) {
+		buf_put(&b, values[i]->str, values[i]->n);
+		json_free(values[i]);
+	}
+	node->str = b.buf;
+	node->n = b.len;
+	*len = node->n;
+	return JSON_OK;
+}
@@ -2,6 +2,154 @@
 #include <stdlib.h>
 #include <string.h>
 
+// A list is a doubly linked sequence of chunks. Each chunk packs its values
+// back to back as NUL terminated strings in data[start..used), so pushing and
+// popping at either end only moves the start/used offsets.
+
+static ListChunk *chunk_init(int cap, int dir) {
+	ListChunk *c = dmalloc(sizeof(ListChunk) + cap);
+	c->count = 0;
+	c->cap = cap;
+	// chunks created by a left push fill from the back
+	c->start = c->used = dir == LEFT ? cap : 0;
+	c->next = c->prev = NULL;
+	return c;
+}
+
+static void chunk_link(List *ls, ListChunk *c, int dir) {
+	if (ls->head == NULL) {
+		ls->head = ls->tail = c;
+	} else if (dir == LEFT) {
+		c->next = ls->head;
+		ls->head->prev = c;
+		ls->head = c;
+	} else {
+		c->prev = ls->tail;
+		ls->tail->next = c;
+		ls->tail = c;
+	}
+}
+
+static void chunk_unlink(List *ls, ListChunk *c) {
+	if (c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		ls->head = c->next;
+	if (c->next != NULL)
+		c->next->prev = c->prev;
+	else
+		ls->tail = c->prev;
+	free(c);
+}
+
+static bool chunk_fits(ListChunk *c, int n) {
+	return c->count < LIST_CHUNK_ENTRIES && c->used - c->start + n <= LIST_CHUNK_BYTES;
+}
+
+// makes room for n more bytes in front of (LEFT) or after (RIGHT) the live
+// region, growing the chunk when needed. The chunk may move, so its
+// neighbours are relinked and the new address is returned.
+static ListChunk *chunk_room(List *ls, ListChunk *c, int n, int dir) {
+	if (dir == LEFT ? c->start >= n : c->cap - c->used >= n)
+		return c;
+	int bytes = c->used - c->start, cap = c->cap;
+	while (cap < bytes + n)
+		cap *= 2;
+	if (cap > c->cap) {
+		c = drealloc(c, sizeof(ListChunk) + cap);
+		c->cap = cap;
+		if (c->prev != NULL)
+			c->prev->next = c;
+		else
+			ls->head = c;
+		if (c->next != NULL)
+			c->next->prev = c;
+		else
+			ls->tail = c;
+	}
+	int start = dir == LEFT ? cap - bytes : 0;
+	memmove(c->data + start, c->data + c->start, bytes);
+	c->start = start;
+	c->used = start + bytes;
+	return c;
+}
+
+// inserts value (n bytes including NUL) at byte offset rel of the live region,
+// an empty chunk is filled from whichever side it was created for
+static ListChunk *chunk_insert(List *ls, ListChunk *c, int rel, char *value, int n) {
+	if (rel == 0 && (c->count > 0 || c->start >= n)) {
+		c = chunk_room(ls, c, n, LEFT);
+		c->start -= n;
+		memcpy(c->data + c->start, value, n);
+	} else {
+		c = chunk_room(ls, c, n, RIGHT);
+		int off = c->start + rel;
+		memmove(c->data + off + n, c->data + off, c->used - off);
+		memcpy(c->data + off, value, n);
+		c->used += n;
+	}
+	c->count++;
+	return c;
+}
+
+static void chunk_delete(ListChunk *c, int off) {
+	int n = strlen(c->data + off) + 1;
+	if (off == c->start) {
+		c->start += n;
+	} else {
+		memmove(c->data + off, c->data + off + n, c->used - off - n);
+		c->used -= n;
+	}
+	c->count--;
+}
+
+// offset of the value stored before the one at off
+static int chunk_prev(ListChunk *c, int off) {
+	int p = off - 1;
+	while (p > c->start && c->data[p - 1] != '\0')
+		p--;
+	return p;
+}
+
+// offset of the i-th value, walking from whichever end of the chunk is nearer
+static int chunk_offset(ListChunk *c, int i) {
+	int off;
+	if (i < c->count / 2) {
+		off = c->start;
+		while (i--)
+			off += strlen(c->data + off) + 1;
+	} else {
+		off = c->used;
+		for (int j = c->count; j > i; j--)
+			off = chunk_prev(c, off);
+	}
+	return off;
+}
+
+// finds the chunk holding index id, skipping whole chunks from the nearer end
+static ListChunk *list_locate(List *ls, int id, int *off) {
+	if (id < 0 || id >= ls->len)
+		return NULL;
+	ListChunk *c;
+	if (id < ls->len / 2) {
+		c = ls->head;
+		while (id >= c->count) {
+			id -= c->count;
+			c = c->next;
+		}
+	} else {
+		int rid = ls->len - 1 - id;
+		c = ls->tail;
+		while (rid >= c->count) {
+			rid -= c->count;
+			c = c->prev;
+		}
+		id = c->count - 1 - rid;
+	}
+	*off = chunk_offset(c, id);
+	return c;
+}
+
 List *list_init() {
 	List *ls = dmalloc(sizeof(List));
 	ls->len = 0;
@@ -9,177 +157,156 @@ List *list_init() {
 	return ls;
 }
 
-static ListNode *node_init(char *value) {
-	ListNode *node = dmalloc(sizeof(ListNode));
-	node->value = strdup(value);
-	node->next = node->prev = NULL;
-	return node;
-}
-
-static void node_free(ListNode *node) {
-	free(node->value);
-	free(node);
-}
-
 void list_free(List *ls) {
 	if (ls == NULL)
 		return;
-	ListNode *next, *cur = ls->head;
-	while (ls->len--) {
+	ListChunk *next, *cur = ls->head;
+	while (cur != NULL) {
 		next = cur->next;
-		node_free(cur);
+		free(cur);
 		cur = next;
 	}
 	free(ls);
 }
 
-void list_lpush(List *ls, char *value) {
-	ListNode *new_node = node_init(value);
-	if (ls->len > 0) {
-		new_node->next = ls->head;
-		ls->head->prev = new_node;
-		ls->head = new_node;
-	} else {
-		ls->head = ls->tail = new_node;
+static void list_push(List *ls, char *value, int dir) {
+	int n = strlen(value) + 1;
+	ListChunk *c = dir == LEFT ? ls->head : ls->tail;
+	if (c == NULL || !chunk_fits(c, n)) {
+		c = chunk_init(n > LIST_CHUNK_INIT ? n : LIST_CHUNK_INIT, dir);
+		chunk_link(ls, c, dir);
 	}
+	chunk_insert(ls, c, dir == LEFT ? 0 : c->used - c->start, value, n);
 	ls->len++;
 }
 
-void list_rpush(List *ls, char *value) {
-	ListNode *new_node = node_init(value);
-	if (ls->len > 0) {
-		new_node->prev = ls->tail;
-		ls->tail->next = new_node;
-		ls->tail = new_node;
-	} else {
-		ls->tail = ls->head = new_node;
-	}
-	ls->len++;
-}
+void list_lpush(List *ls, char *value) { list_push(ls, value, LEFT); }
 
-ListNode *list_lpop(List *ls) {
+void list_rpush(List *ls, char *value) { list_push(ls, value, RIGHT); }
+
+char *list_lpop(List *ls) {
 	if (ls->len <= 0)
 		return NULL;
-	ListNode *node = ls->head;
-	if (ls->len - 1 > 0) {
-		ls->head = node->next;
-		ls->head->prev = NULL;
-	} else {
-		ls->head = ls->tail = NULL;
-	}
+	ListChunk *c = ls->head;
+	char *res = strdup(c->data + c->start);
+	chunk_delete(c, c->start);
+	if (c->count == 0)
+		chunk_unlink(ls, c);
 	ls->len--;
-	node->next = node->prev = NULL;
-	return node;
+	return res;
 }
 
-ListNode *list_rpop(List *ls) {
+char *list_rpop(List *ls) {
 	if (ls->len <= 0)
 		return NULL;
-	ListNode *node = ls->tail;
-	if (ls->len - 1 > 0) {
-		ls->tail = node->prev;
-		ls->tail->next = NULL;
-	} else {
-		ls->head = ls->tail = NULL;
-	}
+	ListChunk *c = ls->tail;
+	int off = chunk_prev(c, c->used);
+	char *res = strdup(c->data + off);
+	chunk_delete(c, off);
+	if (c->count == 0)
+		chunk_unlink(ls, c);
 	ls->len--;
-	node->next = node->prev = NULL;
-	return node;
+	return res;
 }
 
-ListNode *list_index(List *ls, int id) {
-	int i = 0;
-	ListNode *cur = ls->head;
-	while (i++ < id && cur != NULL) {
-		cur = cur->next;
-	}
-	return cur;
+// returns a pointer into the chunk, valid until the list is next modified
+char *list_index(List *ls, int id) {
+	int off;
+	ListChunk *c = list_locate(ls, id, &off);
+	return c != NULL ? c->data + off : NULL;
 }
 
 bool list_set(List *ls, int id, char *value) {
-	int i = 0;
-	ListNode *cur = ls->head;
-	while (i++ < id && cur != NULL)
-		cur = cur->next;
-	if (cur != NULL) {
-		free(cur->value);
-		cur->value = strdup(value);
-		return true;
-	}
-	return false;
+	int off;
+	ListChunk *c = list_locate(ls, id, &off);
+	if (c == NULL)
+		return false;
+	int rel = off - c->start;
+	chunk_delete(c, off);
+	chunk_insert(ls, c, rel, value, strlen(value) + 1);
+	return true;
 }
 
 int list_pos(List *ls, char *value) {
 	int i = 0;
-	ListNode *cur = ls->head;
-	while (cur != NULL) {
-		if (strcmp(cur->value, value) == 0)
-			return i;
-		cur = cur->next;
-		i++;
+	for (ListChunk *c = ls->head; c != NULL; c = c->next) {
+		for (int off = c->start; off < c->used; off += strlen(c->data + off) + 1) {
+			if (strcmp(c->data + off, value) == 0)
+				return i;
+			i++;
+		}
 	}
 	return -1;
 }
 
-static void node_del(List *ls, ListNode *nd) {
-	// ListNode *tmp = nd;
-	if (ls->head == NULL || nd == NULL)
-		return;
-	if (ls->len - 1 == 0) {
-		ls->head = ls->tail = NULL;
-		return;
-	}
-	if (nd == ls->head) {
-		ls->head = nd->next;
-		ls->head->prev = NULL;
-	} else if (nd == ls->tail) {
-		ls->tail = nd->prev;
-		ls->tail->next = NULL;
-	} else {
-		nd->prev->next = nd->next;
-		nd->next->prev = nd->prev;
-	}
-}
-
 int list_rem(List *ls, int count, char *value) {
-	int i = 0, pos = count;
-	ListNode *cur = count >= 0 ? ls->head : ls->tail;
-	while (cur != NULL) {
-		int flag = 0;
-		if (pos != 0 && count == 0)
-			break;
-		if (strcmp(cur->value, value) == 0) {
-			node_del(ls, cur);
-			i++;
-			pos >= 0 ? count-- : count++;
-			ls->len--;
-			flag++;
+	int i = 0, limit = count < 0 ? -count : count;
+	ListChunk *cur = count >= 0 ? ls->head : ls->tail;
+	while (cur != NULL && (limit == 0 || i < limit)) {
+		ListChunk *next = count >= 0 ? cur->next : cur->prev;
+		if (count >= 0) {
+			int off = cur->start;
+			while (off < cur->used && (limit == 0 || i < limit)) {
+				if (strcmp(cur->data + off, value) == 0) {
+					int rel = off - cur->start;
+					chunk_delete(cur, off);
+					off = cur->start + rel;
+					i++;
+				} else {
+					off += strlen(cur->data + off) + 1;
+				}
+			}
+		} else {
+			int off = cur->used;
+			while (off > cur->start && (limit == 0 || i < limit)) {
+				off = chunk_prev(cur, off);
+				if (strcmp(cur->data + off, value) == 0) {
+					chunk_delete(cur, off);
+					i++;
+				}
+			}
 		}
-		ListNode *tmp = cur;
-		cur = pos >= 0 ? cur->next : cur->prev;
-		if (flag)
-			node_free(tmp);
+		if (cur->count == 0)
+			chunk_unlink(ls, cur);
+		cur = next;
 	}
-
+	ls->len -= i;
 	return i;
 }
 
 char **list_range(List *ls, int begin, int end) {
-	ListNode *cur = ls->head;
+	int off;
+	ListChunk *cur = list_locate(ls, begin, &off);
 	char **res = calloc(end - begin + 2, sizeof(char *));
 
-	int id = 0, i = 0;
-	while (id < begin) {
-		id++;
-		cur = cur->next;
-	}
-
-	while (id <= end) {
-		res[i++] = strdup(cur->value);
-		id++;
+	int i = 0;
+	while (cur != NULL && i <= end - begin) {
+		for (; off < cur->used && i <= end - begin; off += strlen(cur->data + off) + 1)
+			res[i++] = strdup(cur->data + off);
 		cur = cur->next;
+		if (cur != NULL)
+			off = cur->start;
 	}
 
 	res[i] = NULL;
 	return res;
 }
+
+// appends count values packed as in a chunk, as a snapshot wrote them. False,
+// leaving the list as it was, when the bytes do not hold exactly count values.
+bool list_append_chunk(List *ls, const char *data, int bytes, int count) {
+	if (count <= 0 || bytes <= 0 || data[bytes - 1] != '\0')
+		return false;
+	int nuls = 0;
+	for (int i = 0; i < bytes; i++)
+		nuls += data[i] == '\0';
+	if (nuls != count)
+		return false;
+	ListChunk *c = chunk_init(bytes > LIST_CHUNK_INIT ? bytes : LIST_CHUNK_INIT, RIGHT);
+	memcpy(c->data, data, bytes);
+	c->used = bytes;
+	c->count = count;
+	chunk_link(ls, c, RIGHT);
+	ls->len += count;
+	return true;
+}
@@ -0,0 +1,166 @@
+#include "common.h"
+#include <string.h>
+
+// Byte oriented LZ77 compression in the style of LZ4, for snapshot sections.
+// A block is a run of sequences, each a token whose high nibble counts the
+// literals that follow it and whose low nibble counts the match bytes past
+// LZ_MIN_MATCH, then the literals, then a two byte little endian offset back
+// to the match. A nibble of 15 means bytes follow that add to it, up to the
+// first one below 255. The last sequence carries literals only. Matches are
+// found through a table holding the last position each 4 byte prefix hashed
+// to, and the search steps further the longer it goes without a match, so
+// data that does not compress passes through quickly.
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t read32(const uint8_t *p) {
+	uint32_t x;
+	memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+static uint64_t read64(const uint8_t *p) {
+	uint64_t x;
+	memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+static uint32_t lz_hash(uint32_t x) { return (x * 2654435761u) >> (32 - LZ_HASH_BITS); }
+
+static uint8_t *put_length(uint8_t *op, long len) {
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+// how many bytes from a on equal those from b, comparing 8 at a time. Words
+// are read little endian, so the lowest differing bit is in the first
+// differing byte.
+static long match_length(const uint8_t *a, const uint8_t *b, const uint8_t *end) {
+	const uint8_t *start = a;
+	for (; end - a >= 8; a += 8, b += 8) {
+		uint64_t x = read64(a) ^ read64(b);
+		if (x != 0)
+			return a - start + (__builtin_ctzll(x) >> 3);
+	}
+	while (a < end && *a == *b) {
+		a++;
+		b++;
+	}
+	return a - start;
+}
+
+// a sequence of nlit literals then a match of mlen bytes at offset back, mlen
+// 0 for the last sequence
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *lit, long nlit, int offset, long mlen) {
+	uint8_t *token = op++;
+	*token = (nlit < 15 ? nlit : 15) << 4;
+	if (nlit >= 15)
+		op = put_length(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if (mlen == 0)
+		return op;
+	*op++ = offset;
+	*op++ = offset >> 8;
+	mlen -= LZ_MIN_MATCH;
+	*token |= mlen < 15 ? mlen : 15;
+	if (mlen >= 15)
+		op = put_length(op, mlen - 15);
+	return op;
+}
+
+// the most bytes lz_compress writes for n bytes of input
+long lz_bound(long n) { return n + n / 255 + 16; }
+
+// compresses n bytes of src into dst, which has room for lz_bound(n) bytes,
+// and returns the compressed length
+long lz_compress(const uint8_t *src, long n, uint8_t *dst) {
+	// positions are stored plus one so that 0 is empty
+	uint32_t table[1 << LZ_HASH_BITS] = {0};
+	const uint8_t *ip = src, *anchor = src, *end = src + n;
+	uint8_t *op = dst;
+	while (end - ip >= LZ_MIN_MATCH) {
+		uint32_t seq = read32(ip), h = lz_hash(seq), ref = table[h];
+		const uint8_t *match = src + ref - (ref > 0);
+		table[h] = ip - src + 1;
+		if (ref == 0 || ip - match > LZ_MAX_OFFSET || read32(match) != seq) {
+			ip += 1 + ((ip - anchor) >> 6);
+			continue;
+		}
+		while (ip > anchor && match > src && ip[-1] == match[-1]) {
+			ip--;
+			match--;
+		}
+		long len = LZ_MIN_MATCH + match_length(ip + LZ_MIN_MATCH, match + LZ_MIN_MATCH, end);
+		op = put_sequence(op, anchor, ip - anchor, ip - match, len);
+		ip += len;
+		anchor = ip;
+	}
+	return put_sequence(op, anchor, end - anchor, 0, 0) - dst;
+}
+
+// copies n bytes 8 at a time, so up to 7 more are read and written
+static void wild_copy(uint8_t *dst, const uint8_t *src, long n) {
+	uint8_t *end = dst + n;
+	do {
+		memcpy(dst, src, 8);
+		dst += 8;
+		src += 8;
+	} while (dst < end);
+}
+
+static bool get_length(const uint8_t **ip, const uint8_t *end, long *len) {
+	uint8_t b;
+	do {
+		if (*ip == end)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+// decompresses the n bytes at src into dst, false unless they decode to
+// exactly cap bytes
+bool lz_decompress(const uint8_t *src, long n, uint8_t *dst, long cap) {
+	const uint8_t *ip = src, *end = src + n;
+	uint8_t *op = dst, *oend = dst + cap;
+	while (ip < end) {
+		int token = *ip++;
+		long nlit = token >> 4, mlen = token & 15;
+		if ((nlit == 15 && !get_length(&ip, end, &nlit)) || nlit > end - ip || nlit > oend - op)
+			return false;
+		if (end - ip >= nlit + 8 && oend - op >= nlit + 8)
+			wild_copy(op, ip, nlit);
+		else
+			memcpy(op, ip, nlit);
+		op += nlit;
+		ip += nlit;
+		if (ip == end)
+			break;
+		if (end - ip < 2)
+			return false;
+		long offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (mlen == 15 && !get_length(&ip, end, &mlen))
+			return false;
+		mlen += LZ_MIN_MATCH;
+		if (offset == 0 || offset > op - dst || mlen > oend - op)
+			return false;
+		const uint8_t *match = op - offset;
+		if (offset >= 8 && oend - op >= mlen + 8) {
+			// each word read was written before it, even when the match overlaps
+			wild_copy(op, match, mlen);
+		} else {
+			// the match overlaps what it writes, repeating its first offset bytes
+			for (long i = 0; i < mlen; i++)
+				op[i] = match[i];
+		}
+		op += mlen;
+	}
+	return op == oend;
+}
@@ -5,7 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-static Command *command_init(int type, int argc, char **argv) {
+Command *command_init(int type, int argc, char **argv) {
 	log_trace("Initializing command of type %d with %d arguments", type, argc);
 	Command *cmd = dmalloc(sizeof(Command));
 	cmd->type = type;
@@ -22,6 +22,13 @@ void command_free(Command *cmd) {
 	free(cmd);
 }
 
+Command *command_dup(Command *cmd) {
+	char **argv = dmalloc(cmd->argc * sizeof(char *));
+	for (int i = 0; i < cmd->argc; i++)
+		argv[i] = strdup(cmd->argv[i]);
+	return command_init(cmd->type, cmd->argc, argv);
+}
+
 static void parser_advance(Parser *parser) {
 	if (parser->pos < strlen(parser->string)) {
 		parser->pos++;
@@ -46,23 +53,33 @@ static char *parse_id(Parser *parser) {
 	return token;
 }
 
+// a quoted argument ends at the matching quote. As in redis-cli, \' is the
+// only escape inside single quotes, while double quotes also take \\.
 static char *parse_string(Parser *parser) {
+	char quote = parser->current_char;
+	int n = 0, cap = 16;
+	char *token = dmalloc(cap * sizeof(char));
 	// first quote
-	char *token = dmalloc(sizeof(char));
-	*token = '\0';
-	int n = 1;
 	parser_advance(parser);
-	while ((parser->current_char != '"' && parser->current_char != '\'') &&
-		   parser->pos < strlen(parser->string)) {
-		token = drealloc(token, ++n);
-		char *tmp = token;
-		sprintf(token, "%s%c", tmp, parser->current_char);
+	while (parser->current_char != quote && parser->pos < strlen(parser->string)) {
+		char c = parser->current_char;
+		if (c == '\\') {
+			char next = parser->string[parser->pos + 1];
+			if (next == quote || (quote == '"' && next == '\\')) {
+				parser_advance(parser);
+				c = next;
+			}
+		}
+		if (n + 2 > cap) {
+			cap *= 2;
+			token = drealloc(token, cap * sizeof(char));
+		}
+		token[n++] = c;
 		parser_advance(parser);
 	}
 	// last quote
 	parser_advance(parser);
-	token = realloc(token, ++n);
-	token[n - 1] = '\0';
+	token[n] = '\0';
 	return token;
 }
 
@@ -114,93 +131,277 @@ void parser_free(Parser *parser) {
 	free(parser);
 }
 
+// the type of the command called name, UNKNOWN if there is none
+int command_type(char *name) {
+	if (strcmp(name, "del") == 0)
+		return DEL;
+	else if (strcmp(name, "exists") == 0)
+		return EXISTS;
+	else if (strcmp(name, "type") == 0)
+		return TYPE;
+	else if (strcmp(name, "set") == 0)
+		return SET;
+	else if (strcmp(name, "get") == 0)
+		return GET;
+	else if (strcmp(name, "mset") == 0)
+		return MSET;
+	else if (strcmp(name, "mget") == 0)
+		return MGET;
+	else if (strcmp(name, "incr") == 0)
+		return INCR;
+	else if (strcmp(name, "decr") == 0)
+		return DECR;
+	else if (strcmp(name, "incrby") == 0)
+		return INCRBY;
+	else if (strcmp(name, "decrby") == 0)
+		return DECRBY;
+	else if (strcmp(name, "strlen") == 0)
+		return STRLEN;
+	else if (strcmp(name, "hset") == 0)
+		return HSET;
+	else if (strcmp(name, "hget") == 0)
+		return HGET;
+	else if (strcmp(name, "hdel") == 0)
+		return HDEL;
+	else if (strcmp(name, "hgetall") == 0)
+		return HGETALL;
+	else if (strcmp(name, "hexists") == 0)
+		return HEXISTS;
+	else if (strcmp(name, "hkeys") == 0)
+		return HKEYS;
+	else if (strcmp(name, "hvals") == 0)
+		return HVALS;
+	else if (strcmp(name, "hmget") == 0)
+		return HMGET;
+	else if (strcmp(name, "hlen") == 0)
+		return HLEN;
+	else if (strcmp(name, "lpush") == 0)
+		return LPUSH;
+	else if (strcmp(name, "lpop") == 0)
+		return LPOP;
+	else if (strcmp(name, "rpush") == 0)
+		return RPUSH;
+	else if (strcmp(name, "llen") == 0)
+		return LLEN;
+	else if (strcmp(name, "lindex") == 0)
+		return LINDEX;
+	else if (strcmp(name, "lrange") == 0)
+		return LRANGE;
+	else if (strcmp(name, "lset") == 0)
+		return LSET;
+	else if (strcmp(name, "lrem") == 0)
+		return LREM;
+	else if (strcmp(name, "lpos") == 0)
+		return LPOS;
+	else if (strcmp(name, "rpop") == 0)
+		return RPOP;
+	else if (strcmp(name, "sadd") == 0)
+		return SADD;
+	else if (strcmp(name, "srem") == 0)
+		return SREM;
+	else if (strcmp(name, "sismember") == 0)
+		return SISMEMBER;
+	else if (strcmp(name, "smembers") == 0)
+		return SMEMBERS;
+	else if (strcmp(name, "smismember") == 0)
+		return SMISMEMBER;
+	else if (strcmp(name, "sinter") == 0)
+		return SINTER;
+	else if (strcmp(name, "sinterstore") == 0)
+		return SINTERSTORE;
+	else if (strcmp(name, "sintercard") == 0)
+		return SINTERCARD;
+	else if (strcmp(name, "sunion") == 0)
+		return SUNION;
+	else if (strcmp(name, "sunionstore") == 0)
+		return SUNIONSTORE;
+	else if (strcmp(name, "sdiff") == 0)
+		return SDIFF;
+	else if (strcmp(name, "sdiffstore") == 0)
+		return SDIFFSTORE;
+	else if (strcmp(name, "lmove") == 0)
+		return LMOVE;
+	else if (strcmp(name, "blpop") == 0)
+		return BLPOP;
+	else if (strcmp(name, "brpop") == 0)
+		return BRPOP;
+	else if (strcmp(name, "blmove") == 0)
+		return BLMOVE;
+	else if (strcmp(name, "zadd") == 0)
+		return ZADD;
+	else if (strcmp(name, "zrem") == 0)
+		return ZREM;
+	else if (strcmp(name, "zscore") == 0)
+		return ZSCORE;
+	else if (strcmp(name, "zincrby") == 0)
+		return ZINCRBY;
+	else if (strcmp(name, "zcard") == 0)
+		return ZCARD;
+	else if (strcmp(name, "zrank") == 0)
+		return ZRANK;
+	else if (strcmp(name, "zrevrank") == 0)
+		return ZREVRANK;
+	else if (strcmp(name, "zrange") == 0)
+		return ZRANGE;
+	else if (strcmp(name, "zrangebyscore") == 0)
+		return ZRANGEBYSCORE;
+	else if (strcmp(name, "pfadd") == 0)
+		return PFADD;
+	else if (strcmp(name, "pfcount") == 0)
+		return PFCOUNT;
+	else if (strcmp(name, "pfmerge") == 0)
+		return PFMERGE;
+	else if (strcmp(name, "setbit") == 0)
+		return SETBIT;
+	else if (strcmp(name, "getbit") == 0)
+		return GETBIT;
+	else if (strcmp(name, "bitcount") == 0)
+		return BITCOUNT;
+	else if (strcmp(name, "bitop") == 0)
+		return BITOP;
+	else if (strcmp(name, "bitpos") == 0)
+		return BITPOS;
+	else if (strcmp(name, "rbadd") == 0)
+		return RBADD;
+	else if (strcmp(name, "rbrem") == 0)
+		return RBREM;
+	else if (strcmp(name, "rbismember") == 0)
+		return RBISMEMBER;
+	else if (strcmp(name, "rbcard") == 0)
+		return RBCARD;
+	else if (strcmp(name, "rbmembers") == 0)
+		return RBMEMBERS;
+	else if (strcmp(name, "rbop") == 0)
+		return RBOP;
+	else if (strcmp(name, "xadd") == 0)
+		return XADD;
+	else if (strcmp(name, "xlen") == 0)
+		return XLEN;
+	else if (strcmp(name, "xrange") == 0)
+		return XRANGE;
+	else if (strcmp(name, "xtrim") == 0)
+		return XTRIM;
+	else if (strcmp(name, "xread") == 0)
+		return XREAD;
+	else if (strcmp(name, "xgroup") == 0)
+		return XGROUP;
+	else if (strcmp(name, "xreadgroup") == 0)
+		return XREADGROUP;
+	else if (strcmp(name, "xack") == 0)
+		return XACK;
+	else if (strcmp(name, "bf.reserve") == 0)
+		return BFRESERVE;
+	else if (strcmp(name, "bf.add") == 0)
+		return BFADD;
+	else if (strcmp(name, "bf.madd") == 0)
+		return BFMADD;
+	else if (strcmp(name, "bf.exists") == 0)
+		return BFEXISTS;
+	else if (strcmp(name, "bf.mexists") == 0)
+		return BFMEXISTS;
+	else if (strcmp(name, "bf.card") == 0)
+		return BFCARD;
+	else if (strcmp(name, "ts.create") == 0)
+		return TSCREATE;
+	else if (strcmp(name, "ts.add") == 0)
+		return TSADD;
+	else if (strcmp(name, "ts.get") == 0)
+		return TSGET;
+	else if (strcmp(name, "ts.range") == 0)
+		return TSRANGE;
+	else if (strcmp(name, "ts.info") == 0)
+		return TSINFO;
+	else if (strcmp(name, "json.set") == 0)
+		return JSONSET;
+	else if (strcmp(name, "json.get") == 0)
+		return JSONGET;
+	else if (strcmp(name, "json.del") == 0)
+		return JSONDEL;
+	else if (strcmp(name, "json.type") == 0)
+		return JSONTYPE;
+	else if (strcmp(name, "json.numincrby") == 0)
+		return JSONNUMINCRBY;
+	else if (strcmp(name, "json.strappend") == 0)
+		return JSONSTRAPPEND;
+	else if (strcmp(name, "json.arrappend") == 0)
+		return JSONARRAPPEND;
+	else if (strcmp(name, "json.arrlen") == 0)
+		return JSONARRLEN;
+	else if (strcmp(name, "vadd") == 0)
+		return VADD;
+	else if (strcmp(name, "vrem") == 0)
+		return VREM;
+	else if (strcmp(name, "vsim") == 0)
+		return VSIM;
+	else if (strcmp(name, "vcard") == 0)
+		return VCARD;
+	else if (strcmp(name, "vdim") == 0)
+		return VDIM;
+	else if (strcmp(name, "vemb") == 0)
+		return VEMB;
+	else if (strcmp(name, "vinfo") == 0)
+		return VINFO;
+	else if (strcmp(name, "cms.initbydim") == 0)
+		return CMSINITBYDIM;
+	else if (strcmp(name, "cms.initbyprob") == 0)
+		return CMSINITBYPROB;
+	else if (strcmp(name, "cms.incrby") == 0)
+		return CMSINCRBY;
+	else if (strcmp(name, "cms.query") == 0)
+		return CMSQUERY;
+	else if (strcmp(name, "cms.merge") == 0)
+		return CMSMERGE;
+	else if (strcmp(name, "cms.info") == 0)
+		return CMSINFO;
+	else if (strcmp(name, "topk.reserve") == 0)
+		return TOPKRESERVE;
+	else if (strcmp(name, "topk.add") == 0)
+		return TOPKADD;
+	else if (strcmp(name, "topk.incrby") == 0)
+		return TOPKINCRBY;
+	else if (strcmp(name, "topk.query") == 0)
+		return TOPKQUERY;
+	else if (strcmp(name, "topk.list") == 0)
+		return TOPKLIST;
+	else if (strcmp(name, "topk.info") == 0)
+		return TOPKINFO;
+	else if (strcmp(name, "geoadd") == 0)
+		return GEOADD;
+	else if (strcmp(name, "geopos") == 0)
+		return GEOPOS;
+	else if (strcmp(name, "geodist") == 0)
+		return GEODIST;
+	else if (strcmp(name, "geosearch") == 0)
+		return GEOSEARCH;
+	else if (strcmp(name, "cl.throttle") == 0)
+		return THROTTLE;
+	else if (strcmp(name, "save") == 0)
+		return SAVE;
+	else if (strcmp(name, "bgsave") == 0)
+		return BGSAVE;
+	else if (strcmp(name, "lastsave") == 0)
+		return LASTSAVE;
+	else if (strcmp(name, "info") == 0)
+		return INFO;
+	else if (strcmp(name, "bgrewriteaof") == 0)
+		return BGREWRITEAOF;
+	else if (strcmp(name, "quit") == 0)
+		return QUIT;
+	else if (strcmp(name, "shutdown") == 0)
+		return SHUTDOWN;
+	else {
+		log_warn("Unknown command: '%s'", name);
+		return UNKNOWN;
+	}
+}
+
 Command *parse(char *msg) {
 	Parser *parser = parser_init(msg);
 	char *token = get_next_token(parser);
 	int argc = get_argc(parser);
 	Command *cmd;
 	if (argc >= 0) {
-		int type;
-		if (strcmp(token, "del") == 0)
-			type = DEL;
-		else if (strcmp(token, "exists") == 0)
-			type = EXISTS;
-		else if (strcmp(token, "type") == 0)
-			type = TYPE;
-		else if (strcmp(token, "set") == 0)
-			type = SET;
-		else if (strcmp(token, "get") == 0)
-			type = GET;
-		else if (strcmp(token, "mset") == 0)
-			type = MSET;
-		else if (strcmp(token, "mget") == 0)
-			type = MGET;
-		else if (strcmp(token, "incr") == 0)
-			type = INCR;
-		else if (strcmp(token, "decr") == 0)
-			type = DECR;
-		else if (strcmp(token, "incrby") == 0)
-			type = INCRBY;
-		else if (strcmp(token, "decrby") == 0)
-			type = DECRBY;
-		else if (strcmp(token, "strlen") == 0)
-			type = STRLEN;
-		else if (strcmp(token, "hset") == 0)
-			type = HSET;
-		else if (strcmp(token, "hget") == 0)
-			type = HGET;
-		else if (strcmp(token, "hdel") == 0)
-			type = HDEL;
-		else if (strcmp(token, "hgetall") == 0)
-			type = HGETALL;
-		else if (strcmp(token, "hexists") == 0)
-			type = HEXISTS;
-		else if (strcmp(token, "hkeys") == 0)
-			type = HKEYS;
-		else if (strcmp(token, "hvals") == 0)
-			type = HVALS;
-		else if (strcmp(token, "hmget") == 0)
-			type = HMGET;
-		else if (strcmp(token, "hlen") == 0)
-			type = HLEN;
-		else if (strcmp(token, "lpush") == 0)
-			type = LPUSH;
-		else if (strcmp(token, "lpop") == 0)
-			type = LPOP;
-		else if (strcmp(token, "rpush") == 0)
-			type = RPUSH;
-		else if (strcmp(token, "llen") == 0)
-			type = LLEN;
-		else if (strcmp(token, "lindex") == 0)
-			type = LINDEX;
-		else if (strcmp(token, "lrange") == 0)
-			type = LRANGE;
-		else if (strcmp(token, "lset") == 0)
-			type = LSET;
-		else if (strcmp(token, "lrem") == 0)
-			type = LREM;
-		else if (strcmp(token, "lpos") == 0)
-			type = LPOS;
-		else if (strcmp(token, "rpop") == 0)
-			type = RPOP;
-		else if (strcmp(token, "sadd") == 0)
-			type = SADD;
-		else if (strcmp(token, "srem") == 0)
-			type = SREM;
-		else if (strcmp(token, "sismember") == 0)
-			type = SISMEMBER;
-		else if (strcmp(token, "smembers") == 0)
-			type = SMEMBERS;
-		else if (strcmp(token, "smismember") == 0)
-			type = SMISMEMBER;
-		else if (strcmp(token, "quit") == 0)
-			type = QUIT;
-		else if (strcmp(token, "shutdown") == 0)
-			type = SHUTDOWN;
-		else {
-			log_warn("Unknown command: '%s'", token);
-			type = UNKNOWN;
-		}
+		int type = command_type(token);
 
 		log_debug("Command '%s' parsed as type %d with %d arguments", token, type, argc);
 
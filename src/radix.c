@@ -0,0 +1,217 @@
+#include "common.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Radix tree over fixed RADIX_KEY_LEN byte keys. Every node holds the part of
+// the path it compresses in prefix, children are kept sorted by the byte that
+// leads to them, and values live on the leaves at full key depth. Inner nodes
+// other than the root always have two or more children.
+
+static RadixNode *node_new(const uint8_t *prefix, int plen) {
+	RadixNode *nd = dmalloc(sizeof(RadixNode));
+	nd->plen = plen;
+	if (plen > 0)
+		memcpy(nd->prefix, prefix, plen);
+	nd->nchildren = 0;
+	nd->bytes = NULL;
+	nd->children = NULL;
+	nd->value = NULL;
+	return nd;
+}
+
+static void node_free(RadixNode *nd, void (*free_value)(void *)) {
+	for (int i = 0; i < nd->nchildren; i++)
+		node_free(nd->children[i], free_value);
+	if (nd->value != NULL && free_value != NULL)
+		free_value(nd->value);
+	free(nd->bytes);
+	free(nd->children);
+	free(nd);
+}
+
+// index of the child reached through byte b, or where it would be inserted
+static int child_find(RadixNode *nd, uint8_t b) {
+	int lo = 0, hi = nd->nchildren;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (nd->bytes[mid] < b)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void child_insert(RadixNode *nd, int i, uint8_t b, RadixNode *child) {
+	nd->bytes = drealloc(nd->bytes, (nd->nchildren + 1) * sizeof(uint8_t));
+	nd->children = drealloc(nd->children, (nd->nchildren + 1) * sizeof(RadixNode *));
+	memmove(nd->bytes + i + 1, nd->bytes + i, nd->nchildren - i);
+	memmove(nd->children + i + 1, nd->children + i, (nd->nchildren - i) * sizeof(RadixNode *));
+	nd->bytes[i] = b;
+	nd->children[i] = child;
+	nd->nchildren++;
+}
+
+static void child_remove(RadixNode *nd, int i) {
+	nd->nchildren--;
+	memmove(nd->bytes + i, nd->bytes + i + 1, nd->nchildren - i);
+	memmove(nd->children + i, nd->children + i + 1, (nd->nchildren - i) * sizeof(RadixNode *));
+	if (nd->nchildren == 0) {
+		free(nd->bytes);
+		free(nd->children);
+		nd->bytes = NULL;
+		nd->children = NULL;
+	}
+}
+
+RadixTree *radix_init() {
+	RadixTree *t = dmalloc(sizeof(RadixTree));
+	t->size = 0;
+	t->root = node_new(NULL, 0);
+	return t;
+}
+
+void radix_free(RadixTree *t, void (*free_value)(void *)) {
+	if (t == NULL)
+		return;
+	node_free(t->root, free_value);
+	free(t);
+}
+
+// returns the node that takes the place of nd, which changes when its
+// prefix has to be split
+static RadixNode *node_insert(RadixTree *t, RadixNode *nd, const uint8_t *key, int depth,
+							  void *value) {
+	int common = 0;
+	while (common < nd->plen && nd->prefix[common] == key[depth + common])
+		common++;
+	if (common < nd->plen) {
+		RadixNode *parent = node_new(nd->prefix, common);
+		int rest = RADIX_KEY_LEN - depth - common - 1;
+		RadixNode *leaf = node_new(key + depth + common + 1, rest);
+		leaf->value = value;
+		uint8_t old = nd->prefix[common], b = key[depth + common];
+		nd->plen -= common + 1;
+		memmove(nd->prefix, nd->prefix + common + 1, nd->plen);
+		child_insert(parent, 0, old < b ? old : b, old < b ? nd : leaf);
+		child_insert(parent, 1, old < b ? b : old, old < b ? leaf : nd);
+		t->size++;
+		return parent;
+	}
+	depth += nd->plen;
+	if (depth == RADIX_KEY_LEN) {
+		nd->value = value;
+		return nd;
+	}
+	int i = child_find(nd, key[depth]);
+	if (i < nd->nchildren && nd->bytes[i] == key[depth]) {
+		nd->children[i] = node_insert(t, nd->children[i], key, depth + 1, value);
+	} else {
+		RadixNode *leaf = node_new(key + depth + 1, RADIX_KEY_LEN - depth - 1);
+		leaf->value = value;
+		child_insert(nd, i, key[depth], leaf);
+		t->size++;
+	}
+	return nd;
+}
+
+// sets the value of key, replacing any previous one
+void radix_insert(RadixTree *t, const uint8_t *key, void *value) {
+	t->root = node_insert(t, t->root, key, 0, value);
+}
+
+void *radix_find(RadixTree *t, const uint8_t *key) {
+	RadixNode *nd = t->root;
+	int depth = 0;
+	while (true) {
+		if (memcmp(nd->prefix, key + depth, nd->plen) != 0)
+			return NULL;
+		depth += nd->plen;
+		if (depth == RADIX_KEY_LEN)
+			return nd->value;
+		int i = child_find(nd, key[depth]);
+		if (i == nd->nchildren || nd->bytes[i] != key[depth])
+			return NULL;
+		nd = nd->children[i];
+		depth++;
+	}
+}
+
+// leaf with the largest (dir < 0) or smallest (dir > 0) key under nd
+static RadixNode *node_edge(RadixNode *nd, int dir) {
+	while (nd->nchildren > 0)
+		nd = nd->children[dir < 0 ? nd->nchildren - 1 : 0];
+	return nd;
+}
+
+static void *node_seek(RadixNode *nd, const uint8_t *key, int depth, int dir) {
+	int cmp = memcmp(nd->prefix, key + depth, nd->plen);
+	// the whole subtree is either below or above key
+	if (cmp != 0)
+		return (cmp < 0) == (dir < 0) ? node_edge(nd, dir)->value : NULL;
+	depth += nd->plen;
+	if (depth == RADIX_KEY_LEN)
+		return nd->value;
+	int i = child_find(nd, key[depth]);
+	if (i < nd->nchildren && nd->bytes[i] == key[depth]) {
+		void *res = node_seek(nd->children[i], key, depth + 1, dir);
+		if (res != NULL)
+			return res;
+		i += dir < 0 ? -1 : 1;
+	} else if (dir < 0) {
+		i--;
+	}
+	if (i < 0 || i >= nd->nchildren)
+		return NULL;
+	return node_edge(nd->children[i], dir)->value;
+}
+
+// value of the largest key <= key when dir < 0, or of the smallest key >= key
+// when dir > 0, NULL if there is none
+void *radix_seek(RadixTree *t, const uint8_t *key, int dir) {
+	return node_seek(t->root, key, 0, dir);
+}
+
+// returns the node that takes the place of nd, NULL once its subtree is gone
+static RadixNode *node_remove(RadixTree *t, RadixNode *nd, const uint8_t *key, int depth) {
+	if (memcmp(nd->prefix, key + depth, nd->plen) != 0)
+		return nd;
+	depth += nd->plen;
+	if (depth == RADIX_KEY_LEN) {
+		node_free(nd, NULL);
+		t->size--;
+		return NULL;
+	}
+	int i = child_find(nd, key[depth]);
+	if (i == nd->nchildren || nd->bytes[i] != key[depth])
+		return nd;
+	RadixNode *child = node_remove(t, nd->children[i], key, depth + 1);
+	if (child != NULL) {
+		nd->children[i] = child;
+		return nd;
+	}
+	child_remove(nd, i);
+	if (nd == t->root || nd->nchildren != 1)
+		return nd;
+	// a single child is merged into nd's place to keep the path compressed
+	RadixNode *only = nd->children[0];
+	uint8_t prefix[RADIX_KEY_LEN];
+	int plen = nd->plen;
+	memcpy(prefix, nd->prefix, nd->plen);
+	prefix[plen++] = nd->bytes[0];
+	memcpy(prefix + plen, only->prefix, only->plen);
+	only->plen += plen;
+	memcpy(only->prefix, prefix, only->plen);
+	child_remove(nd, 0);
+	node_free(nd, NULL);
+	return only;
+}
+
+// removes key and returns its value, NULL if it was not in the tree
+void *radix_remove(RadixTree *t, const uint8_t *key) {
+	void *value = radix_find(t, key);
+	if (value != NULL)
+		t->root = node_remove(t, t->root, key, 0);
+	return value;
+}
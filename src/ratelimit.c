@@ -0,0 +1,47 @@
+#include "common.h"
+#include <time.h>
+
+// Generic cell rate algorithm. A limit of count requests per period with
+// bursts of up to burst more is enforced through a single timestamp, the
+// theoretical arrival time (TAT) at which the limit would be back to full if
+// requests were spaced by the emission interval period / count. A request is
+// allowed when pushing the TAT by its cost keeps it within the tolerance
+// (burst + 1) * interval of now. A TAT in the past means the limit is full, so
+// stale entries need no expiry to behave as fresh ones.
+
+// wall clock time in microseconds, so that limits carry over a restart
+long long gcra_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static long long sat_mul(long long a, long long b) {
+	return b != 0 && a > RATE_MAX_US / b ? RATE_MAX_US : a * b;
+}
+
+// applies a request of quantity units at now, in microseconds like the period
+void gcra_throttle(RateLimit *rl, long long now, long long burst, long long count,
+				   long long period, long long quantity, RateLimitResult *res) {
+	// rates above one request per microsecond are rounded down to it
+	long long interval = period / count > 0 ? period / count : 1;
+	long long tolerance = sat_mul(interval, burst + 1);
+	long long increment = sat_mul(interval, quantity);
+	long long tat = rl->tat > now ? rl->tat : now;
+	long long new_tat = tat + increment;
+	long long ttl;
+	res->limit = burst + 1;
+	res->limited = new_tat - tolerance > now;
+	if (res->limited) {
+		// a request costing more than the whole tolerance is never allowed
+		res->retry_after = increment <= tolerance ? new_tat - tolerance - now : -1;
+		ttl = tat - now;
+	} else {
+		res->retry_after = -1;
+		rl->tat = new_tat;
+		ttl = new_tat - now;
+	}
+	long long left = tolerance - ttl;
+	res->remaining = left > 0 ? left / interval : 0;
+	res->reset_after = ttl;
+}
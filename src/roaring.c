@@ -0,0 +1,589 @@
+#include "common.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Roaring bitmap of 32 bit ids. The high 16 bits of an id select a container,
+// containers are kept sorted by that key, and the low 16 bits are stored in
+// the container as a sorted array, a 65536 bit bitmap or a list of runs.
+// Writes mark the containers they touch as dirty and roaring_optimize gives
+// each dirty container whichever encoding is smallest.
+
+static void container_init(RContainer *c, uint16_t key) {
+	c->type = RB_ARRAY;
+	c->key = key;
+	c->dirty = false;
+	c->card = 0;
+	c->n = c->cap = 0;
+	c->values = NULL;
+	c->words = NULL;
+}
+
+static void container_clear(RContainer *c) {
+	free(c->values);
+	free(c->words);
+}
+
+static void container_copy(RContainer *dst, RContainer *src) {
+	*dst = *src;
+	if (src->values != NULL) {
+		dst->values = dmalloc(src->cap * sizeof(uint16_t));
+		memcpy(dst->values, src->values, src->cap * sizeof(uint16_t));
+	}
+	if (src->words != NULL) {
+		dst->words = dmalloc(RB_BITMAP_WORDS * sizeof(uint64_t));
+		memcpy(dst->words, src->words, RB_BITMAP_WORDS * sizeof(uint64_t));
+	}
+}
+
+// index of the first value >= x
+static int lower_bound(uint16_t *values, int n, uint16_t x) {
+	int lo = 0, hi = n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (values[mid] < x)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void array_reserve(RContainer *c, int n) {
+	if (n <= c->cap)
+		return;
+	c->cap = c->cap * 2 > n ? c->cap * 2 : n;
+	c->values = drealloc(c->values, c->cap * sizeof(uint16_t));
+}
+
+// sets bits lo..hi inclusive
+static void words_set_range(uint64_t *words, int lo, int hi) {
+	int first = lo >> 6, last = hi >> 6;
+	uint64_t lmask = ~0ULL << (lo & 63), hmask = ~0ULL >> (63 - (hi & 63));
+	if (first == last) {
+		words[first] |= lmask & hmask;
+		return;
+	}
+	words[first] |= lmask;
+	for (int i = first + 1; i < last; i++)
+		words[i] = ~0ULL;
+	words[last] |= hmask;
+}
+
+static int words_count(uint64_t *words) {
+	return bit_count((uint8_t *)words, RB_BITMAP_WORDS * sizeof(uint64_t));
+}
+
+static void container_to_bitmap(RContainer *c) {
+	uint64_t *words = calloc(RB_BITMAP_WORDS, sizeof(uint64_t));
+	if (c->type == RB_ARRAY) {
+		for (int i = 0; i < c->card; i++)
+			words[c->values[i] >> 6] |= 1ULL << (c->values[i] & 63);
+	} else if (c->type == RB_RUN) {
+		for (int i = 0; i < c->n; i++)
+			words_set_range(words, c->values[2 * i], c->values[2 * i] + c->values[2 * i + 1]);
+	}
+	free(c->values);
+	c->values = NULL;
+	c->n = c->cap = 0;
+	c->words = words;
+	c->type = RB_BITMAP;
+}
+
+// writes the values of c in order to out, which has room for c->card
+static void container_values(RContainer *c, uint16_t *out) {
+	int k = 0;
+	switch (c->type) {
+	case RB_ARRAY:
+		memcpy(out, c->values, c->card * sizeof(uint16_t));
+		break;
+	case RB_BITMAP:
+		for (int i = 0; i < RB_BITMAP_WORDS; i++) {
+			for (uint64_t w = c->words[i]; w != 0; w &= w - 1)
+				out[k++] = i * 64 + __builtin_ctzll(w);
+		}
+		break;
+	case RB_RUN:
+		for (int i = 0; i < c->n; i++) {
+			int start = c->values[2 * i], end = start + c->values[2 * i + 1];
+			for (int v = start; v <= end; v++)
+				out[k++] = v;
+		}
+		break;
+	}
+}
+
+static void container_to_array(RContainer *c) {
+	int cap = c->card > 0 ? c->card : 1;
+	uint16_t *values = dmalloc(cap * sizeof(uint16_t));
+	container_values(c, values);
+	container_clear(c);
+	c->words = NULL;
+	c->values = values;
+	c->cap = cap;
+	c->n = 0;
+	c->type = RB_ARRAY;
+}
+
+static int container_nruns(RContainer *c) {
+	int runs = 0;
+	switch (c->type) {
+	case RB_ARRAY:
+		for (int i = 0; i < c->card; i++)
+			runs += i == 0 || c->values[i] != c->values[i - 1] + 1;
+		break;
+	case RB_BITMAP: {
+		// a run starts at every set bit whose lower neighbour is clear
+		uint64_t carry = 0;
+		for (int i = 0; i < RB_BITMAP_WORDS; i++) {
+			uint64_t w = c->words[i];
+			runs += __builtin_popcountll(w & ~(w << 1 | carry));
+			carry = w >> 63;
+		}
+		break;
+	}
+	case RB_RUN:
+		runs = c->n;
+		break;
+	}
+	return runs;
+}
+
+static void container_to_run(RContainer *c, int nruns) {
+	uint16_t *values = dmalloc(c->card * sizeof(uint16_t));
+	uint16_t *runs = dmalloc(2 * nruns * sizeof(uint16_t));
+	container_values(c, values);
+	int k = -1;
+	for (int i = 0; i < c->card; i++) {
+		if (i > 0 && values[i] == values[i - 1] + 1) {
+			runs[2 * k + 1]++;
+		} else {
+			k++;
+			runs[2 * k] = values[i];
+			runs[2 * k + 1] = 0;
+		}
+	}
+	free(values);
+	container_clear(c);
+	c->words = NULL;
+	c->values = runs;
+	c->n = nruns;
+	c->cap = 2 * nruns;
+	c->type = RB_RUN;
+}
+
+// gives c the smallest of the three encodings, arrays hold at most
+// RB_ARRAY_MAX values
+static void container_optimize(RContainer *c) {
+	c->dirty = false;
+	if (c->card == 0)
+		return;
+	int nruns = container_nruns(c);
+	int run_bytes = 4 * nruns, bitmap_bytes = RB_BITMAP_WORDS * sizeof(uint64_t);
+	int array_bytes = c->card <= RB_ARRAY_MAX ? 2 * c->card : bitmap_bytes + 1;
+	if (run_bytes < array_bytes && run_bytes < bitmap_bytes) {
+		if (c->type != RB_RUN)
+			container_to_run(c, nruns);
+	} else if (array_bytes <= bitmap_bytes) {
+		if (c->type != RB_ARRAY)
+			container_to_array(c);
+	} else if (c->type != RB_BITMAP) {
+		container_to_bitmap(c);
+	}
+}
+
+static bool container_contains(RContainer *c, uint16_t x) {
+	switch (c->type) {
+	case RB_ARRAY: {
+		int i = lower_bound(c->values, c->card, x);
+		return i < c->card && c->values[i] == x;
+	}
+	case RB_BITMAP:
+		return c->words[x >> 6] >> (x & 63) & 1;
+	case RB_RUN: {
+		// last run starting at or before x
+		int lo = 0, hi = c->n;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (c->values[2 * mid] <= x)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo > 0 && x - c->values[2 * (lo - 1)] <= c->values[2 * (lo - 1) + 1];
+	}
+	}
+	return false;
+}
+
+// writes into a run container go through an array or a bitmap, the next
+// optimize folds them back into runs
+static void container_unrun(RContainer *c) {
+	if (c->type != RB_RUN)
+		return;
+	if (c->card < RB_ARRAY_MAX)
+		container_to_array(c);
+	else
+		container_to_bitmap(c);
+}
+
+static bool container_add(RContainer *c, uint16_t x) {
+	if (container_contains(c, x))
+		return false;
+	container_unrun(c);
+	if (c->type == RB_ARRAY && c->card == RB_ARRAY_MAX)
+		container_to_bitmap(c);
+	if (c->type == RB_ARRAY) {
+		int i = lower_bound(c->values, c->card, x);
+		array_reserve(c, c->card + 1);
+		memmove(c->values + i + 1, c->values + i, (c->card - i) * sizeof(uint16_t));
+		c->values[i] = x;
+	} else {
+		c->words[x >> 6] |= 1ULL << (x & 63);
+	}
+	c->card++;
+	c->dirty = true;
+	return true;
+}
+
+static bool container_rem(RContainer *c, uint16_t x) {
+	if (!container_contains(c, x))
+		return false;
+	container_unrun(c);
+	if (c->type == RB_ARRAY) {
+		int i = lower_bound(c->values, c->card, x);
+		memmove(c->values + i, c->values + i + 1, (c->card - i - 1) * sizeof(uint16_t));
+	} else {
+		c->words[x >> 6] &= ~(1ULL << (x & 63));
+	}
+	c->card--;
+	c->dirty = true;
+	return true;
+}
+
+// intersection of two sorted arrays, returns its length. With SSE2 blocks of
+// 8 values are compared all against all by rotating one of them a lane at a
+// time, and the block with the smaller maximum moves on.
+static int array_and(uint16_t *a, int na, uint16_t *b, int nb, uint16_t *out) {
+	int i = 0, j = 0, k = 0;
+	// a much smaller array is looked up rather than merged
+	if (na * 64 < nb || nb * 64 < na) {
+		uint16_t *small = na < nb ? a : b, *large = na < nb ? b : a;
+		int ns = na < nb ? na : nb, nl = na < nb ? nb : na;
+		for (; i < ns; i++) {
+			j += lower_bound(large + j, nl - j, small[i]);
+			if (j < nl && large[j] == small[i])
+				out[k++] = small[i];
+		}
+		return k;
+	}
+#ifdef __SSE2__
+	while (i + 8 <= na && j + 8 <= nb) {
+		__m128i va = _mm_loadu_si128((__m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((__m128i *)(b + j));
+		__m128i eq = _mm_cmpeq_epi16(va, vb);
+		for (int r = 1; r < 8; r++) {
+			vb = _mm_or_si128(_mm_srli_si128(vb, 2), _mm_slli_si128(vb, 14));
+			eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, vb));
+		}
+		int mask = _mm_movemask_epi8(eq);
+		for (int l = 0; l < 8; l++) {
+			if (mask >> (2 * l) & 1)
+				out[k++] = a[i + l];
+		}
+		uint16_t amax = a[i + 7], bmax = b[j + 7];
+		if (amax <= bmax)
+			i += 8;
+		if (bmax <= amax)
+			j += 8;
+	}
+#endif
+	while (i < na && j < nb) {
+		if (a[i] < b[j]) {
+			i++;
+		} else if (a[i] > b[j]) {
+			j++;
+		} else {
+			out[k++] = a[i];
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+static int array_or(uint16_t *a, int na, uint16_t *b, int nb, uint16_t *out) {
+	int i = 0, j = 0, k = 0;
+	while (i < na && j < nb) {
+		if (a[i] < b[j])
+			out[k++] = a[i++];
+		else if (a[i] > b[j])
+			out[k++] = b[j++];
+		else {
+			out[k++] = a[i++];
+			j++;
+		}
+	}
+	while (i < na)
+		out[k++] = a[i++];
+	while (j < nb)
+		out[k++] = b[j++];
+	return k;
+}
+
+static int array_andnot(uint16_t *a, int na, uint16_t *b, int nb, uint16_t *out) {
+	int i = 0, j = 0, k = 0;
+	while (i < na) {
+		while (j < nb && b[j] < a[i])
+			j++;
+		if (j == nb || b[j] != a[i])
+			out[k++] = a[i];
+		i++;
+	}
+	return k;
+}
+
+// values of the array container a kept or dropped by the bitmap b
+static void array_filter(RContainer *dst, RContainer *a, RContainer *b, bool keep) {
+	dst->values = dmalloc((a->card > 0 ? a->card : 1) * sizeof(uint16_t));
+	dst->cap = a->card > 0 ? a->card : 1;
+	for (int i = 0; i < a->card; i++) {
+		uint16_t x = a->values[i];
+		if ((bool)(b->words[x >> 6] >> (x & 63) & 1) == keep)
+			dst->values[dst->card++] = x;
+	}
+}
+
+// dst = a op b for two containers with the same key, neither a run container
+static void container_op(RContainer *dst, RContainer *a, RContainer *b, int op) {
+	container_init(dst, a->key);
+	dst->dirty = true;
+	if (a->type == RB_ARRAY && b->type == RB_ARRAY) {
+		int n = op == SET_UNION ? a->card + b->card : a->card;
+		dst->values = dmalloc((n > 0 ? n : 1) * sizeof(uint16_t));
+		dst->cap = n > 0 ? n : 1;
+		if (op == SET_INTER)
+			dst->card = array_and(a->values, a->card, b->values, b->card, dst->values);
+		else if (op == SET_UNION)
+			dst->card = array_or(a->values, a->card, b->values, b->card, dst->values);
+		else
+			dst->card = array_andnot(a->values, a->card, b->values, b->card, dst->values);
+		if (dst->card > RB_ARRAY_MAX)
+			container_to_bitmap(dst);
+		return;
+	}
+	if (op == SET_INTER && (a->type == RB_ARRAY || b->type == RB_ARRAY)) {
+		if (a->type == RB_ARRAY)
+			array_filter(dst, a, b, true);
+		else
+			array_filter(dst, b, a, true);
+		return;
+	}
+	if (op == SET_DIFF && a->type == RB_ARRAY) {
+		array_filter(dst, a, b, false);
+		return;
+	}
+	// the result is built on a bitmap, b may still be an array
+	RContainer *base = a->type == RB_BITMAP ? a : b, *other = base == a ? b : a;
+	dst->type = RB_BITMAP;
+	dst->words = dmalloc(RB_BITMAP_WORDS * sizeof(uint64_t));
+	memcpy(dst->words, base->words, RB_BITMAP_WORDS * sizeof(uint64_t));
+	if (other->type == RB_BITMAP) {
+		int bop = op == SET_INTER ? BITOP_AND : op == SET_UNION ? BITOP_OR : BITOP_ANDNOT;
+		bit_combine(bop, (uint8_t *)dst->words, (uint8_t *)other->words,
+					RB_BITMAP_WORDS * sizeof(uint64_t));
+	} else {
+		for (int i = 0; i < other->card; i++) {
+			uint16_t x = other->values[i];
+			if (op == SET_UNION)
+				dst->words[x >> 6] |= 1ULL << (x & 63);
+			else
+				dst->words[x >> 6] &= ~(1ULL << (x & 63));
+		}
+	}
+	dst->card = words_count(dst->words);
+}
+
+// copy of c, expanded if it is a run container so it can take part in an op
+static RContainer *container_operand(RContainer *c, RContainer *tmp) {
+	if (c->type != RB_RUN)
+		return c;
+	container_copy(tmp, c);
+	container_unrun(tmp);
+	return tmp;
+}
+
+// index of the container with key, or where it would be inserted
+static int roaring_find(Roaring *rb, uint16_t key) {
+	int lo = 0, hi = rb->n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (rb->containers[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static RContainer *roaring_append(Roaring *rb) {
+	if (rb->n == rb->cap) {
+		rb->cap = rb->cap == 0 ? 4 : rb->cap * 2;
+		rb->containers = drealloc(rb->containers, rb->cap * sizeof(RContainer));
+	}
+	return &rb->containers[rb->n++];
+}
+
+Roaring *roaring_init() {
+	Roaring *rb = dmalloc(sizeof(Roaring));
+	rb->card = 0;
+	rb->n = rb->cap = 0;
+	rb->containers = NULL;
+	return rb;
+}
+
+void roaring_free(Roaring *rb) {
+	if (rb == NULL)
+		return;
+	for (int i = 0; i < rb->n; i++)
+		container_clear(&rb->containers[i]);
+	free(rb->containers);
+	free(rb);
+}
+
+bool roaring_add(Roaring *rb, uint32_t x) {
+	uint16_t key = x >> 16;
+	int i = roaring_find(rb, key);
+	if (i == rb->n || rb->containers[i].key != key) {
+		roaring_append(rb);
+		memmove(rb->containers + i + 1, rb->containers + i,
+				(rb->n - i - 1) * sizeof(RContainer));
+		container_init(&rb->containers[i], key);
+	}
+	if (!container_add(&rb->containers[i], x & 0xffff))
+		return false;
+	rb->card++;
+	return true;
+}
+
+bool roaring_rem(Roaring *rb, uint32_t x) {
+	uint16_t key = x >> 16;
+	int i = roaring_find(rb, key);
+	if (i == rb->n || rb->containers[i].key != key)
+		return false;
+	RContainer *c = &rb->containers[i];
+	if (!container_rem(c, x & 0xffff))
+		return false;
+	rb->card--;
+	if (c->card == 0) {
+		container_clear(c);
+		memmove(rb->containers + i, rb->containers + i + 1, (rb->n - i - 1) * sizeof(RContainer));
+		rb->n--;
+	}
+	return true;
+}
+
+bool roaring_contains(Roaring *rb, uint32_t x) {
+	uint16_t key = x >> 16;
+	int i = roaring_find(rb, key);
+	return i < rb->n && rb->containers[i].key == key &&
+		   container_contains(&rb->containers[i], x & 0xffff);
+}
+
+// re-encodes the containers written to since the last call
+void roaring_optimize(Roaring *rb) {
+	for (int i = 0; i < rb->n; i++) {
+		if (rb->containers[i].dirty)
+			container_optimize(&rb->containers[i]);
+	}
+}
+
+// all ids in ascending order, rb->card of them
+uint32_t *roaring_members(Roaring *rb) {
+	uint32_t *res = dmalloc((rb->card > 0 ? rb->card : 1) * sizeof(uint32_t));
+	uint16_t *low = dmalloc(65536 * sizeof(uint16_t));
+	long long k = 0;
+	for (int i = 0; i < rb->n; i++) {
+		RContainer *c = &rb->containers[i];
+		container_values(c, low);
+		for (int j = 0; j < c->card; j++)
+			res[k++] = (uint32_t)c->key << 16 | low[j];
+	}
+	free(low);
+	return res;
+}
+
+static Roaring *roaring_copy(Roaring *rb) {
+	Roaring *res = roaring_init();
+	for (int i = 0; i < rb->n; i++)
+		container_copy(roaring_append(res), &rb->containers[i]);
+	res->card = rb->card;
+	return res;
+}
+
+// a op b, walking both container lists in key order
+static Roaring *roaring_op2(Roaring *a, Roaring *b, int op) {
+	Roaring *res = roaring_init();
+	int i = 0, j = 0;
+	while (i < a->n || j < b->n) {
+		RContainer *ca = i < a->n ? &a->containers[i] : NULL;
+		RContainer *cb = j < b->n ? &b->containers[j] : NULL;
+		if (cb == NULL || (ca != NULL && ca->key < cb->key)) {
+			if (op != SET_INTER)
+				container_copy(roaring_append(res), ca);
+			i++;
+		} else if (ca == NULL || cb->key < ca->key) {
+			if (op == SET_UNION)
+				container_copy(roaring_append(res), cb);
+			j++;
+		} else {
+			RContainer ta, tb, out;
+			RContainer *oa = container_operand(ca, &ta), *ob = container_operand(cb, &tb);
+			container_op(&out, oa, ob, op);
+			if (oa == &ta)
+				container_clear(&ta);
+			if (ob == &tb)
+				container_clear(&tb);
+			if (out.card > 0)
+				*roaring_append(res) = out;
+			else
+				container_clear(&out);
+			i++;
+			j++;
+		}
+	}
+	for (int k = 0; k < res->n; k++)
+		res->card += res->containers[k].card;
+	return res;
+}
+
+static int roaring_cmp_card(const void *a, const void *b) {
+	Roaring *x = *(Roaring **)a, *y = *(Roaring **)b;
+	long long cx = x != NULL ? x->card : -1, cy = y != NULL ? y->card : -1;
+	return (cx > cy) - (cx < cy);
+}
+
+// folds the bitmaps with op from left to right, missing bitmaps (NULL) are
+// empty. Intersections start from the smallest bitmap.
+Roaring *roaring_op(Roaring **rbs, int n, int op) {
+	Roaring **order = dmalloc(n * sizeof(Roaring *));
+	memcpy(order, rbs, n * sizeof(Roaring *));
+	if (op == SET_INTER)
+		qsort(order, n, sizeof(Roaring *), roaring_cmp_card);
+	Roaring *res = order[0] != NULL ? roaring_copy(order[0]) : roaring_init();
+	for (int i = 1; i < n && !(op == SET_INTER && res->card == 0); i++) {
+		// missing bitmaps sort first for intersections, which then stop at once
+		if (order[i] == NULL)
+			continue;
+		Roaring *tmp = roaring_op2(res, order[i], op);
+		roaring_free(res);
+		res = tmp;
+	}
+	free(order);
+	roaring_optimize(res);
+	return res;
+}
@@ -1,9 +1,11 @@
 #include <ctype.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
@@ -70,10 +72,17 @@ void close_client(int cfd) {
 	close(cfd);
 }
 
+// returns NULL once the peer has closed the connection
 char *readline(int cfd) {
-	char *msg = dmalloc(1024 * sizeof(char));
-	read(cfd, msg, 1024);
-	msg[strlen(msg) - 1] = '\0';
+	char *msg = dmalloc(1025 * sizeof(char));
+	int n = read(cfd, msg, 1024);
+	if (n <= 0) {
+		free(msg);
+		return NULL;
+	}
+	msg[n] = '\0';
+	if (strlen(msg) > 0)
+		msg[strlen(msg) - 1] = '\0';
 	log_trace("Read from client fd %d: %s", cfd, msg);
 	return msg;
 }
@@ -86,32 +95,155 @@ void writeline(int cfd, char *msg) {
 	free(tmp);
 }
 
+// replies wait here while the append only log is on, in the order they were
+// made and so by increasing offset
+static struct {
+	int n;
+	int cap;
+	HeldReply *items;
+} held;
+
+// sends msg to cfd, or holds it back while the log is not durable up to the
+// commands run so far, which msg may acknowledge or have read the effect of
+void send_reply(int cfd, char *msg) {
+	if (!aof_enabled() || aof_durable() >= aof_offset()) {
+		writeline(cfd, msg);
+		return;
+	}
+	if (held.n == held.cap) {
+		held.cap = held.cap == 0 ? 16 : held.cap * 2;
+		held.items = drealloc(held.items, held.cap * sizeof(HeldReply));
+	}
+	held.items[held.n++] = (HeldReply){cfd, aof_offset(), strdup(msg)};
+}
+
+static void send_held() {
+	if (held.n == 0)
+		return;
+	long long durable = aof_durable();
+	int i = 0;
+	for (; i < held.n && held.items[i].offset <= durable; i++) {
+		writeline(held.items[i].cfd, held.items[i].msg);
+		free(held.items[i].msg);
+	}
+	held.n -= i;
+	memmove(held.items, held.items + i, held.n * sizeof(HeldReply));
+}
+
+// drops the held replies of a disconnected client
+static void drop_held(int cfd) {
+	int n = 0;
+	for (int i = 0; i < held.n; i++) {
+		if (held.items[i].cfd == cfd)
+			free(held.items[i].msg);
+		else
+			held.items[n++] = held.items[i];
+	}
+	held.n = n;
+}
+
+// handles one command from a readable client, returns 1 on shutdown, -1 when
+// the client is gone and 0 otherwise
 int rediskw(int cfd, HashTable *ht) {
-	log_debug("Started processing commands for client fd: %d", cfd);
+	char *msg = readline(cfd);
+	if (msg == NULL) {
+		log_info("Client disconnected, fd: %d", cfd);
+		return -1;
+	}
+	log_debug("Received command: %s", msg);
+
+	Command *cmd = parse(msg);
+	if (cmd->type == UNKNOWN) {
+		log_warn("Unknown command received from client fd: %d", cfd);
+	}
+
+	block_set_client(cfd);
+	char *resp = interpret(ht, cmd);
+	log_debug("Command processed, response type: %c", *resp);
+	free(msg);
+
+	int code = 0;
+	switch (*resp) {
+	case 'q':
+		log_info("Client requested to quit, fd: %d", cfd);
+		code = -1;
+		break;
+	case 'x':
+		log_info("Server shutdown requested by client fd: %d", cfd);
+		code = 1;
+		break;
+	case 'b':
+		log_debug("Client fd %d is blocked", cfd);
+		break;
+	default:
+		send_reply(cfd, resp);
+	}
+	free(resp);
+	// the command may have pushed to keys other clients are blocked on
+	block_serve(ht);
+	return code;
+}
+
+// event loop multiplexing all clients, blocked clients simply stay idle until
+// a push serves them or their timeout passes. The commands of an iteration go
+// to the append only log in one write at the start of the next one, and
+// fds[1] wakes the loop once they are synced. fds[2] is where a new process
+// asks to take over. Returns 1 on shutdown and 2 once handed over.
+int serve(int sfd, HashTable *ht) {
+	struct pollfd fds[MAX_CLIENTS + 3];
+	int nfds = 3;
+	fds[0].fd = sfd;
+	fds[0].events = POLLIN;
+	// a negative fd, with no log or fsync thread, is ignored by poll
+	fds[1].fd = aof_notify_fd();
+	fds[1].events = POLLIN;
+	fds[2].fd = handover_fd();
+	fds[2].events = POLLIN;
 	while (1) {
-		char *msg = readline(cfd);
-		// msg[strcspn(msg, "\n")] = 0;
-		log_debug("Received command: %s", msg);
+		// lookups stamp items with it, for snapshots to order keys by
+		ht->clock = time(NULL);
+		aof_flush();
+		send_held();
+		int ready = poll(fds, nfds, aof_timeout(snapshot_timeout(block_timeout())));
+		block_expire();
+		snapshot_poll(false);
+		aof_rewrite_poll(ht, false);
+		if (ready <= 0)
+			continue;
+		if (fds[1].revents & POLLIN)
+			aof_poll();
+		if ((fds[2].revents & POLLIN) && handover_send(sfd, ht)) {
+			send_held();
+			return 2;
+		}
 
-		Command *cmd = parse(msg);
-		if (cmd->type == UNKNOWN) {
-			log_warn("Unknown command received from client fd: %d", cfd);
+		for (int i = 3; i < nfds; i++) {
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			int code = rediskw(fds[i].fd, ht);
+			if (code == 1)
+				return 1;
+			if (code < 0) {
+				block_remove(fds[i].fd);
+				drop_held(fds[i].fd);
+				close_client(fds[i].fd);
+				fds[i] = fds[--nfds];
+				i--;
+			}
 		}
 
-		char *resp = interpret(ht, cmd);
-		log_debug("Command processed, response type: %c", *resp);
-
-		switch (*resp) {
-		case 'q':
-			log_info("Client requested to quit, fd: %d", cfd);
-			return 0;
-		case 'x':
-			log_info("Server shutdown requested by client fd: %d", cfd);
-			return 1;
-		default:
-			writeline(cfd, resp);
+		if (fds[0].revents & POLLIN) {
+			int cfd = accept_connection(sfd);
+			if (nfds > MAX_CLIENTS + 2) {
+				log_warn("Too many clients, rejecting fd: %d", cfd);
+				close_client(cfd);
+				continue;
+			}
+			log_info("Accepted new client connection, fd: %d", cfd);
+			fds[nfds].fd = cfd;
+			fds[nfds].events = POLLIN;
+			fds[nfds++].revents = 0;
 		}
-		free(msg);
 	}
 	return 0;
 }
@@ -121,3 +121,95 @@ char **set_members(Set *set) {
 	}
 	return members;
 }
+
+// sets are ordered by cardinality so intersections iterate the smallest one
+// and probe the rest, missing keys (NULL) sort first
+static int set_cmp_used(const void *a, const void *b) {
+	Set *x = *(Set **)a, *y = *(Set **)b;
+	int nx = x != NULL ? x->used : 0, ny = y != NULL ? y->used : 0;
+	return nx - ny;
+}
+
+static bool set_in_all(Set **sets, int n, char *key) {
+	for (int j = 1; j < n; j++) {
+		if (!set_ismember(sets[j], key))
+			return false;
+	}
+	return true;
+}
+
+static Set *set_inter(Set **sets, int n) {
+	qsort(sets, n, sizeof(Set *), set_cmp_used);
+	if (sets[0] == NULL || sets[0]->used == 0)
+		return set_init(HT_BASE_SIZE);
+	Set *res = set_init(sets[0]->used * 2);
+	for (int i = 0; i < sets[0]->size; i++) {
+		char *cur_item = sets[0]->members[i];
+		if (cur_item != NULL && !is_deleted(cur_item) && set_in_all(sets, n, cur_item))
+			set_add(res, cur_item);
+	}
+	return res;
+}
+
+static Set *set_union(Set **sets, int n) {
+	int total = 0;
+	for (int i = 0; i < n; i++)
+		total += sets[i] != NULL ? sets[i]->used : 0;
+	Set *res = set_init(total * 2);
+	for (int i = 0; i < n; i++) {
+		if (sets[i] == NULL)
+			continue;
+		for (int j = 0; j < sets[i]->size; j++) {
+			char *cur_item = sets[i]->members[j];
+			if (cur_item != NULL && !is_deleted(cur_item))
+				set_add(res, cur_item);
+		}
+	}
+	return res;
+}
+
+static Set *set_diff(Set **sets, int n) {
+	if (sets[0] == NULL)
+		return set_init(HT_BASE_SIZE);
+	Set *res = set_init(sets[0]->used * 2);
+	for (int i = 0; i < sets[0]->size; i++) {
+		char *cur_item = sets[0]->members[i];
+		if (cur_item == NULL || is_deleted(cur_item))
+			continue;
+		int j = 1;
+		while (j < n && (sets[j] == NULL || !set_ismember(sets[j], cur_item)))
+			j++;
+		if (j == n)
+			set_add(res, cur_item);
+	}
+	return res;
+}
+
+// sets may contain NULL for missing keys, the array is reordered for SET_INTER
+Set *set_op(Set **sets, int n, int op) {
+	switch (op) {
+	case SET_INTER:
+		return set_inter(sets, n);
+	case SET_UNION:
+		return set_union(sets, n);
+	default:
+		return set_diff(sets, n);
+	}
+}
+
+// counts the intersection without building it, stopping once limit is
+// reached (limit 0 means no limit)
+int set_intercard(Set **sets, int n, int limit) {
+	qsort(sets, n, sizeof(Set *), set_cmp_used);
+	if (sets[0] == NULL)
+		return 0;
+	int count = 0;
+	for (int i = 0; i < sets[0]->size; i++) {
+		char *cur_item = sets[0]->members[i];
+		if (cur_item != NULL && !is_deleted(cur_item) && set_in_all(sets, n, cur_item)) {
+			if (++count == limit)
+				break;
+		}
+	}
+	return count;
+}
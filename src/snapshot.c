@@ -0,0 +1,1948 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Point in time snapshots of the keyspace. A snapshot is a magic string and a
+// version, then the length of the whole snapshot, the offset of its section
+// index, the number of keys and the time it was saved. Keys follow as records
+// grouped into sections of about SNAPSHOT_SECTION_BYTES, each compressed with
+// lz.c unless that does not make it smaller. Each section holds keys of one of
+// SNAPSHOT_HEAT_CLASSES classes of how long ago they were last accessed. The
+// index lists the offset, length, key count, codec, uncompressed length and
+// CRC32C of every section, the age of its most recently accessed key and a
+// bloom filter of its key names, then a CRC32C of the header and the index,
+// before SNAPSHOT_EOF closes the snapshot. Lengths and counts are varints and
+// fixed size fields are little endian.
+//
+// A record is its length, then the key's type, the seconds from its last
+// access to the save, its NUL terminated name, the encoding of the value and
+// the value. Integer strings are written as varints,
+// lists as their packed chunks, sets of integers as sorted deltas and small
+// hashes as one blob of NUL terminated fields and values. Other values are
+// written in their in-memory layout, so sketches, filters and time series
+// chunks are copied back verbatim, while sorted sets and larger hashes and sets
+// are written as their elements. Streams and vector sets serialize themselves
+// in stream.c and vset.c.
+//
+// Loading maps the file and decompresses and decodes sections on up to
+// SNAPSHOT_LOAD_THREADS threads, reading names, chunks and blobs in place from
+// the mapping or the decompressed section, while the main thread links the
+// values into a table sized for every key up front, the most recently accessed
+// sections first. Version 1 snapshots, a flat stream of keys without lengths or
+// sections, are still read sequentially, version 2 to 4 ones without recency
+// and version 2 and 3 ones without checksums, version 2 ones as uncompressed
+// sections. Each loader thread checks the CRC of a section before
+// decompressing it, so a damaged snapshot fails to load instead of loading
+// damaged values.
+//
+// At startup the server serves while a snapshot loads, the event loop linking
+// SNAPSHOT_LOAD_KEYS keys per iteration. Before a command runs, every section
+// whose filter may hold one of its arguments is linked, so commands see the
+// keys they name as they were saved, and a write is never overwritten by a
+// key loaded after it.
+//
+// BGSAVE forks and the child writes the snapshot while the parent keeps
+// serving, the kernel copying the pages the parent writes to in the meantime.
+// The child reports how many pages ended up copied before it exits. Either way
+// the file is written sequentially through one buffer to a temporary file that
+// is renamed over the previous snapshot once synced.
+//
+// In SNAPSHOT_INCREMENTAL mode BGSAVE and log rewrites do not fork. A
+// checkpoint walks SNAPSHOT_CHECKPOINT_SLOTS slots of the table per event
+// loop iteration instead, and before a write runs, the keys it names that the
+// walk has not reached yet are saved as they are. Keys are stamped with the
+// checkpoint that saved them, and keys set meanwhile with the running one, so
+// the walk skips both and the checkpoint holds the keyspace as it was when it
+// started, the position in the log from which a rewrite's commands follow it.
+
+#define SNAPSHOT_EOF 0xff
+
+// how a value is laid out, ENC_PLAIN being the layout of version 1
+enum SnapEncoding { ENC_PLAIN, ENC_INT, ENC_INTSET, ENC_PACKED, ENC_SMALL };
+
+enum SnapCodec { CODEC_RAW, CODEC_LZ };
+
+typedef struct SnapSection {
+	long long offset;
+	long long length;
+	long long nkeys;
+	int codec;
+	// bytes once decompressed
+	long long raw;
+	// of the bytes as stored
+	uint32_t crc;
+	// seconds from the last access to any of its keys to the save
+	unsigned int newest;
+	// the names of its keys, NULL before version 5
+	Bloom *filter;
+} SnapSection;
+
+typedef struct SnapEntry {
+	// points into the mapped file or the decompressed section
+	char *key;
+	int type;
+	unsigned int access;
+	void *value;
+} SnapEntry;
+
+enum PartState { PART_PENDING, PART_DECODING, PART_READY, PART_DAMAGED };
+
+// the keys decoded from one section
+typedef struct SnapPart {
+	// the decompressed section, NULL if it was stored as is
+	uint8_t *raw;
+	SnapEntry *entries;
+	long long n;
+	int state;
+	// entries in the table so far, and whether all are, only touched by the
+	// main thread
+	long long linked;
+	bool done;
+} SnapPart;
+
+// a snapshot being loaded, its sections decoded on loader threads and linked
+// into the table by the main thread
+typedef struct SnapLoad {
+	HashTable *ht;
+	char *path;
+	uint8_t *map;
+	long long size;
+	const uint8_t *base;
+	int version;
+	// when it was saved, 0 before version 5
+	long long saved;
+	long long total;
+	long long nkeys;
+	long long loaded;
+	SnapSection *sections;
+	SnapPart *parts;
+	int nsections;
+	// sections in the order they are linked, the most recently accessed first
+	int *order;
+	// the next of order to decode and the first not linked yet
+	int next;
+	int cursor;
+	// sections decoded and not linked yet, at most SNAPSHOT_LOAD_AHEAD per
+	// thread
+	int ready;
+	bool stop;
+	pthread_t threads[SNAPSHOT_LOAD_THREADS];
+	int nthreads;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	long long start;
+} SnapLoad;
+
+static struct {
+	char *path;
+	int mode;
+	// pid of the child writing a background snapshot, 0 when none is running
+	pid_t child;
+	// the checkpoint being written without forking, NULL when none is running
+	struct Checkpoint *ckpt;
+	// the snapshot being loaded while serving, NULL when none is
+	SnapLoad *load;
+	// 1 if the last checkpoint written for a log rewrite succeeded, -1 if not
+	int ckpt_status;
+	// read end of the pipe the child reports its copy-on-write pages on
+	int report;
+	long long started;
+	long long last_save;
+	bool last_ok;
+	long long fork_us;
+	long long cow_pages;
+} snap = {.last_ok = true, .report = -1};
+
+static long long now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void snap_flush(SnapWriter *w) {
+	if (w->fd < 0) {
+		w->cap *= 2;
+		w->buf = drealloc(w->buf, w->cap);
+		return;
+	}
+	int off = 0;
+	while (!w->failed && off < w->len) {
+		ssize_t n = write(w->fd, w->buf + off, w->len - off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			w->failed = true;
+		else
+			off += n;
+	}
+	w->bytes += w->len;
+	w->len = 0;
+}
+
+void snap_put_bytes(SnapWriter *w, const void *p, size_t n) {
+	const uint8_t *src = p;
+	while (n > 0) {
+		if (w->len == w->cap)
+			snap_flush(w);
+		size_t k = w->cap - w->len;
+		if (k > n)
+			k = n;
+		memcpy(w->buf + w->len, src, k);
+		w->len += k;
+		src += k;
+		n -= k;
+	}
+}
+
+void snap_put_u8(SnapWriter *w, uint8_t x) {
+	if (w->len == w->cap)
+		snap_flush(w);
+	w->buf[w->len++] = x;
+}
+
+void snap_put_len(SnapWriter *w, uint64_t x) {
+	if (w->len + 10 > w->cap)
+		snap_flush(w);
+	while (x >= 0x80) {
+		w->buf[w->len++] = (x & 0x7f) | 0x80;
+		x >>= 7;
+	}
+	w->buf[w->len++] = x;
+}
+
+void snap_put_u64(SnapWriter *w, uint64_t x) {
+	uint8_t b[8];
+	for (int i = 0; i < 8; i++)
+		b[i] = x >> (8 * i);
+	snap_put_bytes(w, b, 8);
+}
+
+void snap_put_double(SnapWriter *w, double x) {
+	uint64_t u;
+	memcpy(&u, &x, sizeof(double));
+	snap_put_u64(w, u);
+}
+
+void snap_put_str(SnapWriter *w, const char *s, int len) {
+	snap_put_len(w, len);
+	snap_put_bytes(w, s, len);
+}
+
+// refills the buffer once it is used up, false at the end of the file
+static bool snap_fill(SnapReader *r) {
+	if (r->failed || r->fd < 0) {
+		r->failed = true;
+		return false;
+	}
+	int want = r->left < SNAPSHOT_BUF_BYTES ? r->left : SNAPSHOT_BUF_BYTES;
+	int n;
+	do
+		n = read(r->fd, r->buf, want);
+	while (n < 0 && errno == EINTR);
+	if (n <= 0) {
+		r->failed = true;
+		return false;
+	}
+	r->pos = 0;
+	r->len = n;
+	r->left -= n;
+	return true;
+}
+
+// whether n more bytes remain in the file, so that lengths read from a
+// damaged file cannot ask for more memory than the file holds
+bool snap_fits(SnapReader *r, uint64_t n) {
+	if (n > (uint64_t)(r->len - r->pos) + r->left)
+		r->failed = true;
+	return !r->failed;
+}
+
+// reads n bytes into p, zeros past the end of the file
+void snap_get_bytes(SnapReader *r, void *p, size_t n) {
+	uint8_t *dst = p;
+	while (n > 0) {
+		if (r->pos == r->len && !snap_fill(r)) {
+			memset(dst, 0, n);
+			return;
+		}
+		size_t k = r->len - r->pos;
+		if (k > n)
+			k = n;
+		memcpy(dst, r->buf + r->pos, k);
+		r->pos += k;
+		dst += k;
+		n -= k;
+	}
+}
+
+uint8_t snap_get_u8(SnapReader *r) {
+	if (r->pos == r->len && !snap_fill(r))
+		return 0;
+	return r->buf[r->pos++];
+}
+
+uint64_t snap_get_len(SnapReader *r) {
+	uint64_t x = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint8_t c = snap_get_u8(r);
+		x |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return x;
+	}
+	r->failed = true;
+	return 0;
+}
+
+uint64_t snap_get_u64(SnapReader *r) {
+	uint8_t b[8];
+	snap_get_bytes(r, b, 8);
+	uint64_t x = 0;
+	for (int i = 0; i < 8; i++)
+		x |= (uint64_t)b[i] << (8 * i);
+	return x;
+}
+
+double snap_get_double(SnapReader *r) {
+	uint64_t u = snap_get_u64(r);
+	double x;
+	memcpy(&x, &u, sizeof(double));
+	return x;
+}
+
+// a NUL terminated copy of the next string, empty past the end of the file
+char *snap_get_str(SnapReader *r, int *len) {
+	uint64_t n = snap_get_len(r);
+	if (n > INT32_MAX || !snap_fits(r, n))
+		n = 0;
+	char *s = dmalloc(n + 1);
+	snap_get_bytes(r, s, n);
+	s[n] = '\0';
+	if (len != NULL)
+		*len = n;
+	return s;
+}
+
+// the next n bytes in place, for readers without a file. NULL when fewer are
+// left.
+const uint8_t *snap_get_ref(SnapReader *r, uint64_t n) {
+	if (n > (uint64_t)(r->len - r->pos)) {
+		r->failed = true;
+		return NULL;
+	}
+	const uint8_t *p = r->buf + r->pos;
+	r->pos += n;
+	return p;
+}
+
+static uint64_t zigzag(long long x) { return ((uint64_t)x << 1) ^ (uint64_t)(x >> 63); }
+
+static long long unzigzag(uint64_t u) { return (long long)(u >> 1) ^ -(long long)(u & 1); }
+
+// whether s is an integer written the way %lld writes it, so that it reads
+// back the same
+static bool canonical_int(const char *s, int len, long long *x) {
+	if (len == 0 || len > 20 || (s[0] != '-' && (s[0] < '0' || s[0] > '9')))
+		return false;
+	char buf[24], *end;
+	memcpy(buf, s, len);
+	buf[len] = '\0';
+	errno = 0;
+	*x = strtoll(buf, &end, 10);
+	return errno == 0 && *end == '\0' && sprintf(buf, "%lld", *x) == len &&
+		   memcmp(buf, s, len) == 0;
+}
+
+static void save_string(SnapWriter *w, char *s, int enc) {
+	long long x;
+	if (enc == ENC_INT && canonical_int(s, str_len(s), &x))
+		snap_put_len(w, zigzag(x));
+	else
+		snap_put_str(w, s, str_len(s));
+}
+
+static char *load_string(SnapReader *r, int enc) {
+	if (enc == ENC_INT) {
+		char buf[24];
+		return str_new(buf, sprintf(buf, "%lld", unzigzag(snap_get_len(r))));
+	}
+	int len;
+	char *data = snap_get_str(r, &len);
+	char *s = str_new(data, len);
+	free(data);
+	return s;
+}
+
+static void save_hash(SnapWriter *w, HashTable *h) {
+	snap_put_len(w, h->used);
+	int pos = 0;
+	HashTableItem *item;
+	while ((item = htable_next(h, &pos)) != NULL) {
+		snap_put_str(w, item->key, strlen(item->key));
+		snap_put_str(w, item->value, str_len(item->value));
+	}
+}
+
+static HashTable *load_hash(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	HashTable *h = htable_init(n * 2 > HT_BASE_SIZE ? n * 2 : HT_BASE_SIZE);
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		char *field = snap_get_str(r, NULL), *value = snap_get_str(r, NULL);
+		htable_set(h, field, value);
+		free(field);
+		free(value);
+	}
+	return h;
+}
+
+// whether every field and value of h is free of NULs and there are few enough
+// of them to write as one blob
+static bool small_hash(HashTable *h) {
+	if (h->used > SNAPSHOT_SMALL_HASH)
+		return false;
+	int pos = 0;
+	HashTableItem *item;
+	while ((item = htable_next(h, &pos)) != NULL)
+		if (str_len(item->value) != (int)strlen(item->value))
+			return false;
+	return true;
+}
+
+static void save_small_hash(SnapWriter *w, HashTable *h) {
+	long long bytes = 0;
+	int pos = 0;
+	HashTableItem *item;
+	while ((item = htable_next(h, &pos)) != NULL)
+		bytes += strlen(item->key) + str_len(item->value) + 2;
+	snap_put_len(w, h->used);
+	snap_put_len(w, bytes);
+	pos = 0;
+	while ((item = htable_next(h, &pos)) != NULL) {
+		snap_put_bytes(w, item->key, strlen(item->key) + 1);
+		snap_put_bytes(w, item->value, str_len(item->value) + 1);
+	}
+}
+
+// fields and values are read in place from the blob
+static HashTable *load_small_hash(SnapReader *r) {
+	uint64_t n = snap_get_len(r), bytes = snap_get_len(r);
+	char *p = (char *)snap_get_ref(r, bytes), *end = p + bytes;
+	if (p == NULL || n > SNAPSHOT_SMALL_HASH || (bytes > 0 && end[-1] != '\0')) {
+		r->failed = true;
+		return NULL;
+	}
+	HashTable *h = htable_init(n * 2 > HT_BASE_SIZE ? n * 2 : HT_BASE_SIZE);
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		char *field = p;
+		p = field < end ? field + strlen(field) + 1 : end;
+		char *value = p;
+		p = value < end ? value + strlen(value) + 1 : end;
+		if (value == end)
+			r->failed = true;
+		else
+			htable_set(h, field, value);
+	}
+	if (p != end)
+		r->failed = true;
+	return h;
+}
+
+// the chunks are written as they are packed in memory
+static void save_list(SnapWriter *w, List *ls) {
+	int n = 0;
+	for (ListChunk *c = ls->head; c != NULL; c = c->next)
+		n += c->count > 0;
+	snap_put_len(w, n);
+	for (ListChunk *c = ls->head; c != NULL; c = c->next) {
+		if (c->count == 0)
+			continue;
+		snap_put_len(w, c->count);
+		snap_put_str(w, c->data + c->start, c->used - c->start);
+	}
+}
+
+static List *load_packed_list(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	List *ls = list_init();
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		uint64_t count = snap_get_len(r), bytes = snap_get_len(r);
+		const uint8_t *data = snap_get_ref(r, bytes);
+		if (data == NULL || count > INT32_MAX || bytes > INT32_MAX ||
+			!list_append_chunk(ls, (const char *)data, bytes, count))
+			r->failed = true;
+	}
+	return ls;
+}
+
+static List *load_list(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	List *ls = list_init();
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		char *value = snap_get_str(r, NULL);
+		list_rpush(ls, value);
+		free(value);
+	}
+	return ls;
+}
+
+// whether every member of set is an integer, which is then written as an intset
+static bool int_set(Set *set) {
+	char **members = set_members(set);
+	bool res = true;
+	long long x;
+	for (int i = 0; members[i] != NULL; i++) {
+		res = res && canonical_int(members[i], strlen(members[i]), &x);
+		free(members[i]);
+	}
+	free(members);
+	return res;
+}
+
+static int cmp_ll(const void *a, const void *b) {
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+// the smallest member, then the distance from each member to the next
+static void save_intset(SnapWriter *w, Set *set) {
+	char **members = set_members(set);
+	long long *ints = dmalloc((set->used > 0 ? set->used : 1) * sizeof(long long));
+	int n = 0;
+	for (; members[n] != NULL; n++) {
+		canonical_int(members[n], strlen(members[n]), &ints[n]);
+		free(members[n]);
+	}
+	free(members);
+	qsort(ints, n, sizeof(long long), cmp_ll);
+	snap_put_len(w, n);
+	for (int i = 0; i < n; i++)
+		snap_put_len(w, i == 0 ? zigzag(ints[0]) : (uint64_t)ints[i] - (uint64_t)ints[i - 1]);
+	free(ints);
+}
+
+static Set *load_intset(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	Set *set = set_init(n * 2 > HT_BASE_SIZE ? n * 2 : HT_BASE_SIZE);
+	uint64_t x = 0;
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		uint64_t d = snap_get_len(r);
+		x = i == 0 ? (uint64_t)unzigzag(d) : x + d;
+		char member[24];
+		sprintf(member, "%lld", (long long)x);
+		set_add(set, member);
+	}
+	return set;
+}
+
+static void save_set(SnapWriter *w, Set *set) {
+	snap_put_len(w, set->used);
+	char **members = set_members(set);
+	for (int i = 0; members[i] != NULL; i++) {
+		snap_put_str(w, members[i], strlen(members[i]));
+		free(members[i]);
+	}
+	free(members);
+}
+
+static Set *load_set(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	Set *set = set_init(n * 2 > HT_BASE_SIZE ? n * 2 : HT_BASE_SIZE);
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		char *member = snap_get_str(r, NULL);
+		set_add(set, member);
+		free(member);
+	}
+	return set;
+}
+
+static bool save_zset_member(char *member, double score, void *arg) {
+	snap_put_str(arg, member, strlen(member));
+	snap_put_double(arg, score);
+	return true;
+}
+
+static void save_zset(SnapWriter *w, ZSet *zs) {
+	snap_put_len(w, zs->len);
+	zset_scan(zs, -INFINITY, INFINITY, save_zset_member, w);
+}
+
+// members come in score order, so every insert lands at the end
+static ZSet *load_zset(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return NULL;
+	ZSet *zs = zset_init();
+	for (uint64_t i = 0; i < n && !r->failed; i++) {
+		char *member = snap_get_str(r, NULL);
+		zset_add(zs, member, snap_get_double(r));
+		free(member);
+	}
+	return zs;
+}
+
+static void save_hll(SnapWriter *w, HyperLogLog *hll) {
+	snap_put_u8(w, hll->dense);
+	if (hll->dense) {
+		snap_put_bytes(w, hll->registers, HLL_DENSE_BYTES);
+		return;
+	}
+	snap_put_len(w, hll->nsparse);
+	snap_put_bytes(w, hll->sparse, hll->nsparse * sizeof(uint32_t));
+}
+
+static HyperLogLog *load_hll(SnapReader *r) {
+	HyperLogLog *hll = hll_init();
+	hll->cached = false;
+	hll->dense = snap_get_u8(r);
+	if (hll->dense) {
+		hll->registers = dmalloc(HLL_DENSE_BYTES);
+		snap_get_bytes(r, hll->registers, HLL_DENSE_BYTES);
+		return hll;
+	}
+	uint64_t n = snap_get_len(r);
+	if (n > HLL_SPARSE_MAX || !snap_fits(r, n * sizeof(uint32_t)))
+		return hll;
+	hll->nsparse = hll->cap = n;
+	hll->sparse = dmalloc((n > 0 ? n : 1) * sizeof(uint32_t));
+	snap_get_bytes(r, hll->sparse, n * sizeof(uint32_t));
+	return hll;
+}
+
+// uint16_t values held by a container, n runs take two each
+static int container_nvalues(RContainer *c) {
+	return c->type == RB_ARRAY ? c->card : c->type == RB_RUN ? 2 * c->n : 0;
+}
+
+static void save_roaring(SnapWriter *w, Roaring *rb) {
+	snap_put_len(w, rb->n);
+	for (int i = 0; i < rb->n; i++) {
+		RContainer *c = &rb->containers[i];
+		snap_put_u8(w, c->type);
+		snap_put_len(w, c->key);
+		snap_put_u8(w, c->dirty);
+		snap_put_len(w, c->card);
+		snap_put_len(w, c->n);
+		if (c->type == RB_BITMAP)
+			snap_put_bytes(w, c->words, RB_BITMAP_WORDS * sizeof(uint64_t));
+		else
+			snap_put_bytes(w, c->values, container_nvalues(c) * sizeof(uint16_t));
+	}
+}
+
+static Roaring *load_roaring(SnapReader *r) {
+	uint64_t n = snap_get_len(r);
+	if (n > 1 << 16)
+		return NULL;
+	Roaring *rb = roaring_init();
+	rb->cap = n > 0 ? n : 1;
+	rb->containers = dmalloc(rb->cap * sizeof(RContainer));
+	for (; rb->n < (int)n && !r->failed; rb->n++) {
+		RContainer *c = &rb->containers[rb->n];
+		c->type = snap_get_u8(r);
+		c->key = snap_get_len(r);
+		c->dirty = snap_get_u8(r);
+		c->card = snap_get_len(r);
+		c->n = snap_get_len(r);
+		c->values = NULL;
+		c->words = NULL;
+		c->cap = 0;
+		rb->card += c->card;
+		if (c->type == RB_BITMAP) {
+			c->words = dmalloc(RB_BITMAP_WORDS * sizeof(uint64_t));
+			snap_get_bytes(r, c->words, RB_BITMAP_WORDS * sizeof(uint64_t));
+			continue;
+		}
+		int m = container_nvalues(c);
+		if (c->type > RB_RUN || c->card > 1 << 16 || c->n > 1 << 16) {
+			r->failed = true;
+			m = 0;
+		}
+		c->cap = m > 0 ? m : 1;
+		c->values = dmalloc(c->cap * sizeof(uint16_t));
+		snap_get_bytes(r, c->values, m * sizeof(uint16_t));
+	}
+	return rb;
+}
+
+static void save_bloom(SnapWriter *w, Bloom *bf) {
+	snap_put_double(w, bf->error);
+	snap_put_len(w, bf->expansion);
+	snap_put_u64(w, bf->count);
+	snap_put_len(w, bf->n);
+	for (int i = 0; i < bf->n; i++) {
+		BloomFilter *f = &bf->filters[i];
+		snap_put_u64(w, f->capacity);
+		snap_put_u64(w, f->count);
+		snap_put_len(w, f->k);
+		snap_put_len(w, f->nblocks);
+		snap_put_bytes(w, f->blocks, f->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+	}
+}
+
+static Bloom *load_bloom(SnapReader *r) {
+	double error = snap_get_double(r);
+	int expansion = snap_get_len(r);
+	long long count = snap_get_u64(r);
+	uint64_t n = snap_get_len(r);
+	if (n == 0 || !snap_fits(r, n))
+		return NULL;
+	Bloom *bf = dmalloc(sizeof(Bloom));
+	bf->error = error;
+	bf->expansion = expansion;
+	bf->count = count;
+	bf->filters = dmalloc(n * sizeof(BloomFilter));
+	for (bf->n = 0; bf->n < (int)n && !r->failed; bf->n++) {
+		BloomFilter *f = &bf->filters[bf->n];
+		f->capacity = snap_get_u64(r);
+		f->count = snap_get_u64(r);
+		f->k = snap_get_len(r);
+		f->nblocks = snap_get_len(r);
+		size_t size = f->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+		if (f->nblocks == 0 || !snap_fits(r, size)) {
+			f->nblocks = 1;
+			size = BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+		}
+		f->blocks = aligned_alloc(64, size);
+		if (f->blocks == NULL) {
+			log_fatal("Memory allocation failed for %zu bytes", size);
+			fprintf(stderr, "couldn't allocate memory");
+			exit(1);
+		}
+		snap_get_bytes(r, f->blocks, size);
+	}
+	return bf;
+}
+
+static void save_ts(SnapWriter *w, TimeSeries *s) {
+	snap_put_u64(w, s->retention);
+	snap_put_u64(w, s->count);
+	snap_put_len(w, s->n);
+	for (int i = 0; i < s->n; i++) {
+		TSChunk *c = &s->chunks[i];
+		snap_put_u64(w, c->first_ts);
+		snap_put_double(w, c->first_value);
+		snap_put_len(w, c->count);
+		snap_put_len(w, c->nbits);
+		snap_put_u64(w, c->last_ts);
+		snap_put_u64(w, c->last_delta);
+		snap_put_u64(w, c->last_value);
+		snap_put_u8(w, c->leading);
+		snap_put_u8(w, c->trailing);
+		snap_put_bytes(w, c->data, (c->nbits + 63) / 64 * sizeof(uint64_t));
+	}
+}
+
+static TimeSeries *load_ts(SnapReader *r) {
+	TimeSeries *s = ts_init(snap_get_u64(r));
+	s->count = snap_get_u64(r);
+	uint64_t n = snap_get_len(r);
+	if (!snap_fits(r, n))
+		return s;
+	s->cap = n > 0 ? n : 1;
+	s->chunks = dmalloc(s->cap * sizeof(TSChunk));
+	for (; s->n < (int)n && !r->failed; s->n++) {
+		TSChunk *c = &s->chunks[s->n];
+		c->first_ts = snap_get_u64(r);
+		c->first_value = snap_get_double(r);
+		c->count = snap_get_len(r);
+		c->nbits = snap_get_len(r);
+		c->last_ts = snap_get_u64(r);
+		c->last_delta = snap_get_u64(r);
+		c->last_value = snap_get_u64(r);
+		c->leading = snap_get_u8(r);
+		c->trailing = snap_get_u8(r);
+		long long words = (c->nbits + 63) / 64;
+		if (c->nbits > TS_CHUNK_BYTES * 8LL || !snap_fits(r, words * sizeof(uint64_t)))
+			c->nbits = words = 0;
+		// appends grow the chunk by doubling, so keep at least the initial 8 words
+		c->cap = words > 8 ? words : 8;
+		c->data = calloc(c->cap, sizeof(uint64_t));
+		snap_get_bytes(r, c->data, words * sizeof(uint64_t));
+	}
+	return s;
+}
+
+static void save_json(SnapWriter *w, JsonNode *node) {
+	char *doc = json_dump(node);
+	snap_put_str(w, doc, strlen(doc));
+	free(doc);
+}
+
+static JsonNode *load_json(SnapReader *r) {
+	char *doc = snap_get_str(r, NULL);
+	JsonNode *node = json_parse(doc);
+	free(doc);
+	return node;
+}
+
+static void save_cms(SnapWriter *w, CountMin *cms) {
+	snap_put_len(w, cms->width);
+	snap_put_len(w, cms->depth);
+	snap_put_u64(w, cms->count);
+	snap_put_bytes(w, cms->counters, (size_t)cms->stride * cms->depth * sizeof(uint32_t));
+}
+
+static CountMin *load_cms(SnapReader *r) {
+	uint64_t width = snap_get_len(r), depth = snap_get_len(r);
+	if (width == 0 || depth == 0 || !snap_fits(r, width * depth * sizeof(uint32_t)))
+		return NULL;
+	CountMin *cms = cms_init(width, depth);
+	cms->count = snap_get_u64(r);
+	snap_get_bytes(r, cms->counters, (size_t)cms->stride * depth * sizeof(uint32_t));
+	return cms;
+}
+
+static void save_topk(SnapWriter *w, TopK *tk) {
+	snap_put_len(w, tk->k);
+	snap_put_len(w, tk->width);
+	snap_put_len(w, tk->depth);
+	snap_put_double(w, tk->decay);
+	snap_put_u64(w, tk->rng);
+	snap_put_bytes(w, tk->buckets, (size_t)tk->width * tk->depth * sizeof(TopKBucket));
+	snap_put_len(w, tk->n);
+	for (int i = 0; i < tk->n; i++) {
+		snap_put_str(w, tk->heap[i].item, strlen(tk->heap[i].item));
+		snap_put_len(w, tk->heap[i].fp);
+		snap_put_len(w, tk->heap[i].count);
+	}
+}
+
+static TopK *load_topk(SnapReader *r) {
+	uint64_t k = snap_get_len(r), width = snap_get_len(r), depth = snap_get_len(r);
+	double decay = snap_get_double(r);
+	uint64_t rng = snap_get_u64(r);
+	size_t size = width * depth * sizeof(TopKBucket);
+	if (k == 0 || width == 0 || depth == 0 || k > INT32_MAX || !snap_fits(r, size))
+		return NULL;
+	TopK *tk = topk_init(k, width, depth, decay);
+	tk->rng = rng;
+	snap_get_bytes(r, tk->buckets, size);
+	uint64_t n = snap_get_len(r);
+	if (n > k)
+		r->failed = true;
+	// the heap is written in array order, so it is still a heap
+	for (; tk->n < (int)n && !r->failed; tk->n++) {
+		tk->heap[tk->n].item = snap_get_str(r, NULL);
+		tk->heap[tk->n].fp = snap_get_len(r);
+		tk->heap[tk->n].count = snap_get_len(r);
+	}
+	return tk;
+}
+
+static int value_encoding(HashTableItem *item) {
+	long long x;
+	switch (item->type) {
+	case STR_T:
+		return canonical_int(item->value, str_len(item->value), &x) ? ENC_INT : ENC_PLAIN;
+	case HASH_T:
+		return small_hash(item->value) ? ENC_SMALL : ENC_PLAIN;
+	case LIST_T:
+		return ENC_PACKED;
+	case SET_T:
+		return int_set(item->value) ? ENC_INTSET : ENC_PLAIN;
+	default:
+		return ENC_PLAIN;
+	}
+}
+
+// writes the encoding and the value
+static void save_value(SnapWriter *w, HashTableItem *item) {
+	int enc = value_encoding(item);
+	snap_put_u8(w, enc);
+	switch (item->type) {
+	case STR_T:
+		save_string(w, item->value, enc);
+		break;
+	case HASH_T:
+		enc == ENC_SMALL ? save_small_hash(w, item->value) : save_hash(w, item->value);
+		break;
+	case LIST_T:
+		save_list(w, item->value);
+		break;
+	case SET_T:
+		enc == ENC_INTSET ? save_intset(w, item->value) : save_set(w, item->value);
+		break;
+	case ZSET_T:
+		save_zset(w, item->value);
+		break;
+	case HLL_T:
+		save_hll(w, item->value);
+		break;
+	case ROARING_T:
+		save_roaring(w, item->value);
+		break;
+	case STREAM_T:
+		stream_save(w, item->value);
+		break;
+	case BLOOM_T:
+		save_bloom(w, item->value);
+		break;
+	case TS_T:
+		save_ts(w, item->value);
+		break;
+	case JSON_T:
+		save_json(w, item->value);
+		break;
+	case VSET_T:
+		vset_save(w, item->value);
+		break;
+	case CMS_T:
+		save_cms(w, item->value);
+		break;
+	case TOPK_T:
+		save_topk(w, item->value);
+		break;
+	case RATELIMIT_T:
+		snap_put_u64(w, ((RateLimit *)item->value)->tat);
+		break;
+	}
+}
+
+// NULL for an unknown type or encoding or a value too damaged to build
+static void *load_value(SnapReader *r, int type, int enc) {
+	if (enc != ENC_PLAIN && (type != STR_T || enc != ENC_INT) &&
+		(type != HASH_T || enc != ENC_SMALL) && (type != LIST_T || enc != ENC_PACKED) &&
+		(type != SET_T || enc != ENC_INTSET))
+		return NULL;
+	switch (type) {
+	case STR_T:
+		return load_string(r, enc);
+	case HASH_T:
+		return enc == ENC_SMALL ? load_small_hash(r) : load_hash(r);
+	case LIST_T:
+		return enc == ENC_PACKED ? load_packed_list(r) : load_list(r);
+	case SET_T:
+		return enc == ENC_INTSET ? load_intset(r) : load_set(r);
+	case ZSET_T:
+		return load_zset(r);
+	case HLL_T:
+		return load_hll(r);
+	case ROARING_T:
+		return load_roaring(r);
+	case STREAM_T:
+		return stream_load(r);
+	case BLOOM_T:
+		return load_bloom(r);
+	case TS_T:
+		return load_ts(r);
+	case JSON_T:
+		return load_json(r);
+	case VSET_T:
+		return vset_load(r);
+	case CMS_T:
+		return load_cms(r);
+	case TOPK_T:
+		return load_topk(r);
+	case RATELIMIT_T: {
+		RateLimit *rl = dmalloc(sizeof(RateLimit));
+		rl->tat = snap_get_u64(r);
+		return rl;
+	}
+	}
+	return NULL;
+}
+
+// frees a value load_value built, going through a scratch table so that each
+// type is freed the way htable.c frees it
+static void free_value(int type, void *value) {
+	HashTable *tmp = htable_init(HT_BASE_SIZE);
+	htable_restore(tmp, "", type, value);
+	htable_free(tmp);
+}
+
+static void put_u32(SnapWriter *w, uint32_t x) {
+	uint8_t b[4] = {x, x >> 8, x >> 16, x >> 24};
+	snap_put_bytes(w, b, 4);
+}
+
+static uint32_t get_u32(SnapReader *r) {
+	uint8_t b[4];
+	snap_get_bytes(r, b, 4);
+	return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+// appends the records gathered in sec to w as one section, compressed through
+// packed when that makes it smaller
+static void put_section(SnapWriter *w, SnapWriter *sec, SnapWriter *packed, SnapSection *s,
+						bool compress) {
+	s->offset = w->bytes + w->len;
+	s->raw = sec->len;
+	long n = sec->len;
+	if (compress) {
+		while (packed->cap < lz_bound(sec->len))
+			snap_flush(packed);
+		n = lz_compress(sec->buf, sec->len, packed->buf);
+	}
+	s->codec = n < sec->len ? CODEC_LZ : CODEC_RAW;
+	s->length = s->codec == CODEC_LZ ? n : sec->len;
+	uint8_t *stored = s->codec == CODEC_LZ ? packed->buf : sec->buf;
+	s->crc = crc32c(0, stored, s->length);
+	snap_put_bytes(w, stored, s->length);
+	sec->len = 0;
+}
+
+// keys last accessed this many seconds or more before the save go to the
+// next colder class of sections
+static const unsigned int heat_ages[SNAPSHOT_HEAT_CLASSES - 1] = {60, 3600, 86400};
+
+// a snapshot being written, one key at a time
+typedef struct SnapSave {
+	char *path;
+	char *tmp;
+	SnapWriter w;
+	// the header as written, with the length and index offset at header
+	uint8_t head[64];
+	int first;
+	int header;
+	long long now;
+	// each record is built in rec first to learn its length, then gathered
+	// with the rest of its section in sec to be compressed through packed.
+	// Keys go to the section of their heat class, so that hot ones load first.
+	SnapWriter rec;
+	SnapWriter sec[SNAPSHOT_HEAT_CLASSES];
+	SnapWriter packed;
+	SnapSection *sections;
+	int nsections;
+	int cap;
+	long long nkeys;
+	// keys in sec, and the age of the most recently accessed one
+	long long pending[SNAPSHOT_HEAT_CLASSES];
+	unsigned int newest[SNAPSHOT_HEAT_CLASSES];
+	// bytes a section is closed at
+	int section_bytes;
+	bool compress;
+	// whether writeback starts as sections are written, so that the final
+	// fsync does not stall the event loop
+	bool writeback;
+	long long start;
+} SnapSave;
+
+// starts a snapshot written to fd, the file at path or a memory file if path
+// is NULL
+static void save_begin(SnapSave *s, char *path, int fd) {
+	*s = (SnapSave){.path = path,
+					.now = time(NULL),
+					.section_bytes = SNAPSHOT_SECTION_BYTES,
+					.compress = true,
+					.start = now_us()};
+	s->w.fd = fd;
+	s->w.cap = SNAPSHOT_BUF_BYTES;
+	s->w.buf = dmalloc(s->w.cap);
+	snap_put_bytes(&s->w, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+	snap_put_len(&s->w, SNAPSHOT_VERSION);
+	// the length, the index offset and the key count are filled in once known
+	s->header = s->w.len;
+	snap_put_u64(&s->w, 0);
+	snap_put_u64(&s->w, 0);
+	snap_put_u64(&s->w, 0);
+	snap_put_u64(&s->w, s->now);
+	s->first = s->w.len;
+	memcpy(s->head, s->w.buf, s->first);
+	s->rec = (SnapWriter){.fd = -1, .cap = 256, .buf = dmalloc(256)};
+	for (int c = 0; c < SNAPSHOT_HEAT_CLASSES; c++)
+		s->sec[c] = (SnapWriter){.fd = -1};
+	s->packed = (SnapWriter){.fd = -1, .cap = SNAPSHOT_SECTION_BYTES};
+	s->packed.buf = dmalloc(s->packed.cap);
+}
+
+// starts a snapshot in a temporary file next to path, false if it cannot be
+// created
+static bool save_open(SnapSave *s, char *path) {
+	char *tmp = dmalloc(strlen(path) + 32);
+	sprintf(tmp, "%s.tmp-%d", path, (int)getpid());
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		log_error("Failed to open snapshot file %s: %s", tmp, strerror(errno));
+		free(tmp);
+		return false;
+	}
+	save_begin(s, path, fd);
+	s->tmp = tmp;
+	return true;
+}
+
+// a filter of the names of the n keys recorded in sec
+static Bloom *section_filter(SnapWriter *sec, long long n) {
+	Bloom *bf = bloom_init(SNAPSHOT_FILTER_ERROR, n, 0);
+	SnapReader r = {.fd = -1, .buf = sec->buf, .len = sec->len};
+	while (r.pos < r.len) {
+		uint64_t len = snap_get_len(&r);
+		long long next = r.pos + len;
+		snap_get_u8(&r);
+		snap_get_len(&r);
+		snap_get_len(&r);
+		char *key = (char *)r.buf + r.pos;
+		int res;
+		bloom_add(bf, &key, 1, &res);
+		r.pos = next;
+	}
+	return bf;
+}
+
+// closes the section of heat class c gathered so far
+static void save_section(SnapSave *s, int c) {
+	if (s->nsections == s->cap) {
+		s->cap = s->cap > 0 ? s->cap * 2 : 16;
+		s->sections = drealloc(s->sections, s->cap * sizeof(SnapSection));
+	}
+	SnapSection *sec = &s->sections[s->nsections++];
+	sec->filter = section_filter(&s->sec[c], s->pending[c]);
+	put_section(&s->w, &s->sec[c], &s->packed, sec, s->compress);
+	sec->nkeys = s->pending[c];
+	sec->newest = s->newest[c];
+	s->pending[c] = 0;
+	if (s->writeback)
+		sync_file_range(s->w.fd, 0, s->w.bytes, SYNC_FILE_RANGE_WRITE);
+}
+
+static void save_item(SnapSave *s, HashTableItem *item) {
+	unsigned int age = s->now > item->access ? s->now - item->access : 0;
+	int c = 0;
+	while (c < SNAPSHOT_HEAT_CLASSES - 1 && age >= heat_ages[c])
+		c++;
+	SnapWriter *sec = &s->sec[c];
+	if (sec->buf == NULL) {
+		sec->cap = s->section_bytes;
+		sec->buf = dmalloc(sec->cap);
+	}
+	s->rec.len = 0;
+	snap_put_u8(&s->rec, item->type);
+	snap_put_len(&s->rec, age);
+	snap_put_str(&s->rec, item->key, strlen(item->key) + 1);
+	save_value(&s->rec, item);
+	snap_put_str(sec, (char *)s->rec.buf, s->rec.len);
+	if (s->pending[c] == 0 || age < s->newest[c])
+		s->newest[c] = age;
+	s->nkeys++;
+	s->pending[c]++;
+	if (sec->len >= s->section_bytes)
+		save_section(s, c);
+}
+
+static void free_sections(SnapSection *sections, int n) {
+	for (int i = 0; i < n; i++)
+		if (sections[i].filter != NULL)
+			bloom_free(sections[i].filter);
+	free(sections);
+}
+
+// writes the index, then syncs the file and renames it over the path if
+// commit is set, or removes it
+static bool save_close(SnapSave *s, bool commit) {
+	for (int c = 0; c < SNAPSHOT_HEAT_CLASSES; c++)
+		if (s->pending[c] > 0)
+			save_section(s, c);
+	// the index is built aside, as its checksum covers the header that gives
+	// its offset and the total length
+	long long index = s->w.bytes + s->w.len;
+	SnapWriter *rec = &s->rec;
+	rec->len = 0;
+	snap_put_len(rec, s->nsections);
+	for (int i = 0; i < s->nsections; i++) {
+		snap_put_u64(rec, s->sections[i].offset);
+		snap_put_u64(rec, s->sections[i].length);
+		snap_put_len(rec, s->sections[i].nkeys);
+		snap_put_u8(rec, s->sections[i].codec);
+		snap_put_len(rec, s->sections[i].raw);
+		put_u32(rec, s->sections[i].crc);
+		snap_put_len(rec, s->sections[i].newest);
+		save_bloom(rec, s->sections[i].filter);
+	}
+	long long total = index + rec->len + 5;
+	uint64_t fields[] = {total, index, s->nkeys};
+	for (int i = 0; i < 24; i++)
+		s->head[s->header + i] = fields[i / 8] >> (8 * (i % 8));
+	snap_put_bytes(&s->w, rec->buf, rec->len);
+	put_u32(&s->w, crc32c(crc32c(0, s->head, s->first), rec->buf, rec->len));
+	snap_put_u8(&s->w, SNAPSHOT_EOF);
+	snap_flush(&s->w);
+	bool ok = commit && !s->w.failed && pwrite(s->w.fd, s->head + s->header, 24, s->header) == 24;
+	// a memory file is left open for its owner
+	if (s->tmp != NULL) {
+		ok = ok && fsync(s->w.fd) == 0;
+		ok = close(s->w.fd) == 0 && ok;
+		ok = ok && rename(s->tmp, s->path) == 0;
+	}
+	char *name = s->path != NULL ? s->path : "memory";
+	if (ok) {
+		log_info("Saved %lld keys to %s, %lld bytes in %d sections in %lld us", s->nkeys, name,
+				 s->w.bytes, s->nsections, now_us() - s->start);
+	} else {
+		if (commit)
+			log_error("Failed to write snapshot %s: %s", name, strerror(errno));
+		if (s->tmp != NULL)
+			unlink(s->tmp);
+	}
+	free_sections(s->sections, s->nsections);
+	free(s->packed.buf);
+	for (int c = 0; c < SNAPSHOT_HEAT_CLASSES; c++)
+		free(s->sec[c].buf);
+	free(s->rec.buf);
+	free(s->w.buf);
+	free(s->tmp);
+	return ok;
+}
+
+// saves the keys of the n tables, which must not share any
+static bool save_tables(SnapSave *s, HashTable **tables, int n) {
+	for (int i = 0; i < n; i++) {
+		int pos = 0;
+		HashTableItem *item;
+		while ((item = htable_next(tables[i], &pos)) != NULL && !s->w.failed)
+			save_item(s, item);
+	}
+	return save_close(s, true);
+}
+
+// writes the keyspace to path through a temporary file renamed over it once
+// synced, so a crash midway leaves the previous snapshot in place
+bool snapshot_save(HashTable *ht, char *path) { return snapshot_save_tables(&ht, 1, path); }
+
+// writes the keys of n tables as one keyspace, as the offline loader builds it
+// in shards
+bool snapshot_save_tables(HashTable **tables, int n, char *path) {
+	SnapSave s;
+	return save_open(&s, path) && save_tables(&s, tables, n);
+}
+
+// writes the keyspace to the memory file fd without compressing it, for a
+// process on this machine to map
+bool snapshot_save_fd(HashTable *ht, int fd) {
+	SnapSave s;
+	save_begin(&s, NULL, fd);
+	s.compress = false;
+	return save_tables(&s, &ht, 1);
+}
+
+// reads the rest of a version 1 snapshot, a key count then keys up to
+// SNAPSHOT_EOF
+static long long load_stream(HashTable *ht, SnapReader *r) {
+	uint64_t expected = snap_get_len(r);
+	long long loaded = 0;
+	int type;
+	while (!r->failed && (type = snap_get_u8(r)) != SNAPSHOT_EOF) {
+		char *key = snap_get_str(r, NULL);
+		void *value = load_value(r, type, ENC_PLAIN);
+		if (value == NULL)
+			r->failed = true;
+		else if (r->failed)
+			free_value(type, value);
+		else
+			htable_restore(ht, key, type, value);
+		free(key);
+		loaded++;
+	}
+	return !r->failed && (uint64_t)loaded == expected ? loaded : -1;
+}
+
+// decodes the records of section i, false if any is damaged
+static bool load_section(SnapLoad *l, int i) {
+	SnapSection *s = &l->sections[i];
+	SnapPart *part = &l->parts[i];
+	SnapReader r = {.fd = -1, .buf = (uint8_t *)l->base + s->offset, .len = s->length};
+	if (l->version >= 4 && crc32c(0, r.buf, r.len) != s->crc)
+		return false;
+	if (s->codec == CODEC_LZ) {
+		part->raw = dmalloc(s->raw);
+		if (!lz_decompress(r.buf, r.len, part->raw, s->raw))
+			return false;
+		r.buf = part->raw;
+		r.len = s->raw;
+	}
+	part->entries = dmalloc((s->nkeys > 0 ? s->nkeys : 1) * sizeof(SnapEntry));
+	while (r.pos < r.len && !r.failed) {
+		uint64_t len = snap_get_len(&r);
+		const uint8_t *p = snap_get_ref(&r, len);
+		if (p == NULL || part->n == s->nkeys)
+			return false;
+		SnapReader rec = {.fd = -1, .buf = (uint8_t *)p, .len = len};
+		int type = snap_get_u8(&rec);
+		uint64_t age = l->version >= 5 ? snap_get_len(&rec) : 0;
+		uint64_t klen = snap_get_len(&rec);
+		char *key = (char *)snap_get_ref(&rec, klen);
+		int enc = snap_get_u8(&rec);
+		if (key == NULL || klen == 0 || key[klen - 1] != '\0')
+			return false;
+		void *value = load_value(&rec, type, enc);
+		if (value != NULL && (rec.failed || rec.pos != rec.len))
+			free_value(type, value);
+		if (value == NULL || rec.failed || rec.pos != rec.len)
+			return false;
+		unsigned int access = (uint64_t)l->saved > age ? l->saved - age : 0;
+		part->entries[part->n++] =
+			(SnapEntry){.key = key, .type = type, .access = access, .value = value};
+	}
+	return !r.failed && part->n == s->nkeys;
+}
+
+// loader thread, taking sections in the order they are linked while no more
+// than SNAPSHOT_LOAD_AHEAD per thread wait to be
+static void *load_sections(void *arg) {
+	SnapLoad *l = arg;
+	pthread_mutex_lock(&l->lock);
+	for (;;) {
+		while (l->next < l->nsections && l->parts[l->order[l->next]].state != PART_PENDING)
+			l->next++;
+		if (l->stop || l->next == l->nsections)
+			break;
+		if (l->ready >= SNAPSHOT_LOAD_AHEAD * l->nthreads) {
+			pthread_cond_wait(&l->cond, &l->lock);
+			continue;
+		}
+		int i = l->order[l->next++];
+		l->parts[i].state = PART_DECODING;
+		pthread_mutex_unlock(&l->lock);
+		bool ok = load_section(l, i);
+		pthread_mutex_lock(&l->lock);
+		l->parts[i].state = ok ? PART_READY : PART_DAMAGED;
+		l->ready++;
+		pthread_cond_broadcast(&l->cond);
+	}
+	pthread_mutex_unlock(&l->lock);
+	return NULL;
+}
+
+// reads the header and section index of the snapshot at l->base, n bytes long
+// at most, false if they do not add up
+static bool load_index(SnapLoad *l, long long n) {
+	SnapReader r = {.fd = -1, .buf = (uint8_t *)l->base, .len = n};
+	snap_get_ref(&r, strlen(SNAPSHOT_MAGIC));
+	snap_get_len(&r);
+	long long total = snap_get_u64(&r);
+	long long index = snap_get_u64(&r);
+	long long nkeys = snap_get_u64(&r);
+	l->saved = l->version >= 5 ? (long long)snap_get_u64(&r) : 0;
+	long long first = r.pos;
+	if (r.failed || total > n || index < first || index >= total || nkeys < 0 || nkeys > total)
+		return false;
+	r.pos = index;
+	r.len = total;
+	// each section takes at least 17 bytes of the index
+	uint64_t count = snap_get_len(&r);
+	if (count > (uint64_t)(r.len - r.pos) / 17)
+		return false;
+	SnapSection *sections = calloc(count > 0 ? count : 1, sizeof(SnapSection));
+	long long next = first, keys = 0;
+	for (uint64_t i = 0; i < count && !r.failed; i++) {
+		SnapSection *s = &sections[i];
+		s->offset = snap_get_u64(&r);
+		s->length = snap_get_u64(&r);
+		s->nkeys = snap_get_len(&r);
+		s->codec = l->version >= 3 ? snap_get_u8(&r) : CODEC_RAW;
+		s->raw = l->version >= 3 ? (long long)snap_get_len(&r) : s->length;
+		s->crc = l->version >= 4 ? get_u32(&r) : 0;
+		if (l->version >= 5) {
+			s->newest = snap_get_len(&r);
+			s->filter = load_bloom(&r);
+		}
+		// sections tile the space between the header and the index, and a
+		// compressed one expands at most 255 times
+		if (s->offset != next || s->length <= 0 || s->length > index - next || s->nkeys < 0 ||
+			s->nkeys > s->raw || s->codec > CODEC_LZ || s->raw < 0 ||
+			(s->codec == CODEC_RAW ? s->raw != s->length : s->raw / 256 > s->length) ||
+			(l->version >= 5 && s->filter == NULL))
+			r.failed = true;
+		next += s->length;
+		keys += s->nkeys;
+	}
+	uint32_t crc = crc32c(crc32c(0, l->base, first), l->base + index, r.pos - index);
+	if (l->version >= 4 && get_u32(&r) != crc)
+		r.failed = true;
+	if (r.failed || next != index || keys != nkeys || snap_get_u8(&r) != SNAPSHOT_EOF ||
+		r.pos != r.len) {
+		free_sections(sections, count);
+		return false;
+	}
+	l->sections = sections;
+	l->nsections = count;
+	l->total = total;
+	l->nkeys = nkeys;
+	return true;
+}
+
+// hotter sections first, then in file order
+static int cmp_heat(const void *a, const void *b, void *arg) {
+	SnapSection *sections = arg;
+	int i = *(const int *)a, j = *(const int *)b;
+	if (sections[i].newest != sections[j].newest)
+		return sections[i].newest < sections[j].newest ? -1 : 1;
+	return i - j;
+}
+
+// maps the sectioned snapshot at offset start of fd, size bytes long with what
+// follows it, and starts decoding its sections. NULL if it cannot be read.
+static SnapLoad *load_begin(HashTable *ht, int fd, long long start, long long size, int version,
+							char *path) {
+	uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		log_error("Failed to map snapshot %s: %s", path, strerror(errno));
+		return NULL;
+	}
+	madvise(map, size, MADV_WILLNEED);
+	SnapLoad *l = dmalloc(sizeof(SnapLoad));
+	*l = (SnapLoad){.ht = ht,
+					.path = strdup(path),
+					.map = map,
+					.size = size,
+					.base = map + start,
+					.version = version,
+					.start = now_us()};
+	if (!load_index(l, size - start) || l->nkeys > INT32_MAX - ht->used) {
+		munmap(map, size);
+		free(l->path);
+		free(l);
+		return NULL;
+	}
+	htable_reserve(ht, l->nkeys);
+	l->parts = calloc(l->nsections > 0 ? l->nsections : 1, sizeof(SnapPart));
+	l->order = dmalloc((l->nsections > 0 ? l->nsections : 1) * sizeof(int));
+	for (int i = 0; i < l->nsections; i++)
+		l->order[i] = i;
+	qsort_r(l->order, l->nsections, sizeof(int), cmp_heat, l->sections);
+	pthread_mutex_init(&l->lock, NULL);
+	pthread_cond_init(&l->cond, NULL);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int nthreads = cpus < SNAPSHOT_LOAD_THREADS ? (cpus > 0 ? cpus : 1) : SNAPSHOT_LOAD_THREADS;
+	nthreads = nthreads < l->nsections ? nthreads : l->nsections;
+	// the threads read how many were started under the lock
+	pthread_mutex_lock(&l->lock);
+	int started = 0;
+	while (started < nthreads && pthread_create(&l->threads[started], NULL, load_sections, l) == 0)
+		started++;
+	l->nthreads = started;
+	pthread_mutex_unlock(&l->lock);
+	return l;
+}
+
+// waits for section i to be decoded, decoding it on this thread if no loader
+// thread has taken it, false if it is damaged
+static bool load_wait(SnapLoad *l, int i) {
+	SnapPart *part = &l->parts[i];
+	pthread_mutex_lock(&l->lock);
+	bool mine = part->state == PART_PENDING;
+	if (mine) {
+		part->state = PART_DECODING;
+		pthread_mutex_unlock(&l->lock);
+		bool ok = load_section(l, i);
+		pthread_mutex_lock(&l->lock);
+		part->state = ok ? PART_READY : PART_DAMAGED;
+		l->ready++;
+	}
+	while (part->state == PART_DECODING)
+		pthread_cond_wait(&l->cond, &l->lock);
+	bool ok = part->state == PART_READY;
+	pthread_mutex_unlock(&l->lock);
+	return ok;
+}
+
+// links up to limit more keys of the decoded section i into the table and
+// returns how many it linked
+static long long load_link(SnapLoad *l, int i, long long limit) {
+	SnapPart *part = &l->parts[i];
+	long long n = 0;
+	for (; part->linked < part->n && n < limit; part->linked++, n++) {
+		SnapEntry *e = &part->entries[part->linked];
+		HashTableItem *item = htable_restore(l->ht, e->key, e->type, e->value);
+		if (l->version >= 5)
+			item->access = e->access;
+	}
+	l->loaded += n;
+	if (part->linked == part->n) {
+		free(part->entries);
+		free(part->raw);
+		part->entries = NULL;
+		part->raw = NULL;
+		part->done = true;
+		pthread_mutex_lock(&l->lock);
+		l->ready--;
+		pthread_cond_broadcast(&l->cond);
+		pthread_mutex_unlock(&l->lock);
+	}
+	return n;
+}
+
+// links up to limit more keys, hottest sections first. Without wait it stops
+// at the first section a loader thread is still decoding, and it decodes one
+// none has taken, as sections partly linked ahead by commands may hold the
+// threads back. Returns 1 once every section is linked, 0 while some are left
+// and -1 if one is damaged.
+static int load_step(SnapLoad *l, long long limit, bool wait) {
+	while (limit > 0 && l->cursor < l->nsections) {
+		int i = l->order[l->cursor];
+		if (l->parts[i].done) {
+			l->cursor++;
+			continue;
+		}
+		pthread_mutex_lock(&l->lock);
+		bool decoding = l->parts[i].state == PART_DECODING;
+		pthread_mutex_unlock(&l->lock);
+		if (decoding && !wait)
+			return 0;
+		if (!load_wait(l, i))
+			return -1;
+		limit -= load_link(l, i, limit);
+	}
+	return l->cursor == l->nsections ? 1 : 0;
+}
+
+// links key ahead of the others, from whichever sections may hold it, false
+// if one of them is damaged. The rest of those sections is linked in turn.
+static bool load_fault(SnapLoad *l, char *key) {
+	for (int c = l->cursor; c < l->nsections; c++) {
+		int i = l->order[c], res = 1;
+		if (l->parts[i].done)
+			continue;
+		if (l->sections[i].filter != NULL)
+			bloom_exists(l->sections[i].filter, &key, 1, &res);
+		if (!res)
+			continue;
+		if (!load_wait(l, i))
+			return false;
+		SnapPart *part = &l->parts[i];
+		for (long long j = part->linked; j < part->n; j++) {
+			if (strcmp(part->entries[j].key, key) == 0) {
+				// moved up to be the next entry linked
+				SnapEntry e = part->entries[j];
+				part->entries[j] = part->entries[part->linked];
+				part->entries[part->linked] = e;
+				load_link(l, i, 1);
+				return true;
+			}
+		}
+	}
+	return true;
+}
+
+// stops the loader threads and frees what was not linked. Returns the number
+// of keys loaded or -1 if not all of them were.
+static long long load_end(SnapLoad *l) {
+	pthread_mutex_lock(&l->lock);
+	l->stop = true;
+	pthread_cond_broadcast(&l->cond);
+	pthread_mutex_unlock(&l->lock);
+	for (int t = 0; t < l->nthreads; t++)
+		pthread_join(l->threads[t], NULL);
+	for (int i = 0; i < l->nsections; i++) {
+		SnapPart *part = &l->parts[i];
+		for (long long j = part->linked; j < part->n; j++)
+			free_value(part->entries[j].type, part->entries[j].value);
+		free(part->entries);
+		free(part->raw);
+	}
+	log_debug("Decoded %d sections of %s on %d threads", l->nsections, l->path, l->nthreads);
+	long long n = l->cursor == l->nsections && l->loaded == l->nkeys ? l->loaded : -1;
+	pthread_mutex_destroy(&l->lock);
+	pthread_cond_destroy(&l->cond);
+	free_sections(l->sections, l->nsections);
+	free(l->parts);
+	free(l->order);
+	munmap(l->map, l->size);
+	free(l->path);
+	free(l);
+	return n;
+}
+
+// loads the sectioned snapshot at offset start of fd, size bytes long with
+// what follows it. Returns the number of keys loaded or -1, and sets *end.
+static long long load_mapped(HashTable *ht, int fd, long long start, long long size, int version,
+							 char *path, long long *end) {
+	SnapLoad *l = load_begin(ht, fd, start, size, version, path);
+	if (l == NULL)
+		return -1;
+	load_step(l, LLONG_MAX, true);
+	*end = start + l->total;
+	return load_end(l);
+}
+
+// loads the snapshot starting at the current offset of fd into ht, path only
+// names it in logs. Returns the number of keys loaded or -1 if it cannot be
+// read, and sets *end to the offset right after it.
+long long snapshot_read(HashTable *ht, int fd, char *path, long long *end) {
+	SnapReader r = {.fd = fd};
+	struct stat st;
+	fstat(r.fd, &st);
+	long long start = now_us(), offset = lseek(r.fd, 0, SEEK_CUR);
+	r.left = st.st_size - offset;
+	r.buf = dmalloc(SNAPSHOT_BUF_BYTES);
+	char magic[sizeof(SNAPSHOT_MAGIC)] = {0};
+	snap_get_bytes(&r, magic, strlen(SNAPSHOT_MAGIC));
+	uint64_t version = snap_get_len(&r);
+	long long n = -1;
+	if (strcmp(magic, SNAPSHOT_MAGIC) != 0 || version < 1 || version > SNAPSHOT_VERSION) {
+		log_error("%s is not a snapshot of version %d or older", path, SNAPSHOT_VERSION);
+	} else if (version == 1) {
+		n = load_stream(ht, &r);
+		*end = st.st_size - r.left - (r.len - r.pos);
+	} else {
+		n = load_mapped(ht, fd, offset, st.st_size, version, path, end);
+	}
+	if (n >= 0)
+		log_info("Loaded %lld keys from %s in %lld us", n, path, now_us() - start);
+	else if (version >= 1 && version <= SNAPSHOT_VERSION)
+		log_error("Snapshot %s is truncated or corrupt", path);
+	free(r.buf);
+	return n;
+}
+
+// loads the snapshot at path into ht, returns the number of keys loaded, 0 if
+// there is no snapshot and -1 if it cannot be read
+long long snapshot_load(HashTable *ht, char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			return 0;
+		log_error("Failed to open snapshot %s: %s", path, strerror(errno));
+		return -1;
+	}
+	long long end;
+	long long n = snapshot_read(ht, fd, path, &end);
+	close(fd);
+	return n;
+}
+
+// starts loading the snapshot at path into ht while the server keeps serving.
+// The event loop links its sections into the table hottest first, and before a
+// command runs, the sections that may hold the keys it names are linked ahead
+// of the rest. Snapshots older than version 5 are loaded before it returns.
+// Returns the number of keys to load, 0 if there is no snapshot and -1 if it
+// cannot be read.
+long long snapshot_load_start(HashTable *ht, char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return snapshot_load(ht, path);
+	struct stat st;
+	fstat(fd, &st);
+	SnapReader r = {.fd = fd, .left = st.st_size, .buf = dmalloc(SNAPSHOT_BUF_BYTES)};
+	char magic[sizeof(SNAPSHOT_MAGIC)] = {0};
+	snap_get_bytes(&r, magic, strlen(SNAPSHOT_MAGIC));
+	uint64_t version = snap_get_len(&r);
+	free(r.buf);
+	if (strcmp(magic, SNAPSHOT_MAGIC) != 0 || version < 5 || version > SNAPSHOT_VERSION) {
+		close(fd);
+		return snapshot_load(ht, path);
+	}
+	SnapLoad *l = load_begin(ht, fd, 0, st.st_size, version, path);
+	close(fd);
+	if (l == NULL) {
+		log_error("Snapshot %s is truncated or corrupt", path);
+		return -1;
+	}
+	snap.load = l;
+	log_info("Loading %lld keys from %s while serving", l->nkeys, path);
+	return l->nkeys;
+}
+
+bool snapshot_loading() { return snap.load != NULL; }
+
+static void load_done(int res) {
+	SnapLoad *l = snap.load;
+	snap.load = NULL;
+	long long start = l->start;
+	char *path = strdup(l->path);
+	long long n = load_end(l);
+	if (res < 0 || n < 0) {
+		// some keys were served as missing, there is no going back
+		log_fatal("Snapshot %s is truncated or corrupt", path);
+		exit(1);
+	}
+	log_info("Loaded %lld keys from %s in %lld us", n, path, now_us() - start);
+	free(path);
+}
+
+// links whatever is left of the snapshot being loaded
+void snapshot_load_wait() {
+	if (snap.load != NULL)
+		load_done(load_step(snap.load, LLONG_MAX, true));
+}
+
+void snapshot_init(char *path) {
+	free(snap.path);
+	snap.path = strdup(path);
+}
+
+void snapshot_set_mode(int mode) { snap.mode = mode; }
+
+int snapshot_mode() { return snap.mode; }
+
+char *snapshot_path() { return snap.path != NULL ? snap.path : SNAPSHOT_FILE; }
+
+static void snapshot_done(bool ok) {
+	snap.last_ok = ok;
+	if (ok)
+		snap.last_save = time(NULL);
+}
+
+typedef struct Checkpoint {
+	HashTable *ht;
+	SnapSave save;
+	// the next slot to walk, of a table of size slots
+	int pos;
+	int size;
+	// whether it was started by BGSAVE rather than by a log rewrite
+	bool bgsave;
+	long long iterations;
+} Checkpoint;
+
+static void checkpoint_item(Checkpoint *c, HashTableItem *item) {
+	save_item(&c->save, item);
+	item->epoch = c->ht->epoch;
+}
+
+// walks the next n slots, true once the whole table has been
+static bool checkpoint_step(Checkpoint *c, int n) {
+	HashTable *ht = c->ht;
+	if (ht->size != c->size) {
+		// a resize moved the items, the walk starts over past the saved ones
+		c->pos = 0;
+		c->size = ht->size;
+	}
+	int end = c->pos + n;
+	HashTableItem *item;
+	while (c->pos < end && (item = htable_next(ht, &c->pos)) != NULL)
+		if (item->epoch != ht->epoch)
+			checkpoint_item(c, item);
+	c->iterations++;
+	return c->pos >= ht->size || c->save.w.failed;
+}
+
+static bool checkpoint_start(HashTable *ht, char *path, bool bgsave) {
+	Checkpoint *c = dmalloc(sizeof(Checkpoint));
+	if (!save_open(&c->save, path)) {
+		free(c);
+		return false;
+	}
+	c->save.section_bytes = SNAPSHOT_CHECKPOINT_SECTION_BYTES;
+	c->save.writeback = true;
+	c->ht = ht;
+	c->pos = 0;
+	c->size = ht->size;
+	c->bgsave = bgsave;
+	c->iterations = 0;
+	ht->epoch++;
+	snap.ckpt = c;
+	snap.started = now_us();
+	log_info("Checkpoint of %d keys to %s started", ht->used, path);
+	return true;
+}
+
+static void checkpoint_finish(bool commit) {
+	Checkpoint *c = snap.ckpt;
+	snap.ckpt = NULL;
+	bool ok = save_close(&c->save, commit);
+	if (ok)
+		log_info("Checkpoint done in %lld us over %lld event loop iterations",
+				 now_us() - snap.started, c->iterations);
+	if (c->bgsave)
+		snapshot_done(ok);
+	else
+		snap.ckpt_status = ok ? 1 : -1;
+	free(c);
+}
+
+// starts writing a checkpoint of ht to path for a log rewrite, false if the
+// file cannot be created
+bool snapshot_checkpoint(HashTable *ht, char *path) {
+	if (!checkpoint_start(ht, path, false))
+		return false;
+	snap.ckpt_status = 0;
+	return true;
+}
+
+// 0 while the checkpoint of a log rewrite runs, then 1 if it succeeded and -1
+// if not
+int snapshot_checkpoint_status() { return snap.ckpt_status; }
+
+// whether a background save is running, forked or as a checkpoint
+bool snapshot_running() { return snap.child > 0 || (snap.ckpt != NULL && snap.ckpt->bgsave); }
+
+// drops a running checkpoint and its file
+void snapshot_checkpoint_cancel() {
+	if (snap.ckpt != NULL)
+		checkpoint_finish(false);
+}
+
+// links the keys a command names first while a snapshot is loading, and saves
+// the keys a write names before it runs, while the walk of a checkpoint has
+// yet to reach them
+void snapshot_touch(HashTable *ht, Command *cmd) {
+	if (snap.load != NULL && snap.load->ht == ht)
+		for (int i = 0; i < cmd->argc; i++)
+			if (!load_fault(snap.load, cmd->argv[i]))
+				load_done(-1);
+	Checkpoint *c = snap.ckpt;
+	if (c == NULL || c->ht != ht || !aof_logs(cmd->type))
+		return;
+	for (int i = 0; i < cmd->argc; i++) {
+		HashTableItem *item = htable_search(ht, cmd->argv[i]);
+		if (item != NULL && item->epoch != ht->epoch)
+			checkpoint_item(c, item);
+	}
+}
+
+// SAVE, blocking the server for the whole write
+bool snapshot_save_now(HashTable *ht) {
+	snapshot_load_wait();
+	bool ok = snapshot_save(ht, snapshot_path());
+	snapshot_done(ok);
+	return ok;
+}
+
+// the child's dirty private memory, which after a fork is made of the pages
+// either side has written to since and that the kernel had to copy
+static long long private_dirty_bytes() {
+	FILE *f = fopen("/proc/self/smaps_rollup", "r");
+	if (f == NULL)
+		f = fopen("/proc/self/smaps", "r");
+	if (f == NULL)
+		return 0;
+	char line[256];
+	long long total = 0, kb;
+	while (fgets(line, sizeof(line), f) != NULL)
+		if (sscanf(line, "Private_Dirty: %lld kB", &kb) == 1)
+			total += kb;
+	fclose(f);
+	return total * 1024;
+}
+
+// BGSAVE, returns 1 once the child is started, 0 if one is already running
+// and -1 if fork failed
+int snapshot_bgsave(HashTable *ht) {
+	if (snapshot_running())
+		return 0;
+	snapshot_load_wait();
+	if (snap.mode == SNAPSHOT_INCREMENTAL) {
+		if (checkpoint_start(ht, snapshot_path(), true))
+			return 1;
+		snapshot_done(false);
+		return -1;
+	}
+	int fds[2];
+	if (pipe(fds) != 0) {
+		log_error("Failed to create the snapshot pipe: %s", strerror(errno));
+		return -1;
+	}
+	long long start = now_us();
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		bool ok = snapshot_save(ht, snapshot_path());
+		long long report[] = {ok, private_dirty_bytes() / sysconf(_SC_PAGESIZE)};
+		write(fds[1], report, sizeof(report));
+		_exit(ok ? 0 : 1);
+	}
+	close(fds[1]);
+	if (pid < 0) {
+		log_error("Failed to fork for a background save: %s", strerror(errno));
+		close(fds[0]);
+		snapshot_done(false);
+		return -1;
+	}
+	snap.fork_us = now_us() - start;
+	snap.started = start;
+	snap.child = pid;
+	snap.report = fds[0];
+	log_info("Background saving started by pid %d, fork took %lld us", (int)pid, snap.fork_us);
+	return 1;
+}
+
+// reaps the snapshot child once it has exited, or waits for it with wait set.
+// A checkpoint takes its next step, or all of them with wait set, and so does
+// a load.
+void snapshot_poll(bool wait) {
+	if (snap.load != NULL) {
+		int res = load_step(snap.load, wait ? LLONG_MAX : SNAPSHOT_LOAD_KEYS, wait);
+		if (res != 0)
+			load_done(res);
+	}
+	if (snap.ckpt != NULL) {
+		bool done;
+		while (!(done = checkpoint_step(snap.ckpt, SNAPSHOT_CHECKPOINT_SLOTS)) && wait)
+			;
+		if (done)
+			checkpoint_finish(true);
+	}
+	if (snap.child <= 0)
+		return;
+	int status;
+	pid_t pid = waitpid(snap.child, &status, wait ? 0 : WNOHANG);
+	if (pid == 0 || (pid < 0 && errno == EINTR))
+		return;
+	long long report[2] = {0, 0};
+	bool ok = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	ok = ok && read(snap.report, report, sizeof(report)) == sizeof(report) && report[0];
+	close(snap.report);
+	snap.child = 0;
+	snap.report = -1;
+	snap.cow_pages = report[1];
+	snapshot_done(ok);
+	if (ok)
+		log_info("Background saving done in %lld us, %lld pages copied on write (%lld kB)",
+				 now_us() - snap.started, snap.cow_pages,
+				 snap.cow_pages * sysconf(_SC_PAGESIZE) / 1024);
+	else
+		log_error("Background saving failed");
+}
+
+// caps an event loop timeout so that a finished child is noticed promptly,
+// and keeps the loop from waiting while a checkpoint has steps left or a load
+// has decoded sections to link
+int snapshot_timeout(int timeout) {
+	if (snap.ckpt != NULL)
+		return 0;
+	if (snap.load != NULL) {
+		pthread_mutex_lock(&snap.load->lock);
+		bool ready = snap.load->ready > 0;
+		pthread_mutex_unlock(&snap.load->lock);
+		return ready ? 0 : (timeout >= 0 && timeout < 1 ? timeout : 1);
+	}
+	if (snap.child <= 0 || (timeout >= 0 && timeout < SNAPSHOT_POLL_MS))
+		return timeout;
+	return SNAPSHOT_POLL_MS;
+}
+
+long long snapshot_lastsave() { return snap.last_save; }
+
+// field and value pairs describing the last save and the running one
+char **snapshot_info() {
+	long long values[] = {snapshot_loading(),
+						  snapshot_running(),
+						  snap.last_save,
+						  snap.fork_us,
+						  snap.cow_pages,
+						  snap.cow_pages * sysconf(_SC_PAGESIZE)};
+	char *names[] = {"loading", "bgsave_in_progress", "last_save_time", "last_fork_usec",
+					 "last_cow_pages", "last_cow_bytes"};
+	int n = sizeof(values) / sizeof(values[0]);
+	char **res = dmalloc((2 * n + 3) * sizeof(char *));
+	for (int i = 0; i < n; i++) {
+		res[2 * i] = strdup(names[i]);
+		res[2 * i + 1] = dmalloc(24);
+		sprintf(res[2 * i + 1], "%lld", values[i]);
+	}
+	res[2 * n] = strdup("last_bgsave_status");
+	res[2 * n + 1] = strdup(snap.last_ok ? "ok" : "err");
+	res[2 * n + 2] = NULL;
+	return res;
+}
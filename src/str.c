@@ -0,0 +1,38 @@
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Binary safe string values. The length and capacity live in a header right
+// before the bytes, so a value is still handed around as a plain char * that
+// is NUL terminated, while str_len gives the real length when it holds NULs.
+
+char *str_new(const char *data, int len) {
+	StrHeader *hdr = dmalloc(sizeof(StrHeader) + len + 1);
+	hdr->len = hdr->cap = len;
+	memcpy(hdr->buf, data, len);
+	hdr->buf[len] = '\0';
+	return hdr->buf;
+}
+
+void str_free(char *s) {
+	if (s != NULL)
+		free(STR_HDR(s));
+}
+
+int str_len(char *s) { return STR_HDR(s)->len; }
+
+// grows s to at least len bytes, zero filling the new ones. Capacity doubles
+// so bit by bit growth from SETBIT stays amortized O(1); s may move.
+char *str_grow(char *s, int len) {
+	StrHeader *hdr = STR_HDR(s);
+	if (len <= hdr->len)
+		return s;
+	if (len > hdr->cap) {
+		int cap = hdr->cap * 2 > len ? hdr->cap * 2 : len;
+		hdr = drealloc(hdr, sizeof(StrHeader) + cap + 1);
+		hdr->cap = cap;
+	}
+	memset(hdr->buf + hdr->len, 0, len - hdr->len + 1);
+	hdr->len = len;
+	return hdr->buf;
+}
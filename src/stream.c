@@ -0,0 +1,523 @@
+#include "common.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Streams append entries to packed blocks of at most STREAM_BLOCK_ENTRIES
+// entries or STREAM_BLOCK_BYTES bytes. An entry is stored as varints: the ms
+// of its id relative to the key of the block, the seq, the number of fields
+// and values, and each of those by length followed by its bytes. Blocks are
+// indexed in a radix tree by the id of their first entry, so ranges seek to
+// the block holding their start and walk the block list from there.
+
+static const StreamID ID_MAX = {UINT64_MAX, UINT64_MAX};
+
+// big endian, so that keys sort like ids
+static void id_key(StreamID id, uint8_t *key) {
+	for (int i = 0; i < 8; i++) {
+		key[i] = id.ms >> (56 - 8 * i);
+		key[8 + i] = id.seq >> (56 - 8 * i);
+	}
+}
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int stream_id_cmp(StreamID a, StreamID b) {
+	if (a.ms != b.ms)
+		return a.ms < b.ms ? -1 : 1;
+	if (a.seq != b.seq)
+		return a.seq < b.seq ? -1 : 1;
+	return 0;
+}
+
+// moves id to the next id, false if it is the largest one
+bool stream_id_incr(StreamID *id) {
+	if (id->seq < UINT64_MAX) {
+		id->seq++;
+		return true;
+	}
+	if (id->ms < UINT64_MAX) {
+		id->ms++;
+		id->seq = 0;
+		return true;
+	}
+	return false;
+}
+
+// moves id to the previous id, false if it is 0-0
+bool stream_id_decr(StreamID *id) {
+	if (id->seq > 0) {
+		id->seq--;
+		return true;
+	}
+	if (id->ms > 0) {
+		id->ms--;
+		id->seq = UINT64_MAX;
+		return true;
+	}
+	return false;
+}
+
+static bool parse_u64(char *str, uint64_t *x, char **end) {
+	if (!isdigit(*str))
+		return false;
+	errno = 0;
+	*x = strtoull(str, end, 10);
+	return errno == 0;
+}
+
+// parses ms-seq, or ms alone in which case the id gets seq
+bool stream_parse_id(char *str, StreamID *id, uint64_t seq) {
+	char *end;
+	if (!parse_u64(str, &id->ms, &end))
+		return false;
+	if (*end == '\0') {
+		id->seq = seq;
+		return true;
+	}
+	return *end == '-' && parse_u64(end + 1, &id->seq, &end) && *end == '\0';
+}
+
+char *stream_id_str(StreamID id) {
+	char buf[48];
+	sprintf(buf, "%llu-%llu", (unsigned long long)id.ms, (unsigned long long)id.seq);
+	return strdup(buf);
+}
+
+static StreamBlock *block_new(StreamID key) {
+	StreamBlock *b = dmalloc(sizeof(StreamBlock));
+	b->key = b->last = key;
+	b->count = b->start = b->used = 0;
+	b->cap = 256;
+	b->data = dmalloc(b->cap);
+	b->next = NULL;
+	return b;
+}
+
+static void block_reserve(StreamBlock *b, int n) {
+	if (b->used + n <= b->cap)
+		return;
+	while (b->used + n > b->cap)
+		b->cap *= 2;
+	b->data = drealloc(b->data, b->cap);
+}
+
+static void varint_put(StreamBlock *b, uint64_t x) {
+	block_reserve(b, 10);
+	while (x >= 0x80) {
+		b->data[b->used++] = (x & 0x7f) | 0x80;
+		x >>= 7;
+	}
+	b->data[b->used++] = x;
+}
+
+static uint64_t varint_get(const uint8_t **p) {
+	uint64_t x = 0;
+	int shift = 0;
+	uint8_t c;
+	do {
+		c = *(*p)++;
+		x |= (uint64_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return x;
+}
+
+static StreamID entry_id(StreamBlock *b, int pos) {
+	const uint8_t *p = b->data + pos;
+	StreamID id;
+	id.ms = b->key.ms + varint_get(&p);
+	id.seq = varint_get(&p);
+	return id;
+}
+
+// moves *pos past the entry there, copying it out into e when e is not NULL
+static void entry_read(StreamBlock *b, int *pos, StreamEntry *e) {
+	const uint8_t *p = b->data + *pos;
+	StreamID id;
+	id.ms = b->key.ms + varint_get(&p);
+	id.seq = varint_get(&p);
+	int n = varint_get(&p);
+	if (e != NULL) {
+		e->id = id;
+		e->nfields = n;
+		e->fields = dmalloc((n > 0 ? n : 1) * sizeof(char *));
+	}
+	for (int i = 0; i < n; i++) {
+		int len = varint_get(&p);
+		if (e != NULL) {
+			e->fields[i] = dmalloc(len + 1);
+			memcpy(e->fields[i], p, len);
+			e->fields[i][len] = '\0';
+		}
+		p += len;
+	}
+	*pos = p - b->data;
+}
+
+Stream *stream_init() {
+	Stream *s = dmalloc(sizeof(Stream));
+	s->len = 0;
+	s->last = (StreamID){0, 0};
+	s->index = radix_init();
+	s->head = s->tail = NULL;
+	s->ngroups = 0;
+	s->groups = NULL;
+	return s;
+}
+
+static void pending_free(void *p) {
+	free(((StreamPending *)p)->consumer);
+	free(p);
+}
+
+static void group_free(StreamGroup *g) {
+	free(g->name);
+	radix_free(g->pel, pending_free);
+	free(g);
+}
+
+void stream_free(Stream *s) {
+	if (s == NULL)
+		return;
+	StreamBlock *b = s->head;
+	while (b != NULL) {
+		StreamBlock *next = b->next;
+		free(b->data);
+		free(b);
+		b = next;
+	}
+	radix_free(s->index, NULL);
+	for (int i = 0; i < s->ngroups; i++)
+		group_free(s->groups[i]);
+	free(s->groups);
+	free(s);
+}
+
+// resolves the id of a new entry, XID_AUTO picks the current time and
+// XID_AUTO_SEQ the next seq within id->ms. Fails unless the id is above the
+// last one of the stream.
+bool stream_add(Stream *s, StreamID *id, int gen, char **fields, int n) {
+	if (gen == XID_AUTO) {
+		id->ms = now_ms();
+		id->seq = 0;
+		if (id->ms <= s->last.ms) {
+			*id = s->last;
+			if (!stream_id_incr(id))
+				return false;
+		}
+	} else if (gen == XID_AUTO_SEQ) {
+		if (id->ms == s->last.ms && s->last.seq == UINT64_MAX)
+			return false;
+		id->seq = id->ms == s->last.ms ? s->last.seq + 1 : 0;
+	}
+	if (stream_id_cmp(*id, s->last) <= 0)
+		return false;
+
+	StreamBlock *b = s->tail;
+	if (b == NULL || b->count >= STREAM_BLOCK_ENTRIES || b->used >= STREAM_BLOCK_BYTES) {
+		b = block_new(*id);
+		if (s->tail != NULL)
+			s->tail->next = b;
+		else
+			s->head = b;
+		s->tail = b;
+		uint8_t key[RADIX_KEY_LEN];
+		id_key(*id, key);
+		radix_insert(s->index, key, b);
+	}
+	varint_put(b, id->ms - b->key.ms);
+	varint_put(b, id->seq);
+	varint_put(b, n);
+	for (int i = 0; i < n; i++) {
+		int len = strlen(fields[i]);
+		varint_put(b, len);
+		block_reserve(b, len);
+		memcpy(b->data + b->used, fields[i], len);
+		b->used += len;
+	}
+	b->count++;
+	b->last = s->last = *id;
+	s->len++;
+	return true;
+}
+
+static void block_drop_head(Stream *s) {
+	StreamBlock *b = s->head;
+	uint8_t key[RADIX_KEY_LEN];
+	id_key(b->key, key);
+	radix_remove(s->index, key);
+	s->head = b->next;
+	if (s->head == NULL)
+		s->tail = NULL;
+	s->len -= b->count;
+	free(b->data);
+	free(b);
+}
+
+// drops the oldest entries until at most maxlen remain, returns how many were
+// dropped. Approximate trims only drop whole blocks and may leave more.
+long long stream_trim(Stream *s, long long maxlen, bool approx) {
+	long long before = s->len;
+	while (s->head != NULL && s->len - s->head->count >= maxlen)
+		block_drop_head(s);
+	while (!approx && s->len > maxlen) {
+		entry_read(s->head, &s->head->start, NULL);
+		s->head->count--;
+		s->len--;
+	}
+	return before - s->len;
+}
+
+// entries with ids within start..end, at most count of them when count > 0
+StreamEntry *stream_range(Stream *s, StreamID start, StreamID end, long long count, int *n) {
+	StreamEntry *res = NULL;
+	int cap = 0;
+	*n = 0;
+	if (stream_id_cmp(start, end) > 0)
+		return NULL;
+	uint8_t key[RADIX_KEY_LEN];
+	id_key(start, key);
+	StreamBlock *b = radix_seek(s->index, key, -1);
+	if (b == NULL)
+		b = s->head;
+	for (; b != NULL; b = b->next) {
+		if (stream_id_cmp(b->last, start) < 0)
+			continue;
+		int pos = b->start;
+		for (int i = 0; i < b->count; i++) {
+			StreamID id = entry_id(b, pos);
+			if (stream_id_cmp(id, end) > 0 || (count > 0 && *n == count))
+				return res;
+			if (stream_id_cmp(id, start) < 0) {
+				entry_read(b, &pos, NULL);
+				continue;
+			}
+			if (*n == cap) {
+				cap = cap == 0 ? 8 : cap * 2;
+				res = drealloc(res, cap * sizeof(StreamEntry));
+			}
+			entry_read(b, &pos, &res[(*n)++]);
+		}
+	}
+	return res;
+}
+
+void stream_entries_free(StreamEntry *entries, int n) {
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < entries[i].nfields; j++)
+			free(entries[i].fields[j]);
+		free(entries[i].fields);
+	}
+	free(entries);
+}
+
+StreamGroup *stream_group(Stream *s, char *name) {
+	for (int i = 0; i < s->ngroups; i++) {
+		if (strcmp(s->groups[i]->name, name) == 0)
+			return s->groups[i];
+	}
+	return NULL;
+}
+
+// false if the group already exists
+bool stream_group_create(Stream *s, char *name, StreamID last) {
+	if (stream_group(s, name) != NULL)
+		return false;
+	StreamGroup *g = dmalloc(sizeof(StreamGroup));
+	g->name = strdup(name);
+	g->last = last;
+	g->pel = radix_init();
+	s->groups = drealloc(s->groups, (s->ngroups + 1) * sizeof(StreamGroup *));
+	s->groups[s->ngroups++] = g;
+	return true;
+}
+
+bool stream_group_destroy(Stream *s, char *name) {
+	for (int i = 0; i < s->ngroups; i++) {
+		if (strcmp(s->groups[i]->name, name) == 0) {
+			group_free(s->groups[i]);
+			s->groups[i] = s->groups[--s->ngroups];
+			return true;
+		}
+	}
+	return false;
+}
+
+static void pending_add(StreamGroup *g, StreamID id, char *consumer) {
+	uint8_t key[RADIX_KEY_LEN];
+	id_key(id, key);
+	StreamPending *p = radix_find(g->pel, key);
+	if (p == NULL) {
+		p = dmalloc(sizeof(StreamPending));
+		p->id = id;
+		p->deliveries = 0;
+		radix_insert(g->pel, key, p);
+	} else {
+		free(p->consumer);
+	}
+	p->consumer = strdup(consumer);
+	p->delivered = now_ms();
+	p->deliveries++;
+}
+
+// with after NULL, delivers the entries past the last one delivered to the
+// group and records them as pending for consumer unless noack is set.
+// Otherwise returns the entries pending for consumer with ids above *after.
+StreamEntry *stream_read_group(Stream *s, StreamGroup *g, char *consumer, StreamID *after,
+							   long long count, bool noack, int *n) {
+	if (after == NULL) {
+		StreamID start = g->last;
+		*n = 0;
+		if (!stream_id_incr(&start))
+			return NULL;
+		StreamEntry *res = stream_range(s, start, ID_MAX, count, n);
+		for (int i = 0; i < *n; i++) {
+			g->last = res[i].id;
+			if (!noack)
+				pending_add(g, res[i].id, consumer);
+		}
+		return res;
+	}
+
+	StreamEntry *res = NULL;
+	int cap = 0;
+	StreamID id = *after;
+	uint8_t key[RADIX_KEY_LEN];
+	*n = 0;
+	while ((count <= 0 || *n < count) && stream_id_incr(&id)) {
+		id_key(id, key);
+		StreamPending *p = radix_seek(g->pel, key, 1);
+		if (p == NULL)
+			break;
+		id = p->id;
+		if (strcmp(p->consumer, consumer) != 0)
+			continue;
+		p->delivered = now_ms();
+		p->deliveries++;
+		if (*n == cap) {
+			cap = cap == 0 ? 8 : cap * 2;
+			res = drealloc(res, cap * sizeof(StreamEntry));
+		}
+		int m;
+		StreamEntry *e = stream_range(s, id, id, 1, &m);
+		res[(*n)++] = m == 1 ? e[0] : (StreamEntry){id, -1, NULL};
+		free(e);
+	}
+	return res;
+}
+
+// removes id from the pending entries of g, false if it was not there
+bool stream_ack(StreamGroup *g, StreamID id) {
+	uint8_t key[RADIX_KEY_LEN];
+	id_key(id, key);
+	StreamPending *p = radix_remove(g->pel, key);
+	if (p != NULL)
+		pending_free(p);
+	return p != NULL;
+}
+
+// blocks are written as their live bytes, which stay valid once moved to the
+// start of a new block since entries are relative to the block key
+void stream_save(SnapWriter *w, Stream *s) {
+	snap_put_len(w, s->len);
+	snap_put_len(w, s->last.ms);
+	snap_put_len(w, s->last.seq);
+	long long nblocks = 0;
+	for (StreamBlock *b = s->head; b != NULL; b = b->next)
+		nblocks++;
+	snap_put_len(w, nblocks);
+	for (StreamBlock *b = s->head; b != NULL; b = b->next) {
+		snap_put_len(w, b->key.ms);
+		snap_put_len(w, b->key.seq);
+		snap_put_len(w, b->last.ms);
+		snap_put_len(w, b->last.seq);
+		snap_put_len(w, b->count);
+		snap_put_str(w, (char *)b->data + b->start, b->used - b->start);
+	}
+	snap_put_len(w, s->ngroups);
+	for (int i = 0; i < s->ngroups; i++) {
+		StreamGroup *g = s->groups[i];
+		snap_put_str(w, g->name, strlen(g->name));
+		snap_put_len(w, g->last.ms);
+		snap_put_len(w, g->last.seq);
+		snap_put_len(w, g->pel->size);
+		StreamID id = {0, 0};
+		uint8_t key[RADIX_KEY_LEN];
+		StreamPending *p;
+		do {
+			id_key(id, key);
+			if ((p = radix_seek(g->pel, key, 1)) == NULL)
+				break;
+			snap_put_len(w, p->id.ms);
+			snap_put_len(w, p->id.seq);
+			snap_put_str(w, p->consumer, strlen(p->consumer));
+			snap_put_u64(w, p->delivered);
+			snap_put_len(w, p->deliveries);
+			id = p->id;
+		} while (stream_id_incr(&id));
+	}
+}
+
+static StreamID load_id(SnapReader *r) {
+	StreamID id;
+	id.ms = snap_get_len(r);
+	id.seq = snap_get_len(r);
+	return id;
+}
+
+Stream *stream_load(SnapReader *r) {
+	Stream *s = stream_init();
+	s->len = snap_get_len(r);
+	s->last = load_id(r);
+	uint8_t key[RADIX_KEY_LEN];
+	uint64_t nblocks = snap_get_len(r);
+	for (uint64_t i = 0; i < nblocks && snap_fits(r, 1); i++) {
+		StreamBlock *b = block_new(load_id(r));
+		b->last = load_id(r);
+		b->count = snap_get_len(r);
+		free(b->data);
+		b->data = (uint8_t *)snap_get_str(r, &b->used);
+		b->cap = b->used + 1;
+		if (s->tail != NULL)
+			s->tail->next = b;
+		else
+			s->head = b;
+		s->tail = b;
+		id_key(b->key, key);
+		radix_insert(s->index, key, b);
+	}
+	uint64_t ngroups = snap_get_len(r);
+	for (uint64_t i = 0; i < ngroups && snap_fits(r, 1); i++) {
+		char *name = snap_get_str(r, NULL);
+		if (!stream_group_create(s, name, load_id(r)))
+			r->failed = true;
+		free(name);
+		StreamGroup *g = s->groups[s->ngroups - 1];
+		uint64_t npending = snap_get_len(r);
+		for (uint64_t j = 0; j < npending && snap_fits(r, 1); j++) {
+			StreamPending *p = dmalloc(sizeof(StreamPending));
+			p->id = load_id(r);
+			p->consumer = snap_get_str(r, NULL);
+			p->delivered = snap_get_u64(r);
+			p->deliveries = snap_get_len(r);
+			id_key(p->id, key);
+			if (radix_find(g->pel, key) != NULL) {
+				r->failed = true;
+				pending_free(p);
+				continue;
+			}
+			radix_insert(g->pel, key, p);
+		}
+	}
+	return s;
+}
@@ -0,0 +1,191 @@
+#include "common.h"
+#include "log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Top-K heavy hitters with HeavyKeeper (Gong et al.). Items hash to one bucket
+// per row holding a fingerprint and a count. A matching bucket counts the item
+// up, a foreign one is decayed by one with probability decay^count and taken
+// over once it reaches zero, so small flows wear each other out while large
+// ones keep their buckets. The largest count over the rows feeds a min heap of
+// the k items seen so far with the highest counts. Memory is fixed by k, width
+// and depth however many distinct items are added.
+
+#define TOPK_SEED 0x9e3779b97f4a7c15ULL
+
+// uniform in (0, 1]
+static double topk_random(TopK *tk) {
+	tk->rng ^= tk->rng << 13;
+	tk->rng ^= tk->rng >> 7;
+	tk->rng ^= tk->rng << 17;
+	return ((tk->rng >> 11) + 1.0) / 9007199254740992.0;
+}
+
+// number of colliding increments up to and including the one that decays a
+// bucket holding count, drawn from the geometric distribution so that large
+// increments cost one draw per decay rather than one per unit
+static uint64_t decay_trials(TopK *tk, uint32_t count) {
+	double p = tk->lookup[count];
+	if (p >= 1)
+		return 1;
+	if (p <= 0)
+		return UINT64_MAX;
+	double t = ceil(log(topk_random(tk)) / log1p(-p));
+	return t < 1 ? 1 : t >= 1e18 ? UINT64_MAX : (uint64_t)t;
+}
+
+static uint32_t count_add(uint32_t c, uint64_t by) {
+	uint64_t sum = c + by;
+	return sum < UINT32_MAX ? sum : UINT32_MAX;
+}
+
+// returns the count of the bucket if it now holds fp, 0 otherwise
+static uint32_t bucket_add(TopK *tk, TopKBucket *b, uint32_t fp, uint64_t incr) {
+	if (b->count == 0)
+		b->fp = fp;
+	if (b->fp == fp) {
+		b->count = count_add(b->count, incr);
+		return b->count;
+	}
+	uint64_t left = incr;
+	while (b->count < TOPK_DECAY_LOOKUP) {
+		uint64_t t = decay_trials(tk, b->count);
+		if (t > left)
+			break;
+		// the increment that empties the bucket is counted for the new item
+		left -= t - 1;
+		if (--b->count == 0) {
+			b->fp = fp;
+			b->count = count_add(0, left);
+			return b->count;
+		}
+		left--;
+	}
+	return 0;
+}
+
+static void heap_swap(TopK *tk, int i, int j) {
+	TopKItem tmp = tk->heap[i];
+	tk->heap[i] = tk->heap[j];
+	tk->heap[j] = tmp;
+}
+
+static void heap_up(TopK *tk, int i) {
+	while (i > 0 && tk->heap[(i - 1) / 2].count > tk->heap[i].count) {
+		heap_swap(tk, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void heap_down(TopK *tk, int i) {
+	for (;;) {
+		int min = i, l = 2 * i + 1, r = l + 1;
+		if (l < tk->n && tk->heap[l].count < tk->heap[min].count)
+			min = l;
+		if (r < tk->n && tk->heap[r].count < tk->heap[min].count)
+			min = r;
+		if (min == i)
+			return;
+		heap_swap(tk, i, min);
+		i = min;
+	}
+}
+
+// k is small, so a scan over the fingerprints beats keeping an index in step
+// with the heap
+static int heap_find(TopK *tk, char *item, uint32_t fp) {
+	for (int i = 0; i < tk->n; i++)
+		if (tk->heap[i].fp == fp && strcmp(tk->heap[i].item, item) == 0)
+			return i;
+	return -1;
+}
+
+TopK *topk_init(int k, int width, int depth, double decay) {
+	TopK *tk = dmalloc(sizeof(TopK));
+	tk->k = k;
+	tk->width = width;
+	tk->depth = depth;
+	tk->decay = decay;
+	size_t size = (size_t)width * depth * sizeof(TopKBucket);
+	tk->buckets = aligned_alloc(64, (size + 63) / 64 * 64);
+	if (tk->buckets == NULL) {
+		log_fatal("Memory allocation failed for %zu bytes", size);
+		fprintf(stderr, "couldn't allocate memory");
+		exit(1);
+	}
+	memset(tk->buckets, 0, size);
+	tk->n = 0;
+	tk->heap = dmalloc(k * sizeof(TopKItem));
+	tk->rng = 0x2545f4914f6cdd1dULL;
+	for (int i = 0; i < TOPK_DECAY_LOOKUP; i++)
+		tk->lookup[i] = pow(decay, i);
+	return tk;
+}
+
+void topk_free(TopK *tk) {
+	if (tk == NULL)
+		return;
+	for (int i = 0; i < tk->n; i++)
+		free(tk->heap[i].item);
+	free(tk->heap);
+	free(tk->buckets);
+	free(tk);
+}
+
+// counts item up by incr, returns the item it pushed out of the top k if any,
+// which the caller frees
+char *topk_add(TopK *tk, char *item, long long incr) {
+	uint64_t h = murmur64a(item, strlen(item), TOPK_SEED);
+	uint32_t fp = h >> 32, step = fp | 1, max = 0;
+	for (int i = 0; i < tk->depth; i++) {
+		uint32_t x = (uint32_t)h + i * step;
+		TopKBucket *b = tk->buckets + (long long)i * tk->width + ((uint64_t)x * tk->width >> 32);
+		uint32_t c = bucket_add(tk, b, fp, incr);
+		if (c > max)
+			max = c;
+	}
+	int pos = heap_find(tk, item, fp);
+	if (pos >= 0) {
+		if (max > tk->heap[pos].count) {
+			tk->heap[pos].count = max;
+			heap_down(tk, pos);
+		}
+		return NULL;
+	}
+	if (max == 0)
+		return NULL;
+	if (tk->n < tk->k) {
+		tk->heap[tk->n] = (TopKItem){strdup(item), fp, max};
+		heap_up(tk, tk->n++);
+		return NULL;
+	}
+	if (max <= tk->heap[0].count)
+		return NULL;
+	char *expelled = tk->heap[0].item;
+	tk->heap[0] = (TopKItem){strdup(item), fp, max};
+	heap_down(tk, 0);
+	return expelled;
+}
+
+bool topk_query(TopK *tk, char *item) {
+	uint64_t h = murmur64a(item, strlen(item), TOPK_SEED);
+	return heap_find(tk, item, h >> 32) >= 0;
+}
+
+static int cmp_topk_item(const void *a, const void *b) {
+	const TopKItem *x = a, *y = b;
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	return strcmp(x->item, y->item);
+}
+
+// the tracked items by descending count, names are borrowed from the heap
+TopKItem *topk_list(TopK *tk, int *n) {
+	*n = tk->n;
+	TopKItem *res = dmalloc((tk->n > 0 ? tk->n : 1) * sizeof(TopKItem));
+	memcpy(res, tk->heap, tk->n * sizeof(TopKItem));
+	qsort(res, tk->n, sizeof(TopKItem), cmp_topk_item);
+	return res;
+}
@@ -0,0 +1,348 @@
+#include "common.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Time series are appended to chunks compressed as in Facebook's Gorilla.
+// Timestamps store the delta of their delta to the previous sample in 1 to 68
+// bits, so regular intervals cost a single bit. Values store their XOR with
+// the previous value, either as one bit when unchanged or as the meaningful
+// bits between its leading and trailing zeros, reusing the previous window
+// when they fit in it. Chunks are closed at TS_CHUNK_BYTES and retention drops
+// whole chunks once their newest sample has expired.
+
+// longest encoding of a sample: '1111' and 64 bits of delta of delta, then
+// '11', 5 bits of leading zeros, 6 bits of length and 64 meaningful bits
+#define TS_SAMPLE_MAX_BITS (4 + 64 + 2 + 5 + 6 + 64)
+#define TS_NO_WINDOW 0xff
+
+typedef struct BitReader {
+	const uint64_t *data;
+	long long pos;
+} BitReader;
+
+typedef struct ChunkIter {
+	BitReader r;
+	TSChunk *c;
+	int i;
+	long long ts;
+	long long delta;
+	uint64_t value;
+	uint8_t leading;
+	uint8_t trailing;
+} ChunkIter;
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static uint64_t double_bits(double x) {
+	uint64_t u;
+	memcpy(&u, &x, sizeof(uint64_t));
+	return u;
+}
+
+static double bits_double(uint64_t u) {
+	double x;
+	memcpy(&x, &u, sizeof(double));
+	return x;
+}
+
+static void chunk_reserve(TSChunk *c, int n) {
+	if (c->nbits + n <= c->cap * 64LL)
+		return;
+	int old = c->cap;
+	while (c->nbits + n > c->cap * 64LL)
+		c->cap *= 2;
+	c->data = drealloc(c->data, c->cap * sizeof(uint64_t));
+	memset(c->data + old, 0, (c->cap - old) * sizeof(uint64_t));
+}
+
+// appends the low n bits of x, most significant first, 1 <= n <= 64
+static void bits_put(TSChunk *c, uint64_t x, int n) {
+	if (n < 64)
+		x &= (1ULL << n) - 1;
+	chunk_reserve(c, n);
+	long long w = c->nbits >> 6;
+	int avail = 64 - (c->nbits & 63);
+	if (n <= avail) {
+		c->data[w] |= x << (avail - n);
+	} else {
+		c->data[w] |= x >> (n - avail);
+		c->data[w + 1] |= x << (64 - (n - avail));
+	}
+	c->nbits += n;
+}
+
+static uint64_t bits_get(BitReader *r, int n) {
+	long long w = r->pos >> 6;
+	int used = r->pos & 63, avail = 64 - used;
+	uint64_t x = (r->data[w] << used) >> (64 - n);
+	if (n > avail)
+		x |= r->data[w + 1] >> (64 - (n - avail));
+	r->pos += n;
+	return x;
+}
+
+static void chunk_init(TSChunk *c, long long t, double value) {
+	c->first_ts = c->last_ts = t;
+	c->first_value = value;
+	c->last_value = double_bits(value);
+	c->last_delta = 0;
+	c->count = 1;
+	c->nbits = 0;
+	c->cap = 8;
+	c->data = calloc(c->cap, sizeof(uint64_t));
+	c->leading = TS_NO_WINDOW;
+	c->trailing = 0;
+}
+
+static bool chunk_full(TSChunk *c) {
+	return c->nbits + TS_SAMPLE_MAX_BITS > TS_CHUNK_BYTES * 8LL;
+}
+
+static void put_timestamp(TSChunk *c, long long t) {
+	long long delta = t - c->last_ts, dod = delta - c->last_delta;
+	if (dod == 0) {
+		bits_put(c, 0, 1);
+	} else if (dod >= -63 && dod <= 64) {
+		bits_put(c, 0x2, 2);
+		bits_put(c, dod + 63, 7);
+	} else if (dod >= -255 && dod <= 256) {
+		bits_put(c, 0x6, 3);
+		bits_put(c, dod + 255, 9);
+	} else if (dod >= -2047 && dod <= 2048) {
+		bits_put(c, 0xe, 4);
+		bits_put(c, dod + 2047, 12);
+	} else {
+		bits_put(c, 0xf, 4);
+		bits_put(c, dod, 64);
+	}
+	c->last_delta = delta;
+	c->last_ts = t;
+}
+
+static void put_value(TSChunk *c, uint64_t value) {
+	uint64_t x = value ^ c->last_value;
+	c->last_value = value;
+	if (x == 0) {
+		bits_put(c, 0, 1);
+		return;
+	}
+	int leading = __builtin_clzll(x), trailing = __builtin_ctzll(x);
+	if (leading > 31)
+		leading = 31;
+	if (c->leading != TS_NO_WINDOW && leading >= c->leading && trailing >= c->trailing) {
+		bits_put(c, 0x2, 2);
+		bits_put(c, x >> c->trailing, 64 - c->leading - c->trailing);
+		return;
+	}
+	int len = 64 - leading - trailing;
+	bits_put(c, 0x3, 2);
+	bits_put(c, leading, 5);
+	// a length of 64 wraps to 0
+	bits_put(c, len, 6);
+	bits_put(c, x >> trailing, len);
+	c->leading = leading;
+	c->trailing = trailing;
+}
+
+static void iter_init(ChunkIter *it, TSChunk *c) {
+	it->r.data = c->data;
+	it->r.pos = 0;
+	it->c = c;
+	it->i = 0;
+	it->ts = c->first_ts;
+	it->delta = 0;
+	it->value = double_bits(c->first_value);
+	it->leading = it->trailing = 0;
+}
+
+// decodes the next sample of the chunk, false once it is exhausted
+static bool iter_next(ChunkIter *it, TSSample *s) {
+	if (it->i == it->c->count)
+		return false;
+	if (it->i++ > 0) {
+		long long dod;
+		if (bits_get(&it->r, 1) == 0)
+			dod = 0;
+		else if (bits_get(&it->r, 1) == 0)
+			dod = (long long)bits_get(&it->r, 7) - 63;
+		else if (bits_get(&it->r, 1) == 0)
+			dod = (long long)bits_get(&it->r, 9) - 255;
+		else if (bits_get(&it->r, 1) == 0)
+			dod = (long long)bits_get(&it->r, 12) - 2047;
+		else
+			dod = (long long)bits_get(&it->r, 64);
+		it->delta += dod;
+		it->ts += it->delta;
+
+		if (bits_get(&it->r, 1) == 1) {
+			if (bits_get(&it->r, 1) == 1) {
+				it->leading = bits_get(&it->r, 5);
+				int len = bits_get(&it->r, 6);
+				if (len == 0)
+					len = 64;
+				it->trailing = 64 - it->leading - len;
+			}
+			int len = 64 - it->leading - it->trailing;
+			it->value ^= bits_get(&it->r, len) << it->trailing;
+		}
+	}
+	s->ts = it->ts;
+	s->value = bits_double(it->value);
+	return true;
+}
+
+TimeSeries *ts_init(long long retention) {
+	TimeSeries *s = dmalloc(sizeof(TimeSeries));
+	s->retention = retention;
+	s->count = 0;
+	s->n = s->cap = 0;
+	s->chunks = NULL;
+	return s;
+}
+
+void ts_free(TimeSeries *s) {
+	if (s == NULL)
+		return;
+	for (int i = 0; i < s->n; i++)
+		free(s->chunks[i].data);
+	free(s->chunks);
+	free(s);
+}
+
+// drops the chunks whose newest sample is older than the retention window,
+// the chunk being appended to is always kept
+static void ts_trim(TimeSeries *s) {
+	if (s->retention == 0)
+		return;
+	long long oldest = s->chunks[s->n - 1].last_ts - s->retention;
+	int k = 0;
+	while (k < s->n - 1 && s->chunks[k].last_ts < oldest) {
+		s->count -= s->chunks[k].count;
+		free(s->chunks[k].data);
+		k++;
+	}
+	if (k == 0)
+		return;
+	memmove(s->chunks, s->chunks + k, (s->n - k) * sizeof(TSChunk));
+	s->n -= k;
+}
+
+// appends a sample at *t, or at the current time when *t is negative.
+// Returns false if *t is not newer than the last sample.
+bool ts_add(TimeSeries *s, long long *t, double value) {
+	if (*t < 0)
+		*t = now_ms();
+	TSChunk *c = s->n > 0 ? &s->chunks[s->n - 1] : NULL;
+	if (c != NULL && *t <= c->last_ts)
+		return false;
+	if (c == NULL || chunk_full(c)) {
+		if (s->n == s->cap) {
+			s->cap = s->cap == 0 ? 4 : s->cap * 2;
+			s->chunks = drealloc(s->chunks, s->cap * sizeof(TSChunk));
+		}
+		chunk_init(&s->chunks[s->n++], *t, value);
+	} else {
+		put_timestamp(c, *t);
+		put_value(c, double_bits(value));
+		c->count++;
+	}
+	s->count++;
+	ts_trim(s);
+	return true;
+}
+
+static void agg_add(TSSample *out, int agg, int *seen, double value) {
+	switch (agg) {
+	case TS_AGG_MIN:
+		if (*seen == 0 || value < out->value)
+			out->value = value;
+		break;
+	case TS_AGG_MAX:
+		if (*seen == 0 || value > out->value)
+			out->value = value;
+		break;
+	case TS_AGG_COUNT:
+		out->value = *seen + 1;
+		break;
+	default:
+		out->value = *seen == 0 ? value : out->value + value;
+	}
+	(*seen)++;
+}
+
+static void agg_done(TSSample *out, int agg, int seen) {
+	if (agg == TS_AGG_AVG)
+		out->value /= seen;
+}
+
+// samples with from <= ts <= to, or with agg one per bucket of the given
+// width starting at the bucket's timestamp. count limits the samples
+// returned when it is positive.
+TSSample *ts_range(TimeSeries *s, long long from, long long to, long long count, int agg,
+				   long long bucket, int *n) {
+	*n = 0;
+	if (s->n > 0 && s->retention > 0 && from < s->chunks[s->n - 1].last_ts - s->retention)
+		from = s->chunks[s->n - 1].last_ts - s->retention;
+	// first chunk that may hold from
+	int lo = 0, hi = s->n;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (s->chunks[mid].last_ts < from)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	int cap = 16, seen = 0;
+	TSSample *res = dmalloc(cap * sizeof(TSSample)), sample = {0};
+	bool done = false;
+	for (int k = lo; k < s->n && !done; k++) {
+		ChunkIter it;
+		iter_init(&it, &s->chunks[k]);
+		while (!done && iter_next(&it, &sample)) {
+			if (sample.ts < from)
+				continue;
+			if (sample.ts > to)
+				break;
+			if (agg == TS_AGG_NONE) {
+				res[(*n)++] = sample;
+				done = count > 0 && *n == count;
+			} else {
+				long long start = sample.ts - sample.ts % bucket;
+				if (seen > 0 && res[*n - 1].ts != start) {
+					agg_done(&res[*n - 1], agg, seen);
+					seen = 0;
+					if (count > 0 && *n == count) {
+						done = true;
+						break;
+					}
+				}
+				if (seen == 0)
+					res[(*n)++].ts = start;
+				agg_add(&res[*n - 1], agg, &seen, sample.value);
+			}
+			if (*n == cap) {
+				cap *= 2;
+				res = drealloc(res, cap * sizeof(TSSample));
+			}
+		}
+		done = done || sample.ts > to;
+	}
+	if (seen > 0)
+		agg_done(&res[*n - 1], agg, seen);
+	return res;
+}
+
+// bytes held by the series, including the unused tail of each chunk
+long long ts_bytes(TimeSeries *s) {
+	long long bytes = sizeof(TimeSeries) + s->cap * sizeof(TSChunk);
+	for (int i = 0; i < s->n; i++)
+		bytes += s->chunks[i].cap * sizeof(uint64_t);
+	return bytes;
+}
@@ -0,0 +1,672 @@
+#include "common.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Vector sets keep their vectors in one array indexed by slot and link the
+// slots into an HNSW graph (Malkov and Yashunin). Each element is inserted on
+// levels 0..l, l drawn from a geometric distribution, and a query descends
+// greedily from the entry point on the top level before running a best first
+// search with ef candidates on level 0. Neighbours are picked with the paper's
+// heuristic, which keeps the links of a node pointing in different directions.
+//
+// Cosine vectors are normalized on insert, so every metric is a dot product or
+// an L2 kernel from distance.c. int8 vectors are quantized symmetrically with
+// one scale per vector and compared to an int8 copy of the query.
+//
+// Links are not kept symmetric, so removing an element repairs the lists of
+// its own neighbours only. Other links to the freed slot are skipped while it
+// is free and are merely extra edges once it is reused.
+
+#define VSET_INDEX_SEED 0x9747b28cULL
+
+typedef struct VecQuery {
+	const float *f32;
+	const int8_t *q8;
+	float scale;
+	float norm;
+} VecQuery;
+
+typedef struct VecCand {
+	float dist;
+	int slot;
+} VecCand;
+
+// binary min heap, max heaps push negated distances
+typedef struct VecHeap {
+	int n;
+	int cap;
+	VecCand *items;
+} VecHeap;
+
+static void heap_push(VecHeap *h, float dist, int slot) {
+	if (h->n == h->cap) {
+		h->cap = h->cap == 0 ? 64 : h->cap * 2;
+		h->items = drealloc(h->items, h->cap * sizeof(VecCand));
+	}
+	int i = h->n++;
+	while (i > 0 && h->items[(i - 1) / 2].dist > dist) {
+		h->items[i] = h->items[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	h->items[i].dist = dist;
+	h->items[i].slot = slot;
+}
+
+static VecCand heap_pop(VecHeap *h) {
+	VecCand top = h->items[0], last = h->items[--h->n];
+	int i = 0;
+	while (2 * i + 1 < h->n) {
+		int c = 2 * i + 1;
+		if (c + 1 < h->n && h->items[c + 1].dist < h->items[c].dist)
+			c++;
+		if (h->items[c].dist >= last.dist)
+			break;
+		h->items[i] = h->items[c];
+		i = c;
+	}
+	if (h->n > 0)
+		h->items[i] = last;
+	return top;
+}
+
+static int cand_cmp(const void *a, const void *b) {
+	const VecCand *x = a, *y = b;
+	if (x->dist != y->dist)
+		return x->dist < y->dist ? -1 : 1;
+	return x->slot - y->slot;
+}
+
+static int *node_links(VectorSet *vs, int slot, int level) {
+	int *links = vs->nodes[slot].links;
+	return level == 0 ? links : links + 2 * vs->m + 1 + (level - 1) * (vs->m + 1);
+}
+
+static int max_links(VectorSet *vs, int level) { return level == 0 ? 2 * vs->m : vs->m; }
+
+static bool slot_live(VectorSet *vs, int slot, int level) {
+	return vs->nodes[slot].name != NULL && vs->nodes[slot].level >= level;
+}
+
+static const void *slot_vector(VectorSet *vs, int slot) {
+	if (vs->quant == VEC_Q8)
+		return vs->q8 + (size_t)slot * vs->dim;
+	return vs->f32 + (size_t)slot * vs->dim;
+}
+
+static void slot_query(VectorSet *vs, int slot, VecQuery *q) {
+	q->f32 = vs->f32 != NULL ? vs->f32 + (size_t)slot * vs->dim : NULL;
+	q->q8 = vs->q8 != NULL ? vs->q8 + (size_t)slot * vs->dim : NULL;
+	q->scale = vs->scale != NULL ? vs->scale[slot] : 1;
+	q->norm = vs->norm != NULL ? vs->norm[slot] : 0;
+}
+
+// smaller is closer: squared L2, 1 - cosine similarity or the negated dot
+// product
+static float vec_dist(VectorSet *vs, VecQuery *q, int slot) {
+	float dot;
+	if (vs->quant == VEC_F32) {
+		const float *v = vs->f32 + (size_t)slot * vs->dim;
+		if (vs->metric == VEC_L2)
+			return vec_l2_f32(q->f32, v, vs->dim);
+		dot = vec_dot_f32(q->f32, v, vs->dim);
+	} else {
+		const int8_t *v = vs->q8 + (size_t)slot * vs->dim;
+		dot = q->scale * vs->scale[slot] * vec_dot_i8(q->q8, v, vs->dim);
+		if (vs->metric == VEC_L2)
+			return q->norm + vs->norm[slot] - 2 * dot;
+	}
+	return vs->metric == VEC_COSINE ? 1 - dot : -dot;
+}
+
+// stores values in the layout of the set: normalized for cosine, then either
+// copied to f32 or quantized to q8 with its scale and squared norm
+static void vec_encode(VectorSet *vs, float *values, float *f32, int8_t *q8, float *scale,
+					   float *norm) {
+	int dim = vs->dim;
+	float mult = 1, maxabs = 0;
+	if (vs->metric == VEC_COSINE) {
+		double sum = 0;
+		for (int i = 0; i < dim; i++)
+			sum += (double)values[i] * values[i];
+		mult = sum > 0 ? 1 / sqrt(sum) : 0;
+	}
+	if (vs->quant == VEC_F32) {
+		for (int i = 0; i < dim; i++)
+			f32[i] = values[i] * mult;
+		return;
+	}
+	for (int i = 0; i < dim; i++)
+		if (fabsf(values[i] * mult) > maxabs)
+			maxabs = fabsf(values[i] * mult);
+	*scale = maxabs > 0 ? maxabs / 127 : 1;
+	for (int i = 0; i < dim; i++)
+		q8[i] = (int8_t)lrintf(values[i] * mult / *scale);
+	*norm = *scale * *scale * vec_dot_i8(q8, q8, dim);
+}
+
+static uint64_t name_hash(char *name) {
+	return murmur64a(name, strlen(name), VSET_INDEX_SEED);
+}
+
+static int index_pos(VectorSet *vs, char *name) {
+	int mask = vs->nindex - 1, i = name_hash(name) & mask;
+	while (vs->index[i] != 0 && strcmp(vs->nodes[vs->index[i] - 1].name, name) != 0)
+		i = (i + 1) & mask;
+	return i;
+}
+
+static int index_find(VectorSet *vs, char *name) {
+	return vs->nindex > 0 ? vs->index[index_pos(vs, name)] - 1 : -1;
+}
+
+static void index_put(VectorSet *vs, int slot) {
+	if ((vs->count + 1) * 2 > vs->nindex) {
+		int old = vs->nindex, *index = vs->index;
+		vs->nindex = old == 0 ? 16 : old * 2;
+		vs->index = calloc(vs->nindex, sizeof(int));
+		for (int i = 0; i < old; i++)
+			if (index[i] != 0)
+				vs->index[index_pos(vs, vs->nodes[index[i] - 1].name)] = index[i];
+		free(index);
+	}
+	vs->index[index_pos(vs, vs->nodes[slot].name)] = slot + 1;
+}
+
+// backward shift deletion, entries after the hole move into it unless that
+// would put them before their home position
+static void index_del(VectorSet *vs, char *name) {
+	int mask = vs->nindex - 1, i = index_pos(vs, name), j = i;
+	vs->index[i] = 0;
+	while (vs->index[j = (j + 1) & mask] != 0) {
+		int home = name_hash(vs->nodes[vs->index[j] - 1].name) & mask;
+		bool stays = i <= j ? i < home && home <= j : i < home || home <= j;
+		if (stays)
+			continue;
+		vs->index[i] = vs->index[j];
+		vs->index[j] = 0;
+		i = j;
+	}
+}
+
+static void next_epoch(VectorSet *vs) {
+	if (++vs->epoch == 0) {
+		memset(vs->visited, 0, vs->cap * sizeof(uint32_t));
+		vs->epoch = 1;
+	}
+}
+
+// best first search on level l from eps[0..neps). Leaves the ef closest slots
+// found in out, sorted by distance, and returns their number. out may be eps.
+static int search_layer(VectorSet *vs, VecQuery *q, VecCand *eps, int neps, int ef, int l,
+						VecCand *out) {
+	VecHeap cand = {0, 0, NULL}, res = {0, 0, NULL};
+	next_epoch(vs);
+	for (int i = 0; i < neps; i++) {
+		vs->visited[eps[i].slot] = vs->epoch;
+		heap_push(&cand, eps[i].dist, eps[i].slot);
+		heap_push(&res, -eps[i].dist, eps[i].slot);
+		if (res.n > ef)
+			heap_pop(&res);
+	}
+	while (cand.n > 0) {
+		VecCand c = heap_pop(&cand);
+		if (res.n >= ef && c.dist > -res.items[0].dist)
+			break;
+		int *links = node_links(vs, c.slot, l);
+		for (int i = 1; i <= links[0]; i++)
+			__builtin_prefetch(slot_vector(vs, links[i]));
+		for (int i = 1; i <= links[0]; i++) {
+			int nb = links[i];
+			if (vs->visited[nb] == vs->epoch || !slot_live(vs, nb, l))
+				continue;
+			vs->visited[nb] = vs->epoch;
+			float d = vec_dist(vs, q, nb);
+			if (res.n < ef || d < -res.items[0].dist) {
+				heap_push(&cand, d, nb);
+				heap_push(&res, -d, nb);
+				if (res.n > ef)
+					heap_pop(&res);
+			}
+		}
+	}
+	int n = res.n;
+	for (int i = n - 1; i >= 0; i--) {
+		VecCand c = heap_pop(&res);
+		out[i].dist = -c.dist;
+		out[i].slot = c.slot;
+	}
+	free(cand.items);
+	free(res.items);
+	return n;
+}
+
+// keeps a candidate only if it is closer to the base than to every candidate
+// kept before it. cands is sorted by distance to the base, the kept ones are
+// moved to its front and counted.
+static int select_neighbors(VectorSet *vs, VecCand *cands, int n, int max) {
+	int kept = 0;
+	for (int i = 0; i < n && kept < max; i++) {
+		VecQuery q;
+		slot_query(vs, cands[i].slot, &q);
+		bool diverse = true;
+		for (int j = 0; j < kept && diverse; j++)
+			diverse = vec_dist(vs, &q, cands[j].slot) >= cands[i].dist;
+		if (diverse)
+			cands[kept++] = cands[i];
+	}
+	return kept;
+}
+
+static void set_links(VectorSet *vs, int slot, int l, VecCand *cands, int n) {
+	int *links = node_links(vs, slot, l);
+	links[0] = n;
+	for (int i = 0; i < n; i++)
+		links[i + 1] = cands[i].slot;
+}
+
+// rebuilds the links of slot on level l from the live slots in a and b, with
+// a[0] and b[0] holding their counts
+static void relink(VectorSet *vs, int slot, int l, int *a, int *b) {
+	VecQuery q;
+	slot_query(vs, slot, &q);
+	VecCand *cands = dmalloc((a[0] + b[0] + 1) * sizeof(VecCand));
+	int n = 0;
+	for (int k = 0; k < 2; k++) {
+		int *links = k == 0 ? a : b;
+		for (int i = 1; i <= links[0]; i++) {
+			if (links[i] == slot || !slot_live(vs, links[i], l))
+				continue;
+			cands[n].dist = vec_dist(vs, &q, links[i]);
+			cands[n++].slot = links[i];
+		}
+	}
+	qsort(cands, n, sizeof(VecCand), cand_cmp);
+	int m = 0;
+	for (int i = 0; i < n; i++)
+		if (m == 0 || cands[i].slot != cands[m - 1].slot)
+			cands[m++] = cands[i];
+	set_links(vs, slot, l, cands, select_neighbors(vs, cands, m, max_links(vs, l)));
+	free(cands);
+}
+
+// adds slot to the links of nb on level l, pruning them once they are full
+static void link_back(VectorSet *vs, int nb, int slot, int l) {
+	int *links = node_links(vs, nb, l);
+	for (int i = 1; i <= links[0]; i++)
+		if (links[i] == slot)
+			return;
+	if (links[0] < max_links(vs, l)) {
+		links[++links[0]] = slot;
+		return;
+	}
+	int extra[2] = {1, slot};
+	relink(vs, nb, l, links, extra);
+}
+
+static int random_level(VectorSet *vs) {
+	vs->rng ^= vs->rng << 13;
+	vs->rng ^= vs->rng >> 7;
+	vs->rng ^= vs->rng << 17;
+	double u = ((vs->rng >> 11) + 1.0) / 9007199254740992.0;
+	int level = -log(u) / log(vs->m);
+	return level < HNSW_MAX_LEVEL ? level : HNSW_MAX_LEVEL - 1;
+}
+
+static void hnsw_insert(VectorSet *vs, int slot) {
+	HNSWNode *node = &vs->nodes[slot];
+	int level = random_level(vs), m = vs->m;
+	node->level = level;
+	node->links = calloc(2 * m + 1 + level * (m + 1), sizeof(int));
+	if (vs->entry < 0) {
+		vs->entry = slot;
+		vs->max_level = level;
+		return;
+	}
+	VecQuery q;
+	slot_query(vs, slot, &q);
+	int ef = vs->ef_construction;
+	VecCand *w = dmalloc(ef * sizeof(VecCand)), *cands = dmalloc(ef * sizeof(VecCand));
+	w[0].dist = vec_dist(vs, &q, vs->entry);
+	w[0].slot = vs->entry;
+	int nw = 1;
+	for (int l = vs->max_level; l > level; l--)
+		nw = search_layer(vs, &q, w, nw, 1, l, w);
+	for (int l = level < vs->max_level ? level : vs->max_level; l >= 0; l--) {
+		nw = search_layer(vs, &q, w, nw, ef, l, w);
+		// a reused slot may still be linked from the graph and find itself
+		int n = 0;
+		for (int i = 0; i < nw; i++)
+			if (w[i].slot != slot)
+				cands[n++] = w[i];
+		n = select_neighbors(vs, cands, n, m);
+		set_links(vs, slot, l, cands, n);
+		for (int i = 0; i < n; i++)
+			link_back(vs, cands[i].slot, slot, l);
+	}
+	if (level > vs->max_level) {
+		vs->entry = slot;
+		vs->max_level = level;
+	}
+	free(w);
+	free(cands);
+}
+
+VectorSet *vset_init(int dim, int metric, int quant, int m, int ef_construction) {
+	VectorSet *vs = dmalloc(sizeof(VectorSet));
+	vs->dim = dim;
+	vs->metric = metric;
+	vs->quant = quant;
+	vs->m = m;
+	vs->ef_construction = ef_construction;
+	vs->count = vs->n = vs->cap = vs->nfree = vs->nindex = 0;
+	vs->free = vs->index = NULL;
+	vs->nodes = NULL;
+	vs->f32 = vs->scale = vs->norm = NULL;
+	vs->q8 = NULL;
+	vs->entry = -1;
+	vs->max_level = 0;
+	vs->epoch = 0;
+	vs->visited = NULL;
+	vs->rng = 0x2545f4914f6cdd1dULL;
+	return vs;
+}
+
+void vset_free(VectorSet *vs) {
+	if (vs == NULL)
+		return;
+	for (int i = 0; i < vs->n; i++) {
+		free(vs->nodes[i].name);
+		free(vs->nodes[i].links);
+	}
+	free(vs->nodes);
+	free(vs->f32);
+	free(vs->q8);
+	free(vs->scale);
+	free(vs->norm);
+	free(vs->free);
+	free(vs->index);
+	free(vs->visited);
+	free(vs);
+}
+
+static void vset_grow(VectorSet *vs) {
+	int old = vs->cap;
+	vs->cap = old == 0 ? 16 : old * 2;
+	vs->nodes = drealloc(vs->nodes, vs->cap * sizeof(HNSWNode));
+	if (vs->quant == VEC_F32) {
+		vs->f32 = drealloc(vs->f32, (size_t)vs->cap * vs->dim * sizeof(float));
+	} else {
+		vs->q8 = drealloc(vs->q8, (size_t)vs->cap * vs->dim);
+		vs->scale = drealloc(vs->scale, vs->cap * sizeof(float));
+		vs->norm = drealloc(vs->norm, vs->cap * sizeof(float));
+	}
+	vs->visited = drealloc(vs->visited, vs->cap * sizeof(uint32_t));
+	memset(vs->visited + old, 0, (vs->cap - old) * sizeof(uint32_t));
+}
+
+bool vset_rem(VectorSet *vs, char *name) {
+	int slot = index_find(vs, name);
+	if (slot < 0)
+		return false;
+	index_del(vs, name);
+	HNSWNode *node = &vs->nodes[slot];
+	free(node->name);
+	node->name = NULL;
+	for (int l = 0; l <= node->level; l++) {
+		int *links = node_links(vs, slot, l);
+		for (int i = 1; i <= links[0]; i++) {
+			int nb = links[i], *nbl;
+			if (!slot_live(vs, nb, l))
+				continue;
+			nbl = node_links(vs, nb, l);
+			for (int j = 1; j <= nbl[0]; j++) {
+				if (nbl[j] == slot) {
+					relink(vs, nb, l, nbl, links);
+					break;
+				}
+			}
+		}
+	}
+	free(node->links);
+	node->links = NULL;
+	vs->free = drealloc(vs->free, (vs->nfree + 1) * sizeof(int));
+	vs->free[vs->nfree++] = slot;
+	vs->count--;
+	if (slot == vs->entry) {
+		vs->entry = -1;
+		vs->max_level = 0;
+		for (int i = 0; i < vs->n; i++) {
+			if (vs->nodes[i].name == NULL)
+				continue;
+			if (vs->entry < 0 || vs->nodes[i].level > vs->max_level) {
+				vs->entry = i;
+				vs->max_level = vs->nodes[i].level;
+			}
+		}
+	}
+	return true;
+}
+
+// adds or replaces the vector of name, true if it was not in the set
+bool vset_add(VectorSet *vs, char *name, float *values) {
+	bool added = !vset_rem(vs, name);
+	int slot;
+	if (vs->nfree > 0) {
+		slot = vs->free[--vs->nfree];
+	} else {
+		if (vs->n == vs->cap)
+			vset_grow(vs);
+		slot = vs->n++;
+	}
+	size_t off = (size_t)slot * vs->dim;
+	if (vs->quant == VEC_F32)
+		vec_encode(vs, values, vs->f32 + off, NULL, NULL, NULL);
+	else
+		vec_encode(vs, values, NULL, vs->q8 + off, &vs->scale[slot], &vs->norm[slot]);
+	vs->nodes[slot].name = strdup(name);
+	index_put(vs, slot);
+	vs->count++;
+	hnsw_insert(vs, slot);
+	return added;
+}
+
+// the stored vector of name, normalized for cosine sets
+bool vset_emb(VectorSet *vs, char *name, float *out) {
+	int slot = index_find(vs, name);
+	if (slot < 0)
+		return false;
+	size_t off = (size_t)slot * vs->dim;
+	for (int i = 0; i < vs->dim; i++)
+		out[i] = vs->quant == VEC_F32 ? vs->f32[off + i] : vs->q8[off + i] * vs->scale[slot];
+	return true;
+}
+
+// the k closest slots by a linear scan
+static int search_exact(VectorSet *vs, VecQuery *q, int k, VecCand *out) {
+	VecHeap res = {0, 0, NULL};
+	for (int i = 0; i < vs->n; i++) {
+		if (vs->nodes[i].name == NULL)
+			continue;
+		float d = vec_dist(vs, q, i);
+		if (res.n < k || d < -res.items[0].dist) {
+			heap_push(&res, -d, i);
+			if (res.n > k)
+				heap_pop(&res);
+		}
+	}
+	int n = res.n;
+	for (int i = n - 1; i >= 0; i--) {
+		VecCand c = heap_pop(&res);
+		out[i].dist = -c.dist;
+		out[i].slot = c.slot;
+	}
+	free(res.items);
+	return n;
+}
+
+static int search_graph(VectorSet *vs, VecQuery *q, int k, int ef, VecCand *out) {
+	out[0].dist = vec_dist(vs, q, vs->entry);
+	out[0].slot = vs->entry;
+	int n = 1;
+	for (int l = vs->max_level; l > 0; l--)
+		n = search_layer(vs, q, out, n, 1, l, out);
+	n = search_layer(vs, q, out, n, ef, 0, out);
+	return n < k ? n : k;
+}
+
+// the k elements closest to query, or to the vector of ele when it is set,
+// closest first. exact scans the whole set instead of the graph. *n is -1 if
+// ele is not in the set.
+VecMatch *vset_search(VectorSet *vs, float *query, char *ele, int k, int ef, bool exact, int *n) {
+	VecQuery q;
+	float *f32 = NULL;
+	int8_t *q8 = NULL;
+	if (ele != NULL) {
+		int slot = index_find(vs, ele);
+		if (slot < 0) {
+			*n = -1;
+			return NULL;
+		}
+		slot_query(vs, slot, &q);
+	} else {
+		if (vs->quant == VEC_F32)
+			f32 = dmalloc(vs->dim * sizeof(float));
+		else
+			q8 = dmalloc(vs->dim);
+		vec_encode(vs, query, f32, q8, &q.scale, &q.norm);
+		q.f32 = f32;
+		q.q8 = q8;
+	}
+	if (ef < k)
+		ef = k;
+	VecCand *found = dmalloc(ef * sizeof(VecCand));
+	*n = 0;
+	if (vs->entry >= 0)
+		*n = exact ? search_exact(vs, &q, k, found) : search_graph(vs, &q, k, ef, found);
+	VecMatch *res = dmalloc((*n > 0 ? *n : 1) * sizeof(VecMatch));
+	for (int i = 0; i < *n; i++) {
+		res[i].name = vs->nodes[found[i].slot].name;
+		res[i].dist = found[i].dist;
+	}
+	free(found);
+	free(f32);
+	free(q8);
+	return res;
+}
+
+// bytes held by the set, vectors, graph and index included
+long long vset_bytes(VectorSet *vs) {
+	long long per_slot = sizeof(HNSWNode) + sizeof(uint32_t);
+	per_slot += vs->quant == VEC_F32 ? vs->dim * sizeof(float) : vs->dim + 2 * sizeof(float);
+	long long bytes = sizeof(VectorSet) + vs->cap * per_slot + vs->nindex * sizeof(int);
+	bytes += vs->nfree * sizeof(int);
+	for (int i = 0; i < vs->n; i++) {
+		if (vs->nodes[i].name == NULL)
+			continue;
+		bytes += strlen(vs->nodes[i].name) + 1;
+		bytes += (2 * vs->m + 1 + vs->nodes[i].level * (vs->m + 1)) * sizeof(int);
+	}
+	return bytes;
+}
+
+// ints in the links of a node on levels 0..level
+static int links_len(VectorSet *vs, int level) { return 2 * vs->m + 1 + level * (vs->m + 1); }
+
+// the graph is written as it is, so loading needs no reinsertion
+void vset_save(SnapWriter *w, VectorSet *vs) {
+	snap_put_len(w, vs->dim);
+	snap_put_u8(w, vs->metric);
+	snap_put_u8(w, vs->quant);
+	snap_put_len(w, vs->m);
+	snap_put_len(w, vs->ef_construction);
+	snap_put_len(w, vs->n);
+	snap_put_len(w, vs->entry + 1);
+	snap_put_len(w, vs->max_level);
+	snap_put_u64(w, vs->rng);
+	for (int i = 0; i < vs->n; i++) {
+		HNSWNode *node = &vs->nodes[i];
+		snap_put_u8(w, node->name != NULL);
+		if (node->name == NULL)
+			continue;
+		snap_put_str(w, node->name, strlen(node->name));
+		snap_put_len(w, node->level);
+		snap_put_bytes(w, node->links, links_len(vs, node->level) * sizeof(int));
+	}
+	size_t values = (size_t)vs->n * vs->dim;
+	if (vs->quant == VEC_F32) {
+		snap_put_bytes(w, vs->f32, values * sizeof(float));
+	} else {
+		snap_put_bytes(w, vs->q8, values);
+		snap_put_bytes(w, vs->scale, vs->n * sizeof(float));
+		snap_put_bytes(w, vs->norm, vs->n * sizeof(float));
+	}
+}
+
+// links pointing outside the set would be followed blindly by searches
+static bool links_valid(VectorSet *vs, int slot) {
+	HNSWNode *node = &vs->nodes[slot];
+	for (int l = 0; l <= node->level; l++) {
+		int *links = node_links(vs, slot, l);
+		if (links[0] < 0 || links[0] > max_links(vs, l))
+			return false;
+		for (int i = 1; i <= links[0]; i++)
+			if (links[i] < 0 || links[i] >= vs->n)
+				return false;
+	}
+	return true;
+}
+
+VectorSet *vset_load(SnapReader *r) {
+	int dim = snap_get_len(r), metric = snap_get_u8(r), quant = snap_get_u8(r);
+	int m = snap_get_len(r), ef_construction = snap_get_len(r);
+	uint64_t n = snap_get_len(r);
+	if (dim < 1 || dim > VEC_MAX_DIM || metric > VEC_IP || quant > VEC_Q8 || m < 1 ||
+		m > HNSW_MAX_M || !snap_fits(r, n * dim))
+		return NULL;
+	VectorSet *vs = vset_init(dim, metric, quant, m, ef_construction);
+	vs->entry = (int)snap_get_len(r) - 1;
+	vs->max_level = snap_get_len(r);
+	vs->rng = snap_get_u64(r);
+	while ((uint64_t)vs->cap < n)
+		vset_grow(vs);
+	for (; (uint64_t)vs->n < n && !r->failed; vs->n++) {
+		HNSWNode *node = &vs->nodes[vs->n];
+		node->name = NULL;
+		node->links = NULL;
+		if (!snap_get_u8(r)) {
+			vs->free = drealloc(vs->free, (vs->nfree + 1) * sizeof(int));
+			vs->free[vs->nfree++] = vs->n;
+			continue;
+		}
+		node->name = snap_get_str(r, NULL);
+		node->level = snap_get_len(r);
+		if (node->level > HNSW_MAX_LEVEL)
+			r->failed = true;
+		int len = r->failed ? 1 : links_len(vs, node->level);
+		node->links = dmalloc(len * sizeof(int));
+		snap_get_bytes(r, node->links, r->failed ? 0 : len * sizeof(int));
+		if (r->failed) {
+			node->level = 0;
+			node->links[0] = 0;
+		}
+		index_put(vs, vs->n);
+		vs->count++;
+	}
+	size_t values = (size_t)vs->n * dim;
+	if (quant == VEC_F32) {
+		snap_get_bytes(r, vs->f32, values * sizeof(float));
+	} else {
+		snap_get_bytes(r, vs->q8, values);
+		snap_get_bytes(r, vs->scale, vs->n * sizeof(float));
+		snap_get_bytes(r, vs->norm, vs->n * sizeof(float));
+	}
+	for (int i = 0; i < vs->n && !r->failed; i++)
+		if (vs->nodes[i].name != NULL && !links_valid(vs, i))
+			r->failed = true;
+	if (vs->entry >= vs->n || (vs->entry >= 0 && vs->nodes[vs->entry].name == NULL))
+		r->failed = true;
+	return vs;
+}
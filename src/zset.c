@@ -0,0 +1,426 @@
+#include "common.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Small sorted sets are packed into one buffer of (score, member) entries kept
+// in order, larger ones become a skiplist whose links carry span counts for
+// rank queries, plus an open addressing index from member to node.
+
+ZNode ZINDEX_DELETED;
+
+static int zcmp(double s1, char *m1, double s2, char *m2) {
+	if (s1 != s2)
+		return s1 < s2 ? -1 : 1;
+	return strcmp(m1, m2);
+}
+
+static double pk_score(char *p) {
+	double score;
+	memcpy(&score, p, sizeof(double));
+	return score;
+}
+
+static char *pk_member(char *p) { return p + sizeof(double); }
+
+static int pk_size(char *p) { return sizeof(double) + strlen(pk_member(p)) + 1; }
+
+static int pk_find(ZSet *zs, char *member) {
+	for (int off = 0; off < zs->used; off += pk_size(zs->packed + off)) {
+		if (strcmp(pk_member(zs->packed + off), member) == 0)
+			return off;
+	}
+	return -1;
+}
+
+static void pk_insert(ZSet *zs, char *member, double score) {
+	int off = 0, n = sizeof(double) + strlen(member) + 1;
+	while (off < zs->used &&
+		   zcmp(pk_score(zs->packed + off), pk_member(zs->packed + off), score, member) < 0)
+		off += pk_size(zs->packed + off);
+	if (zs->used + n > zs->cap) {
+		while (zs->used + n > zs->cap)
+			zs->cap *= 2;
+		zs->packed = drealloc(zs->packed, zs->cap);
+	}
+	char *p = zs->packed + off;
+	memmove(p + n, p, zs->used - off);
+	memcpy(p, &score, sizeof(double));
+	memcpy(pk_member(p), member, n - sizeof(double));
+	zs->used += n;
+	zs->len++;
+}
+
+static void pk_delete(ZSet *zs, int off) {
+	int n = pk_size(zs->packed + off);
+	memmove(zs->packed + off, zs->packed + off + n, zs->used - off - n);
+	zs->used -= n;
+	zs->len--;
+}
+
+static bool is_deleted(ZNode *nd) { return nd == &ZINDEX_DELETED; }
+
+static void index_put(ZNode **index, int size, ZNode *nd) {
+	for (int i = 0; i < size; i++) {
+		int hash = hash_func(nd->member, size, i);
+		if (index[hash] == NULL || is_deleted(index[hash])) {
+			index[hash] = nd;
+			return;
+		}
+	}
+}
+
+static void index_resize(ZSet *zs, int new_size) {
+	int size = next_prime(new_size);
+	ZNode **index = calloc(size, sizeof(ZNode *));
+	for (int i = 0; i < zs->size; i++) {
+		if (zs->index[i] != NULL && !is_deleted(zs->index[i]))
+			index_put(index, size, zs->index[i]);
+	}
+	free(zs->index);
+	zs->index = index;
+	zs->size = size;
+}
+
+// returns the index slot holding member, -1 if it is missing
+static int index_slot(ZSet *zs, char *member) {
+	for (int i = 0; i < zs->size; i++) {
+		int hash = hash_func(member, zs->size, i);
+		ZNode *nd = zs->index[hash];
+		if (nd == NULL)
+			return -1;
+		if (!is_deleted(nd) && strcmp(nd->member, member) == 0)
+			return hash;
+	}
+	return -1;
+}
+
+static ZNode *index_get(ZSet *zs, char *member) {
+	int slot = index_slot(zs, member);
+	return slot >= 0 ? zs->index[slot] : NULL;
+}
+
+static ZNode *znode_init(int height, double score, char *member) {
+	int n = strlen(member) + 1;
+	// the member is stored right after the levels, in the same allocation
+	ZNode *nd = dmalloc(sizeof(ZNode) + height * sizeof(struct ZLevel) + n);
+	nd->score = score;
+	nd->member = (char *)(nd->level + height);
+	memcpy(nd->member, member, n);
+	nd->backward = NULL;
+	nd->height = height;
+	for (int i = 0; i < height; i++) {
+		nd->level[i].forward = NULL;
+		nd->level[i].span = 0;
+	}
+	return nd;
+}
+
+static int zsl_random_level() {
+	int level = 1;
+	while (level < ZSKIPLIST_MAXLEVEL && (random() & 0xffff) < 0xffff / 4)
+		level++;
+	return level;
+}
+
+static ZNode *zsl_insert(ZSet *zs, double score, char *member) {
+	ZNode *update[ZSKIPLIST_MAXLEVEL], *x = zs->header;
+	int rank[ZSKIPLIST_MAXLEVEL];
+	for (int i = zs->level - 1; i >= 0; i--) {
+		rank[i] = i == zs->level - 1 ? 0 : rank[i + 1];
+		while (x->level[i].forward != NULL &&
+			   zcmp(x->level[i].forward->score, x->level[i].forward->member, score, member) < 0) {
+			rank[i] += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		update[i] = x;
+	}
+	int height = zsl_random_level();
+	if (height > zs->level) {
+		for (int i = zs->level; i < height; i++) {
+			rank[i] = 0;
+			update[i] = zs->header;
+			update[i]->level[i].span = zs->len;
+		}
+		zs->level = height;
+	}
+	x = znode_init(height, score, member);
+	for (int i = 0; i < height; i++) {
+		x->level[i].forward = update[i]->level[i].forward;
+		update[i]->level[i].forward = x;
+		x->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
+		update[i]->level[i].span = rank[0] - rank[i] + 1;
+	}
+	for (int i = height; i < zs->level; i++)
+		update[i]->level[i].span++;
+	x->backward = update[0] == zs->header ? NULL : update[0];
+	if (x->level[0].forward != NULL)
+		x->level[0].forward->backward = x;
+	else
+		zs->tail = x;
+	zs->len++;
+	return x;
+}
+
+// unlinks and frees the node holding (score, member)
+static void zsl_delete(ZSet *zs, double score, char *member) {
+	ZNode *update[ZSKIPLIST_MAXLEVEL], *x = zs->header;
+	for (int i = zs->level - 1; i >= 0; i--) {
+		while (x->level[i].forward != NULL &&
+			   zcmp(x->level[i].forward->score, x->level[i].forward->member, score, member) < 0)
+			x = x->level[i].forward;
+		update[i] = x;
+	}
+	x = x->level[0].forward;
+	for (int i = 0; i < zs->level; i++) {
+		if (update[i]->level[i].forward == x) {
+			update[i]->level[i].span += x->level[i].span - 1;
+			update[i]->level[i].forward = x->level[i].forward;
+		} else {
+			update[i]->level[i].span--;
+		}
+	}
+	if (x->level[0].forward != NULL)
+		x->level[0].forward->backward = x->backward;
+	else
+		zs->tail = x->backward;
+	while (zs->level > 1 && zs->header->level[zs->level - 1].forward == NULL)
+		zs->level--;
+	zs->len--;
+	free(x);
+}
+
+// node at 1-based rank
+static ZNode *zsl_by_rank(ZSet *zs, int rank) {
+	ZNode *x = zs->header;
+	int traversed = 0;
+	for (int i = zs->level - 1; i >= 0; i--) {
+		while (x->level[i].forward != NULL && traversed + x->level[i].span <= rank) {
+			traversed += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		if (traversed == rank)
+			return x;
+	}
+	return NULL;
+}
+
+// switches a packed sorted set to the skiplist encoding
+static void zset_convert(ZSet *zs) {
+	char *packed = zs->packed;
+	int used = zs->used;
+	zs->packed = NULL;
+	zs->used = zs->cap = zs->len = 0;
+	zs->level = 1;
+	zs->header = znode_init(ZSKIPLIST_MAXLEVEL, 0, "");
+	zs->tail = NULL;
+	zs->nindex = 0;
+	zs->size = next_prime(ZSET_PACKED_ENTRIES * 2);
+	zs->index = calloc(zs->size, sizeof(ZNode *));
+	for (int off = 0; off < used; off += pk_size(packed + off)) {
+		ZNode *nd = zsl_insert(zs, pk_score(packed + off), pk_member(packed + off));
+		index_put(zs->index, zs->size, nd);
+		zs->nindex++;
+	}
+	free(packed);
+}
+
+ZSet *zset_init() {
+	ZSet *zs = dmalloc(sizeof(ZSet));
+	zs->len = 0;
+	zs->cap = ZSET_PACKED_INIT;
+	zs->used = 0;
+	zs->packed = dmalloc(zs->cap);
+	zs->level = 0;
+	zs->header = zs->tail = NULL;
+	zs->size = zs->nindex = 0;
+	zs->index = NULL;
+	return zs;
+}
+
+void zset_free(ZSet *zs) {
+	if (zs == NULL)
+		return;
+	if (zs->packed != NULL) {
+		free(zs->packed);
+	} else {
+		ZNode *next, *cur = zs->header;
+		while (cur != NULL) {
+			next = cur->level[0].forward;
+			free(cur);
+			cur = next;
+		}
+		free(zs->index);
+	}
+	free(zs);
+}
+
+// adds member or updates its score, returns true if member is new
+bool zset_add(ZSet *zs, char *member, double score) {
+	if (zs->packed != NULL) {
+		int off = pk_find(zs, member);
+		if (off >= 0) {
+			if (pk_score(zs->packed + off) == score)
+				return false;
+			pk_delete(zs, off);
+		} else if (zs->len + 1 > ZSET_PACKED_ENTRIES || strlen(member) > ZSET_PACKED_VALUE) {
+			zset_convert(zs);
+		}
+		if (zs->packed != NULL) {
+			pk_insert(zs, member, score);
+			return off < 0;
+		}
+	}
+
+	int slot = index_slot(zs, member);
+	if (slot >= 0) {
+		ZNode *nd = zs->index[slot];
+		// keep the node in place as long as the order is unchanged
+		if ((nd->backward == NULL || nd->backward->score < score) &&
+			(nd->level[0].forward == NULL || nd->level[0].forward->score > score)) {
+			nd->score = score;
+			return false;
+		}
+		zsl_delete(zs, nd->score, nd->member);
+		zs->index[slot] = zsl_insert(zs, score, member);
+		return false;
+	}
+	if ((zs->nindex + 1) * 100 / zs->size > 70)
+		index_resize(zs, zs->size * 2);
+	index_put(zs->index, zs->size, zsl_insert(zs, score, member));
+	zs->nindex++;
+	return true;
+}
+
+bool zset_rem(ZSet *zs, char *member) {
+	if (zs->packed != NULL) {
+		int off = pk_find(zs, member);
+		if (off < 0)
+			return false;
+		pk_delete(zs, off);
+		return true;
+	}
+	int slot = index_slot(zs, member);
+	if (slot < 0)
+		return false;
+	ZNode *nd = zs->index[slot];
+	zs->index[slot] = &ZINDEX_DELETED;
+	zs->nindex--;
+	zsl_delete(zs, nd->score, nd->member);
+	return true;
+}
+
+bool zset_score(ZSet *zs, char *member, double *score) {
+	if (zs->packed != NULL) {
+		int off = pk_find(zs, member);
+		if (off >= 0)
+			*score = pk_score(zs->packed + off);
+		return off >= 0;
+	}
+	ZNode *nd = index_get(zs, member);
+	if (nd != NULL)
+		*score = nd->score;
+	return nd != NULL;
+}
+
+// 0-based rank of member in ascending order, -1 if it is missing
+int zset_rank(ZSet *zs, char *member) {
+	if (zs->packed != NULL) {
+		int rank = 0;
+		for (int off = 0; off < zs->used; off += pk_size(zs->packed + off), rank++) {
+			if (strcmp(pk_member(zs->packed + off), member) == 0)
+				return rank;
+		}
+		return -1;
+	}
+	ZNode *nd = index_get(zs, member), *x = zs->header;
+	if (nd == NULL)
+		return -1;
+	int rank = 0;
+	for (int i = zs->level - 1; i >= 0; i--) {
+		while (x->level[i].forward != NULL &&
+			   zcmp(x->level[i].forward->score, x->level[i].forward->member, nd->score,
+					nd->member) <= 0) {
+			rank += x->level[i].span;
+			x = x->level[i].forward;
+		}
+		if (x == nd)
+			return rank - 1;
+	}
+	return -1;
+}
+
+// number of members scoring below score, or at most score when inclusive
+int zset_count_below(ZSet *zs, double score, bool inclusive) {
+	int rank = 0;
+	if (zs->packed != NULL) {
+		for (int off = 0; off < zs->used; off += pk_size(zs->packed + off), rank++) {
+			double cur = pk_score(zs->packed + off);
+			if (cur > score || (cur == score && !inclusive))
+				break;
+		}
+		return rank;
+	}
+	ZNode *x = zs->header;
+	for (int i = zs->level - 1; i >= 0; i--) {
+		ZNode *next;
+		while ((next = x->level[i].forward) != NULL &&
+			   (next->score < score || (inclusive && next->score == score))) {
+			rank += x->level[i].span;
+			x = next;
+		}
+	}
+	return rank;
+}
+
+// members ranked start..end (both valid, counted from the top when rev),
+// each followed by its score when withscores is set
+char **zset_range(ZSet *zs, int start, int end, bool rev, bool withscores) {
+	int n = end - start + 1, step = withscores ? 2 : 1;
+	char **res = calloc(n * step + 1, sizeof(char *));
+	int first = rev ? zs->len - 1 - end : start;
+	int i = 0;
+	if (zs->packed != NULL) {
+		int off = 0;
+		for (int r = 0; r < first; r++)
+			off += pk_size(zs->packed + off);
+		for (; i < n; i++, off += pk_size(zs->packed + off)) {
+			int pos = rev ? n - 1 - i : i;
+			res[pos * step] = strdup(pk_member(zs->packed + off));
+			if (withscores)
+				res[pos * step + 1] = dtostr(pk_score(zs->packed + off));
+		}
+	} else {
+		ZNode *x = zsl_by_rank(zs, first + 1);
+		for (; i < n; i++, x = x->level[0].forward) {
+			int pos = rev ? n - 1 - i : i;
+			res[pos * step] = strdup(x->member);
+			if (withscores)
+				res[pos * step + 1] = dtostr(x->score);
+		}
+	}
+	res[n * step] = NULL;
+	return res;
+}
+
+// calls fn on every member scoring between min and max inclusive, in order,
+// until it returns false
+void zset_scan(ZSet *zs, double min, double max, bool (*fn)(char *, double, void *), void *arg) {
+	if (zs->packed != NULL) {
+		for (int off = 0; off < zs->used; off += pk_size(zs->packed + off)) {
+			double score = pk_score(zs->packed + off);
+			if (score > max)
+				return;
+			if (score >= min && !fn(pk_member(zs->packed + off), score, arg))
+				return;
+		}
+		return;
+	}
+	ZNode *x = zs->header;
+	for (int i = zs->level - 1; i >= 0; i--)
+		while (x->level[i].forward != NULL && x->level[i].forward->score < min)
+			x = x->level[i].forward;
+	for (x = x->level[0].forward; x != NULL && x->score <= max; x = x->level[0].forward)
+		if (!fn(x->member, x->score, arg))
+			return;
+}
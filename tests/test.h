@@ -16,5 +16,20 @@ void test_interpret_str(HashTable *ht);
 void test_interpret_hash(HashTable *ht);
 void test_interpret_list(HashTable *ht);
 void test_interpret_set(HashTable *ht);
+void test_interpret_zset(HashTable *ht);
+void test_interpret_hll(HashTable *ht);
+void test_interpret_bitmap(HashTable *ht);
+void test_interpret_roaring(HashTable *ht);
+void test_interpret_stream(HashTable *ht);
+void test_interpret_bloom(HashTable *ht);
+void test_interpret_timeseries(HashTable *ht);
+void test_interpret_json(HashTable *ht);
+void test_interpret_vector(HashTable *ht);
+void test_interpret_sketch(HashTable *ht);
+void test_interpret_geo(HashTable *ht);
+void test_interpret_ratelimit(HashTable *ht);
+void test_interpret_snapshot(HashTable *ht);
+void test_interpret_aof(HashTable *ht);
+void test_interpret_handover(HashTable *ht);
 
 #endif
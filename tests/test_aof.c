@@ -0,0 +1,243 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_AOF "/tmp/hyperkv-test.aof"
+
+// closes the log and replays it into a fresh table
+static HashTable *reload(long long *replayed) {
+	aof_close();
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	*replayed = aof_load(copy, TEST_AOF);
+	return copy;
+}
+
+// whether cmd replies the same on both tables
+static bool same(HashTable *ht, HashTable *copy, char *cmd) {
+	char *a = interpret(ht, parse(cmd)), *b = interpret(copy, parse(cmd));
+	bool res = strcmp(a, b) == 0;
+	free(a);
+	free(b);
+	return res;
+}
+
+static long long file_size(char *path) {
+	struct stat st;
+	return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+static void test_aof_replay(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	HashTable *empty = htable_init(HT_BASE_SIZE);
+	bool opened = aof_open(empty, TEST_AOF, AOF_FSYNC_ALWAYS);
+	htable_free(empty);
+	test_case("test aof replay", {
+		expect("open", opened);
+		expect("set quoted", compare(ht, "set a 'say \"hi\" \\ bye'", "$2\r\nOK\r\n"));
+		expect("rpush", compare(ht, "rpush b x y z", ":3\r\n"));
+		expect("blpop served", compare(ht, "blpop d b 0", "*2\r\n$1\r\nb\r\n$1\r\nx\r\n"));
+		expect("blpop blocks", compare(ht, "blpop c 0", "b"));
+		expect("push to c", compare(ht, "rpush c v w", ":2\r\n"));
+		block_serve(ht);
+		interpret(ht, parse("xadd d * f v"));
+		expect("xadd auto id", compare(ht, "xlen d", ":1\r\n"));
+		expect("xadd nomkstream", compare(ht, "xadd aof:none nomkstream * f v", "$-1\r\n"));
+		expect("error not logged", compare(ht, "incr b", "-ERR wrongtype operation\r\n"));
+		expect("read not logged", compare(ht, "llen b", ":2\r\n"));
+		aof_flush();
+		expect("synced", aof_wait() && aof_durable() == aof_offset());
+	});
+	long long replayed;
+	HashTable *copy = reload(&replayed);
+	test_case("test aof replayed state", {
+		expect("replayed", replayed == 6);
+		expect("same keys", copy->used == 4);
+		expect("string", same(ht, copy, "get a"));
+		expect("list", same(ht, copy, "lrange b 0 -1"));
+		expect("served pop", same(ht, copy, "lrange c 0 -1"));
+		expect("stream", same(ht, copy, "xrange d - +"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_aof_preamble(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	interpret(ht, parse("set a 1"));
+	interpret(ht, parse("hset b f v"));
+	bool opened = aof_open(ht, TEST_AOF, AOF_FSYNC_NO);
+	test_case("test aof snapshot preamble", {
+		expect("open", opened);
+		FILE *f = fopen(TEST_AOF, "r");
+		char magic[8] = {0};
+		expect("starts with a snapshot",
+			   fread(magic, 1, 7, f) == 7 && strcmp(magic, SNAPSHOT_MAGIC) == 0);
+		fclose(f);
+		expect("incr", compare(ht, "incr a", ":2\r\n"));
+		expect("multi line value", compare(ht, "hset b g 'one\ntwo'", ":1\r\n"));
+		aof_flush();
+		expect("written without fsync", aof_durable() == aof_offset());
+	});
+	long long replayed;
+	HashTable *copy = reload(&replayed);
+	test_case("test aof replayed preamble", {
+		expect("replayed", replayed == 2);
+		expect("string", same(ht, copy, "get a"));
+		expect("hash", same(ht, copy, "hmget b f g"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_aof_truncated(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	aof_open(ht, TEST_AOF, AOF_FSYNC_EVERYSEC);
+	interpret(ht, parse("rpush a 1 2"));
+	aof_close();
+	long long size = file_size(TEST_AOF);
+	FILE *f = fopen(TEST_AOF, "a");
+	fputs("rpush \"a\" \"3", f);
+	fclose(f);
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	test_case("test aof truncated tail", {
+		expect("missing log", aof_load(copy, "/tmp/hyperkv-missing.aof") == 0);
+		expect("complete commands replayed", aof_load(copy, TEST_AOF) == 1);
+		expect("list", same(ht, copy, "lrange a 0 -1"));
+		expect("cut off", file_size(TEST_AOF) == size);
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_aof_checksum(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	HashTable *empty = htable_init(HT_BASE_SIZE);
+	aof_open(empty, TEST_AOF, AOF_FSYNC_NO);
+	htable_free(empty);
+	long long preamble = file_size(TEST_AOF);
+	interpret(ht, parse("set a 1"));
+	aof_flush();
+	long long sealed = file_size(TEST_AOF);
+	interpret(ht, parse("set b 2"));
+	aof_close();
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	test_case("test aof checksums", {
+		// a batch a crash left without its checksum line
+		expect("truncate", truncate(TEST_AOF, file_size(TEST_AOF) - 1) == 0);
+		expect("sealed batches replayed", aof_load(copy, TEST_AOF) == 1);
+		expect("unsealed batch dropped", file_size(TEST_AOF) == sealed);
+		expect("no b", compare(copy, "exists b", ":0\r\n"));
+		FILE *f = fopen(TEST_AOF, "r+");
+		// the key of the sealed batch
+		fseek(f, preamble + 5, SEEK_SET);
+		fputc('x', f);
+		fclose(f);
+		HashTable *other = htable_init(HT_BASE_SIZE);
+		expect("damaged batch", aof_load(other, TEST_AOF) < 0);
+		htable_free(other);
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_aof_rewrite(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	HashTable *empty = htable_init(HT_BASE_SIZE);
+	aof_open(empty, TEST_AOF, AOF_FSYNC_EVERYSEC);
+	htable_free(empty);
+	for (int i = 0; i < 500; i++)
+		interpret(ht, parse("incr a"));
+	interpret(ht, parse("rpush b x y"));
+	aof_flush();
+	long long before = file_size(TEST_AOF);
+	test_case("test aof rewrite", {
+		expect("bgrewriteaof",
+			   compare(ht, "bgrewriteaof",
+					   "$45\r\nBackground append only file rewriting started\r\n"));
+		expect("rewrite running",
+			   compare(ht, "bgrewriteaof",
+					   "-ERR background save or rewrite already in progress\r\n"));
+		expect("bgsave during rewrite",
+			   compare(ht, "bgsave", "-ERR append only log rewrite in progress\r\n"));
+		// fed while the child writes
+		expect("incr", compare(ht, "incr a", ":501\r\n"));
+		expect("lpop", compare(ht, "lpop b", "$1\r\nx\r\n"));
+		aof_rewrite_poll(ht, true);
+		char *info = interpret(ht, parse("info persistence"));
+		expect("status",
+			   strstr(info, "$25\r\naof_last_bgrewrite_status\r\n$2\r\nok\r\n") != NULL);
+		free(info);
+		expect("smaller", file_size(TEST_AOF) < before);
+		expect("after the rewrite", compare(ht, "incr a", ":502\r\n"));
+		expect("bgrewriteaof err argc",
+			   compare(ht, "bgrewriteaof x",
+					   "-ERR wrong number of arguments (given 1, expected 0)\r\n"));
+	});
+	long long replayed;
+	HashTable *copy = reload(&replayed);
+	test_case("test aof rewritten state", {
+		expect("replayed the buffered commands", replayed == 3);
+		expect("counter", same(ht, copy, "get a"));
+		expect("list", same(ht, copy, "lrange b 0 -1"));
+		expect("log off", compare(ht, "bgrewriteaof", "-ERR append only log is off\r\n"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_aof_checkpoint(HashTable *ht) {
+	cleanup(ht);
+	unlink(TEST_AOF);
+	HashTable *empty = htable_init(HT_BASE_SIZE);
+	aof_open(empty, TEST_AOF, AOF_FSYNC_NO);
+	htable_free(empty);
+	interpret(ht, parse("set a 1"));
+	interpret(ht, parse("rpush b x y"));
+	snapshot_set_mode(SNAPSHOT_INCREMENTAL);
+	test_case("test aof rewrite from a checkpoint", {
+		expect("bgrewriteaof",
+			   compare(ht, "bgrewriteaof",
+					   "$45\r\nBackground append only file rewriting started\r\n"));
+		expect("bgsave during rewrite",
+			   compare(ht, "bgsave", "-ERR append only log rewrite in progress\r\n"));
+		// logged for the new log and kept out of the checkpoint
+		expect("incr", compare(ht, "incr a", ":2\r\n"));
+		expect("lmove", compare(ht, "lmove b c left right", "$1\r\nx\r\n"));
+		aof_rewrite_poll(ht, true);
+		expect("done", !aof_rewriting());
+		char *info = interpret(ht, parse("info persistence"));
+		expect("status",
+			   strstr(info, "$25\r\naof_last_bgrewrite_status\r\n$2\r\nok\r\n") != NULL);
+		free(info);
+	});
+	snapshot_set_mode(SNAPSHOT_FORK);
+	long long replayed;
+	HashTable *copy = reload(&replayed);
+	test_case("test aof checkpoint replayed", {
+		expect("replayed the commands since", replayed == 2);
+		expect("counter", same(ht, copy, "get a"));
+		expect("source", same(ht, copy, "lrange b 0 -1"));
+		expect("destination", same(ht, copy, "lrange c 0 -1"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+void test_interpret_aof(HashTable *ht) {
+	test_aof_replay(ht);
+	test_aof_preamble(ht);
+	test_aof_truncated(ht);
+	test_aof_checksum(ht);
+	test_aof_rewrite(ht);
+	test_aof_checkpoint(ht);
+	unlink(TEST_AOF);
+}
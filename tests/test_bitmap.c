@@ -0,0 +1,115 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_setbit(HashTable *ht) {
+	test_case("test setbit", {
+		// test gen
+		expect("setbit new key", compare(ht, "setbit a 7 1", ":0\r\n"));
+		expect("setbit returns old bit", compare(ht, "setbit a 7 1", ":1\r\n"));
+		expect("getbit set", compare(ht, "getbit a 7", ":1\r\n"));
+		expect("getbit unset", compare(ht, "getbit a 6", ":0\r\n"));
+		expect("getbit past end", compare(ht, "getbit a 1000", ":0\r\n"));
+		expect("getbit missing key", compare(ht, "getbit b 3", ":0\r\n"));
+		expect("setbit grows", compare(ht, "setbit a 100 1", ":0\r\n"));
+		expect("strlen grown", compare(ht, "strlen a", ":13\r\n"));
+		expect("setbit clears", compare(ht, "setbit a 7 0", ":1\r\n"));
+		expect("bitcount after clear", compare(ht, "bitcount a", ":1\r\n"));
+		expect("setbit on string", compare(ht, "set c a", "$2\r\nOK\r\n"));
+		expect("setbit flips char", compare(ht, "setbit c 6 1", ":0\r\n"));
+		expect("get c", compare(ht, "get c", "$1\r\nc\r\n"));
+		expect("bad offset", compare(ht, "setbit a -1 1",
+									 "-ERR bit offset is not an integer or out of range\r\n"));
+		expect("huge offset", compare(ht, "setbit a 4294967296 1",
+									  "-ERR bit offset is not an integer or out of range\r\n"));
+		expect("bad bit",
+			   compare(ht, "setbit a 1 2", "-ERR bit is not an integer or out of range\r\n"));
+		// test argc
+		expect(
+			"setbit err argc",
+			compare(ht, "setbit a 1", "-ERR wrong number of arguments (given 2, expected 3)\r\n"));
+		expect("getbit err argc",
+			   compare(ht, "getbit a", "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("setbit set", compare(ht, "setbit d 1 1", "-ERR wrongtype operation\r\n"));
+		expect("getbit set", compare(ht, "getbit d 1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_bitcount(HashTable *ht) {
+	test_case("test bitcount", {
+		// test gen
+		expect("set a", compare(ht, "set a foobar", "$2\r\nOK\r\n"));
+		expect("bitcount all", compare(ht, "bitcount a", ":26\r\n"));
+		expect("bitcount bytes", compare(ht, "bitcount a 1 1", ":6\r\n"));
+		expect("bitcount negative", compare(ht, "bitcount a -2 -1", ":7\r\n"));
+		expect("bitcount bits", compare(ht, "bitcount a 5 30 bit", ":17\r\n"));
+		expect("bitcount empty range", compare(ht, "bitcount a 4 2", ":0\r\n"));
+		expect("bitcount missing", compare(ht, "bitcount b", ":0\r\n"));
+		expect("bitpos 1", compare(ht, "bitpos a 1", ":1\r\n"));
+		expect("bitpos 0", compare(ht, "bitpos a 0", ":0\r\n"));
+		expect("bitpos range", compare(ht, "bitpos a 1 2 -1", ":17\r\n"));
+		expect("set c", compare(ht, "set c \xff\xff", "$2\r\nOK\r\n"));
+		expect("bitpos 0 past end", compare(ht, "bitpos c 0", ":16\r\n"));
+		expect("bitpos 0 with end", compare(ht, "bitpos c 0 0 -1", ":-1\r\n"));
+		expect("bitpos missing 0", compare(ht, "bitpos b 0", ":0\r\n"));
+		expect("bitpos missing 1", compare(ht, "bitpos b 1", ":-1\r\n"));
+		expect("bitcount bad mode", compare(ht, "bitcount a 0 1 foo", "-ERR syntax error\r\n"));
+		expect("bitcount bad index",
+			   compare(ht, "bitcount a x 1", "-ERR value is not an integer or out of range\r\n"));
+		expect("bitpos bad bit",
+			   compare(ht, "bitpos a 2", "-ERR bit is not an integer or out of range\r\n"));
+		// test argc
+		expect("bitcount err argc",
+			   compare(ht, "bitcount a 1",
+					   "-ERR wrong number of arguments (given 2, expected 1 or 3..4)\r\n"));
+		expect("bitpos err argc",
+			   compare(ht, "bitpos a",
+					   "-ERR wrong number of arguments (given 1, expected 2..4)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("bitcount set", compare(ht, "bitcount d", "-ERR wrongtype operation\r\n"));
+		expect("bitpos set", compare(ht, "bitpos d 1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_bitop(HashTable *ht) {
+	test_case("test bitop", {
+		// test gen
+		expect("set a", compare(ht, "set a abc", "$2\r\nOK\r\n"));
+		expect("set b", compare(ht, "set b a", "$2\r\nOK\r\n"));
+		expect("bitop and", compare(ht, "bitop and d a b", ":3\r\n"));
+		expect("and pads with zeros", compare(ht, "bitcount d 1 -1", ":0\r\n"));
+		expect("bitop or", compare(ht, "bitop or d a b", ":3\r\n"));
+		expect("get or", compare(ht, "get d", "$3\r\nabc\r\n"));
+		expect("bitop xor", compare(ht, "bitop xor d a b", ":3\r\n"));
+		expect("xor clears common bits", compare(ht, "bitcount d", ":7\r\n"));
+		expect("bitop not", compare(ht, "bitop not d b", ":1\r\n"));
+		expect("get not", compare(ht, "get d", "$1\r\n\x9e\r\n"));
+		expect("missing keys are empty", compare(ht, "bitop or d a x", ":3\r\n"));
+		expect("empty result deletes", compare(ht, "bitop and d x y", ":0\r\n"));
+		expect("deleted d", compare(ht, "exists d", ":0\r\n"));
+		expect("bitop bad op", compare(ht, "bitop nand d a b", "-ERR syntax error\r\n"));
+		expect("bitop not many",
+			   compare(ht, "bitop not d a b",
+					   "-ERR BITOP NOT must be called with a single source key\r\n"));
+		// test argc
+		expect("bitop err argc",
+			   compare(ht, "bitop and d",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		// test type
+		expect("sadd e", compare(ht, "sadd e 1", ":1\r\n"));
+		expect("bitop set", compare(ht, "bitop and d a e", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_bitmap(HashTable *ht) {
+	test_setbit(ht);
+	test_bitcount(ht);
+	test_bitop(ht);
+}
@@ -0,0 +1,73 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_bfadd(HashTable *ht) {
+	test_case("test bf.add", {
+		// test gen
+		expect("bf.add new key", compare(ht, "bf.add a x", ":1\r\n"));
+		expect("bf.add again", compare(ht, "bf.add a x", ":0\r\n"));
+		expect("type", compare(ht, "type a", "$5\r\nbloom\r\n"));
+		expect("bf.exists", compare(ht, "bf.exists a x", ":1\r\n"));
+		expect("bf.exists absent", compare(ht, "bf.exists a y", ":0\r\n"));
+		expect("bf.exists missing key", compare(ht, "bf.exists b x", ":0\r\n"));
+		expect("bf.madd", compare(ht, "bf.madd a y z y x", "*4\r\n:1\r\n:1\r\n:0\r\n:0\r\n"));
+		expect("bf.mexists",
+			   compare(ht, "bf.mexists a x y w", "*3\r\n:1\r\n:1\r\n:0\r\n"));
+		expect("bf.mexists missing key", compare(ht, "bf.mexists b x y", "*2\r\n:0\r\n:0\r\n"));
+		expect("bf.card", compare(ht, "bf.card a", ":3\r\n"));
+		expect("bf.card missing", compare(ht, "bf.card b", ":0\r\n"));
+		// test argc
+		expect("bf.add err argc",
+			   compare(ht, "bf.add a", "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		expect("bf.madd err argc",
+			   compare(ht, "bf.madd a", "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		expect("bf.exists err argc",
+			   compare(ht, "bf.exists a x y",
+					   "-ERR wrong number of arguments (given 3, expected 2)\r\n"));
+		expect("bf.card err argc",
+			   compare(ht, "bf.card", "-ERR wrong number of arguments (given 0, expected 1)\r\n"));
+		// test type
+		expect("sadd c", compare(ht, "sadd c 1", ":1\r\n"));
+		expect("bf.add set", compare(ht, "bf.add c x", "-ERR wrongtype operation\r\n"));
+		expect("bf.mexists set", compare(ht, "bf.mexists c x", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_bfreserve(HashTable *ht) {
+	test_case("test bf.reserve", {
+		expect("bf.reserve", compare(ht, "bf.reserve a 0.001 1000", "$2\r\nOK\r\n"));
+		expect("bf.reserve exists", compare(ht, "bf.reserve a 0.01 10", "-ERR item exists\r\n"));
+		expect("bf.add reserved", compare(ht, "bf.add a x", ":1\r\n"));
+		expect("bf.reserve nonscaling", compare(ht, "bf.reserve b 0.01 2 nonscaling",
+												"$2\r\nOK\r\n"));
+		expect("bf.madd full", compare(ht, "bf.madd b x y z",
+									   "*3\r\n:1\r\n:1\r\n-ERR non scaling filter is full\r\n"));
+		expect("bf.add full", compare(ht, "bf.add b w", "-ERR non scaling filter is full\r\n"));
+		expect("bf.card full", compare(ht, "bf.card b", ":2\r\n"));
+		expect("bf.reserve expansion",
+			   compare(ht, "bf.reserve c 0.01 2 expansion 4", "$2\r\nOK\r\n"));
+		expect("scaling filter grows", compare(ht, "bf.madd c x y z", "*3\r\n:1\r\n:1\r\n:1\r\n"));
+		// test args
+		expect("bad error rate", compare(ht, "bf.reserve d 1 10",
+										 "-ERR error rate should be between 0 and 1\r\n"));
+		expect("bad capacity",
+			   compare(ht, "bf.reserve d 0.01 0", "-ERR capacity is out of range\r\n"));
+		expect("bad expansion", compare(ht, "bf.reserve d 0.01 10 expansion 0",
+										"-ERR expansion is out of range\r\n"));
+		expect("expansion and nonscaling",
+			   compare(ht, "bf.reserve d 0.01 10 expansion 2 nonscaling", "-ERR syntax error\r\n"));
+		expect("bf.reserve err argc",
+			   compare(ht, "bf.reserve d 0.01",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		expect("nothing created", compare(ht, "exists d", ":0\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_bloom(HashTable *ht) {
+	test_bfadd(ht);
+	test_bfreserve(ht);
+}
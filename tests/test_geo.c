@@ -0,0 +1,115 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_geoadd(HashTable *ht) {
+	test_case("test geoadd", {
+		// test gen
+		expect("geoadd new key", compare(ht,
+										 "geoadd a 13.361389 38.115556 Palermo "
+										 "15.087269 37.502669 Catania",
+										 ":2\r\n"));
+		expect("type", compare(ht, "type a", "$4\r\nzset\r\n"));
+		expect("zscore", compare(ht, "zscore a Palermo", "$16\r\n3479099956230698\r\n"));
+		expect("geopos", compare(ht, "geopos a Palermo x",
+								 "*2\r\n*2\r\n$18\r\n13.361389338970184\r\n"
+								 "$16\r\n38.1155563954963\r\n*-1\r\n"));
+		expect("geodist", compare(ht, "geodist a Palermo Catania", "$11\r\n166274.1516\r\n"));
+		expect("geodist km", compare(ht, "geodist a Palermo Catania km", "$8\r\n166.2742\r\n"));
+		expect("geodist mi", compare(ht, "geodist a Palermo Catania mi", "$8\r\n103.3182\r\n"));
+		expect("geodist missing", compare(ht, "geodist a Palermo x", "$-1\r\n"));
+		expect("geoadd update", compare(ht, "geoadd a 15 37 Catania", ":0\r\n"));
+		expect("geoadd ch", compare(ht, "geoadd a ch 15.087269 37.502669 Catania", ":1\r\n"));
+		expect("geoadd nx", compare(ht, "geoadd a nx 15 37 Catania 1 1 x", ":1\r\n"));
+		expect("geoadd xx", compare(ht, "geoadd a xx 1 1 y", ":0\r\n"));
+		expect("zcard", compare(ht, "zcard a", ":3\r\n"));
+		expect("geoadd xx missing key", compare(ht, "geoadd b xx 1 1 y", ":0\r\n"));
+		expect("exists xx missing key", compare(ht, "exists b", ":0\r\n"));
+		// test args
+		expect("geoadd bad lon", compare(ht, "geoadd a 181 1 y",
+										 "-ERR invalid longitude,latitude pair "
+										 "181.000000,1.000000\r\n"));
+		expect("geoadd bad lat", compare(ht, "geoadd a 1 86 y",
+										 "-ERR invalid longitude,latitude pair "
+										 "1.000000,86.000000\r\n"));
+		expect("geoadd bad float",
+			   compare(ht, "geoadd a x 1 y", "-ERR value is not a valid float\r\n"));
+		expect("geoadd nx xx",
+			   compare(ht, "geoadd a nx xx 1 1 y",
+					   "-ERR xx and nx options at the same time are not compatible\r\n"));
+		expect("geoadd syntax", compare(ht, "geoadd a 1 1 y 2", "-ERR syntax error\r\n"));
+		expect("geodist bad unit", compare(ht, "geodist a Palermo Catania yd",
+										   "-ERR unsupported unit provided. please use m, km, ft, "
+										   "mi\r\n"));
+		// test argc
+		expect("geoadd err argc",
+			   compare(ht, "geoadd a 1 1",
+					   "-ERR wrong number of arguments (given 3, expected 4+)\r\n"));
+		expect("geodist err argc",
+			   compare(ht, "geodist a x",
+					   "-ERR wrong number of arguments (given 2, expected 3 or 4)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("geoadd set", compare(ht, "geoadd d 1 1 x", "-ERR wrongtype operation\r\n"));
+		expect("geopos set", compare(ht, "geopos d x", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_geosearch(HashTable *ht) {
+	test_case("test geosearch", {
+		expect("geoadd", compare(ht,
+								 "geoadd a 13.361389 38.115556 Palermo "
+								 "15.087269 37.502669 Catania",
+								 ":2\r\n"));
+		expect("geosearch radius",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius 200 km asc",
+					   "*2\r\n$7\r\nCatania\r\n$7\r\nPalermo\r\n"));
+		expect("geosearch desc withdist",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius 200 km desc withdist",
+					   "*2\r\n*2\r\n$7\r\nPalermo\r\n$8\r\n190.4424\r\n"
+					   "*2\r\n$7\r\nCatania\r\n$7\r\n56.4413\r\n"));
+		expect("geosearch withhash withcoord",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius 100 km withhash withcoord",
+					   "*1\r\n*3\r\n$7\r\nCatania\r\n:3479447370796909\r\n"
+					   "*2\r\n$18\r\n15.087267458438873\r\n$17\r\n37.50266842333161\r\n"));
+		expect("geosearch box",
+			   compare(ht, "geosearch a fromlonlat 15 37 bybox 400 400 km asc",
+					   "*2\r\n$7\r\nCatania\r\n$7\r\nPalermo\r\n"));
+		expect("geosearch small box",
+			   compare(ht, "geosearch a fromlonlat 15 37 bybox 100 100 km", "*0\r\n"));
+		expect("geosearch frommember count",
+			   compare(ht, "geosearch a frommember Palermo byradius 200 km count 1 withdist",
+					   "*1\r\n*2\r\n$7\r\nPalermo\r\n$6\r\n0.0000\r\n"));
+		expect("geosearch count any",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius 200 km count 1 any",
+					   "*1\r\n$7\r\nPalermo\r\n"));
+		expect("geosearch missing key",
+			   compare(ht, "geosearch b frommember x byradius 1 m", "*0\r\n"));
+		// test args
+		expect("geosearch missing member",
+			   compare(ht, "geosearch a frommember x byradius 1 m",
+					   "-ERR could not decode requested zset member\r\n"));
+		expect("geosearch no shape",
+			   compare(ht, "geosearch a fromlonlat 15 37 asc count 1", "-ERR syntax error\r\n"));
+		expect("geosearch two centres",
+			   compare(ht, "geosearch a frommember x fromlonlat 15 37 byradius 1 m",
+					   "-ERR syntax error\r\n"));
+		expect("geosearch bad radius",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius -1 m", "-ERR syntax error\r\n"));
+		expect("geosearch bad count",
+			   compare(ht, "geosearch a fromlonlat 15 37 byradius 1 m count 0",
+					   "-ERR value is not an integer or out of range\r\n"));
+		expect("geosearch err argc",
+			   compare(ht, "geosearch a byradius 1 m",
+					   "-ERR wrong number of arguments (given 4, expected 5+)\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_geo(HashTable *ht) {
+	test_geoadd(ht);
+	test_geosearch(ht);
+}
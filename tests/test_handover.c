@@ -0,0 +1,59 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_HANDOVER "/tmp/hyperkv-test.sock"
+
+// takes over in a child process, which exits 0 if it received a listening
+// socket and the keyspace of ht
+static pid_t take_over(HashTable *ht) {
+	pid_t pid = fork();
+	if (pid != 0)
+		return pid;
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	int sfd = -1, listening = 0;
+	socklen_t len = sizeof(listening);
+	bool ok = handover_receive(TEST_HANDOVER, copy, &sfd, true) == 1;
+	ok = ok && getsockopt(sfd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == 0 && listening;
+	ok = ok && copy->used == ht->used && compare(copy, "get a", "$5\r\nhello\r\n") &&
+		 compare(copy, "lrange b 0 -1", "*2\r\n$1\r\nx\r\n$1\r\ny\r\n");
+	_exit(ok ? 0 : 1);
+}
+
+void test_interpret_handover(HashTable *ht) {
+	cleanup(ht);
+	interpret(ht, parse("set a hello"));
+	interpret(ht, parse("rpush b x y"));
+	int sfd = socket(AF_INET, SOCK_STREAM, 0);
+	listen(sfd, 1);
+	struct sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = TEST_HANDOVER};
+	test_case("test handover", {
+		HashTable *none = htable_init(HT_BASE_SIZE);
+		int fd = -1;
+		expect("no server", handover_receive(TEST_HANDOVER, none, &fd, true) == 0);
+		htable_free(none);
+		expect("listen", handover_listen(TEST_HANDOVER));
+		// a process that goes away before taking over leaves this one serving
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		expect("connect", connect(fd, (SA *)&addr, sizeof(addr)) == 0);
+		close(fd);
+		expect("not taken", !handover_send(sfd, ht));
+		pid_t pid = take_over(ht);
+		expect("handed over", handover_send(sfd, ht));
+		handover_close();
+		int status;
+		expect("taken over", waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+								 WEXITSTATUS(status) == 0);
+		expect("socket left to the new process", access(TEST_HANDOVER, F_OK) == 0);
+	});
+	close(sfd);
+	unlink(TEST_HANDOVER);
+	cleanup(ht);
+}
@@ -0,0 +1,54 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_pfadd(HashTable *ht) {
+	test_case("test pfadd", {
+		// test gen
+		expect("pfadd new sketch", compare(ht, "pfadd a x y z", ":1\r\n"));
+		expect("pfadd seen values", compare(ht, "pfadd a x y", ":0\r\n"));
+		expect("pfadd creates empty sketch", compare(ht, "pfadd b", ":1\r\n"));
+		expect("pfadd existing empty sketch", compare(ht, "pfadd b", ":0\r\n"));
+		expect("type a", compare(ht, "type a", "$11\r\nhyperloglog\r\n"));
+		// test argc
+		expect("empty pfadd",
+			   compare(ht, "pfadd", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		// test type
+		expect("set c", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("pfadd str", compare(ht, "pfadd c x", "-ERR wrongtype operation\r\n"));
+		expect("pfadd set", compare(ht, "pfadd d x", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_pfcount(HashTable *ht) {
+	test_case("test pfcount", {
+		// test gen
+		expect("pfadd a", compare(ht, "pfadd a 1 2 3 4", ":1\r\n"));
+		expect("pfadd b", compare(ht, "pfadd b 3 4 5 6 7", ":1\r\n"));
+		expect("pfcount a", compare(ht, "pfcount a", ":4\r\n"));
+		expect("pfcount union", compare(ht, "pfcount a b", ":7\r\n"));
+		expect("pfcount missing key", compare(ht, "pfcount c", ":0\r\n"));
+		expect("pfmerge", compare(ht, "pfmerge c a b", "$2\r\nOK\r\n"));
+		expect("pfcount merged", compare(ht, "pfcount c", ":7\r\n"));
+		expect("pfmerge into existing", compare(ht, "pfmerge a b", "$2\r\nOK\r\n"));
+		expect("pfcount merged a", compare(ht, "pfcount a", ":7\r\n"));
+		// test argc
+		expect("empty pfcount",
+			   compare(ht, "pfcount", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		expect("empty pfmerge",
+			   compare(ht, "pfmerge", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		// test type
+		expect("set d", compare(ht, "set d 1", "$2\r\nOK\r\n"));
+		expect("pfcount str", compare(ht, "pfcount a d", "-ERR wrongtype operation\r\n"));
+		expect("pfmerge str", compare(ht, "pfmerge d a", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_hll(HashTable *ht) {
+	test_pfadd(ht);
+	test_pfcount(ht);
+}
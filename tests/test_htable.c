@@ -1,5 +1,9 @@
 #include "../src/common.h"
 #include "miniunit.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void test_creation() {
@@ -200,6 +204,92 @@ static void test_list_funcs() {
 	htable_free(ht);
 }
 
+// checks every index of ls against a reference array of ints
+static bool list_matches(List *ls, int *ref, int n) {
+	if (ls->len != n)
+		return false;
+	char buf[16];
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "%d", ref[i]);
+		if (strcmp(list_index(ls, i), buf) != 0)
+			return false;
+	}
+	return true;
+}
+
+static void test_list_chunks() {
+	List *ls = list_init();
+	int ref[2000], n = 0;
+	char buf[16];
+	test_case("test list chunks", {
+		// pushes on both ends spill over many chunks
+		for (int i = 0; i < 1000; i++) {
+			sprintf(buf, "%d", i);
+			list_rpush(ls, buf);
+			ref[n++] = i;
+		}
+		for (int i = 1; i <= 500; i++) {
+			sprintf(buf, "%d", -i);
+			list_lpush(ls, buf);
+			memmove(ref + 1, ref, n++ * sizeof(int));
+			ref[0] = -i;
+		}
+		expect("1500 values over chunks", list_matches(ls, ref, n));
+		expect("index -1 from tail", strcmp(list_index(ls, n - 1), "999") == 0);
+		expect("index out of range", list_index(ls, n) == NULL);
+
+		// lset grows values inside a full chunk
+		expect("lset middle", list_set(ls, 700, "123456789"));
+		ref[700] = 123456789;
+		expect("lset head", list_set(ls, 0, "-1000"));
+		ref[0] = -1000;
+		expect("lset tail", list_set(ls, n - 1, "7"));
+		ref[n - 1] = 7;
+		expect("values after lset", list_matches(ls, ref, n));
+
+		// lrange across chunk boundaries
+		char **range = list_range(ls, 120, 400);
+		bool ok = true;
+		for (int i = 120; i <= 400; i++) {
+			sprintf(buf, "%d", ref[i]);
+			ok = ok && strcmp(range[i - 120], buf) == 0;
+		}
+		expect("lrange 120..400", ok && range[281] == NULL);
+
+		// pops from both ends
+		char *head = list_lpop(ls);
+		char *tail = list_rpop(ls);
+		expect("lpop head", strcmp(head, "-1000") == 0);
+		expect("rpop tail", strcmp(tail, "7") == 0);
+		memmove(ref, ref + 1, --n * sizeof(int));
+		n--;
+		expect("values after pops", list_matches(ls, ref, n));
+
+		// lrem from the tail and the head
+		list_rpush(ls, "5");
+		list_rpush(ls, "5");
+		ref[n++] = 5;
+		ref[n++] = 5;
+		expect("lrem last 2 5s", list_rem(ls, -2, "5") == 2);
+		n -= 2;
+		expect("lrem all 42s", list_rem(ls, 0, "42") == 1);
+		for (int i = 0; i < n; i++) {
+			if (ref[i] == 42) {
+				memmove(ref + i, ref + i + 1, (n - i - 1) * sizeof(int));
+				n--;
+			}
+		}
+		expect("values after lrem", list_matches(ls, ref, n));
+		expect("lpos 500", list_pos(ls, "500") == 500 + 499 - 1);
+
+		// drain the list completely
+		while (ls->len > 0)
+			free(list_rpop(ls));
+		expect("drained list has no chunks", ls->head == NULL && ls->tail == NULL);
+	});
+	list_free(ls);
+}
+
 static void test_set_funcs() {
 	HashTable *ht = htable_init(HT_BASE_SIZE);
 	test_case("test set functions", {
@@ -235,6 +325,774 @@ static void test_set_funcs() {
 	htable_free(ht);
 }
 
+static int ref_cmp(const void *a, const void *b) {
+	const int *x = a, *y = b;
+	if (x[0] != y[0])
+		return x[0] - y[0];
+	char ma[16], mb[16];
+	sprintf(ma, "m%d", x[1]);
+	sprintf(mb, "m%d", y[1]);
+	return strcmp(ma, mb);
+}
+
+// checks ranks, range and scores of zs against (score, member id) pairs
+static bool zset_matches(ZSet *zs, int (*ref)[2], int n) {
+	qsort(ref, n, sizeof(ref[0]), ref_cmp);
+	if (zs->len != n)
+		return false;
+	char **range = n > 0 ? zset_range(zs, 0, n - 1, false, true) : NULL;
+	bool ok = true;
+	char buf[16];
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "m%d", ref[i][1]);
+		double score;
+		ok = ok && zset_rank(zs, buf) == i && zset_score(zs, buf, &score) && score == ref[i][0];
+		ok = ok && strcmp(range[2 * i], buf) == 0 && strtoi(range[2 * i + 1]) == ref[i][0];
+		free(range[2 * i]);
+		free(range[2 * i + 1]);
+	}
+	free(range);
+	return ok;
+}
+
+static void test_zset_encodings() {
+	ZSet *zs = zset_init();
+	int ref[1000][2], n = 0;
+	char buf[16];
+	test_case("test zset encodings", {
+		for (int i = 0; i < 100; i++) {
+			sprintf(buf, "m%d", i);
+			zset_add(zs, buf, i % 7);
+			ref[n][0] = i % 7;
+			ref[n++][1] = i;
+		}
+		expect("100 members stay packed", zs->packed != NULL);
+		expect("packed ranks", zset_matches(zs, ref, n));
+
+		// growing past the packed limit switches to the skiplist
+		for (int i = 100; i < 1000; i++) {
+			sprintf(buf, "m%d", i);
+			zset_add(zs, buf, (i * 37) % 101);
+			ref[n][0] = (i * 37) % 101;
+			ref[n++][1] = i;
+		}
+		expect("1000 members use the skiplist", zs->packed == NULL);
+		expect("skiplist ranks", zset_matches(zs, ref, n));
+
+		// score updates move members, removals close the gaps
+		bool updates = true;
+		bool removals = true;
+		for (int i = 0; i < n; i += 3) {
+			sprintf(buf, "m%d", ref[i][1]);
+			updates = updates && !zset_add(zs, buf, ref[i][0] + 50);
+			ref[i][0] += 50;
+		}
+		for (int i = n - 1; i >= 0; i -= 5) {
+			sprintf(buf, "m%d", ref[i][1]);
+			removals = removals && zset_rem(zs, buf);
+			memmove(ref + i, ref + i + 1, (n - i - 1) * sizeof(ref[0]));
+			n--;
+		}
+		expect("updates are not adds", updates);
+		expect("members removed", removals);
+		expect("removing missing member", !zset_rem(zs, "m-1"));
+		expect("ranks after updates", zset_matches(zs, ref, n));
+
+		int below = 0;
+		for (int i = 0; i < n; i++)
+			below += ref[i][0] < 50;
+		expect("count below 50", zset_count_below(zs, 50, false) == below);
+		expect("count up to 50", zset_count_below(zs, 50, true) >= below);
+	});
+	zset_free(zs);
+}
+
+static bool within(long long estimate, long long exact, double err) {
+	return fabs((double)(estimate - exact)) <= exact * err;
+}
+
+static void test_hll_funcs() {
+	HyperLogLog *a = hll_init();
+	HyperLogLog *b = hll_init();
+	char buf[16];
+	test_case("test hyperloglog", {
+		for (int i = 0; i < 500; i++) {
+			sprintf(buf, "v%d", i);
+			hll_add(a, buf);
+		}
+		expect("500 values stay sparse", !a->dense);
+		expect("sparse estimate", within(hll_count(a), 500, 0.02));
+		expect("estimate is cached", a->cached);
+		expect("re-adding changes nothing", !hll_add(a, "v1") && a->cached);
+
+		for (int i = 500; i < 100000; i++) {
+			sprintf(buf, "v%d", i);
+			hll_add(a, buf);
+		}
+		expect("100000 values are dense", a->dense);
+		expect("dense estimate", within(hll_count(a), 100000, 0.02));
+
+		// merging an overlapping sketch estimates the union
+		for (int i = 50000; i < 150000; i++) {
+			sprintf(buf, "v%d", i);
+			hll_add(b, buf);
+		}
+		uint8_t *raw = calloc(HLL_REGISTERS, sizeof(uint8_t));
+		hll_merge(raw, a);
+		expect("unpacked registers estimate the same", hll_estimate(raw) == hll_count(a));
+		hll_merge(raw, b);
+		expect("union estimate", within(hll_estimate(raw), 150000, 0.02));
+		hll_set_raw(b, raw);
+		expect("packed union estimate", hll_count(b) == hll_estimate(raw));
+		free(raw);
+	});
+	hll_free(a);
+	hll_free(b);
+}
+
+// the dispatched kernels must agree with a plain per byte loop on lengths
+// that are not multiples of the vector width
+static void test_bit_kernels() {
+	int n = 1000;
+	uint8_t *a = malloc(n), *b = malloc(n), *dst = malloc(n);
+	srand(7);
+	for (int i = 0; i < n; i++) {
+		a[i] = rand();
+		b[i] = rand();
+	}
+	bool count_ok = true;
+	bool op_ok = true;
+	uint8_t *srcs[2] = {a, b};
+	int lens[2] = {n, n - 5};
+	test_case("test bit kernels", {
+		for (int len = 0; len <= n; len += 37) {
+			long expected = 0;
+			for (int i = 0; i < len; i++)
+				expected += __builtin_popcount(a[i]);
+			count_ok = count_ok && bit_count(a, len) == expected;
+		}
+		expect("bit_count", count_ok);
+		bit_op(BITOP_AND, dst, srcs, lens, 2, n);
+		for (int i = 0; i < n; i++)
+			op_ok = op_ok && dst[i] == (i < n - 5 ? a[i] & b[i] : 0);
+		bit_op(BITOP_XOR, dst, srcs, lens, 2, n);
+		for (int i = 0; i < n; i++)
+			op_ok = op_ok && dst[i] == (i < n - 5 ? a[i] ^ b[i] : a[i]);
+		expect("bit_op", op_ok);
+		memset(dst, 0, n);
+		dst[900] = 0x10;
+		expect("bit_pos 1", bit_pos(dst, n, 1) == 900 * 8 + 3);
+		memset(dst, 0xff, n);
+		expect("bit_pos 0 none", bit_pos(dst, n, 0) == -1);
+	});
+	free(a);
+	free(b);
+	free(dst);
+}
+
+#define RB_TEST_IDS (4 * 65536)
+
+// fills rb and the reference bitmap ref with n random ids from container
+// key, or with the whole range lo..hi of it when n is 0
+static void rb_fill(Roaring *rb, uint8_t *ref, int key, int n, int lo, int hi) {
+	for (int i = 0; n > 0 ? i < n : i <= hi - lo; i++) {
+		uint32_t x = key << 16 | (n > 0 ? rand() % 65536 : lo + i);
+		roaring_add(rb, x);
+		ref[x] = 1;
+	}
+	roaring_optimize(rb);
+}
+
+static bool rb_matches(Roaring *rb, uint8_t *ref) {
+	uint32_t *ids = roaring_members(rb);
+	long long k = 0;
+	bool ok = true;
+	for (uint32_t x = 0; x < RB_TEST_IDS && ok; x++) {
+		if (ref[x])
+			ok = k < rb->card && ids[k++] == x;
+	}
+	free(ids);
+	return ok && k == rb->card;
+}
+
+// every pair of container encodings meets in one of the ops below and each
+// result is checked against plain byte per id references
+static void test_roaring_funcs() {
+	Roaring *a = roaring_init();
+	Roaring *b = roaring_init();
+	uint8_t *ra = calloc(RB_TEST_IDS, 1), *rb = calloc(RB_TEST_IDS, 1);
+	uint8_t *ref = malloc(RB_TEST_IDS);
+	srand(11);
+	rb_fill(a, ra, 0, 2000, 0, 0);
+	rb_fill(a, ra, 1, 30000, 0, 0);
+	rb_fill(a, ra, 2, 0, 100, 60000);
+	rb_fill(a, ra, 3, 10, 0, 0);
+	rb_fill(b, rb, 0, 2000, 0, 0);
+	rb_fill(b, rb, 1, 20000, 0, 0);
+	rb_fill(b, rb, 2, 0, 0, 65535);
+	rb_fill(b, rb, 3, 2000, 0, 0);
+	Roaring *pair[2] = {a, b};
+	test_case("test roaring", {
+		expect("array container", a->containers[0].type == RB_ARRAY);
+		expect("bitmap container", a->containers[1].type == RB_BITMAP);
+		expect("run container", a->containers[2].type == RB_RUN && a->containers[2].n == 1);
+		expect("full run container", b->containers[2].type == RB_RUN);
+		expect("a matches", rb_matches(a, ra));
+		expect("contains in run", roaring_contains(a, 2 << 16 | 100));
+		expect("not in run", !roaring_contains(a, 2 << 16 | 99));
+
+		for (int op = SET_INTER; op <= SET_DIFF; op++) {
+			for (int x = 0; x < RB_TEST_IDS; x++)
+				ref[x] = op == SET_INTER	 ? ra[x] & rb[x]
+						 : op == SET_UNION ? ra[x] | rb[x]
+										   : ra[x] & !rb[x];
+			Roaring *res = roaring_op(pair, 2, op);
+			expect("op matches", rb_matches(res, ref));
+			roaring_free(res);
+		}
+
+		// removing from the middle of a run splits it
+		expect("rem in run", roaring_rem(a, 2 << 16 | 30000));
+		ra[2 << 16 | 30000] = 0;
+		roaring_optimize(a);
+		expect("split run", a->containers[2].type == RB_RUN && a->containers[2].n == 2);
+		expect("a matches after rem", rb_matches(a, ra));
+		for (int x = 0; x < 65536; x++)
+			roaring_rem(b, 2 << 16 | x);
+		expect("empty container dropped", b->n == 3);
+	});
+	roaring_free(a);
+	roaring_free(b);
+	free(ra);
+	free(rb);
+	free(ref);
+}
+
+static void radix_key(uint64_t x, uint8_t *key) {
+	memset(key, 0, RADIX_KEY_LEN);
+	for (int i = 0; i < 8; i++)
+		key[8 + i] = x >> (56 - 8 * i);
+}
+
+// keys are spread so that prefixes get split and merged again on removal,
+// seeks are checked against a scan of the sorted values
+static void test_radix_funcs() {
+	RadixTree *t = radix_init();
+	int n = 2000;
+	uint64_t *vals = malloc(n * sizeof(uint64_t));
+	uint8_t key[RADIX_KEY_LEN];
+	for (int i = 0; i < n; i++) {
+		vals[i] = (uint64_t)i * i * 2654435761ULL % 1000003 * 64 + 1;
+		radix_key(vals[i], key);
+		radix_insert(t, key, &vals[i]);
+	}
+	bool found = true;
+	bool seek = true;
+	bool removed = true;
+	test_case("test radix tree", {
+		for (int i = 0; i < n; i++) {
+			radix_key(vals[i], key);
+			found = found && radix_find(t, key) == &vals[i];
+		}
+		expect("find inserted", found);
+		radix_key(5, key);
+		expect("find missing", radix_find(t, key) == NULL);
+		for (uint64_t x = 0; x < 64000000; x += 99991) {
+			uint64_t *le = NULL;
+			uint64_t *ge = NULL;
+			for (int i = 0; i < n; i++) {
+				if (vals[i] <= x && (le == NULL || vals[i] > *le))
+					le = &vals[i];
+				if (vals[i] >= x && (ge == NULL || vals[i] < *ge))
+					ge = &vals[i];
+			}
+			radix_key(x, key);
+			seek = seek && radix_seek(t, key, -1) == le && radix_seek(t, key, 1) == ge;
+		}
+		expect("seek", seek);
+		for (int i = 0; i < n; i += 2) {
+			radix_key(vals[i], key);
+			removed = removed && radix_remove(t, key) == &vals[i];
+		}
+		for (int i = 0; i < n; i++) {
+			radix_key(vals[i], key);
+			removed = removed && radix_find(t, key) == (i % 2 == 1 ? &vals[i] : NULL);
+		}
+		expect("remove every other", removed && t->size == n / 2);
+		for (int i = 1; i < n; i += 2) {
+			radix_key(vals[i], key);
+			radix_remove(t, key);
+		}
+		expect("empty", t->size == 0 && t->root->nchildren == 0);
+	});
+	radix_free(t, NULL);
+	free(vals);
+}
+
+// entries spanning many blocks, ranges starting inside a block and trims
+// that drop whole blocks or part of one
+static void test_stream_blocks() {
+	Stream *st = stream_init();
+	char *fields[2] = {"f", "v"};
+	int n;
+	for (uint64_t i = 1; i <= 1000; i++) {
+		StreamID id = {i, i % 3};
+		stream_add(st, &id, XID_EXPLICIT, fields, 2);
+	}
+	test_case("test stream blocks", {
+		expect("several blocks", st->index->size == (1000 + STREAM_BLOCK_ENTRIES - 1) /
+														   STREAM_BLOCK_ENTRIES);
+		StreamEntry *e = stream_range(st, (StreamID){500, 0}, (StreamID){UINT64_MAX, 0}, 3, &n);
+		expect("range inside a block", n == 3 && e[0].id.ms == 500 && e[2].id.ms == 502 &&
+										   strcmp(e[2].fields[1], "v") == 0);
+		stream_entries_free(e, n);
+		e = stream_range(st, (StreamID){0, 0}, (StreamID){UINT64_MAX, UINT64_MAX}, 0, &n);
+		expect("full range", n == 1000 && e[999].id.ms == 1000);
+		stream_entries_free(e, n);
+		expect("approx trim drops blocks", stream_trim(st, 900, true) == 0 && st->len == 1000);
+		expect("approx trim", stream_trim(st, 700, true) == 256 && st->len == 744);
+		expect("exact trim", stream_trim(st, 700, false) == 44 && st->len == 700);
+		e = stream_range(st, (StreamID){0, 0}, (StreamID){UINT64_MAX, UINT64_MAX}, 1, &n);
+		expect("first after trim", n == 1 && e[0].id.ms == 301);
+		stream_entries_free(e, n);
+		StreamID auto_id = {0};
+		expect("auto id", stream_add(st, &auto_id, XID_AUTO, fields, 2) && auto_id.ms > 1000);
+	});
+	stream_free(st);
+}
+
+// no false negatives, and the measured false positive rate stays under the
+// target for a single filter and for one that scaled past its capacity
+static void test_bloom_funcs() {
+	Bloom *fixed = bloom_init(0.01, 10000, 0);
+	Bloom *scaled = bloom_init(0.01, 1000, 2);
+	char **items = malloc(20000 * sizeof(char *));
+	int *res = malloc(20000 * sizeof(int));
+	for (int i = 0; i < 20000; i++) {
+		items[i] = malloc(16);
+		sprintf(items[i], "in%d", i);
+	}
+	test_case("test bloom filter", {
+		bloom_add(fixed, items, 10000, res);
+		bloom_add(scaled, items, 20000, res);
+		expect("sub filters added", scaled->n > 1 && fixed->n == 1);
+		bloom_add(fixed, items, 1, res);
+		expect("re-adding reports 0", res[0] == 0);
+		int missing = 0;
+		bloom_exists(fixed, items, 10000, res);
+		for (int i = 0; i < 10000; i++)
+			missing += !res[i];
+		bloom_exists(scaled, items, 20000, res);
+		for (int i = 0; i < 20000; i++)
+			missing += !res[i];
+		expect("no false negatives", missing == 0);
+
+		for (int i = 0; i < 20000; i++)
+			sprintf(items[i], "out%d", i);
+		int fixed_fp = 0;
+		int scaled_fp = 0;
+		bloom_exists(fixed, items, 20000, res);
+		for (int i = 0; i < 20000; i++)
+			fixed_fp += res[i];
+		bloom_exists(scaled, items, 20000, res);
+		for (int i = 0; i < 20000; i++)
+			scaled_fp += res[i];
+		expect("fixed error rate", fixed_fp < 20000 * 0.012);
+		expect("scaled error rate", scaled_fp < 20000 * 0.012);
+	});
+	for (int i = 0; i < 20000; i++)
+		free(items[i]);
+	free(items);
+	free(res);
+	bloom_free(fixed);
+	bloom_free(scaled);
+}
+
+// the count-min sketch never undercounts and stays within its error bound for
+// nearly every item, and HeavyKeeper finds the heavy items among many light ones
+static void test_sketch_funcs() {
+	CountMin *cms = cms_init(2000, 5);
+	TopK *tk = topk_init(10, 80, 4, 0.9);
+	char **items = malloc(5000 * sizeof(char *));
+	long long *incrs = malloc(5000 * sizeof(long long));
+	long long *res = malloc(5000 * sizeof(long long));
+	int *events = malloc(20000 * sizeof(int));
+	for (int i = 0; i < 5000; i++) {
+		items[i] = malloc(16);
+		sprintf(items[i], "item%d", i);
+		incrs[i] = i % 100 + 1;
+	}
+	// items 0..9 are heavy, the next 4000 are seen once or twice
+	int nevents = 0;
+	for (int i = 0; i < 10; i++)
+		for (int j = 0; j < 300 + 50 * i; j++)
+			events[nevents++] = i;
+	for (int i = 10; i < 4010; i++)
+		for (int j = 0; j <= i % 2; j++)
+			events[nevents++] = i;
+	uint64_t rng = 1;
+	for (int i = nevents - 1; i > 0; i--) {
+		rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+		int j = (rng >> 33) % (i + 1);
+		int tmp = events[i];
+		events[i] = events[j];
+		events[j] = tmp;
+	}
+	test_case("test count-min sketch and top-k", {
+		cms_incrby(cms, items, incrs, 5000, res);
+		cms_query(cms, items, 5000, res);
+		int under = 0;
+		int over = 0;
+		double bound = 2.718281828 / 2000 * cms->count;
+		for (int i = 0; i < 5000; i++) {
+			under += res[i] < incrs[i];
+			over += res[i] > incrs[i] + bound;
+		}
+		expect("total count", cms->count == 50 * 101 * 50);
+		expect("no undercounts", under == 0);
+		expect("error bound", over < 5000 * 0.01);
+		cms_merge(cms, &cms, NULL, 1);
+		long long before = res[0];
+		cms_query(cms, items, 1, res);
+		expect("merge with itself", res[0] == before);
+		long long two = 2;
+		cms_merge(cms, &cms, &two, 1);
+		cms_query(cms, items, 1, res);
+		expect("weighted merge", res[0] == 2 * before && cms->count == 2 * 50 * 101 * 50);
+
+		for (int i = 0; i < nevents; i++)
+			free(topk_add(tk, items[events[i]], 1));
+		int n;
+		TopKItem *top = topk_list(tk, &n);
+		int heavy = 0;
+		int sorted = 1;
+		for (int i = 0; i < n; i++) {
+			heavy += strncmp(top[i].item, "item", 4) == 0 && atoi(top[i].item + 4) < 10;
+			sorted &= i == 0 || top[i - 1].count >= top[i].count;
+		}
+		expect("heavy hitters found", n == 10 && heavy == 10);
+		expect("list sorted", sorted);
+		expect("query", topk_query(tk, items[9]) && !topk_query(tk, items[4000]));
+		free(top);
+		free(topk_add(tk, "flood", 1000000000));
+		expect("large increment", topk_query(tk, "flood"));
+	});
+	for (int i = 0; i < 5000; i++)
+		free(items[i]);
+	free(items);
+	free(incrs);
+	free(res);
+	free(events);
+	cms_free(cms);
+	topk_free(tk);
+}
+
+// radius and box searches return exactly the points a scan over all of them
+// finds, including searches across the antimeridian and near the poles
+static void test_geo_search() {
+	ZSet *zs = zset_init();
+	double *lon = malloc(1500 * sizeof(double));
+	double *lat = malloc(1500 * sizeof(double));
+	char name[16];
+	uint64_t rng = 7;
+	for (int i = 0; i < 1500; i++) {
+		rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+		double u = (rng >> 11) / 9007199254740992.0;
+		rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+		double v = (rng >> 11) / 9007199254740992.0;
+		// half of the points sit in a small area to exercise fine steps
+		if (i % 2 == 0) {
+			lon[i] = 179.5 + v;
+			lon[i] -= lon[i] > 180 ? 360 : 0;
+			lat[i] = 10 + u;
+		} else {
+			lon[i] = -180 + 360 * v;
+			lat[i] = GEO_LAT_MIN + (GEO_LAT_MAX - GEO_LAT_MIN) * u;
+		}
+		sprintf(name, "p%d", i);
+		zset_add(zs, name, geo_encode(lon[i], lat[i]));
+		geo_decode(geo_encode(lon[i], lat[i]), &lon[i], &lat[i]);
+	}
+	double centres[][2] = {{180, 10.5}, {-179.9, 10.2}, {0, 84}, {12, -84.9}, {45, 30}, {-70, 0}};
+	double sizes[] = {1000, 20000, 100000, 800000, 5000000};
+	GeoShape shape = {0};
+	GeoShape near = {.lon = 180, .lat = 10.5, .radius = 50000};
+	test_case("test geo search", {
+		int wrong = 0;
+		int total = 0;
+		for (int c = 0; c < 6; c++) {
+			for (int k = 0; k < 10; k++) {
+				shape.lon = centres[c][0];
+				shape.lat = centres[c][1];
+				shape.box = k % 2;
+				shape.radius = sizes[k / 2];
+				shape.width = sizes[k / 2];
+				shape.height = sizes[k / 2] * 1.5;
+				int n;
+				GeoMatch *res = geo_search(zs, &shape, GEO_SORT_NONE, 0, false, &n);
+				int expected = 0;
+				for (int i = 0; i < 1500; i++) {
+					double d = geo_dist(shape.lon, shape.lat, lon[i], lat[i]);
+					if (shape.box)
+						expected += 6372797.560856 * fabs(lat[i] - shape.lat) * M_PI / 180 <=
+										shape.height / 2 &&
+									geo_dist(shape.lon, lat[i], lon[i], lat[i]) <= shape.width / 2;
+					else
+						expected += d <= shape.radius;
+				}
+				wrong += n != expected;
+				total += n;
+				free(res);
+			}
+		}
+		expect("matches a full scan", wrong == 0);
+		expect("searches found points", total > 1000);
+		int n;
+		GeoMatch *res = geo_search(zs, &near, GEO_SORT_ASC, 5, false, &n);
+		int sorted = n == 5;
+		for (int i = 1; i < n; i++)
+			sorted &= res[i - 1].dist <= res[i].dist;
+		expect("count keeps the nearest", sorted);
+		free(res);
+		res = geo_search(zs, &near, GEO_SORT_NONE, 3, true, &n);
+		expect("any stops early", n == 3);
+		free(res);
+	});
+	free(lon);
+	free(lat);
+	zset_free(zs);
+}
+
+// a steady stream at the limit is always allowed after the burst, one just
+// above it is limited at the expected times, and idle time refills the burst
+static void test_gcra() {
+	RateLimit rl = {0};
+	RateLimitResult r;
+	long long now = 1000000000;
+	test_case("test gcra", {
+		// 10 per second with bursts of 4 more
+		int allowed = 0;
+		for (int i = 0; i < 10; i++) {
+			gcra_throttle(&rl, now, 4, 10, 1000000, 1, &r);
+			allowed += !r.limited;
+		}
+		expect("burst", allowed == 5 && r.limited && r.retry_after == 100000);
+		now += r.retry_after;
+		gcra_throttle(&rl, now, 4, 10, 1000000, 1, &r);
+		expect("allowed after retry", !r.limited && r.remaining == 0);
+		allowed = 0;
+		for (int i = 0; i < 100; i++) {
+			now += 100000;
+			gcra_throttle(&rl, now, 4, 10, 1000000, 1, &r);
+			allowed += !r.limited;
+		}
+		expect("steady rate", allowed == 100);
+		allowed = 0;
+		for (int i = 0; i < 100; i++) {
+			now += 50000;
+			gcra_throttle(&rl, now, 4, 10, 1000000, 1, &r);
+			allowed += !r.limited;
+		}
+		expect("double rate", allowed == 50);
+		now += 10000000;
+		gcra_throttle(&rl, now, 4, 10, 1000000, 0, &r);
+		expect("refilled", !r.limited && r.remaining == 5 && r.reset_after == 0);
+		gcra_throttle(&rl, now, 4, 10, 1000000, 6, &r);
+		expect("never allowed", r.limited && r.retry_after == -1);
+		gcra_throttle(&rl, now, 4, 10, 1000000, 5, &r);
+		expect("whole burst", !r.limited && r.remaining == 0 && r.reset_after == 500000);
+	});
+}
+
+// samples read back exactly across every delta of delta and XOR encoding, and
+// a regular gauge stays under 2 bytes per sample
+static void test_ts_chunks() {
+	TimeSeries *regular = ts_init(0);
+	TimeSeries *mixed = ts_init(0);
+	TimeSeries *kept = ts_init(10000);
+	long long deltas[] = {1000, 1000, 1001, 1200, 3000, 1, 5000000000LL, 1000};
+	double values[] = {1.5, 1.5, 2.5, -0.1, 1e300, 0, -INFINITY, 3};
+	long long t = 0;
+	for (int i = 0; i < 100; i++) {
+		t += deltas[i % 8];
+		long long at = t;
+		ts_add(mixed, &at, values[i % 8] * (i + 1));
+	}
+	for (long long i = 0; i < 50000; i++) {
+		t = 1700000000000LL + i * 1000;
+		ts_add(regular, &t, 100 + i / 10 % 50);
+		t = i * 1000;
+		ts_add(kept, &t, i);
+	}
+	test_case("test timeseries chunks", {
+		int n;
+		TSSample *res = ts_range(mixed, 0, LLONG_MAX, 0, TS_AGG_NONE, 0, &n);
+		bool same = n == 100;
+		t = 0;
+		for (int i = 0; i < n; i++) {
+			t += deltas[i % 8];
+			same = same && res[i].ts == t && res[i].value == values[i % 8] * (i + 1);
+		}
+		free(res);
+		expect("mixed samples read back", same);
+		expect("older timestamp rejected", !ts_add(mixed, &t, 1));
+		expect("regular series compresses", ts_bytes(regular) < regular->count * 2);
+		expect("several chunks", regular->n > 1);
+
+		expect("retention drops old chunks", kept->count < 50000 && kept->n < 3);
+		res = ts_range(kept, 0, LLONG_MAX, 0, TS_AGG_NONE, 0, &n);
+		expect("range honours retention", n == 11 && res[0].ts == 49989000);
+		free(res);
+		res = ts_range(kept, 0, LLONG_MAX, 2, TS_AGG_SUM, 5000, &n);
+		expect("sum buckets", n == 2 && res[0].ts == 49985000 && res[0].value == 49989 &&
+								  res[1].ts == 49990000 && res[1].value == 249960);
+		free(res);
+	});
+	ts_free(regular);
+	ts_free(mixed);
+	ts_free(kept);
+}
+
+// documents survive a parse and dump round trip, large objects are indexed
+// and malformed documents are rejected
+static void test_json_tree() {
+	const char *docs[] = {"null", "[true,false,-0.5,1e+300,9223372036854775807]",
+						  "{\"a\":{\"b\":[[],{}]},\"s\":\"\\\"\\\\\\n\"}"};
+	const char *bad[] = {"", "[1,]", "{\"a\":}", "01", "\"\\u12\"", "[1] x", "nul"};
+	char big[2048] = "{";
+	for (int i = 0; i < 100; i++)
+		sprintf(big + strlen(big), "%s\"k%d\":%d", i > 0 ? "," : "", i, i);
+	strcat(big, "}");
+	char deep[300] = "";
+	for (int i = 0; i < 129; i++)
+		strcat(deep, "[");
+	test_case("test json tree", {
+		bool same = true;
+		for (int i = 0; i < 3; i++) {
+			JsonNode *node = json_parse(docs[i]);
+			char *dump = json_dump(node);
+			same = same && strcmp(dump, docs[i]) == 0;
+			free(dump);
+			json_free(node);
+		}
+		expect("round trip", same);
+		bool rejected = json_parse(deep) == NULL;
+		for (int i = 0; i < 7; i++)
+			rejected = rejected && json_parse(bad[i]) == NULL;
+		expect("malformed rejected", rejected);
+
+		JsonNode *root = json_parse(big);
+		JsonNode *res;
+		expect("large object indexed", root->nindex > 0);
+		expect("indexed lookup", json_get(root, "$.k77", &res) == JSON_OK && res->i == 77);
+		long long removed;
+		expect("indexed delete", json_del(&root, "$.k10", &removed) == JSON_OK && removed == 1);
+		expect("deleted key gone", json_get(root, "$.k10", &res) == JSON_ERR_MISSING);
+		expect("later key kept", json_get(root, "k99", &res) == JSON_OK && res->i == 99);
+		expect("set indexed",
+			   json_set(&root, "$.k100", json_parse("[1]"), 0) == JSON_OK && root->n == 100);
+		expect("get new key", json_get(root, "$.k100[0]", &res) == JSON_OK && res->i == 1);
+		json_free(root);
+	});
+}
+
+// the dispatched kernels agree with a plain loop at every tail length, and the
+// graph finds most of the exact neighbours before and after removals
+static void test_vset_graph() {
+	float a[70], b[70];
+	int8_t qa[70], qb[70];
+	for (int i = 0; i < 70; i++) {
+		a[i] = (i * 7 % 13) / 6.0 - 1;
+		b[i] = (i * 5 % 11) / 5.0 - 1;
+		qa[i] = i * 37 % 255 - 127;
+		qb[i] = i * 91 % 255 - 127;
+	}
+	VectorSet *vs = vset_init(16, VEC_L2, VEC_F32, 8, 64);
+	VectorSet *q8 = vset_init(16, VEC_COSINE, VEC_Q8, 8, 64);
+	float values[1100][16];
+	char name[16];
+	srand(7);
+	for (int i = 0; i < 1100; i++) {
+		for (int j = 0; j < 16; j++)
+			values[i][j] = rand() / (float)RAND_MAX * 2 - 1;
+		sprintf(name, "e%d", i);
+		if (i < 1000) {
+			vset_add(vs, name, values[i]);
+			vset_add(q8, name, values[i]);
+		}
+	}
+	test_case("test vector set graph", {
+		bool same = true;
+		for (int n = 0; n <= 70; n++) {
+			double dot = 0;
+			double l2 = 0;
+			int32_t idot = 0;
+			for (int i = 0; i < n; i++) {
+				dot += a[i] * b[i];
+				l2 += (a[i] - b[i]) * (a[i] - b[i]);
+				idot += qa[i] * qb[i];
+			}
+			same = same && fabs(vec_dot_f32(a, b, n) - dot) < 1e-4;
+			same = same && fabs(vec_l2_f32(a, b, n) - l2) < 1e-4;
+			same = same && vec_dot_i8(qa, qb, n) == idot;
+		}
+		expect("kernels match", same);
+
+		int found = 0;
+		int n;
+		int m;
+		for (int q = 1000; q < 1100; q++) {
+			VecMatch *exact = vset_search(vs, values[q], NULL, 10, 10, true, &n);
+			VecMatch *graph = vset_search(vs, values[q], NULL, 10, 64, false, &m);
+			for (int i = 0; i < m; i++)
+				for (int j = 0; j < n; j++)
+					found += graph[i].name == exact[j].name;
+			free(exact);
+			free(graph);
+		}
+		expect("recall", found >= 900);
+		found = 0;
+		for (int q = 1000; q < 1100; q++) {
+			VecMatch *graph = vset_search(q8, values[q], NULL, 1, 64, false, &m);
+			VecMatch *exact = vset_search(vs, values[q], NULL, 1, 1, true, &n);
+			found += strcmp(graph[0].name, exact[0].name) == 0;
+			free(exact);
+			free(graph);
+		}
+		expect("q8 recall", found >= 50);
+		VecMatch *self = vset_search(vs, NULL, "e5", 1, 10, false, &n);
+		expect("element query", n == 1 && strcmp(self[0].name, "e5") == 0 && self[0].dist == 0);
+		free(self);
+
+		for (int i = 0; i < 1000; i += 2) {
+			sprintf(name, "e%d", i);
+			vset_rem(vs, name);
+		}
+		expect("removed", vs->count == 500 && !vset_rem(vs, "e0"));
+		found = 0;
+		bool live = true;
+		for (int q = 1000; q < 1100; q++) {
+			VecMatch *exact = vset_search(vs, values[q], NULL, 10, 10, true, &n);
+			VecMatch *graph = vset_search(vs, values[q], NULL, 10, 64, false, &m);
+			for (int i = 0; i < m; i++) {
+				live = live && atoi(graph[i].name + 1) % 2 == 1;
+				for (int j = 0; j < n; j++)
+					found += graph[i].name == exact[j].name;
+			}
+			free(exact);
+			free(graph);
+		}
+		expect("only live elements", live);
+		expect("recall after removals", found >= 900);
+		expect("update", !vset_add(vs, "e1", values[1050]));
+		self = vset_search(vs, values[1050], NULL, 1, 10, false, &n);
+		expect("updated vector", n == 1 && strcmp(self[0].name, "e1") == 0);
+		free(self);
+	});
+	vset_free(vs);
+	vset_free(q8);
+}
+
 void test_htable() {
 	test_creation();
 	test_insert();
@@ -242,5 +1100,19 @@ void test_htable() {
 	test_str_funcs();
 	test_hash_funcs();
 	test_list_funcs();
+	test_list_chunks();
 	test_set_funcs();
+	test_zset_encodings();
+	test_hll_funcs();
+	test_bit_kernels();
+	test_roaring_funcs();
+	test_radix_funcs();
+	test_stream_blocks();
+	test_bloom_funcs();
+	test_sketch_funcs();
+	test_geo_search();
+	test_gcra();
+	test_ts_chunks();
+	test_json_tree();
+	test_vset_graph();
 }
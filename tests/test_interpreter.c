@@ -41,6 +41,21 @@ void test_interpret() {
 	test_interpret_hash(ht);
 	test_interpret_list(ht);
 	test_interpret_set(ht);
+	test_interpret_zset(ht);
+	test_interpret_hll(ht);
+	test_interpret_bitmap(ht);
+	test_interpret_roaring(ht);
+	test_interpret_stream(ht);
+	test_interpret_bloom(ht);
+	test_interpret_timeseries(ht);
+	test_interpret_json(ht);
+	test_interpret_vector(ht);
+	test_interpret_sketch(ht);
+	test_interpret_geo(ht);
+	test_interpret_ratelimit(ht);
+	test_interpret_snapshot(ht);
+	test_interpret_aof(ht);
+	test_interpret_handover(ht);
 	test_etc(ht);
 	htable_free(ht);
 }
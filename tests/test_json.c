@@ -0,0 +1,116 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_jsonset(HashTable *ht) {
+	test_case("test json.set", {
+		// test gen
+		expect("json.set new key",
+			   compare(ht, "json.set a $ '{\"name\":\"kv\",\"n\":1,\"tags\":[\"x\",\"y\"]}'",
+					   "$2\r\nOK\r\n"));
+		expect("type", compare(ht, "type a", "$4\r\njson\r\n"));
+		expect("json.set nx exists", compare(ht, "json.set a $.n 5 nx", "$-1\r\n"));
+		expect("json.set xx missing", compare(ht, "json.set a $.m 5 xx", "$-1\r\n"));
+		expect("json.set nx", compare(ht, "json.set a $.m true nx", "$2\r\nOK\r\n"));
+		expect("json.set index", compare(ht, "json.set a $.tags[-1] '\"z\"'", "$2\r\nOK\r\n"));
+		expect("json.get", compare(ht, "json.get a",
+								   "$45\r\n{\"name\":\"kv\",\"n\":1,\"tags\":[\"x\",\"z\"],"
+								   "\"m\":true}\r\n"));
+		expect("json.set replace root", compare(ht, "json.set b $ ' [ 1 , {} ] '", "$2\r\nOK\r\n"));
+		expect("json.get compact", compare(ht, "json.get b", "$6\r\n[1,{}]\r\n"));
+		expect("json.set escapes", compare(ht, "json.set c $ '\"\\u00e9\\t\\ud83d\\ude00\"'",
+										   "$2\r\nOK\r\n"));
+		expect("json.get escapes", compare(ht, "json.get c", "$10\r\n\"é\\t😀\"\r\n"));
+		// test args
+		expect("json.set bad json", compare(ht, "json.set b $ x", "-ERR invalid json\r\n"));
+		expect("json.set bad escape",
+			   compare(ht, "json.set b $ '\"\\x\"'", "-ERR invalid json\r\n"));
+		expect("json.set lone surrogate",
+			   compare(ht, "json.set b $ '\"\\ud83d\"'", "-ERR invalid json\r\n"));
+		expect("json.set new not root",
+			   compare(ht, "json.set d $.x 1",
+					   "-ERR new documents must be created at the root path\r\n"));
+		expect("json.set out of range",
+			   compare(ht, "json.set a $.tags[5] 1", "-ERR index or result out of range\r\n"));
+		expect("json.set syntax", compare(ht, "json.set a $ 1 foo", "-ERR syntax error\r\n"));
+		// test argc
+		expect("json.set err argc",
+			   compare(ht, "json.set a $",
+					   "-ERR wrong number of arguments (given 2, expected 3 or 4)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("json.set set", compare(ht, "json.set d $ 1", "-ERR wrongtype operation\r\n"));
+		expect("json.get set", compare(ht, "json.get d", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_jsonget(HashTable *ht) {
+	test_case("test json.get", {
+		expect("json.set", compare(ht,
+								   "json.set a $ '{\"name\":\"kv\",\"tags\":[\"x\",\"y\"],"
+								   "\"o\":{\"d\":1.5}}'",
+								   "$2\r\nOK\r\n"));
+		expect("json.get path", compare(ht, "json.get a $.name", "$4\r\n\"kv\"\r\n"));
+		expect("json.get bare path", compare(ht, "json.get a tags[1]", "$3\r\n\"y\"\r\n"));
+		expect("json.get bracket", compare(ht, "json.get a $[\"o\"].d", "$3\r\n1.5\r\n"));
+		expect("json.get paths", compare(ht, "json.get a $.tags[-1] o.d",
+										 "$28\r\n{\"$.tags[-1]\":\"y\",\"o.d\":1.5}\r\n"));
+		expect("json.get missing path",
+			   compare(ht, "json.get a $.missing", "-ERR path does not exist\r\n"));
+		expect("json.get bad path", compare(ht, "json.get a $.tags[", "-ERR invalid path\r\n"));
+		expect("json.get missing key", compare(ht, "json.get b", "$-1\r\n"));
+		expect("json.type", compare(ht, "json.type a", "$6\r\nobject\r\n"));
+		expect("json.type array", compare(ht, "json.type a $.tags", "$5\r\narray\r\n"));
+		expect("json.type number", compare(ht, "json.type a o.d", "$6\r\nnumber\r\n"));
+		expect("json.type missing", compare(ht, "json.type b", "$-1\r\n"));
+		expect("json.get err argc",
+			   compare(ht, "json.get",
+					   "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_jsonupdate(HashTable *ht) {
+	test_case("test json updates", {
+		expect("json.set",
+			   compare(ht, "json.set a $ '{\"name\":\"kv\",\"n\":1,\"tags\":[\"x\"]}'",
+					   "$2\r\nOK\r\n"));
+		expect("json.numincrby int", compare(ht, "json.numincrby a $.n 2", "$1\r\n3\r\n"));
+		expect("json.numincrby float", compare(ht, "json.numincrby a $.n 0.5", "$3\r\n3.5\r\n"));
+		expect("json.numincrby string",
+			   compare(ht, "json.numincrby a $.name 1", "-ERR wrong json type at path\r\n"));
+		expect("json.numincrby bad float",
+			   compare(ht, "json.numincrby a $.n x", "-ERR value is not a valid float\r\n"));
+		expect("json.strappend", compare(ht, "json.strappend a $.name '\"db\"'", ":4\r\n"));
+		expect("json.strappend number",
+			   compare(ht, "json.strappend a $.n '\"x\"'", "-ERR wrong json type at path\r\n"));
+		expect("json.arrappend", compare(ht, "json.arrappend a $.tags '\"y\"' 3", ":3\r\n"));
+		expect("json.arrlen", compare(ht, "json.arrlen a $.tags", ":3\r\n"));
+		expect("json.arrlen string",
+			   compare(ht, "json.arrlen a $.name", "-ERR wrong json type at path\r\n"));
+		expect("json.arrlen missing", compare(ht, "json.arrlen b", "$-1\r\n"));
+		expect("json.del index", compare(ht, "json.del a $.tags[0]", ":1\r\n"));
+		expect("json.del missing path", compare(ht, "json.del a $.nope", ":0\r\n"));
+		expect("json.get", compare(ht, "json.get a",
+								   "$38\r\n{\"name\":\"kvdb\",\"n\":3.5,\"tags\":[\"y\",3]}\r\n"));
+		expect("json.del root", compare(ht, "json.del a", ":1\r\n"));
+		expect("json.get deleted", compare(ht, "json.get a", "$-1\r\n"));
+		expect("exists deleted", compare(ht, "exists a", ":0\r\n"));
+		expect("json.del err argc",
+			   compare(ht, "json.del a $ x",
+					   "-ERR wrong number of arguments (given 3, expected 1 or 2)\r\n"));
+		expect("json.arrappend err argc",
+			   compare(ht, "json.arrappend a $",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_json(HashTable *ht) {
+	test_jsonset(ht);
+	test_jsonget(ht);
+	test_jsonupdate(ht);
+}
@@ -2,6 +2,7 @@
 #include "miniunit.h"
 #include "test.h"
 #include <string.h>
+#include <unistd.h>
 
 static void test_push(HashTable *ht) {
 	test_case("test push", {
@@ -245,6 +246,82 @@ void test_lpos(HashTable *ht) {
 	cleanup(ht);
 }
 
+static void test_lmove(HashTable *ht) {
+	test_case("test lmove", {
+		// test gen
+		expect("rpush 3 values", compare(ht, "rpush a 1 2 3", ":3\r\n"));
+		expect("lmove right left", compare(ht, "lmove a b right left", "$1\r\n3\r\n"));
+		expect("lmove left right", compare(ht, "lmove a b left right", "$1\r\n1\r\n"));
+		expect("lrange b", compare(ht, "lrange b 0 -1", "*2\r\n:3\r\n:1\r\n"));
+		expect("lmove same list", compare(ht, "lmove b b left right", "$1\r\n3\r\n"));
+		expect("lrange rotated b", compare(ht, "lrange b 0 -1", "*2\r\n:1\r\n:3\r\n"));
+		expect("lmove last value", compare(ht, "lmove a b left left", "$1\r\n2\r\n"));
+		expect("deleted a", compare(ht, "exists a", ":0\r\n"));
+		expect("lmove non existing key", compare(ht, "lmove a b left left", "$-1\r\n"));
+		expect("lmove bad direction", compare(ht, "lmove b a up left", "-ERR syntax error\r\n"));
+		// test argc
+		expect(
+			"lmove err argc",
+			compare(ht, "lmove a b", "-ERR wrong number of arguments (given 2, expected 4)\r\n"));
+		// test type
+		expect("set c", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("lmove to str", compare(ht, "lmove b c left left", "-ERR wrongtype operation\r\n"));
+		expect("lmove from str",
+			   compare(ht, "lmove c b left left", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_blocking(HashTable *ht) {
+	test_case("test blocking pop", {
+		// test gen
+		expect("rpush b", compare(ht, "rpush b 1 2", ":2\r\n"));
+		expect("blpop first non empty", compare(ht, "blpop a b 0", "*2\r\n$1\r\nb\r\n:1\r\n"));
+		expect("brpop", compare(ht, "brpop b 0", "*2\r\n$1\r\nb\r\n:2\r\n"));
+		expect("blpop blocks", compare(ht, "blpop a b 0", "b"));
+		expect("brpop blocks", compare(ht, "brpop b 0", "b"));
+		expect("push to b", compare(ht, "rpush b x", ":1\r\n"));
+		block_serve(ht);
+		expect("b served once", compare(ht, "llen b", ":0\r\n"));
+		expect("push to b again", compare(ht, "rpush b y", ":1\r\n"));
+		block_serve(ht);
+		expect("b served twice", compare(ht, "llen b", ":0\r\n"));
+		expect("push without waiters", compare(ht, "rpush b z", ":1\r\n"));
+		block_serve(ht);
+		expect("b not served", compare(ht, "llen b", ":1\r\n"));
+		// test timeout
+		expect("blpop with timeout", compare(ht, "blpop c 0.01", "b"));
+		usleep(20000);
+		block_expire();
+		expect("push after timeout", compare(ht, "rpush c 1", ":1\r\n"));
+		block_serve(ht);
+		expect("c not served", compare(ht, "llen c", ":1\r\n"));
+		expect("blpop err timeout",
+			   compare(ht, "blpop a x", "-ERR timeout is not a float or out of range\r\n"));
+		expect("blpop negative timeout",
+			   compare(ht, "blpop a -1", "-ERR timeout is not a float or out of range\r\n"));
+		// test blmove
+		expect("blmove blocks", compare(ht, "blmove d e right left 0", "b"));
+		expect("blpop on destination", compare(ht, "blpop e 0", "b"));
+		expect("push to d", compare(ht, "lpush d v", ":1\r\n"));
+		block_serve(ht);
+		expect("d moved", compare(ht, "exists d", ":0\r\n"));
+		expect("e popped by chained waiter", compare(ht, "exists e", ":0\r\n"));
+		// test argc
+		expect("blpop err argc",
+			   compare(ht, "blpop a", "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		expect("blmove err argc",
+			   compare(ht, "blmove a b left",
+					   "-ERR wrong number of arguments (given 3, expected 5)\r\n"));
+		// test type
+		expect("set f", compare(ht, "set f 1", "$2\r\nOK\r\n"));
+		expect("blpop str", compare(ht, "blpop a f 0", "-ERR wrongtype operation\r\n"));
+		expect("blmove str", compare(ht, "blmove a f left left 0", "-ERR wrongtype operation\r\n"));
+		expect("del e f", compare(ht, "del e f", ":1\r\n"));
+	});
+	cleanup(ht);
+}
+
 void test_interpret_list(HashTable *ht) {
 	test_push(ht);
 	test_pop(ht);
@@ -254,4 +331,6 @@ void test_interpret_list(HashTable *ht) {
 	test_lset(ht);
 	test_lpos(ht);
 	test_lrem(ht);
+	test_lmove(ht);
+	test_blocking(ht);
 }
@@ -21,6 +21,12 @@ void test_parser() {
 		expect("parse: sadd 1 2 3 4",
 			   check_cmd(parse("sadd 1 2 3 4"), SADD, (char *[]){"1", "2", "3", "4"}));
 		expect("parse: ''", check_cmd(parse(""), NOOP, NULL));
+		expect("parse: mixed quotes", check_cmd(parse("set a '{\"b\": 1}'"), SET,
+												(char *[]){"a", "{\"b\": 1}"}));
+		expect("parse: escaped quote",
+			   check_cmd(parse("set a \"x \\\"y\\\" \\\\\""), SET, (char *[]){"a", "x \"y\" \\"}));
+		expect("parse: single quote escapes",
+			   check_cmd(parse("set a 'it\\'s \\n'"), SET, (char *[]){"a", "it's \\n"}));
 	});
 	return;
 }
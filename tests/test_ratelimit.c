@@ -0,0 +1,48 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_throttle(HashTable *ht) {
+	test_case("test cl.throttle", {
+		// test gen
+		expect("cl.throttle first",
+			   compare(ht, "cl.throttle a 2 1 60", "*5\r\n:0\r\n:3\r\n:2\r\n:-1\r\n:60\r\n"));
+		expect("type", compare(ht, "type a", "$9\r\nratelimit\r\n"));
+		expect("cl.throttle second",
+			   compare(ht, "cl.throttle a 2 1 60", "*5\r\n:0\r\n:3\r\n:1\r\n:-1\r\n:120\r\n"));
+		expect("cl.throttle burst used",
+			   compare(ht, "cl.throttle a 2 1 60", "*5\r\n:0\r\n:3\r\n:0\r\n:-1\r\n:180\r\n"));
+		expect("cl.throttle limited",
+			   compare(ht, "cl.throttle a 2 1 60", "*5\r\n:1\r\n:3\r\n:0\r\n:60\r\n:180\r\n"));
+		expect("cl.throttle peek",
+			   compare(ht, "cl.throttle a 2 1 60 0", "*5\r\n:0\r\n:3\r\n:0\r\n:-1\r\n:180\r\n"));
+		expect("cl.throttle quantity",
+			   compare(ht, "cl.throttle b 4 1 60 3", "*5\r\n:0\r\n:5\r\n:2\r\n:-1\r\n:180\r\n"));
+		expect("cl.throttle over limit",
+			   compare(ht, "cl.throttle c 2 1 60 4", "*5\r\n:1\r\n:3\r\n:3\r\n:-1\r\n:0\r\n"));
+		expect("limited request creates nothing", compare(ht, "exists c", ":0\r\n"));
+		// test args
+		expect("cl.throttle zero count",
+			   compare(ht, "cl.throttle c 2 0 60",
+					   "-ERR value is not an integer or out of range\r\n"));
+		expect("cl.throttle bad period",
+			   compare(ht, "cl.throttle c 2 1 x",
+					   "-ERR value is not an integer or out of range\r\n"));
+		expect("cl.throttle negative burst",
+			   compare(ht, "cl.throttle c -1 1 60",
+					   "-ERR value is not an integer or out of range\r\n"));
+		// test argc
+		expect("cl.throttle err argc",
+			   compare(ht, "cl.throttle c 2 1",
+					   "-ERR wrong number of arguments (given 3, expected 4 or 5)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("cl.throttle set",
+			   compare(ht, "cl.throttle d 2 1 60", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_ratelimit(HashTable *ht) { test_throttle(ht); }
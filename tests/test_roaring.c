@@ -0,0 +1,81 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_rbadd(HashTable *ht) {
+	test_case("test rbadd", {
+		// test gen
+		expect("rbadd new key", compare(ht, "rbadd a 1 2 3 70000 4294967295", ":5\r\n"));
+		expect("rbadd existing", compare(ht, "rbadd a 3 4", ":1\r\n"));
+		expect("rbcard", compare(ht, "rbcard a", ":6\r\n"));
+		expect("rbcard missing", compare(ht, "rbcard b", ":0\r\n"));
+		expect("rbismember", compare(ht, "rbismember a 70000", ":1\r\n"));
+		expect("rbismember absent", compare(ht, "rbismember a 69999", ":0\r\n"));
+		expect("rbismember missing key", compare(ht, "rbismember b 1", ":0\r\n"));
+		expect("rbmembers sorted",
+			   compare(ht, "rbmembers a",
+					   "*6\r\n:1\r\n:2\r\n:3\r\n:4\r\n:70000\r\n:4294967295\r\n"));
+		expect("rbmembers missing", compare(ht, "rbmembers b", "*0\r\n"));
+		expect("rbrem", compare(ht, "rbrem a 1 5 70000", ":2\r\n"));
+		expect("rbrem missing key", compare(ht, "rbrem b 1", ":0\r\n"));
+		expect("rbrem all", compare(ht, "rbrem a 2 3 4 4294967295", ":4\r\n"));
+		expect("deleted a", compare(ht, "exists a", ":0\r\n"));
+		expect("rbadd negative",
+			   compare(ht, "rbadd a -1", "-ERR value is not an integer or out of range\r\n"));
+		expect("rbadd too large", compare(ht, "rbadd a 4294967296",
+										  "-ERR value is not an integer or out of range\r\n"));
+		expect("rbadd not a number",
+			   compare(ht, "rbadd a 1 x", "-ERR value is not an integer or out of range\r\n"));
+		expect("nothing added", compare(ht, "exists a", ":0\r\n"));
+		// test argc
+		expect("rbadd err argc",
+			   compare(ht, "rbadd a", "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		expect("rbismember err argc",
+			   compare(ht, "rbismember a",
+					   "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		expect("rbcard err argc",
+			   compare(ht, "rbcard", "-ERR wrong number of arguments (given 0, expected 1)\r\n"));
+		// test type
+		expect("sadd c", compare(ht, "sadd c 1", ":1\r\n"));
+		expect("rbadd set", compare(ht, "rbadd c 1", "-ERR wrongtype operation\r\n"));
+		expect("rbcard set", compare(ht, "rbcard c", "-ERR wrongtype operation\r\n"));
+		expect("rbadd d", compare(ht, "rbadd d 1", ":1\r\n"));
+		expect("type roaring", compare(ht, "type d", "$7\r\nroaring\r\n"));
+		expect("sadd roaring", compare(ht, "sadd d 1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_rbop(HashTable *ht) {
+	test_case("test rbop", {
+		// test gen
+		expect("rbadd a", compare(ht, "rbadd a 1 2 3 65536 65537", ":5\r\n"));
+		expect("rbadd b", compare(ht, "rbadd b 2 3 4 65537", ":4\r\n"));
+		expect("rbop and", compare(ht, "rbop and d a b", ":3\r\n"));
+		expect("and members", compare(ht, "rbmembers d", "*3\r\n:2\r\n:3\r\n:65537\r\n"));
+		expect("rbop or", compare(ht, "rbop or d a b", ":6\r\n"));
+		expect("rbop andnot", compare(ht, "rbop andnot d a b", ":2\r\n"));
+		expect("andnot members", compare(ht, "rbmembers d", "*2\r\n:1\r\n:65536\r\n"));
+		expect("rbop andnot many", compare(ht, "rbop andnot d a b d", ":0\r\n"));
+		expect("empty result deletes", compare(ht, "exists d", ":0\r\n"));
+		expect("rbop and missing", compare(ht, "rbop and d a x", ":0\r\n"));
+		expect("rbop or missing", compare(ht, "rbop or d x a", ":5\r\n"));
+		expect("rbop into source", compare(ht, "rbop and a a b", ":3\r\n"));
+		expect("rbcard a", compare(ht, "rbcard a", ":3\r\n"));
+		expect("rbop bad op", compare(ht, "rbop xor d a b", "-ERR syntax error\r\n"));
+		// test argc
+		expect("rbop err argc",
+			   compare(ht, "rbop and d",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		// test type
+		expect("sadd c", compare(ht, "sadd c 1", ":1\r\n"));
+		expect("rbop set", compare(ht, "rbop or d a c", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_roaring(HashTable *ht) {
+	test_rbadd(ht);
+	test_rbop(ht);
+}
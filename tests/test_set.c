@@ -137,10 +137,119 @@ void test_smismember(HashTable *ht) {
 	cleanup(ht);
 }
 
+void test_sinter(HashTable *ht) {
+	test_case("test sinter", {
+		// test gen
+		expect("sadd a", compare(ht, "sadd a 1 2 3 4 5", ":5\r\n"));
+		expect("sadd b", compare(ht, "sadd b 2 3 4 9", ":4\r\n"));
+		expect("sadd c", compare(ht, "sadd c 3 4 7", ":3\r\n"));
+		expect("sinter a b", compare(ht, "sinter a b", "*3\r\n:2\r\n:3\r\n:4\r\n"));
+		expect("sinter a b c", compare(ht, "sinter a b c", "*2\r\n:4\r\n:3\r\n"));
+		expect("sinter single set", compare(ht, "sinter c", "*3\r\n:4\r\n:7\r\n:3\r\n"));
+		expect("sinter non existing set", compare(ht, "sinter a d", "*0\r\n"));
+		expect("sinterstore d", compare(ht, "sinterstore d a b c", ":2\r\n"));
+		expect("smembers d", compare(ht, "smembers d", "*2\r\n:4\r\n:3\r\n"));
+		expect("sinterstore empty", compare(ht, "sinterstore d a x", ":0\r\n"));
+		expect("empty result deletes dst", compare(ht, "exists d", ":0\r\n"));
+		// test argc
+		expect("empty sinter",
+			   compare(ht, "sinter", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		expect("sinterstore err argc",
+			   compare(ht, "sinterstore d",
+					   "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		// test type
+		expect("set d", compare(ht, "set d 1", "$2\r\nOK\r\n"));
+		expect("sinter str", compare(ht, "sinter a d", "-ERR wrongtype operation\r\n"));
+		expect("sinterstore str src",
+			   compare(ht, "sinterstore a b d", "-ERR wrongtype operation\r\n"));
+		expect("sinterstore overwrites str dst", compare(ht, "sinterstore d a b", ":3\r\n"));
+		expect("d = set", compare(ht, "type d", "$3\r\nset\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_sintercard(HashTable *ht) {
+	test_case("test sintercard", {
+		// test gen
+		expect("sadd a", compare(ht, "sadd a 1 2 3 4 5", ":5\r\n"));
+		expect("sadd b", compare(ht, "sadd b 2 3 4 9", ":4\r\n"));
+		expect("sintercard a b", compare(ht, "sintercard 2 a b", ":3\r\n"));
+		expect("sintercard limit", compare(ht, "sintercard 2 a b limit 2", ":2\r\n"));
+		expect("sintercard limit 0", compare(ht, "sintercard 2 a b limit 0", ":3\r\n"));
+		expect("sintercard non existing set", compare(ht, "sintercard 2 a c", ":0\r\n"));
+		expect("sintercard bad numkeys",
+			   compare(ht, "sintercard 0 a", "-ERR value is not an integer or out of range\r\n"));
+		expect("sintercard bad limit",
+			   compare(ht, "sintercard 1 a limit x",
+					   "-ERR value is not an integer or out of range\r\n"));
+		// test argc
+		expect("empty sintercard",
+			   compare(ht, "sintercard",
+					   "-ERR wrong number of arguments (given 0, expected 2+)\r\n"));
+		expect("sintercard numkeys mismatch",
+			   compare(ht, "sintercard 3 a b",
+					   "-ERR wrong number of arguments (given 3, expected numkeys+1)\r\n"));
+		// test type
+		expect("lpush c", compare(ht, "lpush c 1", ":1\r\n"));
+		expect("sintercard list", compare(ht, "sintercard 2 a c", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_sunion(HashTable *ht) {
+	test_case("test sunion", {
+		// test gen
+		expect("sadd a", compare(ht, "sadd a 1 2", ":2\r\n"));
+		expect("sadd b", compare(ht, "sadd b 2 3", ":2\r\n"));
+		expect("sunion a b", compare(ht, "sunion a b", "*3\r\n:1\r\n:2\r\n:3\r\n"));
+		expect("sunion non existing set", compare(ht, "sunion a d", "*2\r\n:1\r\n:2\r\n"));
+		expect("sunionstore c", compare(ht, "sunionstore c a b d", ":3\r\n"));
+		expect("sintercard c", compare(ht, "sintercard 1 c", ":3\r\n"));
+		expect("sunionstore empty", compare(ht, "sunionstore c x y", ":0\r\n"));
+		expect("empty result deletes dst", compare(ht, "exists c", ":0\r\n"));
+		// test argc
+		expect("empty sunion",
+			   compare(ht, "sunion", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		// test type
+		expect("hset c", compare(ht, "hset c 1 2", ":1\r\n"));
+		expect("sunion hash", compare(ht, "sunion a c", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_sdiff(HashTable *ht) {
+	test_case("test sdiff", {
+		// test gen
+		expect("sadd a", compare(ht, "sadd a 1 2 3 4 5", ":5\r\n"));
+		expect("sadd b", compare(ht, "sadd b 2 3 4 9", ":4\r\n"));
+		expect("sadd c", compare(ht, "sadd c 3 4 7", ":3\r\n"));
+		expect("sdiff a b c", compare(ht, "sdiff a b c", "*2\r\n:1\r\n:5\r\n"));
+		expect("sdiff non existing first", compare(ht, "sdiff d a", "*0\r\n"));
+		expect("sdiff non existing other",
+			   compare(ht, "sdiff c d", "*3\r\n:4\r\n:7\r\n:3\r\n"));
+		expect("sdiffstore into src", compare(ht, "sdiffstore a a b", ":2\r\n"));
+		expect("smembers a", compare(ht, "smembers a", "*2\r\n:1\r\n:5\r\n"));
+		// test argc
+		expect("empty sdiff",
+			   compare(ht, "sdiff", "-ERR wrong number of arguments (given 0, expected 1+)\r\n"));
+		expect("sdiffstore err argc",
+			   compare(ht, "sdiffstore a",
+					   "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		// test type
+		expect("lpush d", compare(ht, "lpush d 1", ":1\r\n"));
+		expect("sdiff list", compare(ht, "sdiff a d", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
 void test_interpret_set(HashTable *ht) {
 	test_sadd(ht);
 	test_srem(ht);
 	test_sismember(ht);
 	test_smembers(ht);
 	test_smismember(ht);
+	test_sinter(ht);
+	test_sintercard(ht);
+	test_sunion(ht);
+	test_sdiff(ht);
 }
@@ -0,0 +1,139 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_cms(HashTable *ht) {
+	test_case("test cms", {
+		// test gen
+		expect("cms.initbydim", compare(ht, "cms.initbydim a 100 4", "$2\r\nOK\r\n"));
+		expect("type", compare(ht, "type a", "$3\r\ncms\r\n"));
+		expect("cms.incrby",
+			   compare(ht, "cms.incrby a x 5 y 2 x 1", "*3\r\n:5\r\n:2\r\n:6\r\n"));
+		expect("cms.query", compare(ht, "cms.query a x y z", "*3\r\n:6\r\n:2\r\n:0\r\n"));
+		expect("cms.info", compare(ht, "cms.info a",
+								   "*6\r\n$5\r\nwidth\r\n:100\r\n$5\r\ndepth\r\n:4\r\n"
+								   "$5\r\ncount\r\n:8\r\n"));
+		expect("cms.initbyprob", compare(ht, "cms.initbyprob b 0.01 0.01", "$2\r\nOK\r\n"));
+		expect("cms.info prob", compare(ht, "cms.info b",
+										"*6\r\n$5\r\nwidth\r\n:272\r\n$5\r\ndepth\r\n:5\r\n"
+										"$5\r\ncount\r\n:0\r\n"));
+		expect("cms.initbydim exists",
+			   compare(ht, "cms.initbydim b 100 4", "-ERR item exists\r\n"));
+		expect("cms.incrby new key", compare(ht, "cms.incrby c x 3", "*1\r\n:3\r\n"));
+		expect("cms.info default", compare(ht, "cms.info c",
+										   "*6\r\n$5\r\nwidth\r\n:2000\r\n$5\r\ndepth\r\n:5\r\n"
+										   "$5\r\ncount\r\n:3\r\n"));
+		expect("cms.query missing key", compare(ht, "cms.query d x", "*1\r\n:0\r\n"));
+		expect("cms.info missing key", compare(ht, "cms.info d", "*0\r\n"));
+		// test args
+		expect("cms.initbydim bad width",
+			   compare(ht, "cms.initbydim d 0 4", "-ERR width is out of range\r\n"));
+		expect("cms.initbydim bad depth",
+			   compare(ht, "cms.initbydim d 100 17", "-ERR depth is out of range\r\n"));
+		expect("cms.initbyprob bad error",
+			   compare(ht, "cms.initbyprob d 1 0.01",
+					   "-ERR error rate should be between 0 and 1\r\n"));
+		expect("cms.initbyprob bad probability",
+			   compare(ht, "cms.initbyprob d 0.01 x",
+					   "-ERR probability should be between 0 and 1\r\n"));
+		expect("cms.incrby zero",
+			   compare(ht, "cms.incrby a x 0", "-ERR value is not an integer or out of range\r\n"));
+		// test argc
+		expect("cms.incrby err argc",
+			   compare(ht, "cms.incrby a x 1 y",
+					   "-ERR wrong number of arguments (given 4, expected 3+)\r\n"));
+		expect("cms.query err argc",
+			   compare(ht, "cms.query a",
+					   "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("cms.incrby set", compare(ht, "cms.incrby d x 1", "-ERR wrongtype operation\r\n"));
+		expect("cms.query set", compare(ht, "cms.query d x", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_cmsmerge(HashTable *ht) {
+	test_case("test cms.merge", {
+		expect("cms.initbydim a", compare(ht, "cms.initbydim a 100 4", "$2\r\nOK\r\n"));
+		expect("cms.initbydim b", compare(ht, "cms.initbydim b 100 4", "$2\r\nOK\r\n"));
+		expect("cms.incrby a", compare(ht, "cms.incrby a x 5 y 2", "*2\r\n:5\r\n:2\r\n"));
+		expect("cms.incrby b", compare(ht, "cms.incrby b x 3", "*1\r\n:3\r\n"));
+		expect("cms.merge new key", compare(ht, "cms.merge c 2 a b", "$2\r\nOK\r\n"));
+		expect("cms.query merged", compare(ht, "cms.query c x y", "*2\r\n:8\r\n:2\r\n"));
+		expect("cms.merge weights", compare(ht, "cms.merge a 2 a b weights 2 1", "$2\r\nOK\r\n"));
+		expect("cms.query weighted", compare(ht, "cms.query a x y", "*2\r\n:13\r\n:4\r\n"));
+		expect("cms.initbydim d", compare(ht, "cms.initbydim d 50 4", "$2\r\nOK\r\n"));
+		expect("cms.merge mismatch", compare(ht, "cms.merge c 2 a d",
+											 "-ERR width or depth of the sketches differ\r\n"));
+		expect("del d", compare(ht, "del d", ":1\r\n"));
+		expect("cms.merge missing", compare(ht, "cms.merge c 2 a d", "-ERR no such key\r\n"));
+		expect("cms.merge bad numkeys",
+			   compare(ht, "cms.merge c 3 a b",
+					   "-ERR value is not an integer or out of range\r\n"));
+		expect("cms.merge syntax", compare(ht, "cms.merge c 1 a b", "-ERR syntax error\r\n"));
+		expect("cms.merge err argc",
+			   compare(ht, "cms.merge c 1",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("cms.merge set", compare(ht, "cms.merge d 1 a", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_topk(HashTable *ht) {
+	test_case("test topk", {
+		// test gen
+		expect("topk.reserve", compare(ht, "topk.reserve a 2", "$2\r\nOK\r\n"));
+		expect("type", compare(ht, "type a", "$4\r\ntopk\r\n"));
+		expect("topk.add", compare(ht, "topk.add a x y z", "*3\r\n$-1\r\n$-1\r\n$-1\r\n"));
+		expect("topk.incrby expels",
+			   compare(ht, "topk.incrby a z 10 w 5", "*2\r\n$1\r\nx\r\n$1\r\ny\r\n"));
+		expect("topk.list", compare(ht, "topk.list a", "*2\r\n$1\r\nz\r\n$1\r\nw\r\n"));
+		expect("topk.list withcount",
+			   compare(ht, "topk.list a withcount", "*4\r\n$1\r\nz\r\n:11\r\n$1\r\nw\r\n:5\r\n"));
+		expect("topk.query", compare(ht, "topk.query a z x w", "*3\r\n:1\r\n:0\r\n:1\r\n"));
+		expect("topk.info", compare(ht, "topk.info a",
+									"*8\r\n$1\r\nk\r\n:2\r\n$5\r\nwidth\r\n:16\r\n$5\r\ndepth\r\n"
+									":4\r\n$5\r\ndecay\r\n$3\r\n0.9\r\n"));
+		expect("topk.reserve dims", compare(ht, "topk.reserve b 5 64 3 0.5", "$2\r\nOK\r\n"));
+		expect("topk.info dims", compare(ht, "topk.info b",
+										 "*8\r\n$1\r\nk\r\n:5\r\n$5\r\nwidth\r\n:64\r\n$5\r\n"
+										 "depth\r\n:3\r\n$5\r\ndecay\r\n$3\r\n0.5\r\n"));
+		expect("topk.reserve exists", compare(ht, "topk.reserve b 5", "-ERR item exists\r\n"));
+		expect("topk.add new key", compare(ht, "topk.add c x", "*1\r\n$-1\r\n"));
+		expect("topk.list new key", compare(ht, "topk.list c", "*1\r\n$1\r\nx\r\n"));
+		expect("topk.list missing key", compare(ht, "topk.list d", "*0\r\n"));
+		expect("topk.query missing key", compare(ht, "topk.query d x", "*1\r\n:0\r\n"));
+		// test args
+		expect("topk.reserve bad k",
+			   compare(ht, "topk.reserve d 0", "-ERR k is out of range\r\n"));
+		expect("topk.reserve bad width",
+			   compare(ht, "topk.reserve d 1 0 2 0.9", "-ERR width is out of range\r\n"));
+		expect("topk.reserve bad decay",
+			   compare(ht, "topk.reserve d 1 8 2 1.5", "-ERR decay should be in (0, 1]\r\n"));
+		expect("topk.incrby zero", compare(ht, "topk.incrby a x 0",
+										   "-ERR value is not an integer or out of range\r\n"));
+		expect("topk.list syntax", compare(ht, "topk.list a foo", "-ERR syntax error\r\n"));
+		// test argc
+		expect("topk.reserve err argc",
+			   compare(ht, "topk.reserve d 1 8",
+					   "-ERR wrong number of arguments (given 3, expected 2 or 5)\r\n"));
+		expect("topk.add err argc",
+			   compare(ht, "topk.add a",
+					   "-ERR wrong number of arguments (given 1, expected 2+)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("topk.add set", compare(ht, "topk.add d x", "-ERR wrongtype operation\r\n"));
+		expect("topk.list set", compare(ht, "topk.list d", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_sketch(HashTable *ht) {
+	test_cms(ht);
+	test_cmsmerge(ht);
+	test_topk(ht);
+}
@@ -0,0 +1,525 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_SNAPSHOT "/tmp/hyperkv-test.hkv"
+
+// saves ht and loads the snapshot into a fresh table
+static HashTable *reload(HashTable *ht, long long *loaded) {
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	*loaded = compare(ht, "save", "$2\r\nOK\r\n") ? snapshot_load(copy, TEST_SNAPSHOT) : -1;
+	return copy;
+}
+
+// whether cmd replies the same on both tables
+static bool same(HashTable *ht, HashTable *copy, char *cmd) {
+	char *a = interpret(ht, parse(cmd)), *b = interpret(copy, parse(cmd));
+	bool res = strcmp(a, b) == 0;
+	free(a);
+	free(b);
+	return res;
+}
+
+static void test_reload_basic(HashTable *ht) {
+	interpret(ht, parse("set a hello"));
+	interpret(ht, parse("setbit a 100 1"));
+	interpret(ht, parse("hset b f1 v1"));
+	interpret(ht, parse("hset b f2 v2"));
+	interpret(ht, parse("rpush c x y z"));
+	interpret(ht, parse("lpush c w"));
+	interpret(ht, parse("sadd d m1 m2 m3"));
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot strings and collections", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("string", same(ht, copy, "get a"));
+		expect("binary string", same(ht, copy, "bitcount a"));
+		expect("hash", same(ht, copy, "hmget b f1 f2 f3"));
+		expect("list", same(ht, copy, "lrange c 0 -1"));
+		expect("set", same(ht, copy, "smismember d m1 m2 m3 m4"));
+		expect("list type", compare(copy, "type c", "$4\r\nlist\r\n"));
+		expect("still writable", compare(copy, "rpush c v", ":5\r\n"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_reload_sets(HashTable *ht) {
+	interpret(ht, parse("zadd a 1 one 2 two 3 three"));
+	for (int i = 0; i < 200; i++) {
+		char cmd[64];
+		sprintf(cmd, "zadd b %d m%d", i % 7, i);
+		interpret(ht, parse(cmd));
+		sprintf(cmd, "pfadd c e%d", i * 31);
+		interpret(ht, parse(cmd));
+	}
+	interpret(ht, parse("rbadd d 1 2 3 70000 70001 200000"));
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot sorted sets and sketches", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("packed zset", same(ht, copy, "zrange a 0 -1 withscores"));
+		expect("skiplist zset", same(ht, copy, "zrange b 0 -1 withscores"));
+		expect("zrank", same(ht, copy, "zrank b m100"));
+		expect("hll", same(ht, copy, "pfcount c"));
+		expect("roaring", same(ht, copy, "rbmembers d"));
+		expect("roaring card", same(ht, copy, "rbcard d"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_reload_stream(HashTable *ht) {
+	for (int i = 1; i <= 300; i++) {
+		char cmd[64];
+		sprintf(cmd, "xadd a %d-1 f v%d", i, i);
+		interpret(ht, parse(cmd));
+	}
+	interpret(ht, parse("xtrim a maxlen 250"));
+	interpret(ht, parse("xgroup create a g 0"));
+	interpret(ht, parse("xreadgroup group g alice count 3 streams a >"));
+	interpret(ht, parse("xack a g 52-1"));
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot stream", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("xlen", same(ht, copy, "xlen a"));
+		expect("xrange", same(ht, copy, "xrange a - +"));
+		expect("xrange from", same(ht, copy, "xrange a 200 + count 2"));
+		expect("pending", same(ht, copy, "xreadgroup group g alice streams a 0"));
+		expect("group position", same(ht, copy, "xreadgroup group g bob count 1 streams a >"));
+		expect("last id kept", same(ht, copy, "xadd a * f v"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_reload_docs(HashTable *ht) {
+	interpret(ht, parse("bf.reserve a 0.01 50"));
+	for (int i = 0; i < 200; i++) {
+		char cmd[64];
+		sprintf(cmd, "bf.add a item%d", i);
+		interpret(ht, parse(cmd));
+		sprintf(cmd, "ts.add b %d %d.5", 1000 + i * 10, i % 13);
+		interpret(ht, parse(cmd));
+		sprintf(cmd, "vadd d values 3 %d %d 1 v%d", i % 17, i % 5, i);
+		interpret(ht, parse(cmd));
+	}
+	interpret(ht, parse("vrem d v10"));
+	interpret(ht, parse("json.set c $ {\"a\":[1,2,{\"b\":null}],\"s\":\"x\"}"));
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot filters, series, documents and vectors", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("bloom", same(ht, copy, "bf.mexists a item0 item199 item500 nope"));
+		expect("bloom card", same(ht, copy, "bf.card a"));
+		expect("ts range", same(ht, copy, "ts.range b - +"));
+		expect("ts get", same(ht, copy, "ts.get b"));
+		expect("ts append", same(ht, copy, "ts.add b 5000 1.25"));
+		expect("json", same(ht, copy, "json.get c"));
+		expect("vcard", same(ht, copy, "vcard d"));
+		expect("vsim", same(ht, copy, "vsim d values 3 4 2 1 count 5"));
+		expect("removed vector", compare(copy, "vemb d v10", "*0\r\n"));
+		expect("vadd reuses slots", same(ht, copy, "vadd d values 3 1 1 1 v10"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_reload_counters(HashTable *ht) {
+	interpret(ht, parse("cms.initbydim a 100 4"));
+	interpret(ht, parse("cms.incrby a x 5 y 7"));
+	interpret(ht, parse("topk.reserve b 3"));
+	interpret(ht, parse("topk.incrby b x 10 y 20 z 5 w 1"));
+	interpret(ht, parse("cl.throttle c 5 10 60"));
+	interpret(ht, parse("geoadd d 13.361389 38.115556 Palermo 15.087269 37.502669 Catania"));
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot counters and geo", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("cms", same(ht, copy, "cms.query a x y z"));
+		expect("cms info", same(ht, copy, "cms.info a"));
+		expect("topk", same(ht, copy, "topk.list b withcount"));
+		expect("topk add", same(ht, copy, "topk.add b v"));
+		expect("rate limit", compare(copy, "type c", "$9\r\nratelimit\r\n"));
+		expect("geo", same(ht, copy, "geodist d Palermo Catania"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+static void test_reload_encodings(HashTable *ht) {
+	interpret(ht, parse("mset a 12345 c -9223372036854775808"));
+	interpret(ht, parse("sadd b 5 -3 9223372036854775807 -9223372036854775808 0"));
+	for (int i = 0; i < 300; i++) {
+		char cmd[64];
+		sprintf(cmd, "%s d item%d", i % 3 == 0 ? "lpush" : "rpush", i);
+		interpret(ht, parse(cmd));
+	}
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	test_case("test snapshot compact encodings", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("int string", same(ht, copy, "get a"));
+		expect("int string min", same(ht, copy, "get c"));
+		expect("int string is a string", same(ht, copy, "append a 6"));
+		expect("intset",
+			   same(ht, copy, "smismember b 5 -3 0 1 9223372036854775807 -9223372036854775808"));
+		expect("intset card", same(ht, copy, "scard b"));
+		expect("packed list", same(ht, copy, "lrange d 0 -1"));
+		expect("packed list index", same(ht, copy, "lindex d 150"));
+		expect("packed list push", same(ht, copy, "lpush d x"));
+	});
+	htable_free(copy);
+	cleanup(ht);
+	interpret(ht, parse("mset a 007 c +1"));
+	interpret(ht, parse("sadd b 1 2 x"));
+	interpret(ht, parse("hset d f1 v1 f2 v2"));
+	for (int i = 0; i < 100; i++) {
+		char cmd[64];
+		sprintf(cmd, "hset b%d f%d %d", i % 2, i, i);
+		interpret(ht, parse(cmd));
+	}
+	copy = reload(ht, &loaded);
+	test_case("test snapshot plain encodings", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("leading zero", compare(copy, "get a", "$3\r\n007\r\n"));
+		expect("plus sign", compare(copy, "get c", "$2\r\n+1\r\n"));
+		expect("mixed set", same(ht, copy, "smismember b 1 2 x y"));
+		expect("small hash", same(ht, copy, "hmget d f1 f2 f3"));
+		expect("small hash len", same(ht, copy, "hlen d"));
+		expect("large hash", same(ht, copy, "hmget b0 f0 f50 f98"));
+		expect("large hash len", same(ht, copy, "hlen b1"));
+	});
+	htable_free(copy);
+	interpret(ht, parse("del b0 b1"));
+	cleanup(ht);
+}
+
+// enough keys for several sections, loaded on several threads
+static void test_reload_sections(HashTable *ht) {
+	HashTable *big = htable_init(HT_BASE_SIZE);
+	char *cmd = dmalloc(40000);
+	for (int i = 0; i < 300; i++) {
+		int n = sprintf(cmd, "set k%d ", i);
+		memset(cmd + n, 'a' + i % 26, 30000);
+		cmd[n + 30000] = '\0';
+		interpret(big, parse(cmd));
+	}
+	free(cmd);
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	bool saved = snapshot_save(big, TEST_SNAPSHOT);
+	long long loaded = snapshot_load(copy, TEST_SNAPSHOT);
+	test_case("test snapshot sections", {
+		expect("saved", saved);
+		expect("all keys loaded", loaded == 300 && copy->used == 300);
+		expect("first", same(big, copy, "get k0"));
+		expect("middle", same(big, copy, "get k150"));
+		expect("last", same(big, copy, "strlen k299"));
+	});
+	htable_free(copy);
+	htable_free(big);
+}
+
+static void test_reload_shards() {
+	HashTable *shards[] = {htable_init(HT_BASE_SIZE), htable_init(HT_BASE_SIZE)};
+	interpret(shards[0], parse("set a 1"));
+	interpret(shards[0], parse("rpush b x y"));
+	interpret(shards[1], parse("hset c f v"));
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	bool saved = snapshot_save_tables(shards, 2, TEST_SNAPSHOT);
+	long long loaded = snapshot_load(copy, TEST_SNAPSHOT);
+	test_case("test snapshot of shards", {
+		expect("saved", saved);
+		expect("one keyspace", loaded == 3 && copy->used == 3);
+		expect("first shard", same(shards[0], copy, "lrange b 0 -1"));
+		expect("second shard", same(shards[1], copy, "hget c f"));
+	});
+	htable_free(copy);
+	htable_free(shards[0]);
+	htable_free(shards[1]);
+}
+
+// whether src survives compression and decompression unchanged
+static bool lz_roundtrip(const uint8_t *src, long n, long *packed) {
+	uint8_t *dst = malloc(lz_bound(n)), *back = malloc(n + 1);
+	*packed = lz_compress(src, n, dst);
+	bool res = lz_decompress(dst, *packed, back, n) && memcmp(src, back, n) == 0 &&
+			   !lz_decompress(dst, *packed, back, n + 1);
+	free(dst);
+	free(back);
+	return res;
+}
+
+static void test_compression(HashTable *ht) {
+	uint8_t *buf = malloc(1 << 20);
+	long packed;
+	test_case("test snapshot compression", {
+		expect("empty", lz_roundtrip(buf, 0, &packed) && packed == 1);
+		memcpy(buf, "abc", 3);
+		expect("short", lz_roundtrip(buf, 3, &packed));
+		memset(buf, 'x', 1 << 20);
+		expect("run", lz_roundtrip(buf, 1 << 20, &packed) && packed < 5000);
+		for (int i = 0; i < 1 << 20; i++)
+			buf[i] = "the quick brown fox "[i % 20] ^ (i % 997 == 0);
+		expect("text", lz_roundtrip(buf, 1 << 20, &packed) && packed < (1 << 20) / 4);
+		srandom(7);
+		for (int i = 0; i < 1 << 20; i++)
+			buf[i] = random();
+		expect("noise", lz_roundtrip(buf, 1 << 20, &packed) && packed <= lz_bound(1 << 20));
+	});
+	free(buf);
+	char cmd[4200];
+	for (int i = 0; i < 200; i++) {
+		int n = sprintf(cmd, "set k%d ", i);
+		for (int j = 0; j < 4000; j += 20)
+			n += sprintf(cmd + n, "word%05d-", (i * 7 + j) % 1000);
+		interpret(ht, parse(cmd));
+	}
+	long long loaded;
+	HashTable *copy = reload(ht, &loaded);
+	struct stat st;
+	stat(TEST_SNAPSHOT, &st);
+	test_case("test snapshot compressed sections", {
+		expect("all keys loaded", loaded == ht->used);
+		expect("value", same(ht, copy, "get k0"));
+		expect("last value", same(ht, copy, "get k199"));
+		expect("compressed", st.st_size < 200 * 4000 / 4);
+	});
+	htable_free(copy);
+	for (int i = 0; i < 200; i++) {
+		sprintf(cmd, "del k%d", i);
+		interpret(ht, parse(cmd));
+	}
+}
+
+static void test_checksum() {
+	test_case("test crc32c", {
+		expect("check value", crc32c(0, "123456789", 9) == 0xe3069283);
+		expect("chained", crc32c(crc32c(0, "1234", 4), "56789", 5) == 0xe3069283);
+		expect("empty", crc32c(0, "", 0) == 0);
+		expect("table fallback", crc32c_selftest());
+	});
+}
+
+static void test_bgsave(HashTable *ht) {
+	interpret(ht, parse("set a 1"));
+	interpret(ht, parse("rpush b x y"));
+	test_case("test bgsave", {
+		expect("bgsave", compare(ht, "bgsave", "$25\r\nBackground saving started\r\n"));
+		expect("bgsave running",
+			   compare(ht, "bgsave", "-ERR background save already in progress\r\n"));
+		expect("save running",
+			   compare(ht, "save", "-ERR background save already in progress\r\n"));
+		snapshot_poll(true);
+		char *info = interpret(ht, parse("info persistence"));
+		expect("info",
+			   strncmp(info, "*30\r\n$7\r\nloading\r\n:0\r\n$18\r\nbgsave_in_progress\r\n:0\r\n",
+					   51) == 0);
+		expect("info status", strstr(info, "$18\r\nlast_bgsave_status\r\n$2\r\nok\r\n") != NULL);
+		free(info);
+		expect("lastsave", !compare(ht, "lastsave", ":0\r\n"));
+		expect("info other section", compare(ht, "info keyspace", "*0\r\n"));
+		HashTable *copy = htable_init(HT_BASE_SIZE);
+		expect("child snapshot", snapshot_load(copy, TEST_SNAPSHOT) == ht->used);
+		expect("child snapshot list", same(ht, copy, "lrange b 0 -1"));
+		htable_free(copy);
+		// test argc
+		expect("save err argc",
+			   compare(ht, "save x", "-ERR wrong number of arguments (given 1, expected 0)\r\n"));
+		expect("bgsave err argc",
+			   compare(ht, "bgsave x", "-ERR wrong number of arguments (given 1, expected 0)\r\n"));
+		expect("info err argc",
+			   compare(ht, "info a b",
+					   "-ERR wrong number of arguments (given 2, expected 0 or 1)\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_checkpoint() {
+	HashTable *big = htable_init(HT_BASE_SIZE);
+	char cmd[64];
+	for (int i = 0; i < 20000; i++) {
+		sprintf(cmd, "set k%d %d", i, i);
+		interpret(big, parse(cmd));
+	}
+	interpret(big, parse("rpush l x y"));
+	snapshot_set_mode(SNAPSHOT_INCREMENTAL);
+	test_case("test incremental checkpoint", {
+		expect("bgsave", compare(big, "bgsave", "$25\r\nBackground saving started\r\n"));
+		expect("bgsave running",
+			   compare(big, "bgsave", "-ERR background save already in progress\r\n"));
+		snapshot_poll(false);
+		expect("one step", snapshot_running());
+		// none of these reach the checkpoint, which keeps the keys as they were
+		expect("incr", compare(big, "incr k19999", ":20000\r\n"));
+		expect("del", compare(big, "del k7", ":1\r\n"));
+		expect("set new", compare(big, "set new 1", "$2\r\nOK\r\n"));
+		expect("push", compare(big, "rpush l z", ":3\r\n"));
+		expect("lmove", compare(big, "lmove l k8 left left", "-ERR wrongtype operation\r\n"));
+		expect("lmove to new", compare(big, "lmove l m left left", "$1\r\nx\r\n"));
+		// growing the table moves every key under the walk
+		for (int i = 0; i < 30000; i++) {
+			sprintf(cmd, "set n%d %d", i, i);
+			interpret(big, parse(cmd));
+			if (i % 1000 == 0)
+				snapshot_poll(false);
+		}
+		snapshot_poll(true);
+		expect("done", !snapshot_running());
+		HashTable *copy = htable_init(HT_BASE_SIZE);
+		expect("loaded", snapshot_load(copy, TEST_SNAPSHOT) == 20001 && copy->used == 20001);
+		expect("as it was", compare(copy, "get k19999", "$5\r\n19999\r\n"));
+		expect("deleted since", compare(copy, "get k7", "$1\r\n7\r\n"));
+		expect("set since", compare(copy, "exists new m n0", ":0\r\n"));
+		expect("list", compare(copy, "lrange l 0 -1", "*2\r\n$1\r\nx\r\n$1\r\ny\r\n"));
+		expect("untouched", compare(copy, "get k12345", "$5\r\n12345\r\n"));
+		htable_free(copy);
+		// a second checkpoint sees the keys written during the first
+		expect("again", compare(big, "bgsave", "$25\r\nBackground saving started\r\n"));
+		snapshot_poll(true);
+		copy = htable_init(HT_BASE_SIZE);
+		expect("all keys", snapshot_load(copy, TEST_SNAPSHOT) == big->used);
+		expect("new value", same(big, copy, "get k19999"));
+		expect("moved", same(big, copy, "lrange m 0 -1"));
+		htable_free(copy);
+	});
+	snapshot_set_mode(SNAPSHOT_FORK);
+	htable_free(big);
+}
+
+// when key was last accessed, without a lookup that would stamp it
+static unsigned int access_time(HashTable *ht, char *key) {
+	HashTableItem *item;
+	for (int pos = 0; (item = htable_next(ht, &pos)) != NULL;)
+		if (strcmp(item->key, key) == 0)
+			return item->access;
+	return 0;
+}
+
+// keys last read long ago in sections of their own, behind a few recent ones
+static void test_load_hot() {
+	HashTable *big = htable_init(HT_BASE_SIZE);
+	char *cmd = dmalloc(2000);
+	big->clock = 1000;
+	for (int i = 0; i < 24000; i++) {
+		int n = sprintf(cmd, "set cold%d ", i);
+		memset(cmd + n, 'a' + i % 26, 1000);
+		cmd[n + 1000] = '\0';
+		interpret(big, parse(cmd));
+	}
+	big->clock = time(NULL);
+	for (int i = 0; i < 100; i++) {
+		sprintf(cmd, "set hot%d %d", i, i);
+		interpret(big, parse(cmd));
+	}
+	free(cmd);
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	bool saved = snapshot_save(big, TEST_SNAPSHOT);
+	test_case("test snapshot load while serving", {
+		expect("saved", saved);
+		expect("started", snapshot_load_start(copy, TEST_SNAPSHOT) == 24100);
+		expect("loading", snapshot_loading() && copy->used == 0);
+		// the sections that may hold a key are linked before a command on it
+		expect("read", same(big, copy, "strlen cold7000"));
+		expect("not all", copy->used < 24000);
+		expect("write", compare(copy, "set cold5 v", "$2\r\nOK\r\n"));
+		long long before = copy->used;
+		while (copy->used == before)
+			snapshot_poll(false);
+		bool hot = true;
+		char key[16];
+		for (int i = 0; i < 100; i++) {
+			sprintf(key, "hot%d", i);
+			hot = hot && access_time(copy, key) == big->clock;
+		}
+		// linked with the time they were last accessed
+		expect("hot keys first", hot && copy->used < 24100);
+		snapshot_load_wait();
+		expect("done", !snapshot_loading() && copy->used == 24100);
+		expect("written value kept", compare(copy, "get cold5", "$1\r\nv\r\n"));
+		expect("last cold", same(big, copy, "get cold23999"));
+		expect("recency kept", access_time(copy, "cold1") == 1000);
+	});
+	htable_free(copy);
+	htable_free(big);
+}
+
+static void test_load_v1(HashTable *ht) {
+	// a string a and a list c as version 1 wrote them
+	const char v1[] = "HYPERKV\x01\x02"
+					  "\x00\x01"
+					  "a\x05hello"
+					  "\x02\x01"
+					  "c\x02\x01x\x01y"
+					  "\xff";
+	FILE *f = fopen(TEST_SNAPSHOT, "w");
+	fwrite(v1, 1, sizeof(v1) - 1, f);
+	fclose(f);
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	test_case("test snapshot version 1", {
+		expect("loaded", snapshot_load(copy, TEST_SNAPSHOT) == 2);
+		expect("string", compare(copy, "get a", "$5\r\nhello\r\n"));
+		expect("list", compare(copy, "lrange c 0 -1", "*2\r\n$1\r\nx\r\n$1\r\ny\r\n"));
+	});
+	htable_free(copy);
+}
+
+static void test_load_errors(HashTable *ht) {
+	HashTable *copy = htable_init(HT_BASE_SIZE);
+	test_case("test snapshot load errors", {
+		expect("missing file", snapshot_load(copy, "/tmp/hyperkv-missing.hkv") == 0);
+		interpret(ht, parse("set a 1"));
+		interpret(ht, parse("hset b f v"));
+		expect("save", compare(ht, "save", "$2\r\nOK\r\n"));
+		truncate(TEST_SNAPSHOT, 40);
+		expect("truncated", snapshot_load(copy, TEST_SNAPSHOT) < 0);
+		expect("save again", compare(ht, "save", "$2\r\nOK\r\n"));
+		// the length of the first record, right after the header
+		int fd = open(TEST_SNAPSHOT, O_RDWR);
+		pwrite(fd, "\x7f", 1, 40);
+		close(fd);
+		expect("damaged record", snapshot_load(copy, TEST_SNAPSHOT) < 0);
+		expect("save once more", compare(ht, "save", "$2\r\nOK\r\n"));
+		// a single flipped bit inside the first section
+		fd = open(TEST_SNAPSHOT, O_RDWR);
+		char c;
+		pread(fd, &c, 1, 44);
+		c ^= 4;
+		pwrite(fd, &c, 1, 44);
+		close(fd);
+		expect("flipped bit", snapshot_load(copy, TEST_SNAPSHOT) < 0);
+		FILE *f = fopen(TEST_SNAPSHOT, "w");
+		fputs("not a snapshot", f);
+		fclose(f);
+		expect("bad magic", snapshot_load(copy, TEST_SNAPSHOT) < 0);
+	});
+	htable_free(copy);
+	cleanup(ht);
+}
+
+void test_interpret_snapshot(HashTable *ht) {
+	snapshot_init(TEST_SNAPSHOT);
+	test_reload_basic(ht);
+	test_reload_sets(ht);
+	test_reload_stream(ht);
+	test_reload_docs(ht);
+	test_reload_counters(ht);
+	test_reload_encodings(ht);
+	test_reload_sections(ht);
+	test_reload_shards();
+	test_compression(ht);
+	test_checksum();
+	test_bgsave(ht);
+	test_checkpoint();
+	test_load_hot();
+	test_load_v1(ht);
+	test_load_errors(ht);
+	unlink(TEST_SNAPSHOT);
+}
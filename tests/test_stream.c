@@ -0,0 +1,192 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_xadd(HashTable *ht) {
+	test_case("test xadd", {
+		// test gen
+		expect("xadd explicit", compare(ht, "xadd a 1-1 a 1", "$3\r\n1-1\r\n"));
+		expect("xadd auto seq", compare(ht, "xadd a 1-* b 2", "$3\r\n1-2\r\n"));
+		expect("xadd ms only", compare(ht, "xadd a 5 c 3", "$3\r\n5-0\r\n"));
+		expect("xadd not increasing",
+			   compare(ht, "xadd a 5 d 4",
+					   "-ERR The ID specified in XADD is equal or smaller than the target "
+					   "stream top item\r\n"));
+		expect("xadd zero id",
+			   compare(ht, "xadd b 0-0 a 1",
+					   "-ERR The ID specified in XADD must be greater than 0-0\r\n"));
+		expect("xadd bad id",
+			   compare(ht, "xadd a 1-x a 1",
+					   "-ERR Invalid stream ID specified as stream command argument\r\n"));
+		expect("failed xadd creates nothing", compare(ht, "exists b", ":0\r\n"));
+		expect("xlen", compare(ht, "xlen a", ":3\r\n"));
+		expect("xlen missing", compare(ht, "xlen b", ":0\r\n"));
+		expect("xadd maxlen", compare(ht, "xadd a maxlen 2 6 e 5", "$3\r\n6-0\r\n"));
+		expect("xlen trimmed", compare(ht, "xlen a", ":2\r\n"));
+		expect("xtrim", compare(ht, "xtrim a maxlen = 1", ":1\r\n"));
+		expect("xtrim approx keeps the block", compare(ht, "xtrim a maxlen ~ 0", ":1\r\n"));
+		expect("empty stream stays", compare(ht, "type a", "$6\r\nstream\r\n"));
+		expect("nomkstream", compare(ht, "xadd b nomkstream 1 a 1", "$-1\r\n"));
+		expect("nomkstream creates nothing", compare(ht, "exists b", ":0\r\n"));
+		// test argc
+		expect("xadd err argc",
+			   compare(ht, "xadd a 1-1 a",
+					   "-ERR wrong number of arguments (given 3, expected 4+)\r\n"));
+		expect("xadd odd fields",
+			   compare(ht, "xadd a 7 a 1 b",
+					   "-ERR wrong number of arguments (given 5, expected 4+)\r\n"));
+		expect("xlen err argc",
+			   compare(ht, "xlen", "-ERR wrong number of arguments (given 0, expected 1)\r\n"));
+		// test type
+		expect("set u", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("xadd str", compare(ht, "xadd c 1 a 1", "-ERR wrongtype operation\r\n"));
+		expect("xlen str", compare(ht, "xlen c", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_xrange(HashTable *ht) {
+	test_case("test xrange", {
+		// test gen
+		expect("xadd 1", compare(ht, "xadd a 1-1 a x", "$3\r\n1-1\r\n"));
+		expect("xadd 2", compare(ht, "xadd a 2-1 b y c z", "$3\r\n2-1\r\n"));
+		expect("xadd 3", compare(ht, "xadd a 3-1 d w", "$3\r\n3-1\r\n"));
+		expect("xrange all", compare(ht, "xrange a - +",
+									 "*3\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\na\r\n$1\r\nx\r\n"
+									 "*2\r\n$3\r\n2-1\r\n*4\r\n$1\r\nb\r\n$1\r\ny\r\n$1\r\nc\r\n"
+									 "$1\r\nz\r\n*2\r\n$3\r\n3-1\r\n*2\r\n$1\r\nd\r\n$1\r\nw\r\n"));
+		expect("xrange ms bounds",
+			   compare(ht, "xrange a 2 2", "*1\r\n*2\r\n$3\r\n2-1\r\n*4\r\n$1\r\nb\r\n$1\r\ny\r\n"
+										   "$1\r\nc\r\n$1\r\nz\r\n"));
+		expect("xrange exclusive",
+			   compare(ht, "xrange a (2-1 + count 5",
+					   "*1\r\n*2\r\n$3\r\n3-1\r\n*2\r\n$1\r\nd\r\n$1\r\nw\r\n"));
+		expect("xrange count",
+			   compare(ht, "xrange a - + count 1",
+					   "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\na\r\n$1\r\nx\r\n"));
+		expect("xrange empty", compare(ht, "xrange a 4 +", "*0\r\n"));
+		expect("xrange reversed", compare(ht, "xrange a 3 1", "*0\r\n"));
+		expect("xrange missing", compare(ht, "xrange b - +", "*0\r\n"));
+		expect("xrange bad id",
+			   compare(ht, "xrange a x +",
+					   "-ERR Invalid stream ID specified as stream command argument\r\n"));
+		expect("xrange bad option", compare(ht, "xrange a - + limit 1", "-ERR syntax error\r\n"));
+		// test argc
+		expect("xrange err argc",
+			   compare(ht, "xrange a -",
+					   "-ERR wrong number of arguments (given 2, expected 3 or 5)\r\n"));
+		// test type
+		expect("set u", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("xrange str", compare(ht, "xrange c - +", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_xread(HashTable *ht) {
+	test_case("test xread", {
+		// test gen
+		expect("xadd s", compare(ht, "xadd a 1-1 a x", "$3\r\n1-1\r\n"));
+		expect("xadd t", compare(ht, "xadd b 1-1 b y", "$3\r\n1-1\r\n"));
+		expect("xread two streams",
+			   compare(ht, "xread count 1 streams a b 0 1-1",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\na\r\n$1\r\nx\r\n"));
+		expect("xread nothing new", compare(ht, "xread streams a $", "*-1\r\n"));
+		expect("xread blocks", compare(ht, "xread block 0 streams a $", "b"));
+		expect("xread unbalanced",
+			   compare(ht, "xread streams a b 0",
+					   "-ERR Unbalanced list of streams: for each stream key an ID must be "
+					   "specified\r\n"));
+		expect("xread no streams", compare(ht, "xread count 1", "-ERR syntax error\r\n"));
+		// test type
+		expect("set u", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("xread str", compare(ht, "xread streams a c 0 0", "-ERR wrongtype operation\r\n"));
+		expect("xadd wakes reader", compare(ht, "xadd a 2-1 c z", "$3\r\n2-1\r\n"));
+		block_serve(ht);
+	});
+	cleanup(ht);
+}
+
+static void test_xreadgroup(HashTable *ht) {
+	test_case("test xreadgroup", {
+		// test gen
+		expect("xgroup missing key", compare(ht, "xgroup create a g 0",
+											 "-ERR The XGROUP subcommand requires the key to "
+											 "exist\r\n"));
+		expect("xgroup mkstream", compare(ht, "xgroup create a g $ mkstream", "$2\r\nOK\r\n"));
+		expect("xgroup exists", compare(ht, "xgroup create a g 0",
+										"-BUSYGROUP Consumer Group name already exists\r\n"));
+		expect("xadd 1", compare(ht, "xadd a 1-1 a x", "$3\r\n1-1\r\n"));
+		expect("xadd 2", compare(ht, "xadd a 2-1 b y", "$3\r\n2-1\r\n"));
+		expect("alice reads new",
+			   compare(ht, "xreadgroup group g alice count 1 streams a >",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\na\r\n$1\r\nx\r\n"));
+		expect("bob reads the next",
+			   compare(ht, "xreadgroup group g bob streams a >",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n2-1\r\n*2\r\n$1\r\nb\r\n$1\r\ny\r\n"));
+		expect("nothing new", compare(ht, "xreadgroup group g alice streams a >", "*-1\r\n"));
+		expect("alice pending",
+			   compare(ht, "xreadgroup group g alice streams a 0",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\na\r\n$1\r\nx\r\n"));
+		expect("xack", compare(ht, "xack a g 1-1 3-1", ":1\r\n"));
+		expect("xack again", compare(ht, "xack a g 1-1", ":0\r\n"));
+		expect("alice has none pending",
+			   compare(ht, "xreadgroup group g alice streams a 0",
+					   "*1\r\n*2\r\n$1\r\na\r\n*0\r\n"));
+		expect("trim bob's entry", compare(ht, "xtrim a maxlen 0", ":2\r\n"));
+		expect("trimmed pending entry",
+			   compare(ht, "xreadgroup group g bob streams a 0",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n2-1\r\n*-1\r\n"));
+		// blocked consumers are served one entry at a time in arrival order
+		expect("carol blocks", compare(ht, "xreadgroup group g carol block 0 streams a >", "b"));
+		expect("dave blocks", compare(ht, "xreadgroup group g dave block 0 streams a >", "b"));
+		expect("xadd 3", compare(ht, "xadd a 3-1 c z", "$3\r\n3-1\r\n"));
+		block_serve(ht);
+		expect("carol got 3-1",
+			   compare(ht, "xreadgroup group g carol streams a 0",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n3-1\r\n*2\r\n$1\r\nc\r\n$1\r\nz\r\n"));
+		expect("xadd 4", compare(ht, "xadd a 4-1 d w", "$3\r\n4-1\r\n"));
+		block_serve(ht);
+		expect("dave got 4-1",
+			   compare(ht, "xreadgroup group g dave streams a 0",
+					   "*1\r\n*2\r\n$1\r\na\r\n"
+					   "*1\r\n*2\r\n$3\r\n4-1\r\n*2\r\n$1\r\nd\r\n$1\r\nw\r\n"));
+		expect("noack", compare(ht, "xadd a 5-1 e v", "$3\r\n5-1\r\n"));
+		expect("read noack", compare(ht, "xreadgroup group g erin noack streams a >",
+									 "*1\r\n*2\r\n$1\r\na\r\n*1\r\n*2\r\n$3\r\n5-1\r\n*2\r\n"
+									 "$1\r\ne\r\n$1\r\nv\r\n"));
+		expect("noack leaves nothing pending",
+			   compare(ht, "xreadgroup group g erin streams a 0", "*1\r\n*2\r\n$1\r\na\r\n*0\r\n"));
+		expect("nogroup", compare(ht, "xreadgroup group h alice streams a >",
+								  "-NOGROUP No such key 'a' or consumer group 'h'\r\n"));
+		expect("xgroup destroy", compare(ht, "xgroup destroy a g", ":1\r\n"));
+		expect("xgroup destroy missing", compare(ht, "xgroup destroy a g", ":0\r\n"));
+		expect("xgroup bad subcommand", compare(ht, "xgroup setid a g 0", "-ERR syntax error\r\n"));
+		// test argc
+		expect("xreadgroup err argc",
+			   compare(ht, "xreadgroup group g a streams a",
+					   "-ERR wrong number of arguments (given 5, expected 6+)\r\n"));
+		expect("xack err argc",
+			   compare(ht, "xack a g",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		// test type
+		expect("set u", compare(ht, "set c 1", "$2\r\nOK\r\n"));
+		expect("xgroup str",
+			   compare(ht, "xgroup create c g 0", "-ERR wrongtype operation\r\n"));
+		expect("xack str", compare(ht, "xack c g 1-1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_stream(HashTable *ht) {
+	test_xadd(ht);
+	test_xrange(ht);
+	test_xread(ht);
+	test_xreadgroup(ht);
+}
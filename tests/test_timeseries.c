@@ -0,0 +1,98 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_tsadd(HashTable *ht) {
+	// retention drops whole chunks, so the expired sample is still counted
+	char info[256];
+	sprintf(info,
+			"*12\r\n$12\r\ntotalSamples\r\n:2\r\n$11\r\nmemoryUsage\r\n:%zu\r\n"
+			"$14\r\nfirstTimestamp\r\n:1000\r\n$13\r\nlastTimestamp\r\n:5000\r\n"
+			"$13\r\nretentionTime\r\n:1000\r\n$10\r\nchunkCount\r\n:1\r\n",
+			sizeof(TimeSeries) + 4 * sizeof(TSChunk) + 8 * sizeof(uint64_t));
+	test_case("test ts.add", {
+		// test gen
+		expect("ts.add new key", compare(ht, "ts.add a 1000 1.5", ":1000\r\n"));
+		expect("ts.add", compare(ht, "ts.add a 2000 2.5", ":2000\r\n"));
+		expect("ts.add same value", compare(ht, "ts.add a 3000 2.5", ":3000\r\n"));
+		expect("ts.add negative", compare(ht, "ts.add a 4500 -7.25", ":4500\r\n"));
+		expect("ts.add older", compare(ht, "ts.add a 3000 3",
+									   "-ERR timestamp must be newer than the last sample\r\n"));
+		expect("type", compare(ht, "type a", "$10\r\ntimeseries\r\n"));
+		expect("ts.get", compare(ht, "ts.get a", "*2\r\n:4500\r\n$5\r\n-7.25\r\n"));
+		expect("ts.get missing", compare(ht, "ts.get b", "*0\r\n"));
+		expect("ts.create", compare(ht, "ts.create b retention 1000", "$2\r\nOK\r\n"));
+		expect("ts.create exists", compare(ht, "ts.create b", "-ERR item exists\r\n"));
+		expect("ts.add b", compare(ht, "ts.add b 1000 1", ":1000\r\n"));
+		expect("ts.add b later", compare(ht, "ts.add b 5000 2", ":5000\r\n"));
+		expect("retention", compare(ht, "ts.range b - +", "*1\r\n*2\r\n:5000\r\n$1\r\n2\r\n"));
+		expect("ts.info", compare(ht, "ts.info b", info));
+		expect("ts.info missing", compare(ht, "ts.info d", "*0\r\n"));
+		// test args
+		expect("bad timestamp", compare(ht, "ts.add a x 1", "-ERR invalid timestamp\r\n"));
+		expect("bad value",
+			   compare(ht, "ts.add a 5000 x", "-ERR value is not a valid float\r\n"));
+		expect("bad retention",
+			   compare(ht, "ts.create c retention -1", "-ERR invalid retention\r\n"));
+		expect("ts.create syntax", compare(ht, "ts.create c foo 1", "-ERR syntax error\r\n"));
+		// test argc
+		expect("ts.add err argc",
+			   compare(ht, "ts.add a 1",
+					   "-ERR wrong number of arguments (given 2, expected 3)\r\n"));
+		expect("ts.create err argc",
+			   compare(ht, "ts.create c retention",
+					   "-ERR wrong number of arguments (given 2, expected 1 or 3)\r\n"));
+		// test type
+		expect("sadd c", compare(ht, "sadd c 1", ":1\r\n"));
+		expect("ts.add set", compare(ht, "ts.add c 1 1", "-ERR wrongtype operation\r\n"));
+		expect("ts.range set", compare(ht, "ts.range c - +", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_tsrange(HashTable *ht) {
+	test_case("test ts.range", {
+		expect("ts.add 1000", compare(ht, "ts.add a 1000 1.5", ":1000\r\n"));
+		expect("ts.add 2000", compare(ht, "ts.add a 2000 2.5", ":2000\r\n"));
+		expect("ts.add 3000", compare(ht, "ts.add a 3000 3.5", ":3000\r\n"));
+		expect("ts.add 4500", compare(ht, "ts.add a 4500 -7", ":4500\r\n"));
+		expect("ts.range bounds",
+			   compare(ht, "ts.range a 1500 3000",
+					   "*2\r\n*2\r\n:2000\r\n$3\r\n2.5\r\n*2\r\n:3000\r\n$3\r\n3.5\r\n"));
+		expect("ts.range count",
+			   compare(ht, "ts.range a - + count 1", "*1\r\n*2\r\n:1000\r\n$3\r\n1.5\r\n"));
+		expect("ts.range avg",
+			   compare(ht, "ts.range a - + aggregation avg 2000",
+					   "*3\r\n*2\r\n:0\r\n$3\r\n1.5\r\n*2\r\n:2000\r\n$1\r\n3\r\n"
+					   "*2\r\n:4000\r\n$2\r\n-7\r\n"));
+		expect("ts.range min",
+			   compare(ht, "ts.range a 2000 + aggregation min 5000",
+					   "*1\r\n*2\r\n:0\r\n$2\r\n-7\r\n"));
+		expect("ts.range max count",
+			   compare(ht, "ts.range a - + aggregation max 2000 count 2",
+					   "*2\r\n*2\r\n:0\r\n$3\r\n1.5\r\n*2\r\n:2000\r\n$3\r\n3.5\r\n"));
+		expect("ts.range sum", compare(ht, "ts.range a - + aggregation sum 10000",
+									   "*1\r\n*2\r\n:0\r\n$3\r\n0.5\r\n"));
+		expect("ts.range count agg", compare(ht, "ts.range a 0 2999 aggregation count 10000",
+											 "*1\r\n*2\r\n:0\r\n$1\r\n2\r\n"));
+		expect("ts.range empty", compare(ht, "ts.range a 5000 +", "*0\r\n"));
+		expect("ts.range missing", compare(ht, "ts.range b - +", "*0\r\n"));
+		// test args
+		expect("bad aggregator",
+			   compare(ht, "ts.range a - + aggregation foo 10", "-ERR syntax error\r\n"));
+		expect("bad bucket", compare(ht, "ts.range a - + aggregation avg 0",
+									 "-ERR bucket duration is out of range\r\n"));
+		expect("bad bound", compare(ht, "ts.range a x +", "-ERR invalid timestamp\r\n"));
+		expect("ts.range err argc",
+			   compare(ht, "ts.range a -",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_timeseries(HashTable *ht) {
+	test_tsadd(ht);
+	test_tsrange(ht);
+}
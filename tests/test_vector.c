@@ -0,0 +1,107 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_vadd(HashTable *ht) {
+	// 16 slots of int8 vectors with a scale and norm each, 16 index entries,
+	// the name and the level 0 links
+	char info[512];
+	sprintf(info,
+			"*16\r\n$10\r\nquant-type\r\n$4\r\nint8\r\n$6\r\nmetric\r\n$2\r\nip\r\n"
+			"$10\r\nvector-dim\r\n:2\r\n$4\r\nsize\r\n:1\r\n$9\r\nmax-level\r\n:0\r\n"
+			"$6\r\nhnsw-m\r\n:4\r\n$15\r\nef-construction\r\n:10\r\n"
+			"$12\r\nmemory-usage\r\n:%zu\r\n",
+			sizeof(VectorSet) + 16 * (sizeof(HNSWNode) + sizeof(uint32_t) + 2 + 2 * sizeof(float)) +
+				16 * sizeof(int) + 2 + 9 * sizeof(int));
+	test_case("test vadd", {
+		// test gen
+		expect("vadd new key", compare(ht, "vadd a values 2 1 0 x metric l2", ":1\r\n"));
+		expect("vadd", compare(ht, "vadd a values 2 0 1 y", ":1\r\n"));
+		expect("vadd z", compare(ht, "vadd a values 2 1 1 z", ":1\r\n"));
+		expect("vadd update", compare(ht, "vadd a values 2 2 2 z", ":0\r\n"));
+		expect("type", compare(ht, "type a", "$9\r\nvectorset\r\n"));
+		expect("vcard", compare(ht, "vcard a", ":3\r\n"));
+		expect("vdim", compare(ht, "vdim a", ":2\r\n"));
+		expect("vemb", compare(ht, "vemb a z", "*2\r\n$1\r\n2\r\n$1\r\n2\r\n"));
+		expect("vemb missing", compare(ht, "vemb a w", "*0\r\n"));
+		expect("vadd cosine", compare(ht, "vadd b values 2 3 4 p", ":1\r\n"));
+		expect("vemb normalized", compare(ht, "vemb b p", "*2\r\n$3\r\n0.6\r\n$3\r\n0.8\r\n"));
+		expect("vadd q8", compare(ht, "vadd c values 2 1 -1 p q8 metric ip m 4 ef 10", ":1\r\n"));
+		expect("vinfo", compare(ht, "vinfo c", info));
+		expect("vrem", compare(ht, "vrem a x", ":1\r\n"));
+		expect("vrem missing", compare(ht, "vrem a x", ":0\r\n"));
+		expect("vcard after vrem", compare(ht, "vcard a", ":2\r\n"));
+		expect("vrem last", compare(ht, "vrem b p", ":1\r\n"));
+		expect("exists after vrem", compare(ht, "exists b", ":0\r\n"));
+		expect("vcard missing", compare(ht, "vcard b", ":0\r\n"));
+		// test args
+		expect("vadd dim mismatch",
+			   compare(ht, "vadd a values 3 1 1 1 w", "-ERR vector dimension mismatch\r\n"));
+		expect("vadd bad dim",
+			   compare(ht, "vadd a values 0 w", "-ERR vector dimension is out of range\r\n"));
+		expect("vadd bad float",
+			   compare(ht, "vadd a values 2 1 x w", "-ERR value is not a valid float\r\n"));
+		expect("vadd bad m",
+			   compare(ht, "vadd d values 2 1 1 w m 1", "-ERR m is out of range\r\n"));
+		expect("vadd bad ef",
+			   compare(ht, "vadd d values 2 1 1 w ef 0", "-ERR ef is out of range\r\n"));
+		expect("vadd syntax", compare(ht, "vadd d values 2 1 1 w foo", "-ERR syntax error\r\n"));
+		expect("vadd no element", compare(ht, "vadd d values 2 1 1", "-ERR syntax error\r\n"));
+		expect("vadd no values", compare(ht, "vadd d 2 1 1 w", "-ERR syntax error\r\n"));
+		// test argc
+		expect("vadd err argc",
+			   compare(ht, "vadd a values 1",
+					   "-ERR wrong number of arguments (given 3, expected 4+)\r\n"));
+		expect("vrem err argc",
+			   compare(ht, "vrem a", "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		// test type
+		expect("sadd d", compare(ht, "sadd d 1", ":1\r\n"));
+		expect("vadd set", compare(ht, "vadd d values 1 1 w", "-ERR wrongtype operation\r\n"));
+		expect("vcard set", compare(ht, "vcard d", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_vsim(HashTable *ht) {
+	test_case("test vsim", {
+		expect("vadd x", compare(ht, "vadd a values 2 1 0 x metric l2", ":1\r\n"));
+		expect("vadd y", compare(ht, "vadd a values 2 0 1 y", ":1\r\n"));
+		expect("vadd z", compare(ht, "vadd a values 2 1 1 z", ":1\r\n"));
+		expect("vsim values",
+			   compare(ht, "vsim a values 2 1 0.75",
+					   "*3\r\n$1\r\nz\r\n$1\r\nx\r\n$1\r\ny\r\n"));
+		expect("vsim withscores",
+			   compare(ht, "vsim a values 2 1 0.75 withscores count 2",
+					   "*4\r\n$1\r\nz\r\n$6\r\n0.0625\r\n$1\r\nx\r\n$6\r\n0.5625\r\n"));
+		expect("vsim ele",
+			   compare(ht, "vsim a ele x withscores count 2",
+					   "*4\r\n$1\r\nx\r\n$1\r\n0\r\n$1\r\nz\r\n$1\r\n1\r\n"));
+		expect("vsim truth",
+			   compare(ht, "vsim a values 2 0 2 count 1 truth", "*1\r\n$1\r\ny\r\n"));
+		expect("vsim ef", compare(ht, "vsim a values 2 0 2 count 1 ef 1", "*1\r\n$1\r\ny\r\n"));
+		expect("vadd cosine", compare(ht, "vadd b values 2 1 0 p", ":1\r\n"));
+		expect("vadd cosine q", compare(ht, "vadd b values 2 -1 0 q", ":1\r\n"));
+		expect("vsim cosine", compare(ht, "vsim b values 2 2 0 withscores",
+									  "*4\r\n$1\r\np\r\n$1\r\n0\r\n$1\r\nq\r\n$1\r\n2\r\n"));
+		expect("vsim missing key", compare(ht, "vsim c values 2 1 1", "*0\r\n"));
+		// test args
+		expect("vsim missing ele",
+			   compare(ht, "vsim a ele w", "-ERR element not found\r\n"));
+		expect("vsim dim mismatch",
+			   compare(ht, "vsim a values 1 1", "-ERR vector dimension mismatch\r\n"));
+		expect("vsim bad count", compare(ht, "vsim a ele x count 0",
+										 "-ERR value is not an integer or out of range\r\n"));
+		expect("vsim syntax", compare(ht, "vsim a ele x foo", "-ERR syntax error\r\n"));
+		expect("vsim err argc",
+			   compare(ht, "vsim a ele",
+					   "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_vector(HashTable *ht) {
+	test_vadd(ht);
+	test_vsim(ht);
+}
@@ -0,0 +1,102 @@
+#include "../src/common.h"
+#include "miniunit.h"
+#include "test.h"
+#include <string.h>
+
+static void test_zadd(HashTable *ht) {
+	test_case("test zadd", {
+		// test gen
+		expect("zadd new zset", compare(ht, "zadd a 1 x 2 y 3 z", ":3\r\n"));
+		expect("zadd updates score", compare(ht, "zadd a 0.5 z 4 w", ":1\r\n"));
+		expect("zcard a", compare(ht, "zcard a", ":4\r\n"));
+		expect("zscore z", compare(ht, "zscore a z", "$3\r\n0.5\r\n"));
+		expect("zscore missing member", compare(ht, "zscore a q", "$-1\r\n"));
+		expect("zscore missing key", compare(ht, "zscore b q", "$-1\r\n"));
+		expect("zadd bad score", compare(ht, "zadd a x y", "-ERR value is not a valid float\r\n"));
+		expect("zincrby", compare(ht, "zincrby a 2.5 x", "$3\r\n3.5\r\n"));
+		expect("zincrby new member", compare(ht, "zincrby a -1 v", "$2\r\n-1\r\n"));
+		expect("zrem", compare(ht, "zrem a x y q", ":2\r\n"));
+		expect("zrem all", compare(ht, "zrem a z w v", ":3\r\n"));
+		expect("deleted a", compare(ht, "exists a", ":0\r\n"));
+		// test argc
+		expect(
+			"zadd err argc",
+			compare(ht, "zadd a 1", "-ERR wrong number of arguments (given 2, expected 3+)\r\n"));
+		expect("zadd odd pairs",
+			   compare(ht, "zadd a 1 x 2",
+					   "-ERR wrong number of arguments (given 4, expected 3+)\r\n"));
+		expect("zscore err argc",
+			   compare(ht, "zscore a", "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		expect("zcard err argc",
+			   compare(ht, "zcard", "-ERR wrong number of arguments (given 0, expected 1)\r\n"));
+		// test type
+		expect("set b", compare(ht, "set b 1", "$2\r\nOK\r\n"));
+		expect("sadd c", compare(ht, "sadd c 1", ":1\r\n"));
+		expect("zadd str", compare(ht, "zadd b 1 x", "-ERR wrongtype operation\r\n"));
+		expect("zscore set", compare(ht, "zscore c 1", "-ERR wrongtype operation\r\n"));
+		expect("zincrby str", compare(ht, "zincrby b 1 x", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_zrank(HashTable *ht) {
+	test_case("test zrank", {
+		// test gen
+		expect("zadd a", compare(ht, "zadd a 3 c 1 a 2 b 2 bb", ":4\r\n"));
+		expect("zrank lowest", compare(ht, "zrank a a", ":0\r\n"));
+		expect("zrank tie by member", compare(ht, "zrank a bb", ":2\r\n"));
+		expect("zrevrank", compare(ht, "zrevrank a c", ":0\r\n"));
+		expect("zrank missing", compare(ht, "zrank a q", "$-1\r\n"));
+		expect("zrank missing key", compare(ht, "zrank b q", "$-1\r\n"));
+		// test argc
+		expect("zrank err argc",
+			   compare(ht, "zrank a", "-ERR wrong number of arguments (given 1, expected 2)\r\n"));
+		// test type
+		expect("set b", compare(ht, "set b 1", "$2\r\nOK\r\n"));
+		expect("zrank str", compare(ht, "zrank b 1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+static void test_zrange(HashTable *ht) {
+	test_case("test zrange", {
+		// test gen
+		expect("zadd a", compare(ht, "zadd a 1 a 2 b 3 c 4.5 d", ":4\r\n"));
+		expect("zrange all",
+			   compare(ht, "zrange a 0 -1", "*4\r\n$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n$1\r\nd\r\n"));
+		expect("zrange withscores", compare(ht, "zrange a 2 3 withscores",
+											"*4\r\n$1\r\nc\r\n:3\r\n$1\r\nd\r\n$3\r\n4.5\r\n"));
+		expect("zrange rev", compare(ht, "zrange a 0 1 rev", "*2\r\n$1\r\nd\r\n$1\r\nc\r\n"));
+		expect("zrange clamped", compare(ht, "zrange a -10 0", "*1\r\n$1\r\na\r\n"));
+		expect("zrange empty", compare(ht, "zrange a 5 9", "*0\r\n"));
+		expect("zrange byscore",
+			   compare(ht, "zrange a (1 3 byscore", "*2\r\n$1\r\nb\r\n$1\r\nc\r\n"));
+		expect("zrange byscore rev",
+			   compare(ht, "zrange a +inf (3 byscore rev", "*1\r\n$1\r\nd\r\n"));
+		expect("zrangebyscore", compare(ht, "zrangebyscore a -inf 2 withscores",
+										"*4\r\n$1\r\na\r\n:1\r\n$1\r\nb\r\n:2\r\n"));
+		expect("zrangebyscore empty", compare(ht, "zrangebyscore a 5 10", "*0\r\n"));
+		expect("zrange bad option", compare(ht, "zrange a 0 1 foo", "-ERR syntax error\r\n"));
+		expect("zrange bad index",
+			   compare(ht, "zrange a x 1", "-ERR value is not an integer or out of range\r\n"));
+		expect("zrangebyscore bad bound",
+			   compare(ht, "zrangebyscore a x 1", "-ERR min or max is not a float\r\n"));
+		// test argc
+		expect("zrange err argc",
+			   compare(ht, "zrange a 0",
+					   "-ERR wrong number of arguments (given 2, expected 3..6)\r\n"));
+		expect("zrangebyscore err argc",
+			   compare(ht, "zrangebyscore a 0",
+					   "-ERR wrong number of arguments (given 2, expected 3..4)\r\n"));
+		// test type
+		expect("set b", compare(ht, "set b 1", "$2\r\nOK\r\n"));
+		expect("zrange str", compare(ht, "zrange b 0 1", "-ERR wrongtype operation\r\n"));
+	});
+	cleanup(ht);
+}
+
+void test_interpret_zset(HashTable *ht) {
+	test_zadd(ht);
+	test_zrank(ht);
+	test_zrange(ht);
+}